@@ -0,0 +1,130 @@
+#version 430 core
+// Instances of Component::CrowdRenderer, animated from the baked vertex animation textures
+// The matrices are sent transposed by WrapperRHI, the vectors are multiplied on the left as on the CPU
+
+// Vertex of Resources::SkeletalMesh : position, uv, normal, tangent, 8 bone indices then 8 bone weights
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in vec3 aNormal;
+layout (location = 3) in vec3 aTangent;
+layout (location = 4) in vec4 aBoneIndices0;
+layout (location = 5) in vec4 aBoneIndices1;
+layout (location = 6) in vec4 aBoneWeights0;
+layout (location = 7) in vec4 aBoneWeights1;
+
+// Per instance
+// position xyz, scale
+layout (location = 8) in vec4 aInstancePosition;
+// sin(yaw), cos(yaw), speed, time offset
+layout (location = 9) in vec4 aInstanceMotion;
+// first frame, frame count, sample rate of the clip
+layout (location = 10) in vec4 aInstanceClip;
+
+uniform mat4 VPMatrix;
+uniform mat4 modelMatrix;
+uniform float crowdTime;
+// Resources::VertexAnimationMode, 0 vertices, 1 bones
+uniform int vatMode;
+uniform int vatWidth;
+uniform int vatRowsPerFrame;
+// Skinned positions, or the 3 columns of each bone matrix
+uniform sampler2D vatPositions;
+// Skinned normals, vertices mode only
+uniform sampler2D vatNormals;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoord;
+out vec3 Tangent;
+
+const int ModeVertices = 0;
+
+// Same as VertexAnimationData::GetTexelOffset
+vec4 FetchTexel(sampler2D vat, int frame, int index)
+{
+	return texelFetch(vat, ivec2(index % vatWidth, frame * vatRowsPerFrame + index / vatWidth), 0);
+}
+
+// Same as VertexAnimationClip::GetFrame
+float GetFrame(float time)
+{
+	float firstFrame = aInstanceClip.x;
+	float frameCount = aInstanceClip.y;
+	if (frameCount < 2.0)
+		return firstFrame;
+	float span = frameCount - 1.0;
+	float frame = mod(time * aInstanceClip.z, span);
+	return firstFrame + frame;
+}
+
+// Skinned position and normal of the vertex at a baked frame, blended from the bone matrices
+void SkinFrame(int frame, out vec3 position, out vec3 normal)
+{
+	float bones[8] = float[8](aBoneIndices0.x, aBoneIndices0.y, aBoneIndices0.z, aBoneIndices0.w, aBoneIndices1.x, aBoneIndices1.y, aBoneIndices1.z, aBoneIndices1.w);
+	float weights[8] = float[8](aBoneWeights0.x, aBoneWeights0.y, aBoneWeights0.z, aBoneWeights0.w, aBoneWeights1.x, aBoneWeights1.y, aBoneWeights1.z, aBoneWeights1.w);
+
+	position = vec3(0.0);
+	normal = vec3(0.0);
+	float totalWeight = 0.0;
+	for (int i = 0; i < 8; i++)
+	{
+		if (weights[i] <= 0.0)
+			continue;
+		int bone = int(bones[i]);
+		// One texel per column of the skinning matrix
+		vec4 column0 = FetchTexel(vatPositions, frame, bone * 3);
+		vec4 column1 = FetchTexel(vatPositions, frame, bone * 3 + 1);
+		vec4 column2 = FetchTexel(vatPositions, frame, bone * 3 + 2);
+		vec4 point = vec4(aPos, 1.0);
+		vec4 direction = vec4(aNormal, 0.0);
+		position += vec3(dot(point, column0), dot(point, column1), dot(point, column2)) * weights[i];
+		normal += vec3(dot(direction, column0), dot(direction, column1), dot(direction, column2)) * weights[i];
+		totalWeight += weights[i];
+	}
+	// Same as the baker, a vertex without weight stays in its rest pose
+	if (totalWeight <= 0.0)
+	{
+		position = aPos;
+		normal = aNormal;
+	}
+}
+
+void main()
+{
+	float frame = GetFrame(crowdTime * aInstanceMotion.z + aInstanceMotion.w);
+	int frame0 = int(floor(frame));
+	// The last frame of a clip is never passed, the next one is still in the clip
+	int frame1 = min(frame0 + 1, int(aInstanceClip.x + aInstanceClip.y) - 1);
+	float blend = frame - float(frame0);
+
+	vec3 position;
+	vec3 normal;
+	if (vatMode == ModeVertices)
+	{
+		position = mix(FetchTexel(vatPositions, frame0, gl_VertexID).xyz, FetchTexel(vatPositions, frame1, gl_VertexID).xyz, blend);
+		normal = mix(FetchTexel(vatNormals, frame0, gl_VertexID).xyz, FetchTexel(vatNormals, frame1, gl_VertexID).xyz, blend);
+	}
+	else
+	{
+		vec3 position0, position1, normal0, normal1;
+		SkinFrame(frame0, position0, normal0);
+		SkinFrame(frame1, position1, normal1);
+		position = mix(position0, position1, blend);
+		normal = mix(normal0, normal1, blend);
+	}
+
+	// Scaled, turned around the up axis then moved to the instance, relative to the game object
+	float sinYaw = aInstanceMotion.x;
+	float cosYaw = aInstanceMotion.y;
+	mat3 yaw = mat3(cosYaw, 0.0, -sinYaw,
+					0.0,    1.0, 0.0,
+					sinYaw, 0.0, cosYaw);
+	vec3 local = yaw * (position * aInstancePosition.w) + aInstancePosition.xyz;
+
+	vec4 world = vec4(local, 1.0) * modelMatrix;
+	FragPos = world.xyz;
+	Normal = normalize((vec4(yaw * normal, 0.0) * modelMatrix).xyz);
+	Tangent = normalize((vec4(yaw * aTangent, 0.0) * modelMatrix).xyz);
+	TexCoord = aTexCoord;
+	gl_Position = world * VPMatrix;
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <Components/BaseComponent.h>
+#include <Resources/AnimationController.h>
 
 namespace Resources
 {
@@ -8,30 +9,82 @@ namespace Resources
 	struct Link;
 	struct StateRect;
 }
+namespace Core
+{
+	class AnimationSystem;
+}
 namespace Component 
 {
+	enum class AnimatorCullingMode
+	{
+		// Evaluated at the rate of the last lod level
+		AlwaysAnimate,
+		// The state machine and the time keep advancing, the pose is not evaluated
+		AdvanceTime,
+		// Nothing is updated until a camera sees it again
+		CullCompletely,
+	};
+
+	enum class AnimatorLODMetric
+	{
+		// Height fraction of the screen covered by the bounds
+		ScreenSize,
+		Distance,
+	};
+
+	struct AnimatorLODSettings
+	{
+		static constexpr int LevelCount = 4;
+
+		// Opt-in, the animators of the scenes saved without lod line are evaluated every frame as before
+		bool enabled = false;
+		AnimatorLODMetric metric = AnimatorLODMetric::ScreenSize;
+		// Start of the levels 1 to 3, in the unit of the metric
+		float thresholds[LevelCount - 1] = { 0.3f, 0.12f, 0.04f };
+		// Frames between two pose evaluations at each level
+		int updateIntervals[LevelCount] = { 1, 2, 4, 8 };
+		// Blends toward each evaluated pose over the skipped frames, the pose is late by up to one interval
+		bool interpolate = true;
+		// Depth of the deepest bone sampled at the last level, -1 for every bone
+		int lastLevelBoneDepth = -1;
+		// Outside of every camera
+		AnimatorCullingMode cullingMode = AnimatorCullingMode::AdvanceTime;
+	};
+
 	class Animator : public IComponent<Animator>
 	{
 	private:
 		friend Resources::AnimationController;
+		friend Core::AnimationSystem;
 
 		Resources::AnimationController* m_animationController = nullptr;
 		class SkeletalMeshComponent* m_skeletalMesh = nullptr;
 
 		bool m_play = true;
 
-		std::unordered_map<std::string, bool> m_parameters;
-
-		Resources::StateRect* m_currentState;
-		bool m_conditionUpdated = true;
-
-		float m_currentTime = 0.0f;
-
-		Resources::Animation* m_lastAnimation = nullptr;
-		Resources::Link* m_transitionLink = nullptr;
-		float m_elapsedTime = 0.0f; // Transition Elapsed Time.
-
-		bool m_endExitTime = false;
+		// Indexed like m_animationController->parameters
+		std::vector<Resources::AnimatorValue> m_parameters;
+		// Ids and types the values were built for, used to keep them when the controller changes
+		std::vector<int> m_parameterIDs;
+		std::vector<Resources::AnimatorParameterType> m_parameterTypes;
+		uint32_t m_parameterVersion = (uint32_t)-1;
+
+		Resources::AnimatorStateBlock m_state;
+		// Indexed like the compiled layers of the controller
+		std::vector<Resources::AnimatorStateBlock> m_layerStates;
+
+		AnimatorLODSettings m_lod;
+		// Chosen by the animation system every frame
+		int m_lodLevel = 0;
+		bool m_visible = true;
+		float m_screenSize = 1.f;
+		int m_framesSinceEvaluation = 0;
+		float m_pendingDeltaTime = 0.f;
+		// Time since the last evaluation, used by the current one
+		float m_deltaTime = 0.f;
+		bool m_evaluatePose = true;
+		// False when the last evaluation skipped the pose, nothing to interpolate from
+		bool m_poseValid = false;
 		//TMP
 		bool active = false;
 
@@ -49,18 +102,46 @@ namespace Component
 
 		void GameUpdate() override;
 
-		void SetBoolean(const std::string& name, bool value);
+		// Main thread part of the evaluation, before the animators are evaluated in parallel
+		void PrepareEvaluation();
+		// State machine and pose of this animator only, run by the animation system on a job thread
+		void Evaluate();
+		// Frame without evaluation, keeps or interpolates the last pose
+		void SkipEvaluation();
 
-		void SetSkeletalMesh(class SkeletalMeshComponent* _skeletalMesh);
+		AnimatorLODSettings& GetLODSettings() { return m_lod; }
+		// Frames between two evaluations at the current lod level
+		int GetUpdateInterval() const;
+		int GetLODLevel() const { return m_lodLevel; }
+
+		// FNV-1a of the parameter name, scripts resolve it once and keep the id
+		static int StringToHash(std::string_view name);
 
-		void SetTransitionLink(Resources::Link* link);
+		void SetBool(int id, bool value);
+		void SetFloat(int id, float value);
+		void SetInteger(int id, int value);
+		void SetTrigger(int id);
+		void ResetTrigger(int id);
 
-		void IncrementTime(Resources::Animation* anim);
+		bool GetBool(int id) const;
+		float GetFloat(int id) const;
+		int GetInteger(int id) const;
+
+		void SetBoolean(const std::string& name, bool value) { SetBool(StringToHash(name), value); }
+
+		void SetSkeletalMesh(class SkeletalMeshComponent* _skeletalMesh);
+
+		// Advances "time" by the frame delta, "length" is the length of the state in frames
+		void IncrementTime(const Resources::CompiledState& state, float length, float& time);
 
 		void ReadComponent(std::fstream& sceneFile) override;
 
 		std::ostream& operator<<(std::ostream& os) override;
 
-	
+	private:
+		// Index of the parameter "id" if it has the expected type, -1 otherwise
+		int GetParameterIndex(int id, Resources::AnimatorParameterType type) const;
+		// Same, after remapping the values if the controller parameters changed
+		int SyncParameterIndex(int id, Resources::AnimatorParameterType type);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,127 @@
+#pragma once
+#include "PandorAPI.h"
+#include <Components/BaseComponent.h>
+#include <Resources/VertexAnimation.h>
+
+namespace Resources
+{
+	class SkeletalMesh;
+	class Skeleton;
+	class Animation;
+	class Material;
+	class Shader;
+	class VertexShader;
+}
+namespace Core::Wrapper::WrapperRHI
+{
+	class Buffer;
+}
+namespace Component
+{
+	struct CrowdInstance
+	{
+		// Relative to the game object
+		Math::Vector3 position;
+		// Around the up axis, in degrees
+		float yaw = 0.f;
+		float scale = 1.f;
+		// Index in the baked clips
+		int clip = 0;
+		// In seconds, so the instances playing the same clip are not in sync
+		float timeOffset = 0.f;
+		float speed = 1.f;
+	};
+
+	// Grid the instances are placed on when they are not given by a script
+	struct CrowdLayout
+	{
+		int count = 100;
+		int columns = 10;
+		float spacing = 1.5f;
+		// Random offset of each instance, in fraction of the spacing
+		float jitter = 0.3f;
+		// The speed of each instance is picked in [1 - variation, 1 + variation]
+		float speedVariation = 0.1f;
+		int seed = 0;
+	};
+
+	// Draws many copies of a skeletal mesh in one instanced call, animated from baked vertex animation textures
+	// No skeleton is evaluated per instance, each one only picks a clip and a time offset
+	class PANDOR_API CrowdRenderer : public IComponent<CrowdRenderer>
+	{
+	public:
+		CrowdRenderer();
+		// The GPU data is not shared, the copy bakes its own
+		CrowdRenderer(const CrowdRenderer& other);
+		~CrowdRenderer();
+
+		std::string GetComponentName() override { return "Crowd Renderer"; }
+
+		void ShowInInspector() override;
+
+		void Initialize() override;
+		void Update() override;
+		void Draw() override;
+
+		void SetMesh(Resources::SkeletalMesh* mesh);
+		void SetSkeleton(Resources::Skeleton* skeleton);
+		void SetMaterial(Resources::Material* material);
+		void AddAnimation(Resources::Animation* animation);
+		void RemoveAnimation(size_t index);
+
+		// Replaces the instances placed by the layout until GenerateInstances is called
+		void SetInstances(const std::vector<CrowdInstance>& instances);
+		const std::vector<CrowdInstance>& GetInstances() const { return m_instances; }
+		// Places the instances on the grid of the layout, the same seed gives the same crowd
+		void GenerateInstances();
+
+		// Samples the animations into the textures, done on the next update when the inputs changed
+		bool Bake();
+		const Resources::VertexAnimationData& GetBakedData() const { return m_baked; }
+
+		std::ostream& operator<<(std::ostream& os) override;
+
+		void ReadComponent(std::fstream& sceneFile) override;
+
+	private:
+		void LoadPendingResources();
+		void UpdateShader();
+		void CreateBuffers();
+		void UploadInstances();
+		void UploadTextures();
+		void DeleteGPUData();
+		bool IsVisible();
+
+		std::string m_meshToLoad;
+		std::string m_skeletonToLoad;
+
+		Resources::SkeletalMesh* m_mesh = nullptr;
+		Resources::Skeleton* m_skeleton = nullptr;
+		std::vector<Resources::Animation*> m_animations;
+		Resources::Material* m_material = nullptr;
+		Resources::VertexShader* m_crowdVertShader = nullptr;
+		Resources::Shader* m_shader = nullptr;
+
+		Resources::VertexAnimationBakeSettings m_bakeSettings;
+		Resources::VertexAnimationData m_baked;
+		bool m_bakeDirty = true;
+		bool m_texturesDirty = false;
+
+		CrowdLayout m_layout;
+		bool m_useLayout = true;
+		bool m_instancesDirty = true;
+		std::vector<CrowdInstance> m_instances;
+		// Bounds of the instance positions
+		Math::Vector3 m_instancesMin;
+		Math::Vector3 m_instancesMax;
+		float m_maxScale = 1.f;
+
+		Core::Wrapper::WrapperRHI::Buffer* m_buffer = nullptr;
+		Core::Wrapper::WrapperRHI::Buffer* m_instanceBuffer = nullptr;
+		unsigned int m_positionTexture = 0;
+		unsigned int m_normalTexture = 0;
+
+		float m_time = 0.f;
+		float m_playbackSpeed = 1.f;
+	};
+}
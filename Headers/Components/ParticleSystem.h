@@ -1,6 +1,6 @@
 #pragma once
 #include <Components/BaseComponent.h>
-#include <random>
+#include <array>
 namespace Resources
 {
 	class Mesh;
@@ -11,76 +11,125 @@ namespace Resources
 namespace Render
 {
 	class EditorIcon;
+	class Camera;
+	struct Frustum;
+	class GPUParticles;
 }
 namespace Core::Wrapper::WrapperRHI
 {
 	class Buffer;
 }
+namespace Core
+{
+	class ParticleManager;
+}
 namespace Component
 {
 	struct InstanceData
 	{
 		Vector4 xyzs = { 0, 0, 0, 0 };
 		Vector4 color = { 1, 1, 1, 1 };
-
-		float* datas()
-		{
-			std::vector<float> floatArray(8);  // Allocate memory for 8 floats (2 vectors * 4 components)
-
-			floatArray[0] = xyzs.x;
-			floatArray[1] = xyzs.y;
-			floatArray[2] = xyzs.z;
-			floatArray[3] = xyzs.w;
-
-			floatArray[4] = color.x;
-			floatArray[5] = color.y;
-			floatArray[6] = color.z;
-			floatArray[7] = color.w;
-
-			return floatArray.data();  // Return pointer to the underlying float array
-		}
 	};
 
-	class Particle
+	// Xorshift generator, 4 bytes of state, good enough for spawn parameters
+	struct ParticleRandom
 	{
-	public:
-		Particle(class ParticleSystem* ps, int index);
-		~Particle() {}
-
-		inline InstanceData GetDatas();
-
-		inline void Initialize();
-
-		inline void Update(float elapsedTime);
+		uint32_t state = 0x9E3779B9u;
 
-		inline void Reset();
+		ParticleRandom() {}
+		ParticleRandom(uint32_t seed) : state(seed ? seed : 0x9E3779B9u) {}
 
-		inline void SetParameters();
-	private:
-		friend class ParticleSystem;
-		class ParticleSystem* m_particleSystem = nullptr;
-		size_t m_index = 0;
+		uint32_t Next()
+		{
+			state ^= state << 13;
+			state ^= state >> 17;
+			state ^= state << 5;
+			return state;
+		}
 
-		Math::Matrix4 m_xyzs;
+		// In [0, 1)
+		float Float() { return (Next() >> 8) * (1.f / 16777216.f); }
+		float Range(float min, float max) { return min + (max - min) * Float(); }
+	};
 
-		float m_startTime = 0.f;
-		float m_lifeTime = 0.f; // current time
+	class Collider;
 
-		float m_size = 0.1f;
-		bool m_alive = false;
+	// Particles in structure of arrays, the alive ones are packed at the front
+	// The arrays are padded to a multiple of 4 so the update works on 4 particles at once
+	struct ParticleBuffer
+	{
+		size_t capacity = 0;
+		size_t aliveCount = 0;
+
+		// World space
+		std::vector<float> positionX, positionY, positionZ;
+		std::vector<float> velocityX, velocityY, velocityZ;
+		// In seconds
+		std::vector<float> age, lifetime;
+		std::vector<float> size;
+		// Vertical acceleration
+		std::vector<float> gravity;
+		std::vector<float> colorR, colorG, colorB, colorA;
+		// Surface ahead of the particle found by the world collision, a null normal for none
+		std::vector<float> planeNormalX, planeNormalY, planeNormalZ, planeDistance;
+
+		// Collider of the surface, only looked up when the collision sends events
+		std::vector<Collider*> planeCollider;
+
+		static constexpr size_t StreamCount = 18;
+		std::array<std::vector<float>*, StreamCount> GetStreams();
+
+		void Resize(size_t count);
+		void Clear() { aliveCount = 0; }
+		// Moves the last alive particle in its place
+		void Kill(size_t index);
+		size_t GetMemorySize() const;
+	};
 
-		Vector3 m_position;
-		Vector4 m_color = Vector4(1.f);
+	enum class ParticleCollisionMode : int
+	{
+		// Against the planes of the settings only
+		Planes,
+		// Raycasts in the physics scene, the surface found is kept as a plane until the next query
+		World,
+	};
 
-		//For shape
-		Vector3 m_offset;
-		Vector3 m_direction;
+	struct ParticleCollisionPlane
+	{
+		// World space, pointing to the side the particles stay on
+		Vector3 normal = Vector3(0.f, 1.f, 0.f);
+		// Along the normal, from the world origin
+		float distance = 0.f;
+	};
 
-		std::mt19937 m_seed;
+	struct ParticleCollisionSettings
+	{
+		ParticleCollisionMode mode = ParticleCollisionMode::Planes;
+		std::vector<ParticleCollisionPlane> planes = { ParticleCollisionPlane() };
+		// Fraction of the velocity along the normal kept after a hit
+		float bounce = 0.5f;
+		// Fraction of the velocity along the surface lost on each hit
+		float dampen = 0.f;
+		// Fraction of the lifetime lost on each hit
+		float lifetimeLoss = 0.f;
+		bool killOnHit = false;
+		// Collision radius, in fraction of the particle size
+		float radiusScale = 1.f;
+		// World mode, frames between two queries of a particle, the queries are spread over these frames
+		int queryInterval = 4;
+		bool sendEvents = false;
+		// Events kept per frame
+		size_t maxEvents = 64;
+	};
 
-		float m_randomLifetime;
-		float m_randomSpeed;
-		float m_randomGravityModifier;
+	struct ParticleCollisionEvent
+	{
+		Vector3 position;
+		Vector3 normal;
+		// Before the hit
+		Vector3 velocity;
+		// Null for a plane of the settings
+		Collider* collider = nullptr;
 	};
 
 	enum class ParticleShape : int
@@ -116,11 +165,10 @@ namespace Component
 			Max = value2;
 		}
 
-		inline T GetRandomValue(std::mt19937 seed)
+		inline T GetRandomValue(ParticleRandom& random)
 		{
 			if (Min == Max || Min > Max) return Min;
-			std::uniform_real_distribution<T> value(Min, Max);
-			return value(seed);
+			return random.Range(Min, Max);
 		}
 	};
 
@@ -152,7 +200,7 @@ namespace Component
 
 		void ReadValue(std::fstream& sceneFile);
 
-		T GetRandomValue(std::mt19937 seed)
+		T GetRandomValue(ParticleRandom& random)
 		{
 			if (Mode == ValueMode::Constant)
 			{
@@ -160,7 +208,7 @@ namespace Component
 			}
 			else
 			{
-				return Value.GetRandomValue(seed);
+				return Value.GetRandomValue(random);
 			}
 		}
 
@@ -184,7 +232,8 @@ namespace Component
 
 		void ReInitialize();
 
-		void InitializeParticles();
+		// Kills every particle and starts emitting again
+		void Restart();
 
 		void SetMesh(Resources::Mesh* mesh);
 
@@ -208,8 +257,56 @@ namespace Component
 
 		std::string GetComponentName() override { return "Particle System"; }
 
+		// The particles simulated on the GPU are never read back, 0 for them
+		size_t GetAliveCount() const { return m_particles.aliveCount; }
+		// Simulated by compute shaders, when asked and supported
+		bool IsSimulatedOnGPU() const { return m_gpu != nullptr; }
+		ParticleCollisionSettings& GetCollisionSettings() { return m_collision; }
+		// Hits of the last simulated frame, when the collision sends events
+		const std::vector<ParticleCollisionEvent>& GetCollisionEvents() const { return m_collisionEvents; }
+
+		// World bounds of the alive particles and of the emitter volume
+		const Vector3& GetBoundsMin() const { return m_boundsMin; }
+		const Vector3& GetBoundsMax() const { return m_boundsMax; }
+		bool IsVisible(const Render::Frustum& frustum) const;
+		// Systems with a higher priority keep emitting when the particle budget is reached
+		int GetPriority() const { return m_priority; }
+
 	private:
-		friend class Particle;
+		friend Core::ParticleManager;
+
+		// Steps run by the particle manager, the ranges are run in parallel and only touch their own particles
+		// Main thread, before the jobs
+		void BeginSimulation();
+		// Integration, collision and color over life, "begin" is a multiple of 4
+		void SimulateRange(size_t begin, size_t end);
+		void CollideRange(size_t begin, size_t end);
+		// World mode, queries the particles due this frame and keeps the surface they are heading to
+		void QueryWorldRange(size_t begin, size_t end);
+		// Removes the dead particles, then counts the ones emitted this frame
+		void EndSimulation();
+		// Advances the time by the pending step and returns the particles emitted during it
+		size_t UpdateEmission();
+		// Main thread, replaces every step above for the systems simulated on the GPU
+		void SimulateOnGPU();
+		// Reserves "count" emitted particles at the end of the alive ones, at most the emitted count
+		void CommitSpawn(size_t count);
+		// "begin" and "end" are relative to the first emitted particle
+		void SpawnRange(size_t begin, size_t end, ParticleRandom& random);
+		void SpawnParticle(size_t index, ParticleRandom& random);
+		// Back to front order of the alive particles, used by WriteRange
+		void SortParticles(const Vector3& viewPosition, const Vector3& viewForward);
+		// Also returns the bounds of the written particles
+		void WriteRange(size_t begin, size_t end, Vector3& min, Vector3& max);
+		// Main thread, after the jobs, with the bounds of the written particles
+		void EndUpload(const Vector3& min, const Vector3& max);
+		// Half size of the box particles are spawned in, around the emitter
+		float GetEmitterExtent() const;
+		// Bounds of the last simulated particles and of the emitter at its current position
+		void UpdateBounds();
+		// Seed of the spawn chunk, the same for any number of threads
+		uint32_t GetSpawnSeed(size_t chunk) const;
+
 		std::string m_meshToLoad;
 
 		Resources::Mesh* m_mesh = nullptr;
@@ -217,30 +314,65 @@ namespace Component
 		Resources::Shader* m_shader = nullptr;
 		Resources::Shader* m_pickingShader = nullptr;
 		Resources::Material* m_material = nullptr;
+		// Blended particles drawn back to front from the first camera
+		bool m_sortByDepth = false;
 		Core::Wrapper::WrapperRHI::Buffer* m_buffer = nullptr;
+		// Instances of the alive particles, written by the simulation in a persistently mapped ring
 		Core::Wrapper::WrapperRHI::Buffer* m_buffer2 = nullptr;
-
-		std::vector<InstanceData>  m_datas;
-		std::vector<Particle*> m_particles;
+		// The particles stay on the GPU, no CPU particle is allocated
+		bool m_simulateOnGPU = false;
+		Render::GPUParticles* m_gpu = nullptr;
+
+		ParticleBuffer m_particles;
+		ParticleRandom m_random;
+		// 0 picks a new seed on each restart
+		uint32_t m_seed = 0;
+		uint32_t m_currentSeed = 0;
+		// Frames that emitted since the restart
+		uint32_t m_spawnFrame = 0;
+		size_t m_spawnBegin = 0;
+		size_t m_spawnCount = 0;
+		float m_pendingDeltaTime = 0.f;
+		// Frames simulated since the restart, the world queries are spread with it
+		uint32_t m_simulationFrame = 0;
+		// Collision events of each chunk, merged when the simulation ends
+		std::vector<std::vector<ParticleCollisionEvent>> m_chunkEvents;
+		std::vector<ParticleCollisionEvent> m_collisionEvents;
+		// Emission multiplier from the distance to the cameras, set by the particle manager
+		float m_emissionScale = 1.f;
+		// Simulation time skipped while invisible, caught up when visible again
+		float m_skippedTime = 0.f;
+		// Sorted particle indices and their depth keys, with the radix sort buffers
+		bool m_sorted = false;
+		std::vector<uint32_t> m_sortIndices, m_sortKeys, m_sortIndicesScratch, m_sortKeysScratch;
+		Vector3 m_particlesMin;
+		Vector3 m_particlesMax;
+		Vector3 m_boundsMin;
+		Vector3 m_boundsMax;
+		// Region of the instance buffer written this frame
+		float* m_mappedInstances = nullptr;
 
 		bool m_play = false;
 		float m_time = 0.0f;
-		float m_lastUpdateTime = 0.0f;
 		float m_speed = 1.f;
 		size_t m_particleNumber = 1000;
-		size_t m_currentParticleNumber = 0;
+		// Fraction of particle left from the previous emissions
+		float m_emissionAccumulator = 0.f;
+		float m_currentStartDelay = 0.f;
 		Vector3 m_worldPosition;
 		Quaternion m_worldRotation;
 
 		// Main
 		float m_duration = 5.f;
 		bool m_loop = true;
-		bool m_shouldRestart = false;
 		MinMaxValue<float> m_startDelay = 0.f;
 		MinMaxValue<float> m_particleLifeTime = 5.f;
 		MinMaxValue<float> m_startSpeed = 5.f;
 		MinMaxValue<float> m_startSize = 0.1f;
 		MinMaxValue<float> m_gravityModifier = 0;
+		int m_priority = 0;
+		// Not simulated outside every camera, the skipped time is simulated in one step when seen again
+		bool m_pauseWhenInvisible = false;
 
 		//Emission
 		bool m_enableEmission = true;
@@ -253,6 +385,9 @@ namespace Component
 		MinMaxValue<float> m_angle = 25.f;
 		Vector3 m_scale = Vector3(1.f);
 
+		bool m_enableCollision = false;
+		ParticleCollisionSettings m_collision;
+
 		bool m_enableColorOverTime = false;
 		MinMaxValue<Vector4> m_colorOverTime = MinMaxValue(Vector4{ 1, 1, 1, 1 }, ValueMode::Random);
 
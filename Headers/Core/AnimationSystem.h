@@ -0,0 +1,62 @@
+#pragma once
+#include "PandorAPI.h"
+
+#include <vector>
+
+namespace Component
+{
+	class Animator;
+}
+namespace Render
+{
+	class Camera;
+}
+
+namespace Core
+{
+	// Limits shared by every animator of the scene
+	struct AnimationBudget
+	{
+		// Pose evaluations per frame, 0 for no limit. The animators over the budget wait for a later frame,
+		// the ones waiting for the longest time then the largest on screen go first
+		size_t maxEvaluations = 0;
+		// Multiplies the lod distances and the screen sizes, above 1 the levels drop later
+		float lodBias = 1.f;
+	};
+
+	// Evaluates every animator of the frame together, once the scene is updated
+	// State machines, clip sampling, blending and skinning palettes have no dependency between
+	// two animators so they are spread over the job threads
+	class PANDOR_API AnimationSystem
+	{
+	public:
+		// Called by the animators during the scene update, only for the current frame
+		void Register(Component::Animator* animator);
+		void Unregister(Component::Animator* animator);
+
+		// Evaluates the registered animators then clears the list
+		// The lod levels are chosen from the cameras, every animator is at full rate without camera
+		void Update(const std::vector<Render::Camera*>& cameras);
+
+		size_t GetAnimatorCount() const { return m_animators.size(); }
+		// Evaluations of the last update
+		size_t GetEvaluationCount() const { return m_evaluationCount; }
+
+		AnimationBudget budget;
+
+	private:
+		// Visibility, screen size and lod level of the animator
+		void UpdateLOD(Component::Animator* animator, const std::vector<Render::Camera*>& cameras) const;
+
+		struct Job
+		{
+			Component::Animator* animator;
+			bool evaluate;
+		};
+
+		std::vector<Component::Animator*> m_animators;
+		std::vector<Component::Animator*> m_due;
+		std::vector<Job> m_jobs;
+		size_t m_evaluationCount = 0;
+	};
+}
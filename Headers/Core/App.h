@@ -58,6 +58,11 @@ namespace Core
 		bool fullscreen = false;
 		bool resizableScreen = false;
 		Vector2 screenSize = { 1600, 900 };
+		// Counts the managed allocations in the script profiler, slows every allocation, read when the scripting starts
+		bool profileScriptAllocations = false;
+		// Tolerances of the animations compressed on import, see Resources::AnimationCompressionSettings
+		float animationPositionTolerance = 0.0005f;
+		float animationRotationTolerance = 0.001f;
 
 		void Save();
 		void Load(const std::string& projectPath);
@@ -70,6 +75,10 @@ namespace Core
 		Pause
 	};
 
+	class AnimationSystem;
+	class ParticleManager;
+	class RenderQueue;
+
 	class PANDOR_API App
 	{
 	private:
@@ -82,6 +91,9 @@ namespace Core
 		std::deque<std::string>   m_resourceToSend;
 
 		GameState m_gameState = GameState::Editor;
+		// Rendered by a plugged backend, there is no window nor UI
+		bool m_headless = false;
+		Math::Vector2 m_headlessSize;
 	public:
 		ThreadManager* threadManager = nullptr;
 		Resources::ResourcesManager* resourcesManager = nullptr;
@@ -89,6 +101,9 @@ namespace Core
 
 		Core::Wrapper::WrapperWindow* window = nullptr;
 		Core::Wrapper::WrapperPhysic::PhysicManager* physic = nullptr;
+		AnimationSystem* animationSystem = nullptr;
+		ParticleManager* particleManager = nullptr;
+		RenderQueue* renderQueue = nullptr;
 		Core::Wrapper::WrapperAudio::AudioManager* audioManager;
 
 		unsigned char data[4];
@@ -122,6 +137,7 @@ namespace Core
 		void InitializeAudio();
 		void InitializeResources();
 		void ExecuteEventQueue();
+		void SendNextResource();
 		void CloseAppPopup();
 #ifndef PANDOR_GAME
 		void SaveEngineParameters();
@@ -136,8 +152,14 @@ namespace Core
 #ifndef PANDOR_GAME
 		EditorUI::EditorUiManager& GetEditorUIManager() { return *m_editorUIManager; }
 #endif
+		// Headless when a WrapperRHI backend is plugged before
 		void Init(AppInit init, const std::string& projectPath);
 		void Update();
+		// One frame of the current scene, without a window nor UI
+		void UpdateHeadless();
+		bool IsHeadless() const { return m_headless; }
+		// Size of the window, the one given to Init when headless
+		Math::Vector2 GetScreenSize() const;
 		void Clear();
 		void CloseApp();
 		void Delete();
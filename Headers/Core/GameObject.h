@@ -89,10 +89,10 @@ namespace Core
 
 		static GameObject* GetSceneNode();
 
-		void UpdateSelfAndChild(size_t& _index);
+		virtual void UpdateSelfAndChild(size_t& _index);
 		void DrawModelForShadow();
 
-		void DrawSelfAndChild(bool editorCamera = false);
+		virtual void DrawSelfAndChild(bool editorCamera = false);
 
 		void UpdateIndex(size_t& _index);
 
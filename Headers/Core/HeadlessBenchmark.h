@@ -0,0 +1,24 @@
+#pragma once
+#include "PandorAPI.h"
+#include <Core/Wrappers/RHIBackend.h>
+
+#include <string>
+
+namespace Core
+{
+	struct HeadlessBenchmarkResult
+	{
+		size_t frames = 0;
+		// Milliseconds of CPU per frame
+		double averageFrameTime = 0.0;
+		double minFrameTime = 0.0;
+		double maxFrameTime = 0.0;
+		// Commands of every measured frame
+		Core::Wrapper::WrapperRHI::BackendStats stats;
+	};
+
+	// Runs the first scene of the project for "frameCount" frames without a window, the commands go to a NullBackend
+	// Measures the CPU side of the update and of the rendering, the resources are loaded and sent before the first frame
+	// Creates and deletes the App, none must exist
+	PANDOR_API HeadlessBenchmarkResult RunHeadlessBenchmark(const std::string& projectPath, size_t frameCount);
+}
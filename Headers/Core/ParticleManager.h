@@ -0,0 +1,144 @@
+#pragma once
+#include "PandorAPI.h"
+#include <Math/Maths.h>
+
+#include <vector>
+#include <functional>
+
+namespace Component
+{
+	class ParticleSystem;
+}
+namespace Render
+{
+	class Camera;
+}
+namespace Resources
+{
+	class Mesh;
+	class Material;
+	class Shader;
+}
+namespace Core::Wrapper::WrapperRHI
+{
+	class Buffer;
+}
+
+namespace Core
+{
+	// Limits shared by every particle system of the scene
+	struct ParticleBudget
+	{
+		// Alive particles over every simulated system, 0 for no limit. Once reached the systems stop emitting,
+		// the highest priority then the nearest ones keep the remaining particles
+		size_t maxParticles = 0;
+		// Emission is reduced with the distance to the nearest camera, from fullEmissionDistance to reducedEmissionDistance
+		bool distanceReduction = false;
+		float fullEmissionDistance = 30.f;
+		float reducedEmissionDistance = 150.f;
+		// Emission multiplier at reducedEmissionDistance and further
+		float minEmissionScale = 0.1f;
+		// Longest time simulated at once when an invisible system is seen again, in seconds
+		float maxCatchUpTime = 5.f;
+	};
+
+	// Simulates every particle system of the frame together, once the scene is updated
+	// Small systems are one job each, large ones are cut in chunks spread over the job threads
+	// The systems simulated on the GPU are only dispatched, their particles are not counted
+	class PANDOR_API ParticleManager
+	{
+	public:
+		// Particles per job, a multiple of 4 for the update kernels
+		static constexpr size_t ChunkSize = 4096;
+
+		ParticleManager() {}
+		~ParticleManager();
+
+		// Called by the particle systems during the scene update, only for the current frame
+		void Register(Component::ParticleSystem* system);
+		void Unregister(Component::ParticleSystem* system);
+
+		// Simulates and uploads the registered systems then clears the list
+		// The systems are visible from every camera when there is none
+		// The particles of the systems sorted by depth are sorted for the first camera
+		void Update(const std::vector<Render::Camera*>& cameras);
+
+		// Called by the particle systems instead of drawing, for the current camera
+		void Submit(Component::ParticleSystem* system);
+		// Draws the submitted systems, far ones first, with one instanced draw per mesh and material
+		// Called once the scene is drawn, after the opaque objects
+		void DrawSubmitted();
+
+		size_t GetSystemCount() const { return m_systems.size(); }
+		// Alive particles after the last update
+		size_t GetParticleCount() const { return m_particleCount; }
+		// Systems paused outside the cameras in the last update
+		size_t GetCulledCount() const { return m_culledCount; }
+		// Instanced draws of the last DrawSubmitted, for the submitted systems
+		size_t GetDrawCount() const { return m_drawCount; }
+		size_t GetSubmittedCount() const { return m_submittedCount; }
+
+		ParticleBudget budget;
+
+	private:
+		struct Chunk
+		{
+			Component::ParticleSystem* system;
+			size_t begin;
+			size_t end;
+			// Written by the instance upload
+			Math::Vector3 min;
+			Math::Vector3 max;
+		};
+
+		struct Visibility
+		{
+			bool visible;
+			float distance;
+		};
+
+		struct Submission
+		{
+			Component::ParticleSystem* system;
+			float distance;
+		};
+
+		// Instances of the systems sharing a mesh, a material and a shader, copied on the GPU
+		struct Batch
+		{
+			Resources::Mesh* mesh = nullptr;
+			Resources::Material* material = nullptr;
+			Resources::Shader* shader = nullptr;
+			Core::Wrapper::WrapperRHI::Buffer* vertices = nullptr;
+			Core::Wrapper::WrapperRHI::Buffer* instances = nullptr;
+			size_t capacity = 0;
+		};
+
+		Visibility GetVisibility(Component::ParticleSystem* system, const std::vector<Render::Camera*>& cameras) const;
+		// Drops the invisible paused systems and scales the emission of the others
+		void PrepareSystems(const std::vector<Render::Camera*>& cameras);
+		// Cuts the emissions so the alive particles stay under the budget
+		void ApplyBudget();
+
+		// Cuts [0, count(system)) of every system in chunks
+		template<typename Count>
+		void BuildChunks(Count count);
+		void RunChunks(void (*job)(Chunk& chunk));
+		void RunSystems(const std::function<void(Component::ParticleSystem* system)>& job);
+		Batch& GetBatch(Resources::Mesh* mesh, Resources::Material* material, Resources::Shader* shader);
+		// Draws the submissions [begin, end), they share their mesh, material and shader
+		void DrawGroup(size_t begin, size_t end);
+
+		std::vector<Component::ParticleSystem*> m_systems;
+		// Distance to the nearest camera, parallel to m_systems
+		std::vector<float> m_distances;
+		std::vector<size_t> m_order;
+		std::vector<Chunk> m_chunks;
+		std::vector<Submission> m_submissions;
+		std::vector<Batch> m_batches;
+		size_t m_drawCount = 0;
+		size_t m_submittedCount = 0;
+		size_t m_particleCount = 0;
+		size_t m_culledCount = 0;
+	};
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "PandorAPI.h"
+#include <Math/Maths.h>
+
+#include <vector>
+#include <unordered_map>
+
+namespace Component
+{
+	class Transform;
+}
+namespace Resources
+{
+	class Mesh;
+	class Material;
+	class Shader;
+}
+
+namespace Core
+{
+	enum class RenderPass
+	{
+		Opaque,
+		// Materials with a diffuse alpha under 1, drawn after the opaque ones
+		Transparent,
+	};
+
+	// Mesh draws of the current camera, sorted to change the GPU state only when needed
+	// The mesh components submit their submeshes while the scene is drawn, each one is a packet sorted by a 64 bits key (high to low bits) :
+	//   opaque      : pass 2 | shader 12 | material 14 | mesh 12 | depth 24, front to back
+	//   transparent : pass 2 | depth 24, back to front | shader 12 | material 14 | mesh 12
+	// The shader, the material and the mesh are only sent again when their field of the key changes
+	class PANDOR_API RenderQueue
+	{
+	public:
+		RenderQueue() {}
+
+		// Called by the mesh components instead of drawing, one packet per submesh
+		void Submit(Resources::Mesh* mesh, Component::Transform* transform, const std::vector<Resources::Material*>& materials);
+		// Draws the submitted packets then clears them, called after each DrawSelfAndChild
+		void DrawSubmitted();
+
+		// Draws of the last DrawSubmitted
+		size_t GetDrawCount() const { return m_drawCount; }
+		size_t GetShaderChanges() const { return m_shaderChanges; }
+		size_t GetMaterialChanges() const { return m_materialChanges; }
+		size_t GetMeshChanges() const { return m_meshChanges; }
+
+	private:
+		struct Packet
+		{
+			Resources::Mesh* mesh;
+			Resources::Material* material;
+			Resources::Shader* shader;
+			size_t start;
+			size_t count;
+			Math::Matrix4 MVP;
+			Math::Matrix4 model;
+		};
+
+		// Dense index of a resource for the key, the same until the queue is drawn
+		static uint64_t GetIndex(std::unordered_map<const void*, uint64_t>& indices, const void* resource, uint64_t bits);
+		// Sorts m_order by m_keys, 8 bits per pass, the passes where every key has the same byte are skipped
+		void RadixSort();
+		// Sends what does not change between the draws of a shader
+		void BeginShader(Resources::Shader* shader);
+		void BeginMaterial(Resources::Material* material, Resources::Shader* shader);
+
+		std::vector<Packet> m_packets;
+		std::vector<uint64_t> m_keys;
+		std::vector<uint32_t> m_order;
+		std::vector<uint64_t> m_sortedKeys;
+		std::vector<uint32_t> m_sortedOrder;
+		std::unordered_map<const void*, uint64_t> m_shaderIndices;
+		std::unordered_map<const void*, uint64_t> m_materialIndices;
+		std::unordered_map<const void*, uint64_t> m_meshIndices;
+
+		// Same for every draw of the queue
+		Math::Matrix4 m_lightSpace;
+		Math::Vector3 m_upVector;
+		Math::Vector3 m_rightVector;
+		bool m_skybox = false;
+
+		size_t m_drawCount = 0;
+		size_t m_shaderChanges = 0;
+		size_t m_materialChanges = 0;
+		size_t m_meshChanges = 0;
+	};
+}
@@ -96,6 +96,8 @@ namespace Core
 
 		bool NeededResourcesLoaded(const std::string& path, Resources::Model*& sphere, Resources::Material*& material, Resources::Shader*& displayShader);
 		void AddObjectToList(GameObject* object);
+		// Draws the visible cameras of the scene, not the editor one
+		void DrawCameras(const Math::Vector2& size);
 
 	public :
 		void ChangeIndexObjectList(GameObject* object, uint64_t uuid);
@@ -125,6 +127,8 @@ namespace Core
 
 		void BeginPlay();
 		void Update();
+		// No window nor UI, only the cameras of the scene are updated and drawn
+		void UpdateHeadless();
 #ifndef PANDOR_GAME
 		void UpdatePrefabScene();
 #endif
@@ -4,6 +4,8 @@
 #include <thread>
 #include <vector>
 #include "mutex"
+#include <condition_variable>
+#include <atomic>
 #include <any>
 #include <functional>
 #include <queue>
@@ -20,9 +22,25 @@ namespace Core
 
         int m_maxThreads;
         std::atomic_bool m_shouldStopThreads = false;
+
+        // Frame jobs, woken on demand instead of polling the task list
+        std::vector<std::thread> m_jobThreads;
+        std::mutex m_jobMutex;
+        std::condition_variable m_jobStart;
+        std::condition_variable m_jobDone;
+        const std::function<void(size_t, size_t)>* m_job = nullptr;
+        size_t m_jobCount = 0;
+        size_t m_jobBatch = 1;
+        std::atomic<size_t> m_jobNext = 0;
+        uint64_t m_jobGeneration = 0;
+        // Job threads inside the current job
+        int m_jobWorkers = 0;
         
     private:
         void Life();
+        void JobLife();
+        // Runs the next batch of the current job, false when every batch is taken
+        bool RunJobBatch();
         
     public:
         //Delete all the copy constructors.
@@ -58,6 +76,20 @@ namespace Core
 			Unlock();
 		}
 
+        void AddtaskFunction(const std::function<void()>& task)
+		{
+			Lock();
+			m_taskList.emplace(task);
+			Unlock();
+		}
+
+        // Calls job(begin, end) on ranges of at most "batchSize" indices spread over the job threads
+        // The calling thread takes part and the call returns once every index was processed
+        void ParallelFor(size_t count, size_t batchSize, const std::function<void(size_t begin, size_t end)>& job);
+
+        int GetThreadCount() const { return m_maxThreads; }
+        int GetJobThreadCount() const { return (int)m_jobThreads.size(); }
+
 		void Lock();
 		void Unlock();
     };
@@ -0,0 +1,109 @@
+#pragma once
+#include "PandorAPI.h"
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+namespace Core::Wrapper::WrapperRHI
+{
+	enum class CommandType
+	{
+		Draw,
+		DrawIndirect,
+		Dispatch,
+		Clear,
+		BindProgram,
+		BindVertexArray,
+		BindBuffer,
+		BindTexture,
+		BindFramebuffer,
+		// Depth, stencil, cull, blend, polygon mode, vertex attributes and texture parameters
+		SetState,
+		SetViewport,
+		Uniform,
+		BufferUpload,
+		BufferCopy,
+		TextureUpload,
+		Create,
+		Delete,
+		Barrier,
+		// Pixels or values read back from the GPU
+		Readback,
+		Count,
+	};
+
+	struct Command
+	{
+		CommandType type;
+		// Program, buffer, texture or framebuffer, 0 when there is none
+		unsigned int object = 0;
+		// Vertices of a draw, work groups of a dispatch
+		size_t count = 0;
+		size_t instances = 0;
+		size_t bytes = 0;
+	};
+
+	// Receives the commands of WrapperRHI in place of OpenGL once plugged with SetBackend
+	// The objects it creates are only valid with it
+	class PANDOR_API Backend
+	{
+	public:
+		virtual ~Backend() {}
+
+		virtual const char* GetName() const = 0;
+		virtual void Submit(const Command& command) = 0;
+		// Name of a new program, buffer, vertex array, texture or framebuffer, never 0
+		virtual unsigned int CreateObject() = 0;
+		// The same name in the same program gives the same location
+		virtual int GetUniformLocation(unsigned int program, const char* name) = 0;
+		// Memory written through a persistently mapped buffer, kept until unmapped
+		virtual void* MapBuffer(unsigned int buffer, size_t size) = 0;
+		virtual void UnmapBuffer(unsigned int buffer) = 0;
+	};
+
+	struct PANDOR_API BackendStats
+	{
+		size_t commands[(size_t)CommandType::Count] = {};
+		size_t vertices = 0;
+		size_t instances = 0;
+		size_t uniformBytes = 0;
+		size_t bufferBytes = 0;
+		size_t textureBytes = 0;
+
+		size_t GetCount(CommandType type) const { return commands[(size_t)type]; }
+		size_t GetDrawCalls() const;
+		// Binds, render states and viewports
+		size_t GetStateChanges() const;
+	};
+
+	// Renders nothing and needs no window or OpenGL context, counts the commands and keeps them while recording
+	// Used to measure the CPU side of the rendering
+	class PANDOR_API NullBackend : public Backend
+	{
+	public:
+		BackendStats stats;
+		bool recording = false;
+		std::vector<Command> commands;
+
+		const char* GetName() const override { return "Null"; }
+		void Submit(const Command& command) override;
+		unsigned int CreateObject() override { return m_nextObject++; }
+		int GetUniformLocation(unsigned int program, const char* name) override;
+		void* MapBuffer(unsigned int buffer, size_t size) override;
+		void UnmapBuffer(unsigned int buffer) override;
+
+		// Clears the counters and the recorded commands, the objects stay valid
+		void Reset();
+
+	private:
+		unsigned int m_nextObject = 1;
+		std::unordered_map<unsigned int, std::unordered_map<std::string, int>> m_locations;
+		std::unordered_map<unsigned int, std::vector<char>> m_mappedBuffers;
+	};
+
+	// nullptr goes back to OpenGL, the backend is not owned
+	PANDOR_API void SetBackend(Backend* backend);
+	// nullptr for OpenGL
+	PANDOR_API Backend* GetBackend();
+}
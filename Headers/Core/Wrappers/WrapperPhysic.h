@@ -71,6 +71,23 @@ namespace Core::Wrapper::WrapperPhysic {
 	PANDOR_API physx::PxTransform ToPhysXTransform(Component::Transform* transform);
 	PANDOR_API void ToTransform(physx::PxTransform* physXtransform, Component::Transform* transform);
 
+	struct RayQuery
+	{
+		Math::Vector3 origin;
+		// Normalized
+		Math::Vector3 direction;
+		float distance = 0.f;
+	};
+
+	struct RayQueryHit
+	{
+		bool hit = false;
+		float distance = 0.f;
+		Math::Vector3 position;
+		Math::Vector3 normal;
+		physx::PxShape* shape = nullptr;
+	};
+
 	class PANDOR_API PhysicManager
 	{
 	private:
@@ -137,6 +154,10 @@ namespace Core::Wrapper::WrapperPhysic {
 
 		bool RayCast(const Math::Vector3& origin, const Math::Vector3& direction, float distanceMax, Physic::RaycastHit& hit);
 
+		// Closest hit of each ray, without looking up the colliders
+		// Only reads the scene, several threads can query at once while it is not simulated
+		void RayCastBatch(const RayQuery* rays, size_t count, RayQueryHit* hits) const;
+
 		void RemoveCollider(Component::Collider* gameObject);
 
 		void RemoveRigidbody(Component::Rigidbody* rb);
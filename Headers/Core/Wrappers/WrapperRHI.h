@@ -5,6 +5,7 @@
 #include <string>
 #include <Windows.h>
 #include <Math/Maths.h>
+#include <Core/Wrappers/RHIBackend.h>
 
 namespace Resources
 {
@@ -50,7 +51,15 @@ namespace Core::Wrapper
 		class PANDOR_API Buffer
 		{
 		public:
-			unsigned int VertexArray, VertexBuffer, IndexBuffer;
+			static constexpr unsigned int StreamRegionCount = 3;
+
+			unsigned int VertexArray = 0, VertexBuffer = 0, IndexBuffer = 0;
+
+			// Persistently mapped ring, see GenStreamBuffer
+			void* StreamData = nullptr;
+			size_t StreamRegionSize = 0;
+			unsigned int StreamRegion = 0;
+			void* StreamFences[StreamRegionCount] = {};
 
 			Buffer() {}
 			Buffer(float* vertices, size_t numVertices, unsigned int* indices, size_t numIndices);
@@ -65,11 +74,52 @@ namespace Core::Wrapper
 			void BindVertexBuffer();
 			static void BufferSubData(unsigned int offset, size_t size, const void* data);
 			void BufferData(size_t size, const void* data);
+			// Copy between the vertex buffers done by the GPU, ordered with the draws
+			static void CopyData(const Buffer& source, size_t sourceOffset, const Buffer& destination, size_t destinationOffset, size_t size);
+			// Vertex buffer of StreamRegionCount regions of "regionSize" bytes, mapped once and written every frame without any copy
+			// The GPU reads a region while the CPU writes the next one
+			void GenStreamBuffer(size_t regionSize);
+			// Fences the current region and moves to the next one, waiting until the GPU is done with it
+			// Returns the pointer to write to, at StreamOffset() bytes in the buffer
+			void* NextStreamRegion();
+			size_t StreamOffset() const { return StreamRegion * StreamRegionSize; }
 			void Unbind();
 			void UnbindVertexBuffer();
 			void Delete();
 		};
 
+		// Block of uniforms shared by every shader declaring it, bound to a binding point
+		class PANDOR_API UniformBuffer
+		{
+		public:
+			unsigned int ID = 0;
+			size_t Size = 0;
+
+			// Allocates "size" bytes, the previous content is lost
+			void Generate(size_t size);
+			void SetData(size_t offset, size_t size, const void* data);
+			void BindBase(unsigned int binding);
+			void Delete();
+		};
+
+		// Buffer read and written by the compute shaders, also usable as vertex attributes or indirect arguments
+		class PANDOR_API StorageBuffer
+		{
+		public:
+			unsigned int ID = 0;
+			size_t Size = 0;
+
+			// Allocates "size" bytes, filled with "data" when given, the previous content is lost
+			void Generate(size_t size, const void* data = nullptr);
+			void SetData(size_t offset, size_t size, const void* data);
+			void BindBase(unsigned int binding);
+			// As the vertex buffer the next linked attributes read from
+			void BindVertexBuffer();
+			// As the source of the indirect draws and dispatches
+			void BindIndirect();
+			void Delete();
+		};
+
 		PANDOR_API void InitializeAPI();
 		PANDOR_API void EnableDebugOutput();
 		PANDOR_API void ClearColorAndBuffer(Vector4 clearColor);
@@ -77,6 +127,8 @@ namespace Core::Wrapper
 		PANDOR_API void DrawElements(int count);
 		PANDOR_API void DrawArrays(size_t start, size_t count, bool wireframe = false, bool cullface = true);
 		PANDOR_API void DrawInstance(size_t first, size_t count, size_t number);
+		// Arguments read at "offset" bytes in the bound indirect buffer
+		PANDOR_API void DrawInstanceIndirect(size_t offset);
 		PANDOR_API void CreateBuffer(Buffer*& buffer, float* vertices, size_t verticesSize, unsigned int* indices, size_t indicesSize);
 		PANDOR_API void DepthActive();
 		PANDOR_API void DepthDisable();
@@ -85,11 +137,21 @@ namespace Core::Wrapper
 		PANDOR_API void GenVertex(unsigned int& VAO, unsigned int& VBO, float vertices[], std::size_t size);
 		PANDOR_API void BindVAO(unsigned int& VAO);
 		PANDOR_API void SetDephtFunc(bool value);
+		// RGBA 32 bits float texture without filtering, read with texelFetch
+		PANDOR_API void SendFloatTexture(unsigned int& ID, int width, int height, const float* data);
 		PANDOR_API void SendCubeMap(unsigned int& ID, int texWidth, int texHeight, int nrChannels, unsigned char* texData);
 		PANDOR_API void SendSixSided(unsigned int& ID, int texWidths[6], int texHeights[6], unsigned char* texData[6]);
 		PANDOR_API void UpdateTexture(unsigned int& ID, int filter = PR_NEAREST, int wrap = PR_REPEAT);
 		PANDOR_API bool SendShader(std::string& vertShader, std::string& fragShader, unsigned int& ID, Resources::Shader* shader);
 		PANDOR_API void GetAllUniform(Resources::Shader* shaderData);
+		PANDOR_API bool SendComputeShader(std::string& computeShader, unsigned int& ID, const std::string& path);
+		PANDOR_API void DispatchCompute(unsigned int groupsX, unsigned int groupsY = 1, unsigned int groupsZ = 1);
+		// Group counts read at "offset" bytes in the bound indirect buffer
+		PANDOR_API void DispatchComputeIndirect(size_t offset);
+		// Makes the storage writes of the previous dispatches visible to the next ones, and to the draws when "beforeDraw"
+		PANDOR_API void ComputeBarrier(bool beforeDraw = false);
+		// Compute shaders and storage buffers need OpenGL 4.3
+		PANDOR_API bool SupportsCompute();
 		PANDOR_API void StencilActive();
 		PANDOR_API void UseStencil();
 		PANDOR_API void DrawStencil(Resources::Shader* shaderData, Vector4 Color);
@@ -100,6 +162,9 @@ namespace Core::Wrapper
 		PANDOR_API void ShaderUse(unsigned int& ID);
 		PANDOR_API void ShaderDelete(unsigned int& ID);
 		PANDOR_API int	ShaderGetLocation(unsigned int& ID, const char* name);
+		// Index of a uniform block, -1 when the shader does not declare it
+		PANDOR_API int	ShaderGetUniformBlock(unsigned int& ID, const char* name);
+		PANDOR_API void ShaderBindUniformBlock(unsigned int& ID, int blockIndex, unsigned int binding);
 
 		PANDOR_API void ShaderSendSampler(const int shaderProgram, const char* name, const int value);
 		PANDOR_API void ShaderSendInt(const int shaderProgram, const char* name, const int value);
@@ -147,6 +212,12 @@ namespace Core::Wrapper
 
 		PANDOR_API void PixelStore(unsigned int type, int value);
 
+		// WrapperRHI skips the calls setting the program, vertex array, textures, capabilities, polygon mode or viewport it already set
+		// To call after changing this state with OpenGL directly
+		PANDOR_API void InvalidateStateCache();
+		// Debug, compares the cached state with OpenGL before each draw and logs the differences, slow
+		PANDOR_API void SetStateValidation(bool enabled);
+
 		static void APIENTRY DebugOutput(unsigned int source, unsigned int type, unsigned int id, unsigned int severity, int length, const char* message, const void* userParam);
 
 		//FrameBuffer
@@ -0,0 +1,122 @@
+#pragma once
+#include "PandorAPI.h"
+#include <Math/Maths.h>
+
+namespace Resources
+{
+	class Mesh;
+	class Material;
+	class Shader;
+	class ComputeShader;
+}
+namespace Core::Wrapper::WrapperRHI
+{
+	class Buffer;
+	class StorageBuffer;
+}
+
+namespace Render
+{
+	// Emitter of a particle system, sent to the emission shader each frame
+	struct GPUParticleEmitter
+	{
+		Math::Vector3 position;
+		Math::Quaternion rotation;
+		// Component::ParticleShape, -1 to emit from the center along the forward axis
+		int shape = -1;
+		// Min and max of the random values
+		Math::Vector2 radius;
+		// In degrees
+		Math::Vector2 angle;
+		// Rectangle shape
+		Math::Vector2 scale;
+		Math::Vector2 speed;
+		Math::Vector2 lifetime;
+		Math::Vector2 size;
+		// Vertical acceleration
+		Math::Vector2 gravity;
+		// Lerped over the life of the particles when colorOverLife, else colorStart only
+		Math::Vector4 colorStart = Math::Vector4(1.f);
+		Math::Vector4 colorEnd = Math::Vector4(1.f);
+		bool colorOverLife = false;
+	};
+
+	// Particles simulated by compute shaders, they never come back to the CPU
+	// Each frame the alive particles are integrated and packed in the other particle buffer, the emitted ones are appended after them,
+	// then the GPU writes the draw and dispatch arguments itself
+	//
+	// Storage buffers of the shaders (std430) :
+	//   binding 0 : Particle[] read,  binding 1 : Particle[] written,  binding 2 : State
+	// simulate.comp : dispatched with the arguments of the state, kills, integrates and packs the alive particles
+	// emit.comp     : one invocation per emitted particle, appended after the alive ones, dropped past the capacity
+	// finalize.comp : one invocation, writes the alive count and the arguments of the next draw and dispatch
+	class PANDOR_API GPUParticles
+	{
+	public:
+		// The first 2 vectors are the instance attributes of the particle shaders
+		struct Particle
+		{
+			// xyz position, w size
+			Math::Vector4 positionSize;
+			Math::Vector4 color;
+			// xyz velocity, w age
+			Math::Vector4 velocityAge;
+			// x lifetime, y vertical acceleration
+			Math::Vector4 lifetimeGravity;
+		};
+
+		// Start of the state buffer, laid out as the indirect draw then dispatch arguments
+		struct State
+		{
+			uint32_t vertexCount;
+			uint32_t instanceCount;
+			uint32_t firstVertex;
+			uint32_t baseInstance;
+			uint32_t groupsX;
+			uint32_t groupsY;
+			uint32_t groupsZ;
+			uint32_t aliveCount;
+			// Particles written this frame, only used by the shaders
+			uint32_t writtenCount;
+			uint32_t padding[3];
+		};
+
+		static constexpr unsigned int GroupSize = 256;
+		static constexpr size_t DrawArgumentsOffset = 0;
+		static constexpr size_t DispatchArgumentsOffset = sizeof(uint32_t) * 4;
+
+		GPUParticles() {}
+		~GPUParticles();
+
+		// Compute shaders are available, the CPU simulation is used otherwise
+		static bool IsSupported();
+
+		// Allocates the buffers for "capacity" particles drawn with a mesh of "vertexCount" vertices, every particle is killed
+		void Initialize(size_t capacity, size_t vertexCount);
+		// Kills every particle
+		void Clear();
+		// The compute shaders are sent
+		bool IsReady() const;
+
+		// Main thread, emits "spawnCount" particles at any time of the step, the same seed gives the same particles
+		void Simulate(float deltaTime, size_t spawnCount, uint32_t seed, const GPUParticleEmitter& emitter);
+		// Reads the instances of "vertices" from the current particles, the instance count is the alive count
+		void Draw(Resources::Mesh* mesh, Resources::Material* material, Resources::Shader* shader, Core::Wrapper::WrapperRHI::Buffer* vertices);
+
+		size_t GetCapacity() const { return m_capacity; }
+		size_t GetMemorySize() const;
+		void Delete();
+
+	private:
+		Resources::ComputeShader* m_simulateShader = nullptr;
+		Resources::ComputeShader* m_emitShader = nullptr;
+		Resources::ComputeShader* m_finalizeShader = nullptr;
+
+		Core::Wrapper::WrapperRHI::StorageBuffer* m_particles[2] = {};
+		Core::Wrapper::WrapperRHI::StorageBuffer* m_state = nullptr;
+		// Particle buffer holding the alive particles, the other one is written by the next step
+		unsigned int m_current = 0;
+		size_t m_capacity = 0;
+		size_t m_vertexCount = 0;
+	};
+}
@@ -2,7 +2,7 @@
 #include "PandorAPI.h"
 #include <Resources/IResources.h>
 #include <vector>
-#include <unordered_map>
+#include <algorithm>
 
 namespace Utils::Loader
 {
@@ -13,6 +13,84 @@ namespace Utils::Loader
 
 namespace Resources
 {
+	// Keys of one bone channel at full precision, only used while importing
+	template<typename T>
+	struct AnimationCurve
+	{
+		// Time of each key in frames, strictly increasing
+		std::vector<float> times;
+		std::vector<T> values;
+
+		// Keeps the keys sorted, a key at an existing time replaces the previous one
+		void AddKey(float time, const T& value)
+		{
+			if (times.empty() || time > times.back())
+			{
+				times.push_back(time);
+				values.push_back(value);
+				return;
+			}
+			auto it = std::lower_bound(times.begin(), times.end(), time);
+			size_t index = it - times.begin();
+			if (*it == time)
+			{
+				values[index] = value;
+				return;
+			}
+			times.insert(it, time);
+			values.insert(values.begin() + index, value);
+		}
+
+		bool IsEmpty() const { return times.empty(); }
+		float GetEndTime() const { return times.empty() ? 0.f : times.back(); }
+	};
+
+	// Translation keys, each component quantized on 16 bits in the bounds of the curve
+	struct CompressedPositionCurve
+	{
+		// Key frames, sorted
+		std::vector<uint16_t> times;
+		// 3 per key
+		std::vector<uint16_t> values;
+		Math::Vector3 min;
+		Math::Vector3 extent;
+
+		bool IsEmpty() const { return times.empty(); }
+		Math::Vector3 GetKey(size_t index) const;
+	};
+
+	// Rotation keys, the three smallest components on 15 bits and the index of the largest one in the two remaining bits
+	struct CompressedRotationCurve
+	{
+		// Key frames, sorted
+		std::vector<uint16_t> times;
+		// 3 per key
+		std::vector<uint16_t> values;
+
+		bool IsEmpty() const { return times.empty(); }
+		Math::Quaternion GetKey(size_t index) const;
+	};
+
+	struct AnimationCompressionSettings
+	{
+		// Max distance between the imported and the reduced curve, in meters
+		float positionTolerance = 0.0005f;
+		// Max angle between the imported and the reduced curve, in radians
+		float rotationTolerance = 0.001f;
+		// Multiplier of the tolerances for each bone Id, 1 when missing
+		// Lower it for the bones near the root, their error is visible on the whole hierarchy
+		std::vector<float> boneTolerances;
+	};
+
+	// Last key used by each curve, makes the lookup O(1) when the time moves forward
+	// One cursor per sampled clip, it is reset when used with another animation
+	struct AnimationCursor
+	{
+		const class Animation* animation = nullptr;
+		std::vector<uint32_t> positionKeys;
+		std::vector<uint32_t> rotationKeys;
+	};
+
 	class PANDOR_API Animation : public IResources
 	{
 	public:
@@ -22,21 +100,35 @@ namespace Resources
 		void Load() override;
 		void SendResource() override;
 
-		void GetAnimAtFrame(int id, float time, Math::Vector3& Position, Math::Quaternion& Rotation);
+		// Time is in frames, outside of the keys the first or last key is returned
+		// Position and Rotation are left untouched when the bone has no key
+		void GetAnimAtFrame(int id, float time, Math::Vector3& Position, Math::Quaternion& Rotation) const;
+
+		// Samples the first "count" bones, indexed by Bone::Id, in one call
+		// When given, the bones with a 0 in "mask" are not sampled
+		void SampleAll(float time, Math::Vector3* positions, Math::Quaternion* rotations, size_t count, AnimationCursor* cursor = nullptr, const uint8_t* mask = nullptr) const;
+
+		// Removes the keys rebuilt by interpolation within the tolerances then quantizes the others
+		void Compress(const std::vector<AnimationCurve<Math::Vector3>>& positions, const std::vector<AnimationCurve<Math::Quaternion>>& rotations,
+			const AnimationCompressionSettings& settings = {});
+
+		// Last key frame of all the curves
+		void UpdateKeyCount();
+
+		// Bytes used by the keys
+		size_t GetMemorySize() const;
 
 		float FrameRate = 0;
 
 		size_t KeyCount = 0;
 
-		// List of all Bones, With all Key Inside with :
-		// - first = Current Keyframe
-		// - second = Transform at this keyFrame
-		std::vector < std::unordered_map<int, Math::Vector3>> KeyPositions;
-		std::vector < std::unordered_map<int, Math::Quaternion>> KeyRotations;
+		// One curve per bone Id
+		std::vector<CompressedPositionCurve> PositionCurves;
+		std::vector<CompressedRotationCurve> RotationCurves;
 
 		static ResourcesType GetResourceType() { return ResourcesType::Animation; }
 	private:
 		friend class Utils::Loader::FBX;
 		friend class Utils::Loader::ANIM;
 	};
-}
\ No newline at end of file
+}
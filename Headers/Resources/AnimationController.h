@@ -1,6 +1,7 @@
 #pragma once
 #include "PandorAPI.h"
 #include <Resources/IResources.h>
+#include <Resources/PoseBlending.h>
 
 namespace Component
 {
@@ -8,6 +9,68 @@ namespace Component
 }
 namespace Resources
 {
+	enum class AnimatorParameterType
+	{
+		Bool = 0,
+		Float,
+		Int,
+		Trigger,
+	};
+
+	// Value of one parameter, read through the member matching its AnimatorParameterType
+	union AnimatorValue
+	{
+		int i;
+		float f;
+		bool b;
+	};
+
+	struct AnimatorParameter
+	{
+		std::string name;
+		// Component::Animator::StringToHash(name), what scripts use to address the parameter
+		int id = 0;
+		AnimatorParameterType type = AnimatorParameterType::Bool;
+		AnimatorValue defaultValue = {};
+	};
+
+	enum class ConditionMode
+	{
+		If = 0,		// Bool and Trigger
+		IfNot,		// Bool
+		Greater,	// Float and Int
+		Less,		// Float and Int
+		Equals,		// Int
+		NotEqual,	// Int
+	};
+
+	struct Condition
+	{
+		// Index in AnimationController::parameters, -1 when not set
+		int parameter = -1;
+		ConditionMode mode = ConditionMode::If;
+		float threshold = 0.f;
+	};
+
+	struct BlendTreeMotion
+	{
+		class Animation* animation = nullptr;
+		// Parameter values where the motion has its full weight, Simple1D only uses x
+		Math::Vector2 position;
+	};
+
+	// Motions blended by one or two float parameters, played instead of the animation of the state
+	struct BlendTree
+	{
+		static constexpr size_t MaxMotions = 16;
+
+		BlendTreeType type = BlendTreeType::Simple1D;
+		// Index in AnimationController::parameters, -1 when not set
+		int parameterX = -1;
+		int parameterY = -1;
+		std::vector<BlendTreeMotion> motions;
+	};
+
 	struct StateRect
 	{
 		std::string name;
@@ -17,8 +80,11 @@ namespace Resources
 		bool selected;
 		bool loop = true;
 		float speed = 1.0f;
+		bool useBlendTree = false;
+		BlendTree blendTree;
 
-		void ShowInInspector();
+		// Returns true if something was edited
+		bool ShowInInspector(AnimationController* animC);
 	};
 
 	struct Link
@@ -28,10 +94,122 @@ namespace Resources
 		bool hasExitTime = true; //Exit at a certain time
 		float exitTime = 0.75f;
 		float transitionDuration = 0.25f;
-		std::vector<std::pair<std::pair<const std::string, bool>*, bool>> conditions;
+		std::vector<Condition> conditions;
 		AnimationController* animC;
 
-		void ShowInInspector();
+		// Returns true if something was edited
+		bool ShowInInspector();
+	};
+
+	// Condition compiled to a single instruction, the operand is already in the parameter type
+	enum class ConditionOp : uint8_t
+	{
+		BoolTrue,
+		BoolFalse,
+		Trigger,
+		FloatGreater,
+		FloatLess,
+		IntGreater,
+		IntLess,
+		IntEquals,
+		IntNotEqual,
+		Never,		// Mode not valid for the parameter type
+	};
+
+	struct ConditionInstruction
+	{
+		ConditionOp op;
+		uint16_t parameter;
+		AnimatorValue operand;
+	};
+
+	struct CompiledTransition
+	{
+		int target = -1;
+		bool hasExitTime = false;
+		float exitTime = 0.f;
+		float duration = 0.f;
+		// Range in CompiledStateMachine::conditions
+		uint32_t firstCondition = 0;
+		uint32_t conditionCount = 0;
+	};
+
+	struct CompiledBlendTree
+	{
+		BlendTreeType type = BlendTreeType::Simple1D;
+		// Index of a float parameter, -1 reads 0
+		int parameterX = -1;
+		int parameterY = -1;
+		// Range in CompiledStateMachine::motionAnimations and motionPositions
+		uint32_t firstMotion = 0;
+		uint32_t motionCount = 0;
+	};
+
+	struct CompiledState
+	{
+		class Animation* animation = nullptr;
+		float speed = 1.f;
+		bool loop = true;
+		// Index in CompiledStateMachine::blendTrees, -1 plays the animation
+		int blendTree = -1;
+		// Range in CompiledStateMachine::transitions
+		uint32_t firstTransition = 0;
+		uint32_t transitionCount = 0;
+	};
+
+	// Immutable runtime graph built from the editor states and links, shared by every animator of the controller
+	struct CompiledStateMachine
+	{
+		std::vector<CompiledState> states;
+		std::vector<CompiledTransition> transitions;
+		std::vector<ConditionInstruction> conditions;
+		std::vector<CompiledBlendTree> blendTrees;
+		std::vector<class Animation*> motionAnimations;
+		std::vector<Math::Vector2> motionPositions;
+
+		int entryState = -1;
+		// Transitions of the AnyState, in the same array
+		uint32_t firstAnyTransition = 0;
+		uint32_t anyTransitionCount = 0;
+
+		// True if every condition passes, the triggers used by the transition are then consumed
+		bool Evaluate(const CompiledTransition& transition, std::vector<AnimatorValue>& values) const;
+	};
+
+	// State machine played on top of the states of the controller, its graph is the one of another controller
+	struct AnimationLayer
+	{
+		std::string name;
+		// Its parameters are matched by name with the ones of the controller that has the layer
+		AnimationController* controller = nullptr;
+		float weight = 1.f;
+		BlendMode mode = BlendMode::Override;
+		// Indexed like Skeleton::Bones, the bones after the last weight have the full weight
+		BoneMask mask;
+	};
+
+	struct CompiledLayer
+	{
+		CompiledStateMachine machine;
+		float weight = 1.f;
+		BlendMode mode = BlendMode::Override;
+		BoneMask mask;
+	};
+
+	// Per animator runtime state, indices refer to the CompiledStateMachine of the controller
+	struct AnimatorStateBlock
+	{
+		int currentState = -1;
+		int previousState = -1;
+		int transition = -1;
+		float currentTime = 0.f;
+		// Time of the previous state, still played during the transition
+		float previousTime = 0.f;
+		float elapsedTime = 0.f; // Transition Elapsed Time.
+		bool endExitTime = false;
+		bool conditionUpdated = true;
+		// Graph version the indices were taken from
+		uint32_t graphVersion = (uint32_t)-1;
 	};
 
 	class PANDOR_API AnimationController : public IResources
@@ -48,27 +226,43 @@ namespace Resources
 		void Save();
 		void Create();
 
+		// Evaluates the states then the layers on top of them, the graph is compiled by Animator::PrepareEvaluation
 		void Update(Component::Animator* animator);
 
-		void UpdateConditions(Component::Animator* animator);
+		// One state machine, "slot" and the slots after it hold its samples
+		// Returns the pose in "slot", nullptr when nothing was sampled
+		BlendPose* UpdateMachine(const CompiledStateMachine& machine, Component::Animator* animator, AnimatorStateBlock& block, size_t slot);
+
+		void UpdateConditions(const CompiledStateMachine& machine, Component::Animator* animator, AnimatorStateBlock& block);
 
-		void ChangeAnimation(bool value, Resources::Link* anyState, Component::Animator* animator);
+		void ChangeAnimation(const CompiledStateMachine& machine, int transition, AnimatorStateBlock& block);
 
 		void UpdateParameters(Component::Animator* animator, bool UpdateValue = false);
 
-		void UpdateExitTime(Component::Animator* animator);
+		BlendPose* UpdateExitTime(const CompiledStateMachine& machine, Component::Animator* animator, AnimatorStateBlock& block, size_t slot);
 
-		void UpdateTransition(Component::Animator* animator);
+		BlendPose* UpdateTransition(const CompiledStateMachine& machine, Component::Animator* animator, AnimatorStateBlock& block, size_t slot);
 
-		void UpdateAnimation(Component::Animator* animator, Resources::Animation* anim);
+		BlendPose* UpdateAnimation(const CompiledStateMachine& machine, Component::Animator* animator, AnimatorStateBlock& block, const CompiledState& state, size_t slot);
+
+		// Recompiled when the graph or the graph of a layer changed since the last call
+		const CompiledStateMachine& GetStateMachine();
+		const std::vector<CompiledLayer>& GetCompiledLayers() const { return m_compiledLayers; }
+		uint32_t GetGraphVersion() const { return m_graphVersion; }
+		void MarkGraphDirty() { m_graphVersion++; }
 
 		StateRect* GetStateByName(const std::string& name);
 
 		static ResourcesType GetResourceType() { return ResourcesType::AnimationController; }
 
-		void AddParameter(std::string name);
+		void AddParameter(std::string name, AnimatorParameterType type = AnimatorParameterType::Bool);
 		void RenameParameter(const std::string name, const std::string newName);
 		void DeleteParameter(const std::string& name);
+		void SetParameterType(int index, AnimatorParameterType type);
+
+		// Linear scan, controllers only have a handful of parameters
+		int GetParameterIndex(int id) const;
+		int GetParameterIndex(const std::string& name) const;
 
 		StateRect* AddState(std::string name, Math::Vector2 pos, const Math::Vector4& color);
 		void RenameState(const std::string name, const std::string newName);
@@ -81,12 +275,39 @@ namespace Resources
 		void ShowInInspector() override;
 
 	public:
-		std::unordered_map<std::string, bool> parameters;
+		std::vector<AnimatorParameter> parameters;
+		// Incremented when parameters are added, removed, renamed or retyped
+		uint32_t parameterVersion = 0;
 		std::unordered_map<std::string, StateRect*> states;
 		std::vector<Link*> links;
+		// Evaluated in order after the states
+		std::vector<AnimationLayer> layers;
 		
 		bool parameterUpdated = true;
 
+		// Pose slots used by one state machine, a transition samples two states that can both be blend trees
+		static constexpr size_t SlotsPerMachine = 2 * (1 + BlendTree::MaxMotions);
+
 	private:
+		void Compile();
+		// States and links of this controller, the conditions and blend trees read the values of "animatorParameters"
+		void CompileGraph(const std::vector<AnimatorParameter>& animatorParameters, CompiledStateMachine& machine);
+		void ShowLayersInInspector();
+
+		// Weights of the motions of a blend tree state, the motions not loaded yet have none
+		void ComputeBlendWeights(const CompiledStateMachine& machine, const CompiledState& state, const Component::Animator* animator, float* weights) const;
+		// Length in frames, 0 while nothing is loaded. The motions of a blend tree are synchronized on their weighted length
+		float GetStateLength(const CompiledStateMachine& machine, const CompiledState& state, const float* weights) const;
+		// "slot" and the slots after it are used, the motions of a blend tree take the next BlendTree::MaxMotions ones
+		BlendPose& SampleState(class Skeleton* skel, const CompiledStateMachine& machine, const CompiledState& state, float time, const float* weights, size_t slot) const;
+		// First frame of the state shown by the block, the reference of an additive layer
+		BlendPose& SampleAdditiveReference(class Skeleton* skel, const CompiledStateMachine& machine, const AnimatorStateBlock& block, const Component::Animator* animator, size_t slot) const;
+
+		CompiledStateMachine m_stateMachine;
+		std::vector<CompiledLayer> m_compiledLayers;
+		// Graph version of the controller of each layer when compiled
+		std::vector<uint32_t> m_layerVersions;
+		uint32_t m_graphVersion = 0;
+		uint32_t m_compiledVersion = (uint32_t)-1;
 	};
 }
\ No newline at end of file
@@ -26,6 +26,7 @@ namespace Utils
 namespace Component
 {
 	class ParticleSystem;
+	class CrowdRenderer;
 	class Transform;
 	class DirectionalLight;
 }
@@ -57,13 +58,15 @@ namespace Resources
 		void Render(const Math::Matrix4& MVP, const Math::Matrix4& model, const std::vector<class Material*>& materials, bool wireframe = false, bool cullface = true, bool drawOutline = false, bool drawShadow = false);
 
 		void RenderInstancing(class Material* material, class Shader* shader, size_t count, WrapperRHI::Buffer* buffer = nullptr);
+		// Same as RenderInstancing, the draw arguments are read at "offset" bytes in the bound indirect buffer
+		void RenderInstancingIndirect(class Material* material, class Shader* shader, size_t offset, WrapperRHI::Buffer* buffer = nullptr);
 		void RenderInstancingPicking(class Shader* shader, size_t count, int ID);
 
 		void RenderUI(const Math::Vector2& Position, const Math::Vector2& Size, Resources::Material* material, float depth);
 
 		static ResourcesType GetResourceType() { return ResourcesType::Mesh; };
 
-		std::vector<SubMesh> GetSubMeshes() { return m_subMeshes; }
+		const std::vector<SubMesh>& GetSubMeshes() const { return m_subMeshes; }
 		class Model* GetModel() { return m_fromModel; }
 
 		void BindBuffer();
@@ -72,12 +75,17 @@ namespace Resources
 		Texture* GetThumbnail();
 
 		std::vector<Vector3> GetPositionVertices() { return m_positions; }
+		// Interleaved vertex data, see the layouts above
+		const std::vector<float>& GetVertices() const { return m_vertices; }
 		Math::Vector3 MinAABB() const { return m_minAABB; }
 		Math::Vector3 MaxAABB() const { return m_maxAABB; }
 		Utils::AABB* GetBoudingBox() const { return m_boudingBox; }
 
 		bool IsVisible(Render::Camera* camera, Component::Transform* transform);
 	protected:
+		// Binds the buffer and the shader and sends the material, false when nothing can be drawn
+		bool BeginInstancing(class Material* material, class Shader* shader, WrapperRHI::Buffer* buffer);
+
 		class Model* m_fromModel;
 		std::vector<float> m_vertices;
 		std::vector<float> m_defaultVertices;
@@ -100,6 +108,7 @@ namespace Resources
 		friend Utils::Loader::OBJ;
 		friend Utils::Loader::FBX;
 		friend Component::ParticleSystem;
+		friend Component::CrowdRenderer;
 		friend Core::Wrapper::WrapperPhysic::PhysicManager;
 	};
 }
@@ -0,0 +1,65 @@
+#pragma once
+#include "PandorAPI.h"
+#include <Math/Maths.h>
+#include <vector>
+
+namespace Resources
+{
+	// Local pose of a skeleton, one float stream per channel so 4 bones are blended at once
+	// Indexed like Skeleton::Bones, the streams are padded to a multiple of 4 with identity bones
+	struct PANDOR_API BlendPose
+	{
+		size_t count = 0;
+		std::vector<float> tx, ty, tz;
+		std::vector<float> qx, qy, qz, qw;
+
+		void Resize(size_t boneCount);
+		// Zero translations and identity rotations, the reference of an empty additive layer
+		void SetIdentity();
+
+		void SetBone(size_t index, const Math::Vector3& position, const Math::Quaternion& rotation);
+		Math::Vector3 GetPosition(size_t index) const;
+		Math::Quaternion GetRotation(size_t index) const;
+	};
+
+	// Weight of a layer for each bone, indexed like Skeleton::Bones
+	struct BoneMask
+	{
+		std::vector<float> weights;
+	};
+
+	enum class BlendMode
+	{
+		// Blends toward the layer pose
+		Override,
+		// Adds the layer pose, built with PoseBlending::MakeAdditive, on top of the base
+		Additive,
+	};
+
+	enum class BlendTreeType
+	{
+		Simple1D,
+		// Inverse distance weighting of the motion positions
+		Freeform2D,
+	};
+
+	namespace PoseBlending
+	{
+		// out = a toward b by t, per bone t is multiplied by the mask
+		// Rotations use a normalized lerp unless "slerp" is set, slerp is not vectorized
+		PANDOR_API void Blend(const BlendPose& a, const BlendPose& b, float t, BlendPose& out, const BoneMask* mask = nullptr, bool slerp = false);
+
+		// Weighted average of "count" poses, the weights are normalized
+		PANDOR_API void BlendN(const BlendPose* const* poses, const float* weights, size_t count, BlendPose& out);
+
+		// Difference between pose and reference, applied on another pose by ApplyLayer in Additive mode
+		PANDOR_API void MakeAdditive(const BlendPose& pose, const BlendPose& reference, BlendPose& out);
+
+		// Applies a layer on top of "base", in place
+		PANDOR_API void ApplyLayer(BlendPose& base, const BlendPose& layer, float weight, BlendMode mode, const BoneMask* mask = nullptr);
+
+		// Weights of the motions of a blend tree for the parameter values, they sum to 1
+		// Simple1D only reads the x of each position
+		PANDOR_API void ComputeBlendTreeWeights(BlendTreeType type, const Math::Vector2* positions, size_t count, const Math::Vector2& value, float* weights);
+	}
+}
@@ -32,6 +32,8 @@ namespace Resources
 		bool isFragLoaded = false;
 		bool isVertLoaded = false;
 		std::unordered_map<std::string, int> m_locations;
+		// Block index of each looked up uniform block, -1 when not declared
+		std::unordered_map<std::string, int> m_blocks;
 		std::mutex shaderMutex;
 		std::vector<ShaderVariables> variables;
 
@@ -49,6 +51,8 @@ namespace Resources
 		void Recompile();
 
 		int GetLocation(const std::string& locationName);
+		// Binds the uniform block to the binding point on first use, false when the shader does not declare it
+		bool BindUniformBlock(const std::string& blockName, unsigned int binding);
 		VertexShader* GetVertex() { return vertShader; }
 		FragmentShader* GetFrag() { return fragShader; }
 		
@@ -120,4 +124,35 @@ namespace Resources
 
 		static ResourcesType GetResourceType() { return ResourcesType::VertexShader; }
 	};
+
+	/* ===================== */
+	/*  Compute Shader class */
+	/* ===================== */
+
+	// Program made of a single compute stage, sent once the file is loaded
+	class PANDOR_API ComputeShader : public IResources
+	{
+	private:
+		std::unordered_map<std::string, int> m_locations;
+
+	public:
+		unsigned int ID = 0;
+		std::string computeFile;
+
+		ComputeShader(std::string _name, ResourcesType _type);
+
+		~ComputeShader() override;
+		void Load() override;
+		void SendResource() override;
+
+		void Recompile();
+
+		int GetLocation(const std::string& locationName);
+		void Use();
+		// Runs the program on the work groups, the storage buffers it reads must be bound
+		void Dispatch(unsigned int groupsX, unsigned int groupsY = 1, unsigned int groupsZ = 1);
+		void Delete();
+
+		static ResourcesType GetResourceType() { return ResourcesType::ComputeShader; }
+	};
 }
@@ -17,6 +17,12 @@ namespace Resources
 		void PickingResource(const Math::Matrix4& model, std::vector<class Material*> materials, class Skeleton* skel, int ID);
 
 		static ResourcesType GetResourceType() { return ResourcesType::SkeletalMesh; };
+
+		// Floats per vertex : position, uv, normal, tangent, 8 bone indices then 8 bone weights
+		static constexpr size_t VertexStride = 27;
+		static constexpr size_t BoneIndicesOffset = 11;
+		static constexpr size_t BoneWeightsOffset = 19;
+		static constexpr size_t MaxBoneWeights = 8;
 	private:
 
 	};
@@ -1,8 +1,12 @@
 #pragma once
 #include "PandorAPI.h"
 #include <Resources/IResources.h>
+#include <Resources/Animation.h>
+#include <Resources/PoseBlending.h>
 #include <Core/GameObject.h>
 
+#include <deque>
+
 namespace Utils::Loader
 {
 	class OBJ;
@@ -19,6 +23,20 @@ namespace Component
 }
 namespace Resources
 {
+	// Local transforms sampled from an animation, indexed by Bone::Id
+	struct SkeletonPose
+	{
+		std::vector<Math::Vector3> positions;
+		std::vector<Math::Quaternion> rotations;
+	};
+
+	// Pose buffer reused every frame, with the cursor of the clip sampled into it
+	struct PoseSlot
+	{
+		BlendPose pose;
+		AnimationCursor cursor;
+	};
+
 	class Bone : public Core::GameObject
 	{
 	public:
@@ -26,12 +44,11 @@ namespace Resources
 		~Bone();
 
 		void ShowInInspector();
-		void UpdateBone(class Animation*, float);
-		void CrossUpdate(float CrossFadeDuration, float Time, class Animation* currentAnimation,  class Animation* nextAnimation);
 		void SetDefault();
 
 		std::vector<Bone*> GetAllBones();
 
+		// Skinning matrix of the bone, from the skeleton pose
 		Math::Matrix4 GetBoneMatrix();
 
 		void DrawDebug();
@@ -42,6 +59,10 @@ namespace Resources
 
 		void RemoveFromParent();
 
+		// Branches of the skeleton with nothing attached only exist in the skeleton pose and are not updated
+		void UpdateSelfAndChild(size_t& _index) override;
+		void DrawSelfAndChild(bool editorCamera = false) override;
+
 		void ReadGameObject(std::fstream& sceneFile, Core::Scene* scene) override;
 
 		std::ostream& operator<<(std::ostream& os) override;
@@ -55,7 +76,9 @@ namespace Resources
 	private:
 		friend class Utils::Loader::FBX;
 		friend class Skeleton;
-		class Skeleton* m_skeleton;
+		class Skeleton* m_skeleton = nullptr;
+		// Index in Skeleton::Bones
+		int m_boneIndex = -1;
 	};
 
 	class Skeleton : public IResources
@@ -67,9 +90,39 @@ namespace Resources
 		void Load() override {}
 		void SendResource() override {}
 
-		std::vector<Math::Matrix4> GetBonesMatrices();
+		// Skinning palette, recomputed when the pose or the skeleton position changed
+		const std::vector<Math::Matrix4>& GetBonesMatrices();
+		// Uploads the palette to its uniform buffer when it changed since the last upload, then binds it to PaletteBinding
+		// Shaders read it from "SkinningBlock", declared row_major like the matrices sent with ShaderSendMat4
+		void BindPalette();
+
+		static constexpr unsigned int PaletteBinding = 0;
+		// Sorts the bones by Id and builds the flat hierarchy, to call when the bones changed
 		void SortBones();
 
+		// Samples the animation into the local pose
+		void UpdatePose(Animation* anim, float time);
+		// Samples the animation into a pose indexed like Bones, with the default rotations applied
+		void SampleBlendPose(Animation* anim, float time, BlendPose& out, AnimationCursor* cursor = nullptr);
+		// Replaces the local pose by a blended one
+		void SetPose(const BlendPose& pose);
+		// Skinning palette of a pose relative to the root parent, the bones and the current pose are left untouched
+		void ComputeModelPalette(const BlendPose& pose, std::vector<Math::Matrix4>& palette) const;
+		// Created on first use, the references stay valid
+		PoseSlot& GetPoseSlot(size_t index);
+
+		// The next pose written is reached over "frames" updates, from the pose shown now
+		void BeginPoseInterpolation(int frames);
+		// Moves one frame toward the last pose written, for the frames the animator is not evaluated
+		void StepPoseInterpolation();
+		// Bones deeper than "depth" keep their default pose, -1 samples every bone
+		void SetMaxBoneDepth(int depth);
+		// Local pose back to the default bone transforms
+		void ResetPose();
+
+		// World matrix of a bone, from the last evaluated pose
+		const Math::Matrix4& GetBoneModelMatrix(size_t index) const { return m_modelMatrices[index]; }
+
 		Bone* RootBone = nullptr;
 
 		// sorted list by index
@@ -86,12 +139,73 @@ namespace Resources
 
 		static ResourcesType GetResourceType() { return ResourcesType::Skeleton; };
 	private:
+		enum AttachmentFlags : uint8_t
+		{
+			// Components or children that are not bones
+			BoneAttached = 1 << 0,
+			// The bone or one of its children is attached, its transform is kept in sync
+			BranchAttached = 1 << 1,
+		};
+
+		// Resets the pose to the default one then samples every bone of the animation in one call
+		void SamplePose(Animation* anim, float time, SkeletonPose& pose, AnimationCursor* cursor = nullptr) const;
+		// Copies the bone transforms into the local pose, when nothing animates the skeleton
+		void ReadPoseFromBones();
+		// Evaluates the pose written by an animator, or starts interpolating toward it
+		void CommitPose();
+		void ReadLocalPose(BlendPose& out) const;
+		void WriteLocalPose(const BlendPose& pose);
+		// Local to model pass over the flat hierarchy, then sync of the attached bone transforms
+		void EvaluatePose();
+		void UpdateAttachments();
+		Math::Matrix4 GetRootParentMatrix() const;
+
 		size_t m_maxBoneWeight = 0;
 		std::vector<Component::SkeletalMeshComponent*> m_skeletalMeshes = {};
-		
+
+		// Flat pose, element i belongs to Bones[i]
+		std::vector<Math::Vector3> m_localPositions;
+		std::vector<Math::Quaternion> m_localRotations;
+		std::vector<Math::Vector3> m_localScales;
+		// Index in Bones, -1 for the root
+		std::vector<int> m_parents;
+		// Parents before their children
+		std::vector<int> m_evaluationOrder;
+		// Number of children of each bone that are bones
+		std::vector<uint32_t> m_boneChildCount;
+		std::vector<uint32_t> m_boneDepth;
+		std::vector<uint8_t> m_attachments;
+
+		std::vector<Math::Matrix4> m_modelMatrices;
+		std::vector<Math::Matrix4> m_palette;
+		// Incremented by each evaluation, the buffer is uploaded when it is behind
+		uint64_t m_paletteVersion = 0;
+		uint64_t m_uploadedPaletteVersion = UINT64_MAX;
+		Core::Wrapper::WrapperRHI::UniformBuffer m_paletteBuffer;
+		Math::Matrix4 m_rootParentMatrix;
+		bool m_poseDirty = true;
+		// Set when an animator wrote the pose since the last update of the root bone
+		bool m_animated = false;
+		// Set when the pose was read from the bone transforms, nothing to write back
+		bool m_poseFromBones = false;
+
+		// Reused every frame
+		SkeletonPose m_pose;
+		AnimationCursor m_cursor;
+		std::deque<PoseSlot> m_poseSlots;
+
+		// Animation lod
+		BlendPose m_interpolationFrom;
+		BlendPose m_interpolationTarget;
+		BlendPose m_interpolatedPose;
+		int m_interpolationFrames = 1;
+		int m_interpolationStep = 0;
+		int m_maxBoneDepth = -1;
+		// Indexed by Bone::Id, built for m_maxBoneDepth
+		std::vector<uint8_t> m_sampleMask;
 
 		friend Component::SkeletalMeshComponent;
 		friend Bone;
 		friend class Utils::Loader::FBX;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "PandorAPI.h"
+#include <Math/Maths.h>
+#include <vector>
+#include <string>
+
+namespace Resources
+{
+	class SkeletalMesh;
+	class Skeleton;
+	class Animation;
+
+	enum class VertexAnimationMode
+	{
+		// Skinned position and normal of every vertex, nothing left to compute in the vertex shader
+		Vertices,
+		// Skinning matrices, 3 texels per bone, the vertex shader still blends the bone weights
+		Bones,
+	};
+
+	struct VertexAnimationBakeSettings
+	{
+		VertexAnimationMode mode = VertexAnimationMode::Vertices;
+		// Baked frames per second
+		float sampleRate = 30.f;
+		// Longer frames are wrapped on several rows
+		uint32_t maxWidth = 4096;
+	};
+
+	// Frames of one animation in the baked textures
+	struct PANDOR_API VertexAnimationClip
+	{
+		std::string name;
+		uint32_t firstFrame = 0;
+		// The last frame is the end of the animation, the same pose as the first one for a loop
+		uint32_t frameCount = 1;
+		float sampleRate = 30.f;
+		// In seconds
+		float duration = 0.f;
+
+		// Baked frame shown at "time" seconds, looped, the fraction blends with the next frame
+		float GetFrame(float time) const;
+	};
+
+	// Animations of a skeletal mesh sampled into RGBA float textures, one block of rows per frame
+	struct PANDOR_API VertexAnimationData
+	{
+		VertexAnimationMode mode = VertexAnimationMode::Vertices;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		// Vertex count, or 3 times the bone count
+		uint32_t texelsPerFrame = 0;
+		uint32_t rowsPerFrame = 0;
+		uint32_t frameCount = 0;
+
+		// Bounds of the mesh over every frame
+		Math::Vector3 boundsMin;
+		Math::Vector3 boundsMax;
+
+		std::vector<VertexAnimationClip> clips;
+
+		// 4 floats per texel, positions or bone matrix columns
+		std::vector<float> positions;
+		// Vertices mode only
+		std::vector<float> normals;
+
+		// Index of the first float of a texel in the textures
+		size_t GetTexelOffset(uint32_t frame, uint32_t index) const;
+
+		Math::Vector3 GetPosition(uint32_t frame, uint32_t vertex) const;
+		Math::Vector3 GetNormal(uint32_t frame, uint32_t vertex) const;
+		// Skinning matrix of a bone, Bones mode only
+		Math::Matrix4 GetBoneMatrix(uint32_t frame, uint32_t bone) const;
+
+		size_t GetMemorySize() const;
+		bool IsEmpty() const { return frameCount == 0; }
+	};
+
+	namespace VertexAnimationBaker
+	{
+		// Samples each animation from its first to its last key, the pose is relative to the skeleton root
+		// The skeleton is only read, the bones in the scene are not moved
+		PANDOR_API bool Bake(SkeletalMesh* mesh, Skeleton* skeleton, const std::vector<Animation*>& animations,
+			const VertexAnimationBakeSettings& settings, VertexAnimationData& out);
+	}
+}
@@ -1,6 +1,7 @@
 #pragma once
 #include "PandorAPI.h"
 #include <filesystem>
+#include "Scripting/ScriptProfiler.h"
 
 #include <unordered_map>
 #include <string>
@@ -16,6 +17,8 @@ extern "C"
 	typedef struct _MonoAssembly MonoAssembly;
 	typedef struct _MonoImage MonoImage;
 	typedef struct _MonoClassField MonoClassField;
+	typedef struct _MonoException MonoException;
+	typedef struct _MonoDomain MonoDomain;
 }
 
 namespace Core
@@ -115,6 +118,26 @@ namespace Scripting
 		friend class ScriptInstance;
 	};
 
+	// Unmanaged thunks of the lifecycle methods, resolved once per class
+	// Calling a thunk is a plain native call: no reflection and no boxed parameters
+	struct ScriptThunks
+	{
+		using VoidThunk = void(__stdcall*)(MonoObject* instance, MonoException** exception);
+		using UpdateThunk = void(__stdcall*)(MonoObject* instance, float dt, MonoException** exception);
+		using ColliderThunk = void(__stdcall*)(MonoObject* instance, MonoObject* collider, MonoException** exception);
+
+		VoidThunk onCreate = nullptr;
+		UpdateThunk onUpdate = nullptr;
+
+		ColliderThunk onCollisionEnter = nullptr;
+		ColliderThunk onCollisionStay = nullptr;
+		ColliderThunk onCollisionExit = nullptr;
+
+		ColliderThunk onTriggerEnter = nullptr;
+		ColliderThunk onTriggerStay = nullptr;
+		ColliderThunk onTriggerExit = nullptr;
+	};
+
 	class PANDOR_API ScriptClass
 	{
 	private:
@@ -124,9 +147,13 @@ namespace Scripting
 		std::unordered_map<std::string, ScriptField> m_fields;
 
 		MonoClass* m_monoClass = nullptr;
+		ScriptThunks m_thunks;
 
 		friend class ScriptEngine;
 
+	private:
+		void BindThunks();
+
 	public:
 		ScriptClass() = default;
 		ScriptClass(const std::string& classNamespace, const std::string& className, bool isCore = false);
@@ -137,8 +164,10 @@ namespace Scripting
 		std::string GetMethodName(MonoMethod* method);
 		bool InvokeMethod(MonoObject* instance, MonoMethod* method, void** params = nullptr);
 		void InvokeMethodVoid(MonoObject* instance, MonoMethod* method);
+		void PrintException(MonoObject* exception, const char* methodName);
 
 		const std::unordered_map<std::string, ScriptField>& GetFields() const { return m_fields; }
+		const ScriptThunks& GetThunks() const { return m_thunks; }
 		MonoClass* GetMonoClass() const { return m_monoClass; }
 		std::string GetName() const { return m_className; }
 	};
@@ -149,8 +178,11 @@ namespace Scripting
 		std::shared_ptr<ScriptClass> m_scriptClass;
 		MonoObject* m_instance;
 		MonoMethod* m_constructor= nullptr;
-		MonoMethod* m_onCreateMethod = nullptr;
-		MonoMethod* m_onUpdateMethod = nullptr;
+		ScriptThunks::VoidThunk m_onCreate = nullptr;
+		ScriptThunks::UpdateThunk m_onUpdate = nullptr;
+
+		ScriptProfiler::Sample* m_onCreateSample = nullptr;
+		ScriptProfiler::Sample* m_onUpdateSample = nullptr;
 
 		inline static uint8_t s_fieldValueBuffer[16];
 
@@ -158,6 +190,7 @@ namespace Scripting
 
 	private:
 		bool GetFieldValueInternal(const std::string& name);
+		bool InvokeColliderThunk(ScriptThunks::ColliderThunk thunk, Component::Collider* collider, const char* methodName);
 		bool SetFieldValueInternal(const std::string& name, const void* value);
 
 	public:
@@ -238,10 +271,18 @@ namespace Scripting
 		static void OnUpdateScript(Component::ScriptComponent& component, float dt);
 		static void UpdateObjectRefs();
 		static void UpdateComponentRefs();
+
+		// Handle of the object cached by the managed GameObject, 0 for none
+		// A slot index and its generation, the generation changes when the object is destroyed so an old handle resolves to nullptr
+		static uint64_t GetNativeHandle(Core::GameObject* gameObject);
+		static Core::GameObject* ResolveNativeHandle(uint64_t handle);
+		// Called when the object is destroyed
+		static void ReleaseNativeHandle(Core::GameObject* gameObject);
 		static bool IsScriptNameAvaliable(const char* scriptName);
 
 		static MonoObject* CreateComponentInstance(uint64_t objectID, uint64_t componentID);
 		static Core::Scene* GetSceneContext();
+		static MonoDomain* GetAppDomain();
 		static std::shared_ptr<ScriptClass> GetScriptClass(const std::string& name);
 		static MonoImage* GetCoreAssemblyImage();
 		static void GetFieldValue(ScriptClass& scriptClass, MonoClassField* classField, const void* value);
@@ -0,0 +1,42 @@
+#pragma once
+#include "PandorAPI.h"
+
+#include <cstdint>
+
+extern "C"
+{
+	typedef struct _MonoObject MonoObject;
+}
+
+namespace Scripting
+{
+	using JobHandle = uint64_t;
+
+	// Runs C# jobs (IJob / IJobParallelFor structs) on the engine worker threads
+	// Safety rules for the managed side :
+	// - A job only works on its own fields and on NativeArrays, it never touches GameObjects or components
+	// - Only the internal calls registered with ADD_JOB_SAFE_INTERNAL_CALL can be used inside a job,
+	//   any other internal call logs an error and returns a default value
+	// - Scheduled jobs are always completed on OnStop and before an assembly reload, even the ones never completed by the scripts
+	class PANDOR_API ScriptJobs
+	{
+	public:
+		// "job" is the boxed job struct, it is copied by the boxing so the managed caller can reuse its struct
+		static JobHandle Schedule(MonoObject* job, JobHandle dependency = 0);
+		static JobHandle ScheduleParallelFor(MonoObject* job, int length, int batchSize, JobHandle dependency = 0);
+
+		// Wait for the job and its dependencies, the calling thread runs the remaining batches itself
+		static void Complete(JobHandle handle);
+		static bool IsCompleted(JobHandle handle);
+		static void CompleteAll();
+		// Completes every job and drops them, then detaches the worker threads from Mono
+		// Called when the scripts stop or are unloaded, the workers are attached again by the next job
+		static void ReleaseAll();
+
+		// Drop the cached Execute thunks, they belong to the unloaded domain
+		static void ClearCache();
+
+		// True while the current thread is running job code
+		static bool IsJobThread();
+	};
+}
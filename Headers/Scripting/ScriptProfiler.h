@@ -0,0 +1,87 @@
+#pragma once
+#include "PandorAPI.h"
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <unordered_map>
+
+namespace Scripting
+{
+	class PANDOR_API ScriptProfiler
+	{
+	public:
+		// Timing of one method of one script class (or of one internal call)
+		struct Sample
+		{
+			std::string owner;
+			std::string method;
+
+			// Current frame
+			uint32_t callCount = 0;
+			double totalMicroseconds = 0.0;
+			double maxMicroseconds = 0.0;
+
+			// Last completed frame, used for display and export
+			uint32_t lastCallCount = 0;
+			double lastTotalMicroseconds = 0.0;
+			double lastMaxMicroseconds = 0.0;
+
+			// Worst frame since the profiler was enabled
+			double peakMicroseconds = 0.0;
+		};
+
+		struct GCPause
+		{
+			uint64_t frame;
+			uint32_t generation;
+			double microseconds;
+		};
+
+		// Times the enclosing block into a sample, does nothing when the profiler is disabled
+		class Scope
+		{
+		private:
+			Sample* m_sample;
+			std::chrono::high_resolution_clock::time_point m_start;
+
+		public:
+			Scope(Sample* sample) : m_sample(s_Enabled ? sample : nullptr)
+			{
+				if (m_sample)
+					m_start = std::chrono::high_resolution_clock::now();
+			}
+			~Scope()
+			{
+				if (m_sample)
+					ScriptProfiler::AddTime(m_sample, std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - m_start).count());
+			}
+		};
+
+	private:
+		inline static std::atomic<bool> s_Enabled = false;
+
+		static void AddTime(Sample* sample, double microseconds);
+
+	public:
+		// Must be called before mono_jit_init, the allocation callbacks can't be installed later
+		// Counting the allocations makes Mono call back on each of them, only done when asked
+		static void InstallMonoProfiler(bool allocations);
+
+		static void SetEnabled(bool enabled);
+		static bool IsEnabled() { return s_Enabled; }
+
+		// Close the current frame: rotate samples and allocation counters
+		static void NewFrame();
+		static void Reset();
+
+		static Sample* GetSample(const std::string& owner, const std::string& method);
+
+		static uint64_t GetLastFrameAllocations();
+		static uint64_t GetTotalAllocations();
+
+		static void ShowInWindow();
+		static bool Export(const std::string& path);
+	};
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "PandorAPI.h"
+
+#include <cstdint>
+
+extern "C"
+{
+	typedef struct _MonoObject MonoObject;
+}
+
+namespace Scripting
+{
+	using ScheduleHandle = uint64_t;
+
+	// Coroutines and timers of the scripts, resumed by the engine instead of being polled in OnUpdate
+	// A coroutine is the IEnumerator returned by a C# iterator method, what it yields tells when to resume it :
+	// - null (or any unknown object) : next frame
+	// - Pandor.WaitForSeconds : after "seconds" of scaled time, kept in the timer wheel
+	// - Pandor.WaitForFixedUpdate : after the next physic step
+	// - Pandor.WaitUntil : every frame until "predicate" returns true
+	// Waiting coroutines and timers cost nothing until they are due, only WaitUntil is checked every frame
+	// Everything is stopped on ScriptEngine::OnStart/OnStop and before an assembly reload
+	class PANDOR_API ScriptScheduler
+	{
+	public:
+		// Runs the coroutine until its first yield, "owner" is the uuid of the ScriptComponent
+		static ScheduleHandle StartCoroutine(uint64_t owner, MonoObject* enumerator);
+		// "callback" is a System.Action, an interval <= 0 makes a one shot timer
+		static ScheduleHandle StartTimer(uint64_t owner, float delay, float interval, MonoObject* callback);
+
+		static void Stop(ScheduleHandle handle);
+		static void StopAll(uint64_t owner);
+		static void Clear();
+
+		// Called after the physic step
+		static void FixedUpdate();
+		// Called once per frame in play mode, after the scripts and the physic
+		static void Update(float dt);
+
+		static size_t GetCoroutineCount();
+		static size_t GetTimerCount();
+	};
+}
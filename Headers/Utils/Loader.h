@@ -20,8 +20,11 @@ namespace Resources {
 	class Material;
 	class Animation;
 	class AnimationController;
+	template<typename T> struct AnimationCurve;
+	struct AnimationCompressionSettings;
 	struct StateRect;
 	struct Link;
+	struct AnimationLayer;
 }
 namespace Utils
 {
@@ -56,7 +59,7 @@ namespace Utils
 				, const std::vector<Math::Vector3>& Normals
 				, const std::vector<Math::Vector3>& Tangents);
 			static Resources::Material* LoadMaterial(std::string matPath, const ofbx::Mesh* ofbxMesh, size_t lastMaterial, const std::string& path, Resources::Model* model);
-			static void LoadAnimation(ofbx::IScene* scene, const ofbx::AnimationStack* stack, std::string path);
+			static void LoadAnimation(ofbx::IScene* scene, const ofbx::AnimationStack* stack, std::string path, const Resources::AnimationCompressionSettings& settings);
 
 		};
 
@@ -262,14 +265,20 @@ namespace Utils
 		{
 		public:
 			static void Load(Resources::Animation* anim, const std::string& path);
+			// Writes the compressed binary clip
 			static void Save(Resources::Animation* anim);
+			// Text clip, written before the compression, the keys are compressed while loading
 			static void Parse(Resources::Animation* anim, const char* data, uint32_t size); 
+			static bool ParseBinary(Resources::Animation* anim, const char* data, uint32_t size);
+			// Tolerances of the project settings, overridden by "<name>.AnimImport" next to the source file when it exists :
+			// "PositionTolerance : value", "RotationTolerance : value" and one "Bone : id multiplier" line per bone
+			static Resources::AnimationCompressionSettings LoadImportSettings(const std::string& path);
 			static inline Math::Vector3 GetVector3(const char* data, uint32_t& pos, int dec);
 			static inline int GetInt(const char* data, uint32_t& pos, int dec);
 			static inline int GetInt2(const char* data, uint32_t pos, int dec);
 			static inline float GetFloat(const char* data, uint32_t& pos, int dec);
-			static inline void GetKeyPos(const char* data, uint32_t& pos, Resources::Animation* anim);
-			static inline void GetKeyRot(const char* data, uint32_t& pos, Resources::Animation* anim);
+			static inline void GetKeyPos(const char* data, uint32_t& pos, std::vector<Resources::AnimationCurve<Math::Vector3>>& curves);
+			static inline void GetKeyRot(const char* data, uint32_t& pos, std::vector<Resources::AnimationCurve<Math::Quaternion>>& curves);
 		};
 
 		class PANDOR_API ANIMC
@@ -278,13 +287,15 @@ namespace Utils
 			static void Load(Resources::AnimationController* anim, const std::string& path);
 			static void Save(Resources::AnimationController* anim);
 			static void Parse(Resources::AnimationController* anim, const char* data, uint32_t size);
-			static inline Resources::StateRect* GetState(const char* data, uint32_t& pos);
+			static inline Resources::StateRect* GetState(Resources::AnimationController* animC, const char* data, uint32_t& pos);
 			static inline Resources::Link* GetLink(Resources::AnimationController* animC, const char* data, uint32_t& pos);
+			static inline Resources::AnimationLayer GetLayer(const char* data, uint32_t& pos);
 			static inline void GetParameters(Resources::AnimationController*& animC, const char* data, uint32_t& pos);
 			static inline void GetConditions(Resources::AnimationController*& animC, Resources::Link*& link, const char* data, uint32_t& pos);
 			static inline void SkipLine(const char* data, uint32_t& pos);
 			static inline Math::Vector2 GetVector2(const char* data, uint32_t& pos, int dec);
 			static inline std::string GetString(const char* data, uint32_t& pos, int dec);
+			static inline std::string GetLine(const char* data, uint32_t& pos);
 			static inline int GetInt(const char* data, uint32_t& pos, int dec);
 		};
 	}
@@ -2,6 +2,8 @@
 #include <Components/Animator.h>
 #include <Components/SkeletalMeshComponent.h>
 #include <Core/GameObject.h>
+#include <Core/App.h>
+#include <Core/AnimationSystem.h>
 
 #include <Resources/Animation.h>
 #include <Resources/AnimationController.h>
@@ -15,6 +17,8 @@ Component::Animator::Animator()
 
 Component::Animator::~Animator()
 {
+	if (Core::App::Get().animationSystem)
+		Core::App::Get().animationSystem->Unregister(this);
 	if (m_skeletalMesh && m_skeletalMesh->m_skeleton && m_skeletalMesh->m_skeleton->RootBone)
 	{
 		m_skeletalMesh->m_skeleton->RootBone->SetDefault();
@@ -34,9 +38,46 @@ void Component::Animator::ShowInInspector()
 	if (auto anim = Resources::ResourcesManager::Get()->ResourcePopup<Resources::AnimationController>("AnimationContollerPopup"))
 	{
 		m_animationController = Resources::ResourcesManager::Get()->GetOrLoad<Resources::AnimationController>(anim->GetPath());
+		// Indices and values belong to the previous controller
+		m_state = Resources::AnimatorStateBlock();
+		m_layerStates.clear();
+		m_parameterVersion = (uint32_t)-1;
 	}
 
 	WrapperUI::Checkbox("Play", &m_play);
+
+	if (WrapperUI::CollapsingHeader("Level Of Detail"))
+	{
+		WrapperUI::Checkbox("Enabled", &m_lod.enabled);
+		WrapperUI::BeginDisabled(!m_lod.enabled);
+
+		const char* metrics[] = { "Screen Size", "Distance" };
+		int metric = (int)m_lod.metric;
+		if (WrapperUI::Combo("Metric", &metric, metrics, 2))
+		{
+			// The thresholds of one metric mean nothing for the other
+			AnimatorLODSettings defaults;
+			m_lod.metric = (AnimatorLODMetric)metric;
+			for (int i = 0; i < AnimatorLODSettings::LevelCount - 1; i++)
+				m_lod.thresholds[i] = m_lod.metric == AnimatorLODMetric::Distance ? 10.f * (float)(1 << (i * 2)) : defaults.thresholds[i];
+		}
+		WrapperUI::DragFloat3("Thresholds", m_lod.thresholds, 0.01f, 0.f, 1000.f);
+		if (WrapperUI::DragInt4("Update Intervals", m_lod.updateIntervals, 0.1f, 1, 60))
+		{
+			for (int& interval : m_lod.updateIntervals)
+				interval = std::max(interval, 1);
+		}
+		WrapperUI::Checkbox("Interpolate", &m_lod.interpolate);
+		WrapperUI::DragInt("Last Level Bone Depth", &m_lod.lastLevelBoneDepth, 0.1f, -1, 64);
+
+		const char* cullingModes[] = { "Always Animate", "Advance Time", "Cull Completely" };
+		int cullingMode = (int)m_lod.cullingMode;
+		if (WrapperUI::Combo("Culling Mode", &cullingMode, cullingModes, 3))
+			m_lod.cullingMode = (AnimatorCullingMode)cullingMode;
+
+		WrapperUI::EndDisabled();
+		WrapperUI::Text("Current Level : %d%s", m_lodLevel, m_visible ? "" : " (Culled)");
+	}
 }
 
 void Component::Animator::Update()
@@ -63,17 +104,13 @@ void Component::Animator::GameUpdate()
 		m_skeletalMesh = gameObject->GetComponent<SkeletalMeshComponent>();
 	}
 
-	if (m_animationController && !m_currentState)
-	{
-		m_currentState = m_animationController->GetStateByName("Entry");
-	}
 	if (m_animationController)
 	{
 		m_animationController->UpdateParameters(this, false);
 	}
 	if (m_animationController && m_skeletalMesh && m_animationController->IsLoaded())
 	{
-		m_animationController->Update(this);
+		Core::App::Get().animationSystem->Register(this);
 	}
 
 
@@ -82,40 +119,158 @@ void Component::Animator::GameUpdate()
 	{
 		active = !active;
 	}
+	static const int shouldRunID = StringToHash("ShouldRun");
 	if (m_animationController )
-		SetBoolean("ShouldRun", active);
+		SetBool(shouldRunID, active);
 }
 
-void Component::Animator::SetBoolean(const std::string& name, bool value)
+void Component::Animator::PrepareEvaluation()
 {
-	if (m_parameters.count(name))
+	// Compiles the graph shared with the other animators of the controller
+	m_animationController->GetStateMachine();
+}
+
+void Component::Animator::Evaluate()
+{
+	m_deltaTime = m_pendingDeltaTime;
+	m_pendingDeltaTime = 0.f;
+	m_framesSinceEvaluation = 0;
+	m_evaluatePose = m_visible || m_lod.cullingMode == AnimatorCullingMode::AlwaysAnimate;
+
+	if (Resources::Skeleton* skel = m_skeletalMesh->GetSkeleton())
 	{
-		m_parameters[name] = value;
+		bool interpolate = m_lod.enabled && m_lod.interpolate && m_evaluatePose && m_poseValid;
+		skel->BeginPoseInterpolation(interpolate ? GetUpdateInterval() : 1);
+		bool lastLevel = m_lod.enabled && m_lodLevel == AnimatorLODSettings::LevelCount - 1;
+		skel->SetMaxBoneDepth(lastLevel ? m_lod.lastLevelBoneDepth : -1);
 	}
-	m_conditionUpdated = true;
+
+	m_animationController->Update(this);
+	m_poseValid = m_evaluatePose;
 }
 
-void Component::Animator::SetSkeletalMesh(class SkeletalMeshComponent* _skeletalMesh)
+void Component::Animator::SkipEvaluation()
 {
-	m_skeletalMesh = _skeletalMesh;
+	if (!m_poseValid)
+		return;
+	if (Resources::Skeleton* skel = m_skeletalMesh->GetSkeleton())
+		skel->StepPoseInterpolation();
+}
+
+int Component::Animator::GetUpdateInterval() const
+{
+	if (!m_lod.enabled)
+		return 1;
+	int level = m_visible ? m_lodLevel : AnimatorLODSettings::LevelCount - 1;
+	return std::max(m_lod.updateIntervals[level], 1);
+}
+
+int Component::Animator::StringToHash(std::string_view name)
+{
+	uint32_t hash = 2166136261u;
+	for (char c : name)
+	{
+		hash ^= (uint8_t)c;
+		hash *= 16777619u;
+	}
+	return (int)hash;
+}
+
+int Component::Animator::GetParameterIndex(int id, Resources::AnimatorParameterType type) const
+{
+	if (!m_animationController || m_parameterVersion != m_animationController->parameterVersion)
+		return -1;
+
+	int index = m_animationController->GetParameterIndex(id);
+	if (index < 0 || m_animationController->parameters[index].type != type)
+		return -1;
+	return index;
+}
+
+int Component::Animator::SyncParameterIndex(int id, Resources::AnimatorParameterType type)
+{
+	// Scripts can set parameters before the first update of the animator
+	if (m_animationController)
+		m_animationController->UpdateParameters(this, false);
+	return GetParameterIndex(id, type);
+}
+
+void Component::Animator::SetBool(int id, bool value)
+{
+	int index = SyncParameterIndex(id, Resources::AnimatorParameterType::Bool);
+	if (index < 0 || m_parameters[index].b == value)
+		return;
+	m_parameters[index].b = value;
+	m_state.conditionUpdated = true;
+}
+
+void Component::Animator::SetFloat(int id, float value)
+{
+	int index = SyncParameterIndex(id, Resources::AnimatorParameterType::Float);
+	if (index < 0 || m_parameters[index].f == value)
+		return;
+	m_parameters[index].f = value;
+	m_state.conditionUpdated = true;
+}
+
+void Component::Animator::SetInteger(int id, int value)
+{
+	int index = SyncParameterIndex(id, Resources::AnimatorParameterType::Int);
+	if (index < 0 || m_parameters[index].i == value)
+		return;
+	m_parameters[index].i = value;
+	m_state.conditionUpdated = true;
+}
+
+void Component::Animator::SetTrigger(int id)
+{
+	int index = SyncParameterIndex(id, Resources::AnimatorParameterType::Trigger);
+	if (index < 0)
+		return;
+	m_parameters[index].b = true;
+	m_state.conditionUpdated = true;
+}
+
+void Component::Animator::ResetTrigger(int id)
+{
+	int index = SyncParameterIndex(id, Resources::AnimatorParameterType::Trigger);
+	if (index < 0)
+		return;
+	m_parameters[index].b = false;
 }
 
-void Component::Animator::SetTransitionLink(Resources::Link* link)
+bool Component::Animator::GetBool(int id) const
 {
-	m_transitionLink = link;
-	m_currentTime = 0.f;
-	m_elapsedTime = 0.f;
+	int index = GetParameterIndex(id, Resources::AnimatorParameterType::Bool);
+	return index >= 0 ? m_parameters[index].b : false;
 }
 
-void Component::Animator::IncrementTime(Resources::Animation* anim)
+float Component::Animator::GetFloat(int id) const
 {
-	if (m_currentTime < anim->KeyCount + 1)
-		m_currentTime += fmodf(WrapperUI::GetDeltaTime() * 30 * m_currentState->speed, (float)anim->KeyCount);
+	int index = GetParameterIndex(id, Resources::AnimatorParameterType::Float);
+	return index >= 0 ? m_parameters[index].f : 0.f;
+}
 
-	if (m_currentTime > anim->KeyCount && m_currentState->loop)
-		m_currentTime = 0;
-	else if (m_currentTime <= 0 && m_currentState->loop)
-		m_currentTime = (float)anim->KeyCount;
+int Component::Animator::GetInteger(int id) const
+{
+	int index = GetParameterIndex(id, Resources::AnimatorParameterType::Int);
+	return index >= 0 ? m_parameters[index].i : 0;
+}
+
+void Component::Animator::SetSkeletalMesh(class SkeletalMeshComponent* _skeletalMesh)
+{
+	m_skeletalMesh = _skeletalMesh;
+}
+
+void Component::Animator::IncrementTime(const Resources::CompiledState& state, float length, float& time)
+{
+	if (time < length + 1)
+		time += fmodf(m_deltaTime * 30 * state.speed, length);
+
+	if (time > length && state.loop)
+		time = 0;
+	else if (time <= 0 && state.loop)
+		time = length;
 }
 
 void Component::Animator::ReadComponent(std::fstream& sceneFile)
@@ -124,7 +279,23 @@ void Component::Animator::ReadComponent(std::fstream& sceneFile)
 	if (getline(sceneFile, line) && line != "end")
 		m_animationController = Resources::ResourcesManager::Get()->GetOrLoad<AnimationController>(line);
 
-	while (getline(sceneFile, line) && line != "end") {}
+	// Older scenes have no lod line
+	while (getline(sceneFile, line) && line != "end")
+	{
+		if (line.rfind("lod ", 0) != 0)
+			continue;
+		std::istringstream lod(line.substr(4));
+		int metric = 0;
+		int cullingMode = 0;
+		lod >> m_lod.enabled >> metric;
+		for (float& threshold : m_lod.thresholds)
+			lod >> threshold;
+		for (int& interval : m_lod.updateIntervals)
+			lod >> interval;
+		lod >> m_lod.interpolate >> m_lod.lastLevelBoneDepth >> cullingMode;
+		m_lod.metric = (AnimatorLODMetric)metric;
+		m_lod.cullingMode = (AnimatorCullingMode)cullingMode;
+	}
 }
 
 std::ostream& Component::Animator::operator<<(std::ostream& os)
@@ -133,5 +304,11 @@ std::ostream& Component::Animator::operator<<(std::ostream& os)
 		os << m_animationController->GetPath() << '\n';
 	else
 		os << "nullptr" << '\n';
+	os << "lod " << m_lod.enabled << ' ' << (int)m_lod.metric;
+	for (float threshold : m_lod.thresholds)
+		os << ' ' << threshold;
+	for (int interval : m_lod.updateIntervals)
+		os << ' ' << interval;
+	os << ' ' << m_lod.interpolate << ' ' << m_lod.lastLevelBoneDepth << ' ' << (int)m_lod.cullingMode << '\n';
 	return os;
 }
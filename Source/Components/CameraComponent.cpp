@@ -167,7 +167,7 @@ Math::Vector2 Component::CameraComponent::GetScreenResolution()
 #ifndef PANDOR_GAME
 	return Core::App::Get().GetEditorUIManager().GetGameWindow().GetSize();
 #else
-	return Core::App::Get().window->GetSize();
+	return Core::App::Get().GetScreenSize();
 #endif
 }
 
@@ -25,6 +25,7 @@
 
 #include "Components/SoundEmitter.h"
 #include <Components/ParticleSystem.h>
+#include <Components/CrowdRenderer.h>
 
 
 Component::ComponentsData* Component::ComponentsData::m_componentsDatas = nullptr;
@@ -76,6 +77,7 @@ void Component::ComponentsData::Initialize()
 	NewComponent(new Component::Animator());
 	NewComponent(new Component::TextMesh());
 	NewComponent(new Component::ParticleSystem());
+	NewComponent(new Component::CrowdRenderer());
 	NewComponent(new Component::SoundListener());
 	NewComponent(new Component::SoundEmitter());
 	NewComponent(new Component::Constraint());
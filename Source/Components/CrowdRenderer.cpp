@@ -0,0 +1,497 @@
+#include "pch.h"
+#include <Components/CrowdRenderer.h>
+#include <Resources/ResourcesManager.h>
+#include <Resources/SkeletalMesh.h>
+#include <Resources/Skeleton.h>
+#include <Resources/Animation.h>
+#include <Resources/Material.h>
+#include <Resources/Shader.h>
+#include <Resources/Model.h>
+#include <Render/Camera.h>
+#include <Utils/Utils.h>
+#include <Core/GameObject.h>
+#include <Core/SceneManager.h>
+#include <Core/Scene.h>
+#include <Core/App.h>
+
+#include <random>
+
+// Texture units of the baked textures, after the ones of the material (0 to 3), the skybox (4) and the shadow map (5)
+static constexpr unsigned int s_PositionUnit = 6;
+static constexpr unsigned int s_NormalUnit = 7;
+
+// Per instance attributes, read by crowd.vert
+// 8  : position xyz, scale
+// 9  : sin(yaw), cos(yaw), speed, time offset
+// 10 : first frame, frame count, sample rate of the clip
+static constexpr size_t s_InstanceFloats = 12;
+
+Component::CrowdRenderer::CrowdRenderer()
+{
+}
+
+Component::CrowdRenderer::CrowdRenderer(const CrowdRenderer& other) : IComponent<CrowdRenderer>(other)
+{
+	m_meshToLoad = other.m_meshToLoad;
+	m_skeletonToLoad = other.m_skeletonToLoad;
+	m_mesh = other.m_mesh;
+	m_skeleton = other.m_skeleton;
+	m_animations = other.m_animations;
+	m_material = other.m_material;
+	m_crowdVertShader = other.m_crowdVertShader;
+	m_shader = other.m_shader;
+	m_bakeSettings = other.m_bakeSettings;
+	m_baked = other.m_baked;
+	m_bakeDirty = other.m_bakeDirty;
+	m_texturesDirty = !m_baked.IsEmpty();
+	m_layout = other.m_layout;
+	m_useLayout = other.m_useLayout;
+	m_instances = other.m_instances;
+	m_instancesDirty = true;
+	m_playbackSpeed = other.m_playbackSpeed;
+}
+
+Component::CrowdRenderer::~CrowdRenderer()
+{
+	DeleteGPUData();
+}
+
+void Component::CrowdRenderer::ShowInInspector()
+{
+	TreeNodeFlags flags = (TreeNodeFlags)((int)TreeNodeFlags::AllowItemOverlap | (int)TreeNodeFlags::NoTreePushOnOpen);
+	if (WrapperUI::CollapsingHeader("Renderer", flags))
+	{
+		if (WrapperUI::Button("Mesh"))
+			WrapperUI::OpenPopup("CrowdMeshPopup");
+		WrapperUI::SameLine();
+		WrapperUI::TextUnformatted(m_mesh ? m_mesh->GetPath().c_str() : "None");
+		if (auto mesh = Resources::ResourcesManager::Get()->ResourcePopup<Resources::SkeletalMesh>("CrowdMeshPopup"))
+			SetMesh(mesh);
+
+		if (WrapperUI::Button("Skeleton"))
+			WrapperUI::OpenPopup("CrowdSkeletonPopup");
+		WrapperUI::SameLine();
+		WrapperUI::TextUnformatted(m_skeleton ? m_skeleton->GetPath().c_str() : "None");
+		if (auto skeleton = Resources::ResourcesManager::Get()->ResourcePopup<Resources::Skeleton>("CrowdSkeletonPopup"))
+			SetSkeleton(skeleton);
+
+		if (WrapperUI::Button("Material"))
+			WrapperUI::OpenPopup("CrowdMaterialPopup");
+		WrapperUI::SameLine();
+		WrapperUI::TextUnformatted(m_material ? m_material->GetName().c_str() : "None");
+		if (auto material = Resources::ResourcesManager::Get()->MaterialPopup("CrowdMaterialPopup"))
+			SetMaterial(Resources::ResourcesManager::Get()->GetOrLoad<Resources::Material>(material->GetPath()));
+	}
+
+	if (WrapperUI::CollapsingHeader("Animations", flags))
+	{
+		for (size_t i = 0; i < m_animations.size(); i++)
+		{
+			WrapperUI::PushID((int)i);
+			if (WrapperUI::Button("X"))
+			{
+				RemoveAnimation(i);
+				WrapperUI::PopID();
+				break;
+			}
+			WrapperUI::SameLine();
+			WrapperUI::TextUnformatted(m_animations[i] ? m_animations[i]->GetName().c_str() : "Missing Animation");
+			WrapperUI::PopID();
+		}
+		if (WrapperUI::Button("Add Animation"))
+			WrapperUI::OpenPopup("CrowdAnimationPopup");
+		if (auto animation = Resources::ResourcesManager::Get()->ResourcePopup<Resources::Animation>("CrowdAnimationPopup"))
+			AddAnimation(animation);
+	}
+
+	if (WrapperUI::CollapsingHeader("Bake", flags))
+	{
+		int mode = (int)m_bakeSettings.mode;
+		if (WrapperUI::Combo("Mode", &mode, "Vertices\0Bones\0"))
+		{
+			m_bakeSettings.mode = (Resources::VertexAnimationMode)mode;
+			m_bakeDirty = true;
+		}
+		if (WrapperUI::DragFloat("Sample Rate", &m_bakeSettings.sampleRate, 1.f, 1.f, 120.f))
+			m_bakeDirty = true;
+		if (WrapperUI::Button("Bake"))
+			m_bakeDirty = true;
+		if (!m_baked.IsEmpty())
+			WrapperUI::Text("%zu clips, %u frames, %ux%u texels, %.2f MB", m_baked.clips.size(), m_baked.frameCount, m_baked.width, m_baked.height,
+				m_baked.GetMemorySize() / (1024.f * 1024.f));
+	}
+
+	if (WrapperUI::CollapsingHeader("Instances", flags))
+	{
+		bool changed = false;
+		changed |= WrapperUI::DragInt("Count", &m_layout.count, 1.f, 0, 100000);
+		changed |= WrapperUI::DragInt("Columns", &m_layout.columns, 1.f, 1, 1000);
+		changed |= WrapperUI::DragFloat("Spacing", &m_layout.spacing, 0.05f, 0.f, 100.f);
+		changed |= WrapperUI::DragFloat("Jitter", &m_layout.jitter, 0.01f, 0.f, 1.f);
+		changed |= WrapperUI::DragFloat("Speed Variation", &m_layout.speedVariation, 0.01f, 0.f, 1.f);
+		changed |= WrapperUI::DragInt("Seed", &m_layout.seed);
+		if (changed || (!m_useLayout && WrapperUI::Button("Use Layout")))
+			GenerateInstances();
+		WrapperUI::DragFloat("Playback Speed", &m_playbackSpeed, 0.01f, 0.f, 10.f);
+		WrapperUI::Text("Instance Number : %zu", m_instances.size());
+	}
+}
+
+void Component::CrowdRenderer::Initialize()
+{
+	m_crowdVertShader = Resources::ResourcesManager::Get()->GetOrLoad<Resources::VertexShader>(ENGINEPATH"Shaders/CrowdInstanceShader/crowd.vert");
+}
+
+void Component::CrowdRenderer::Update()
+{
+	LoadPendingResources();
+	UpdateShader();
+
+	if (m_bakeDirty && m_mesh && m_mesh->HasBeenSent() && m_skeleton && !m_animations.empty()
+		&& std::all_of(m_animations.begin(), m_animations.end(), [](Resources::Animation* animation) { return animation && animation->HasBeenSent(); }))
+		Bake();
+
+	if (m_mesh && m_mesh->HasBeenSent() && !m_buffer)
+		CreateBuffers();
+	if (m_texturesDirty)
+		UploadTextures();
+	if (m_instancesDirty && m_instanceBuffer && !m_baked.IsEmpty())
+	{
+		if (m_useLayout)
+			GenerateInstances();
+		UploadInstances();
+	}
+
+	m_time += WrapperUI::GetDeltaTime() * m_playbackSpeed;
+}
+
+void Component::CrowdRenderer::Draw()
+{
+	if (!m_mesh || !m_buffer || !m_material || !m_shader || !m_shader->HasBeenSent() || !m_positionTexture || m_texturesDirty || m_instancesDirty || m_instances.empty())
+		return;
+	if (!IsVisible())
+		return;
+
+	m_shader->Use();
+	WrapperRHI::ShaderSendMat4(m_shader->GetLocation("modelMatrix"), gameObject->transform->GetModelMatrix());
+	WrapperRHI::ShaderSendFloat(m_shader->GetLocation("crowdTime"), m_time);
+	WrapperRHI::ShaderSendInt(m_shader->GetLocation("vatMode"), (int)m_baked.mode);
+	WrapperRHI::ShaderSendInt(m_shader->GetLocation("vatWidth"), (int)m_baked.width);
+	WrapperRHI::ShaderSendInt(m_shader->GetLocation("vatRowsPerFrame"), (int)m_baked.rowsPerFrame);
+
+	WrapperRHI::ActivateTexture(s_PositionUnit);
+	WrapperRHI::TextureBind(m_positionTexture);
+	WrapperRHI::ShaderSendInt(m_shader->GetLocation("vatPositions"), s_PositionUnit);
+	if (m_normalTexture)
+	{
+		WrapperRHI::ActivateTexture(s_NormalUnit);
+		WrapperRHI::TextureBind(m_normalTexture);
+		WrapperRHI::ShaderSendInt(m_shader->GetLocation("vatNormals"), s_NormalUnit);
+	}
+
+	m_mesh->RenderInstancing(m_material, m_shader, m_instances.size(), m_buffer);
+
+	WrapperRHI::ActivateTexture(s_NormalUnit);
+	WrapperRHI::TextureUnBind();
+	WrapperRHI::ActivateTexture(s_PositionUnit);
+	WrapperRHI::TextureUnBind();
+	WrapperRHI::ActivateTexture(0);
+}
+
+void Component::CrowdRenderer::SetMesh(Resources::SkeletalMesh* mesh)
+{
+	if (!mesh || mesh == m_mesh)
+		return;
+	DeleteGPUData();
+	m_mesh = mesh;
+	m_bakeDirty = true;
+}
+
+void Component::CrowdRenderer::SetSkeleton(Resources::Skeleton* skeleton)
+{
+	m_skeleton = skeleton;
+	m_bakeDirty = true;
+}
+
+void Component::CrowdRenderer::SetMaterial(Resources::Material* material)
+{
+	m_material = material;
+}
+
+void Component::CrowdRenderer::AddAnimation(Resources::Animation* animation)
+{
+	if (!animation)
+		return;
+	m_animations.push_back(animation);
+	m_bakeDirty = true;
+}
+
+void Component::CrowdRenderer::RemoveAnimation(size_t index)
+{
+	if (index >= m_animations.size())
+		return;
+	m_animations.erase(m_animations.begin() + index);
+	m_bakeDirty = true;
+}
+
+void Component::CrowdRenderer::SetInstances(const std::vector<CrowdInstance>& instances)
+{
+	m_instances = instances;
+	m_useLayout = false;
+	m_instancesDirty = true;
+}
+
+void Component::CrowdRenderer::GenerateInstances()
+{
+	m_useLayout = true;
+	m_instancesDirty = true;
+	m_instances.resize(std::max(m_layout.count, 0));
+
+	std::mt19937 seed((uint32_t)m_layout.seed);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	const int columns = std::max(m_layout.columns, 1);
+	const int rows = ((int)m_instances.size() + columns - 1) / columns;
+	const int clipCount = (int)m_baked.clips.size();
+	// Centered on the game object
+	const Math::Vector3 origin((columns - 1) * m_layout.spacing * -0.5f, 0.f, (rows - 1) * m_layout.spacing * -0.5f);
+	for (size_t i = 0; i < m_instances.size(); i++)
+	{
+		CrowdInstance& instance = m_instances[i];
+		float jitterX = (unit(seed) * 2.f - 1.f) * m_layout.jitter * m_layout.spacing;
+		float jitterZ = (unit(seed) * 2.f - 1.f) * m_layout.jitter * m_layout.spacing;
+		instance.position = origin + Math::Vector3((i % columns) * m_layout.spacing + jitterX, 0.f, (i / columns) * m_layout.spacing + jitterZ);
+		instance.yaw = unit(seed) * 360.f;
+		instance.scale = 1.f;
+		instance.clip = clipCount > 0 ? std::min((int)(unit(seed) * clipCount), clipCount - 1) : 0;
+		instance.timeOffset = clipCount > 0 ? unit(seed) * m_baked.clips[instance.clip].duration : 0.f;
+		instance.speed = 1.f + (unit(seed) * 2.f - 1.f) * m_layout.speedVariation;
+	}
+}
+
+bool Component::CrowdRenderer::Bake()
+{
+	m_bakeDirty = false;
+	if (!m_mesh || !m_skeleton || m_animations.empty())
+		return false;
+	bool baked = Resources::VertexAnimationBaker::Bake(m_mesh, m_skeleton, m_animations, m_bakeSettings, m_baked);
+	m_texturesDirty = baked;
+	// The clips moved in the textures
+	m_instancesDirty = true;
+	return baked;
+}
+
+std::ostream& Component::CrowdRenderer::operator<<(std::ostream& os)
+{
+	if (m_mesh) {
+		os << m_mesh->GetModel()->GetPath() << '\n';
+		os << m_mesh->GetPath() << '\n';
+	}
+	else {
+		os << "nullptr" << '\n';
+		os << "nullptr" << '\n';
+	}
+	os << (m_skeleton ? m_skeleton->GetPath() : "nullptr") << '\n';
+	os << (m_material ? m_material->GetPath() : "nullptr") << '\n';
+	os << m_animations.size() << '\n';
+	for (auto& animation : m_animations)
+		os << (animation ? animation->GetPath() : "nullptr") << '\n';
+	os << "bake " << (int)m_bakeSettings.mode << ' ' << m_bakeSettings.sampleRate << ' ' << m_bakeSettings.maxWidth << '\n';
+	// The instances given by SetInstances are not saved, the script sets them again
+	os << "layout " << m_layout.count << ' ' << m_layout.columns << ' ' << m_layout.spacing << ' ' << m_layout.jitter << ' '
+		<< m_layout.speedVariation << ' ' << m_layout.seed << ' ' << m_playbackSpeed << '\n';
+	return os;
+}
+
+void Component::CrowdRenderer::ReadComponent(std::fstream& sceneFile)
+{
+	std::string line;
+	if (getline(sceneFile, line) && line != "end")
+		if (line != "nullptr")
+			Resources::ResourcesManager::Get()->GetOrLoad<Resources::Model>(line);
+	if (getline(sceneFile, line) && line != "end")
+		if (line != "nullptr")
+			m_meshToLoad = line;
+	if (getline(sceneFile, line) && line != "end")
+		if (line != "nullptr")
+			m_skeletonToLoad = line;
+	if (getline(sceneFile, line) && line != "end")
+		if (line != "nullptr")
+			m_material = Resources::ResourcesManager::Get()->GetOrLoad<Resources::Material>(line);
+
+	size_t animationCount = 0;
+	if (getline(sceneFile, line) && line != "end")
+		animationCount = std::stoul(line);
+	for (size_t i = 0; i < animationCount && getline(sceneFile, line) && line != "end"; i++)
+		if (line != "nullptr")
+			AddAnimation(Resources::ResourcesManager::Get()->GetOrLoad<Resources::Animation>(line));
+
+	while (getline(sceneFile, line) && line != "end")
+	{
+		if (line.rfind("bake ", 0) == 0)
+		{
+			std::istringstream bake(line.substr(5));
+			int mode = 0;
+			bake >> mode >> m_bakeSettings.sampleRate >> m_bakeSettings.maxWidth;
+			m_bakeSettings.mode = (Resources::VertexAnimationMode)mode;
+		}
+		else if (line.rfind("layout ", 0) == 0)
+		{
+			std::istringstream layout(line.substr(7));
+			layout >> m_layout.count >> m_layout.columns >> m_layout.spacing >> m_layout.jitter >> m_layout.speedVariation >> m_layout.seed >> m_playbackSpeed;
+		}
+	}
+	m_bakeDirty = true;
+}
+
+void Component::CrowdRenderer::LoadPendingResources()
+{
+	if (!m_meshToLoad.empty())
+	{
+		auto mesh = Resources::ResourcesManager::Get()->Find<Resources::SkeletalMesh>(m_meshToLoad);
+		if (mesh && mesh->HasBeenSent())
+		{
+			SetMesh(mesh);
+			m_meshToLoad.clear();
+		}
+	}
+	if (!m_skeletonToLoad.empty())
+	{
+		if (auto skeleton = Resources::ResourcesManager::Get()->Find<Resources::Skeleton>(m_skeletonToLoad))
+		{
+			SetSkeleton(skeleton);
+			m_skeletonToLoad.clear();
+		}
+	}
+}
+
+void Component::CrowdRenderer::UpdateShader()
+{
+	if (!m_crowdVertShader || !m_material || !m_material->GetShader() || !m_material->GetShader()->GetFrag())
+		return;
+	Resources::FragmentShader* frag = m_material->GetShader()->GetFrag();
+	if (m_shader && m_shader->GetFrag() == frag)
+		return;
+	auto name = Utils::StringFormat("%s + %s", m_crowdVertShader->GetPath().c_str(), frag->GetPath().c_str());
+	m_shader = Resources::ResourcesManager::Get()->Create(name, m_crowdVertShader->GetPath(), frag->GetPath());
+}
+
+void Component::CrowdRenderer::CreateBuffers()
+{
+	// Own copy of the vertices, the instance attributes are added to its vertex array
+	m_buffer = new WrapperRHI::Buffer(m_mesh->m_vertices.data(), m_mesh->m_vertices.size());
+	m_buffer->Bind();
+	const unsigned int stride = Resources::SkeletalMesh::VertexStride * sizeof(float);
+	m_buffer->LinkAttribute(0, 3, PR_FLOAT, stride, (void*)0);
+	m_buffer->LinkAttribute(1, 2, PR_FLOAT, stride, (void*)(3 * sizeof(float)));
+	m_buffer->LinkAttribute(2, 3, PR_FLOAT, stride, (void*)(5 * sizeof(float)));
+	m_buffer->LinkAttribute(3, 3, PR_FLOAT, stride, (void*)(8 * sizeof(float)));
+	// Bone indices then bone weights, only read in the Bones mode
+	m_buffer->LinkAttribute(4, 4, PR_FLOAT, stride, (void*)(11 * sizeof(float)));
+	m_buffer->LinkAttribute(5, 4, PR_FLOAT, stride, (void*)(15 * sizeof(float)));
+	m_buffer->LinkAttribute(6, 4, PR_FLOAT, stride, (void*)(19 * sizeof(float)));
+	m_buffer->LinkAttribute(7, 4, PR_FLOAT, stride, (void*)(23 * sizeof(float)));
+
+	m_instanceBuffer = new WrapperRHI::Buffer();
+	m_instanceBuffer->GenVertexBuffer();
+	const unsigned int instanceStride = s_InstanceFloats * sizeof(float);
+	for (unsigned int i = 0; i < 3; i++)
+	{
+		m_buffer->LinkAttribute(8 + i, 4, PR_FLOAT, instanceStride, (void*)(i * 4 * sizeof(float)));
+		m_buffer->AttribDivisor(8 + i, 1);
+	}
+	m_buffer->Unbind();
+	m_instanceBuffer->UnbindVertexBuffer();
+	m_instancesDirty = true;
+}
+
+void Component::CrowdRenderer::UploadInstances()
+{
+	m_instancesDirty = false;
+	m_instancesMin = Math::Vector3();
+	m_instancesMax = Math::Vector3();
+	m_maxScale = 0.f;
+
+	std::vector<float> datas(m_instances.size() * s_InstanceFloats);
+	for (size_t i = 0; i < m_instances.size(); i++)
+	{
+		const CrowdInstance& instance = m_instances[i];
+		const Resources::VertexAnimationClip& clip = m_baked.clips[std::clamp(instance.clip, 0, (int)m_baked.clips.size() - 1)];
+		float* data = &datas[i * s_InstanceFloats];
+		data[0] = instance.position.x;
+		data[1] = instance.position.y;
+		data[2] = instance.position.z;
+		data[3] = instance.scale;
+		data[4] = std::sin(instance.yaw * DEG2RAD);
+		data[5] = std::cos(instance.yaw * DEG2RAD);
+		data[6] = instance.speed;
+		data[7] = instance.timeOffset;
+		data[8] = (float)clip.firstFrame;
+		data[9] = (float)clip.frameCount;
+		data[10] = clip.sampleRate;
+		data[11] = 0.f;
+
+		if (i == 0)
+		{
+			m_instancesMin = instance.position;
+			m_instancesMax = instance.position;
+		}
+		for (size_t axis = 0; axis < 3; axis++)
+		{
+			m_instancesMin[axis] = std::min(m_instancesMin[axis], instance.position[axis]);
+			m_instancesMax[axis] = std::max(m_instancesMax[axis], instance.position[axis]);
+		}
+		m_maxScale = std::max(m_maxScale, instance.scale);
+	}
+
+	m_instanceBuffer->BufferData(datas.size() * sizeof(float), datas.empty() ? nullptr : datas.data());
+	m_instanceBuffer->UnbindVertexBuffer();
+}
+
+void Component::CrowdRenderer::UploadTextures()
+{
+	m_texturesDirty = false;
+	if (m_baked.IsEmpty())
+		return;
+	WrapperRHI::SendFloatTexture(m_positionTexture, (int)m_baked.width, (int)m_baked.height, m_baked.positions.data());
+	if (!m_baked.normals.empty())
+		WrapperRHI::SendFloatTexture(m_normalTexture, (int)m_baked.width, (int)m_baked.height, m_baked.normals.data());
+	else if (m_normalTexture)
+	{
+		WrapperRHI::TextureDelete(m_normalTexture);
+		m_normalTexture = 0;
+	}
+}
+
+void Component::CrowdRenderer::DeleteGPUData()
+{
+	if (m_buffer)
+	{
+		m_buffer->Delete();
+		delete m_buffer;
+		m_buffer = nullptr;
+	}
+	if (m_instanceBuffer)
+	{
+		m_instanceBuffer->Delete();
+		delete m_instanceBuffer;
+		m_instanceBuffer = nullptr;
+	}
+	if (m_positionTexture)
+		WrapperRHI::TextureDelete(m_positionTexture);
+	if (m_normalTexture)
+		WrapperRHI::TextureDelete(m_normalTexture);
+	m_positionTexture = 0;
+	m_normalTexture = 0;
+	m_texturesDirty = !m_baked.IsEmpty();
+}
+
+bool Component::CrowdRenderer::IsVisible()
+{
+	Render::Camera* camera = Core::SceneManager::Get()->GetCurrentScene()->currentCamera;
+	if (!camera)
+		return true;
+	// Any yaw of the baked bounds fits in this radius
+	float radius = std::max(m_baked.boundsMin.Length(), m_baked.boundsMax.Length()) * m_maxScale;
+	Utils::AABB bounds(m_instancesMin - Math::Vector3(radius, radius, radius), m_instancesMax + Math::Vector3(radius, radius, radius));
+	return bounds.isOnFrustum(camera->frustum, gameObject->transform);
+}
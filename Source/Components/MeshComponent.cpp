@@ -2,6 +2,7 @@
 
 #include <Components/MeshComponent.h>
 #include <Core/App.h>
+#include <Core/RenderQueue.h>
 
 #include <Resources/Mesh.h>
 #include <Resources/Material.h>
@@ -50,7 +51,7 @@ void Component::MeshComponent::GameDraw()
 
 	bool onFrustum = m_mesh->IsVisible(Core::SceneManager::Get()->GetCurrentScene()->currentCamera, gameObject->transform);
 	if (onFrustum)
-		m_mesh->Render(gameObject->transform->GetModelMatrix() * Core::App::Get().sceneManager->GetCurrentScene()->GetVP(), gameObject->transform->GetModelMatrix(), this->m_materials);
+		Core::App::Get().renderQueue->Submit(m_mesh, gameObject->transform, this->m_materials);
 }
 
 void Component::MeshComponent::EditorDraw()
@@ -61,7 +62,7 @@ void Component::MeshComponent::EditorDraw()
 
 	bool onFrustum = m_mesh->IsVisible(Core::SceneManager::Get()->GetCurrentScene()->currentCamera, gameObject->transform);
 	if (onFrustum && gameObject != Core::App::Get().GetEditorUIManager().GetInspector().GetGameObjectSelected())
-		m_mesh->Render(gameObject->transform->GetModelMatrix() * Core::App::Get().sceneManager->GetCurrentScene()->GetVP(), gameObject->transform->GetModelMatrix(), this->m_materials, false, true);
+		Core::App::Get().renderQueue->Submit(m_mesh, gameObject->transform, this->m_materials);
 #endif
 }
 
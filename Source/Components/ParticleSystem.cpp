@@ -10,34 +10,19 @@
 #include <Core/SceneManager.h>
 #include <Core/Scene.h>
 #include <Core/App.h>
+#include <Core/ParticleManager.h>
+#include <Core/Wrappers/WrapperPhysic.h>
+#include <Render/Camera.h>
+#include <Render/GPUParticles.h>
 #ifndef PANDOR_GAME
 #include <Render/EditorIcon.h>
 #endif
-// Function to convert vector of InstanceData structs to float* pointer
-std::vector<float> convertToFloatPointer(const std::vector<Component::InstanceData>& instances) {
-	const size_t numInstances = instances.size();
-	const size_t floatArraySize = numInstances * 8;  // Each struct has 8 floats
+#include <xmmintrin.h>
+#include <random>
 
-	std::vector<float> floatArray;  // Allocate memory using std::vector
-	floatArray.resize(floatArraySize);
-
-	for (int i = 0; i < numInstances; ++i) {
-		const Component::InstanceData& instance = instances[i];
-		const int baseIndex = i * 8;
-
-		floatArray[baseIndex + 0] = instance.xyzs.x;
-		floatArray[baseIndex + 1] = instance.xyzs.y;
-		floatArray[baseIndex + 2] = instance.xyzs.z;
-		floatArray[baseIndex + 3] = instance.xyzs.w;
-
-		floatArray[baseIndex + 4] = instance.color.x;
-		floatArray[baseIndex + 5] = instance.color.y;
-		floatArray[baseIndex + 6] = instance.color.z;
-		floatArray[baseIndex + 7] = instance.color.w;
-	}
-
-	return floatArray;  // Return the pointer to the underlying data
-}
+static constexpr float s_Gravity = -9.81f;
+// Floats of an InstanceData
+static constexpr size_t s_InstanceFloats = 8;
 
 template<>
 bool Component::MinMaxValue<float>::ShowInInspector(const std::string& name)
@@ -143,12 +128,18 @@ Component::ParticleSystem::ParticleSystem()
 
 Component::ParticleSystem::~ParticleSystem()
 {
-	for (auto& particle : m_particles)
+	if (Core::App::Get().particleManager)
+		Core::App::Get().particleManager->Unregister(this);
+	for (WrapperRHI::Buffer** buffer : { &m_buffer, &m_buffer2 })
 	{
-		delete particle;
-		particle = nullptr;
+		if (!*buffer)
+			continue;
+		(*buffer)->Delete();
+		delete *buffer;
+		*buffer = nullptr;
 	}
-	m_particles.clear();
+	delete m_gpu;
+	m_gpu = nullptr;
 #ifndef PANDOR_GAME
 	delete m_icon;
 	m_icon = nullptr;
@@ -163,23 +154,31 @@ void Component::ParticleSystem::ShowInInspector()
 		if (WrapperUI::Button(m_play ? "Pause" : "Play")) { m_play = !m_play; }
 		WrapperUI::SameLine();
 		if (WrapperUI::Button("Restart"))
-		{
-			m_time = 0;
-			InitializeParticles();
-		}
+			Restart();
 		WrapperUI::SameLine();
 		if (WrapperUI::Button("Stop")) {
-			m_time = 0;
+			Restart();
 			m_play = false;
-			//_drawParticles = false;
-			//ResetPositions();
 		}
 		WrapperUI::PushItemWidth(100.f);
-		WrapperUI::DragFloat("Playback Time", &m_time, 0.1f, 0.001f);
-		if (m_time < 0) m_time = 0;
+		WrapperUI::Text("Playback Time : %.2f", m_time);
 		WrapperUI::DragFloat("Playback Speed", &m_speed, 1.0f, 0.001f);
 		if (m_speed < 0) m_speed = 0;
-		WrapperUI::Text("Particle Number : %d", m_currentParticleNumber);
+		if (m_gpu)
+		{
+			WrapperUI::Text("GPU Particles : %zu max", m_gpu->GetCapacity());
+			WrapperUI::Text("Particle Memory : %.1f KB", m_gpu->GetMemorySize() / 1024.f);
+		}
+		else
+		{
+			WrapperUI::Text("Particle Number : %zu", m_particles.aliveCount);
+			WrapperUI::Text("Particle Memory : %.1f KB", m_particles.GetMemorySize() / 1024.f);
+		}
+		if (Core::ParticleManager* manager = Core::App::Get().particleManager)
+		{
+			WrapperUI::Text("Scene Particles : %zu (%zu culled systems)", manager->GetParticleCount(), manager->GetCulledCount());
+			WrapperUI::Text("Particle Draws : %zu for %zu systems", manager->GetDrawCount(), manager->GetSubmittedCount());
+		}
 		WrapperUI::PopItemWidth();
 	}
 	WrapperUI::End();
@@ -209,6 +208,11 @@ void Component::ParticleSystem::ShowInInspector()
 			Resources::ResourcesManager::Get()->GetOrLoad<Resources::Material>(mat->GetPath());
 			SetMaterial(mat);
 		}
+		WrapperUI::Checkbox("Sort By Depth", &m_sortByDepth);
+		WrapperUI::BeginDisabled(!Render::GPUParticles::IsSupported());
+		if (WrapperUI::Checkbox("Simulate On GPU", &m_simulateOnGPU))
+			SetParticleNumber(m_particleNumber);
+		WrapperUI::EndDisabled();
 	}
 
 	if (WrapperUI::CollapsingHeader("Default", flags))
@@ -221,16 +225,18 @@ void Component::ParticleSystem::ShowInInspector()
 				SetParticleNumber(m_particleNumber);
 			}
 		}
+		int seed = (int)m_seed;
+		if (WrapperUI::DragInt("Seed", &seed, 1.f, 0, INT_MAX))
+			m_seed = (uint32_t)std::max(seed, 0);
 		WrapperUI::DragFloat("Duration", &m_duration);
 		WrapperUI::Checkbox("Loop", &m_loop);
 		m_startDelay.ShowInInspector("Start Delay");
-		if (m_particleLifeTime.ShowInInspector("Life Time"))
-		{
-			InitializeParticles();
-		}
+		m_particleLifeTime.ShowInInspector("Life Time");
 		m_startSpeed.ShowInInspector("Start Speed");
 		m_startSize.ShowInInspector("Start Size");
 		m_gravityModifier.ShowInInspector("Gravity Modifier");
+		WrapperUI::DragInt("Priority", &m_priority);
+		WrapperUI::Checkbox("Pause When Invisible", &m_pauseWhenInvisible);
 	}
 
 	WrapperUI::Checkbox("##Emission", &m_enableEmission);
@@ -238,8 +244,7 @@ void Component::ParticleSystem::ShowInInspector()
 	if (WrapperUI::CollapsingHeader("Emission", flags))
 	{
 		WrapperUI::BeginDisabled(!m_enableEmission);
-		if (m_rateOverTime.ShowInInspector("Rate Over Time"))
-			InitializeParticles();
+		m_rateOverTime.ShowInInspector("Rate Over Time");
 		WrapperUI::EndDisabled();
 	}
 
@@ -271,6 +276,50 @@ void Component::ParticleSystem::ShowInInspector()
 		}
 		WrapperUI::EndDisabled();
 	}
+	WrapperUI::Checkbox("##Collision", &m_enableCollision);
+	WrapperUI::SameLine();
+	if (WrapperUI::CollapsingHeader("Collision", flags))
+	{
+		WrapperUI::BeginDisabled(!m_enableCollision);
+		int mode = (int)m_collision.mode;
+		if (WrapperUI::Combo("Collision Mode", &mode, "Planes\0World"))
+			m_collision.mode = (ParticleCollisionMode)mode;
+		if (m_collision.mode == ParticleCollisionMode::Planes)
+		{
+			for (size_t i = 0; i < m_collision.planes.size(); i++)
+			{
+				ParticleCollisionPlane& plane = m_collision.planes[i];
+				WrapperUI::PushID((int)i);
+				if (WrapperUI::DragFloat3("Normal", &plane.normal.x, 0.01f) && plane.normal.Length() > 0.0001f)
+					plane.normal.Normalize();
+				WrapperUI::DragFloat("Distance", &plane.distance, 0.1f);
+				if (WrapperUI::Button("Remove Plane"))
+					m_collision.planes.erase(m_collision.planes.begin() + i--);
+				WrapperUI::PopID();
+			}
+			if (WrapperUI::Button("Add Plane"))
+				m_collision.planes.push_back(ParticleCollisionPlane());
+		}
+		else
+		{
+			WrapperUI::DragInt("Query Interval", &m_collision.queryInterval, 0.1f, 1, 60);
+		}
+		WrapperUI::DragFloat("Bounce", &m_collision.bounce, 0.01f, 0.f, 1.f);
+		WrapperUI::DragFloat("Dampen", &m_collision.dampen, 0.01f, 0.f, 1.f);
+		WrapperUI::DragFloat("Lifetime Loss", &m_collision.lifetimeLoss, 0.01f, 0.f, 1.f);
+		WrapperUI::Checkbox("Kill On Hit", &m_collision.killOnHit);
+		WrapperUI::DragFloat("Radius Scale", &m_collision.radiusScale, 0.01f, 0.f, 10.f);
+		WrapperUI::Checkbox("Send Events", &m_collision.sendEvents);
+		if (m_collision.sendEvents)
+		{
+			int maxEvents = (int)m_collision.maxEvents;
+			if (WrapperUI::DragInt("Max Events", &maxEvents, 1.f, 0, 4096))
+				m_collision.maxEvents = (size_t)std::max(maxEvents, 0);
+			WrapperUI::Text("Events : %zu", m_collisionEvents.size());
+		}
+		WrapperUI::EndDisabled();
+	}
+
 	WrapperUI::Checkbox("##ColorOverTime", &m_enableColorOverTime);
 	WrapperUI::SameLine();
 	if (WrapperUI::CollapsingHeader("ColorOverTime", flags))
@@ -299,20 +348,34 @@ void Component::ParticleSystem::ReInitialize()
 {
 	if (!m_mesh || !m_buffer)
 		return;
+	// No collision, events or depth sort on the GPU, the CPU simulation stays for them and without compute support
+	const bool onGPU = m_simulateOnGPU && Render::GPUParticles::IsSupported();
+	m_particles.Resize(onGPU ? 0 : m_particleNumber);
+	if (onGPU)
+	{
+		if (!m_gpu)
+			m_gpu = new Render::GPUParticles();
+		const Resources::SubMesh& last = m_mesh->m_subMeshes.back();
+		m_gpu->Initialize(m_particleNumber, last.StartIndex + last.Count);
+	}
+	else if (m_gpu)
+	{
+		delete m_gpu;
+		m_gpu = nullptr;
+	}
 	if (m_buffer2)
 	{
+		m_buffer2->Delete();
 		delete m_buffer2;
 		m_buffer2 = nullptr;
 	}
-	m_datas.resize(m_particles.size());
 
 	m_buffer2 = new WrapperRHI::Buffer();
-	m_buffer2->GenVertexBuffer();
-	m_buffer2->BufferData(m_datas.size() * sizeof(InstanceData), nullptr);
+	m_buffer2->GenStreamBuffer(std::max<size_t>(m_particles.capacity, 1) * sizeof(InstanceData));
 	m_worldPosition = gameObject->transform->GetWorldPosition();
 	m_worldRotation = gameObject->transform->GetWorldRotation();
 
-	InitializeParticles();
+	Restart();
 	m_buffer->Bind();
 	m_buffer->LinkAttribute(8, 4, PR_FLOAT, sizeof(InstanceData), (void*)0);
 	m_buffer->AttribDivisor(8, 1);
@@ -321,12 +384,18 @@ void Component::ParticleSystem::ReInitialize()
 	m_buffer->Unbind();
 }
 
-void Component::ParticleSystem::InitializeParticles()
+void Component::ParticleSystem::Restart()
 {
-	for (auto& particle : m_particles)
-	{
-		particle->Initialize();
-	}
+	m_particles.Clear();
+	m_time = 0.f;
+	m_emissionAccumulator = 0.f;
+	m_spawnFrame = 0;
+	m_simulationFrame = 0;
+	m_currentSeed = m_seed ? m_seed : std::random_device()();
+	m_random = ParticleRandom(m_currentSeed);
+	m_currentStartDelay = m_startDelay.GetRandomValue(m_random);
+	if (m_gpu)
+		m_gpu->Clear();
 }
 
 void Component::ParticleSystem::SetMesh(Resources::Mesh* mesh)
@@ -399,16 +468,25 @@ void Component::ParticleSystem::EditorDraw()
 
 void Component::ParticleSystem::Draw()
 {
-	if (!m_mesh)
+	if (!m_mesh || (m_particles.aliveCount == 0 && !m_gpu))
+		return;
+	Render::Camera* camera = Core::SceneManager::Get()->GetCurrentScene()->currentCamera;
+	if (camera && !IsVisible(camera->frustum))
 		return;
 	if (Core::App::Get().GetGameState() != Core::GameState::Editor || gameObject->IsSelected())
-		m_mesh->RenderInstancing(m_material, m_shader, m_particles.size(), m_buffer);
+	{
+		// Drawn with the systems sharing its mesh and material once the scene is drawn
+		if (Core::App::Get().particleManager)
+			Core::App::Get().particleManager->Submit(this);
+		else
+			m_mesh->RenderInstancing(m_material, m_shader, m_particles.aliveCount, m_buffer);
+	}
 }
 
 void Component::ParticleSystem::DrawPicking(int ID)
 {
 	if (m_mesh && gameObject->IsSelected())
-		m_mesh->RenderInstancingPicking(m_pickingShader, m_particles.size(), ID);
+		m_mesh->RenderInstancingPicking(m_pickingShader, m_particles.aliveCount, ID);
 #ifndef PANDOR_GAME
 	if (m_icon)
 		m_icon->DrawPicking(m_worldPosition, ID);
@@ -429,9 +507,9 @@ void Component::ParticleSystem::Update()
 			ReInitialize();
 		}
 	}
-	m_currentParticleNumber = 0;
 	m_worldPosition = gameObject->transform->GetWorldPosition();
 	m_worldRotation = gameObject->transform->GetWorldRotation();
+	UpdateBounds();
 	if (m_material && m_material->GetShader() && m_material->GetShader()->GetFrag() && m_shader && m_shader->GetFrag() != m_material->GetShader()->GetFrag()
 		|| m_material && m_material->GetShader() && m_material->GetShader()->GetFrag() && !m_shader)
 	{
@@ -446,50 +524,22 @@ void Component::ParticleSystem::Update()
 	if (!m_buffer2)
 		return;
 	if (m_play && (Core::App::Get().GetGameState() != Core::GameState::Editor || gameObject->IsSelected()) || Core::App::Get().GetGameState() == Core::GameState::Play) {
-		for (int i = 0; i < m_particles.size(); i++)
-		{
-			if (m_particles[i]->m_alive)
-				m_currentParticleNumber++;
-			m_particles[i]->Update(m_time - m_lastUpdateTime);
-			m_datas[i] = m_particles[i]->GetDatas();
-		}
-		if (m_enableEmission && m_currentParticleNumber < m_rateOverTime.Value.Min || m_currentParticleNumber < 0)
-		{
-			m_shouldRestart = true;
-		}
-		else if (m_shouldRestart)
-			m_shouldRestart = false;
-		m_lastUpdateTime = m_time;
-		if (m_particles.size() > 0) {
-			m_buffer2->BindVertexBuffer();
-			std::vector<float> datas = convertToFloatPointer(m_datas);
-			m_buffer2->BufferSubData(0, m_datas.size() * sizeof(InstanceData), &datas[0]);
-		}
-		m_time += WrapperUI::GetDeltaTime() * m_speed;
+		// Simulated with the other systems once the scene is updated
+		m_pendingDeltaTime = WrapperUI::GetDeltaTime() * m_speed;
+		m_collisionEvents.clear();
+		Core::App::Get().particleManager->Register(this);
 	}
 }
 
 void Component::ParticleSystem::ResetParticles()
 {
-	for (auto& particle : m_particles)
-	{
-		particle->Reset();
-	}
+	m_particles.Clear();
 }
 
 void Component::ParticleSystem::SetParticleNumber(size_t pn)
 {
 	m_particleNumber = pn;
-	for (auto& p : m_particles)
-	{
-		delete p;
-		p = nullptr;
-	}
-	m_particles.clear();
-	for (int i = 0; i < m_particleNumber; i++)
-	{
-		m_particles.push_back(new Particle(this, i));
-	}
+	m_particles.Resize(m_simulateOnGPU && Render::GPUParticles::IsSupported() ? 0 : m_particleNumber);
 	ReInitialize();
 }
 
@@ -524,6 +574,18 @@ std::ostream& Component::ParticleSystem::operator<<(std::ostream& os)
 	os << m_scale << '\n';
 	os << m_enableColorOverTime << '\n';
 	os << m_colorOverTime;
+	os << "seed " << m_seed << '\n';
+	os << "priority " << m_priority << '\n';
+	os << "pauseWhenInvisible " << m_pauseWhenInvisible << '\n';
+	os << "sortByDepth " << m_sortByDepth << '\n';
+	os << "simulateOnGPU " << m_simulateOnGPU << '\n';
+	os << "collision " << m_enableCollision << ' ' << (int)m_collision.mode << ' ' << m_collision.bounce << ' ' << m_collision.dampen << ' '
+		<< m_collision.lifetimeLoss << ' ' << m_collision.killOnHit << ' ' << m_collision.radiusScale << ' ' << m_collision.queryInterval << ' '
+		<< m_collision.sendEvents << ' ' << m_collision.maxEvents << '\n';
+	os << "collisionPlanes " << m_collision.planes.size();
+	for (const ParticleCollisionPlane& plane : m_collision.planes)
+		os << ' ' << plane.normal.x << ' ' << plane.normal.y << ' ' << plane.normal.z << ' ' << plane.distance;
+	os << '\n';
 	return os;
 }
 
@@ -580,105 +642,611 @@ void Component::ParticleSystem::ReadComponent(std::fstream& sceneFile)
 
 	m_colorOverTime.ReadValue(sceneFile);
 
-	while (getline(sceneFile, line) && line != "end") {}
+	while (getline(sceneFile, line) && line != "end")
+	{
+		std::istringstream stream(line);
+		std::string keyword;
+		stream >> keyword;
+		if (keyword == "seed")
+			stream >> m_seed;
+		else if (keyword == "priority")
+			stream >> m_priority;
+		else if (keyword == "pauseWhenInvisible")
+			stream >> m_pauseWhenInvisible;
+		else if (keyword == "sortByDepth")
+			stream >> m_sortByDepth;
+		else if (keyword == "simulateOnGPU")
+			stream >> m_simulateOnGPU;
+		else if (keyword == "collision")
+		{
+			int mode = 0;
+			stream >> m_enableCollision >> mode >> m_collision.bounce >> m_collision.dampen >> m_collision.lifetimeLoss >> m_collision.killOnHit
+				>> m_collision.radiusScale >> m_collision.queryInterval >> m_collision.sendEvents >> m_collision.maxEvents;
+			m_collision.mode = (ParticleCollisionMode)mode;
+		}
+		else if (keyword == "collisionPlanes")
+		{
+			size_t count = 0;
+			stream >> count;
+			m_collision.planes.resize(count);
+			for (ParticleCollisionPlane& plane : m_collision.planes)
+				stream >> plane.normal.x >> plane.normal.y >> plane.normal.z >> plane.distance;
+		}
+	}
+}
+
+#pragma region Simulation
+
+std::array<std::vector<float>*, Component::ParticleBuffer::StreamCount> Component::ParticleBuffer::GetStreams()
+{
+	return { &positionX, &positionY, &positionZ, &velocityX, &velocityY, &velocityZ, &age, &lifetime, &size, &gravity,
+		&colorR, &colorG, &colorB, &colorA, &planeNormalX, &planeNormalY, &planeNormalZ, &planeDistance };
 }
 
-#pragma region Particle
+void Component::ParticleBuffer::Resize(size_t count)
+{
+	capacity = count;
+	aliveCount = std::min(aliveCount, count);
+	size_t padded = (count + 3) & ~size_t(3);
+	for (std::vector<float>* stream : GetStreams())
+		stream->resize(padded, 0.f);
+	planeCollider.resize(padded, nullptr);
+}
 
-Component::Particle::Particle(class ParticleSystem* ps, int index)
+void Component::ParticleBuffer::Kill(size_t index)
 {
-	m_particleSystem = ps;
-	m_index = index;
+	size_t last = --aliveCount;
+	if (index == last)
+		return;
+	for (std::vector<float>* stream : GetStreams())
+		(*stream)[index] = (*stream)[last];
+	planeCollider[index] = planeCollider[last];
 }
 
-Component::InstanceData Component::Particle::GetDatas()
+size_t Component::ParticleBuffer::GetMemorySize() const
 {
-	InstanceData data;
-	data.xyzs = { m_particleSystem->m_worldPosition + m_position,  m_alive ? m_size : 0 };
-	data.color = m_particleSystem->m_enableColorOverTime ? m_color : Vector4{1, 1, 1, 1};
-	return data;
+	return positionX.capacity() * (StreamCount * sizeof(float) + sizeof(Collider*));
 }
 
-void Component::Particle::Initialize()
+// 4 particles per iteration, the arrays are padded so the last group can go past the alive ones
+// Exact for a constant gravity, a long step catching up an invisible system lands where the small ones would
+static void IntegrateParticles(Component::ParticleBuffer& p, size_t begin, size_t end, float deltaTime)
 {
-	m_startTime = m_index * (1 / m_particleSystem->m_rateOverTime.GetRandomValue(m_seed)) + m_particleSystem->m_startDelay.GetRandomValue(m_seed);
-	SetParameters();
+	const __m128 dt = _mm_set1_ps(deltaTime);
+	const __m128 gravityStep = _mm_set1_ps(s_Gravity * deltaTime);
+	const __m128 gravityDrop = _mm_set1_ps(0.5f * s_Gravity * deltaTime * deltaTime);
+	for (size_t i = begin; i < end; i += 4)
+	{
+		__m128 vx = _mm_loadu_ps(&p.velocityX[i]);
+		__m128 vy = _mm_loadu_ps(&p.velocityY[i]);
+		__m128 vz = _mm_loadu_ps(&p.velocityZ[i]);
+		__m128 gravity = _mm_loadu_ps(&p.gravity[i]);
+		__m128 dy = _mm_add_ps(_mm_mul_ps(vy, dt), _mm_mul_ps(gravity, gravityDrop));
+		_mm_storeu_ps(&p.velocityY[i], _mm_add_ps(vy, _mm_mul_ps(gravity, gravityStep)));
+
+		_mm_storeu_ps(&p.positionX[i], _mm_add_ps(_mm_loadu_ps(&p.positionX[i]), _mm_mul_ps(vx, dt)));
+		_mm_storeu_ps(&p.positionY[i], _mm_add_ps(_mm_loadu_ps(&p.positionY[i]), dy));
+		_mm_storeu_ps(&p.positionZ[i], _mm_add_ps(_mm_loadu_ps(&p.positionZ[i]), _mm_mul_ps(vz, dt)));
+		_mm_storeu_ps(&p.age[i], _mm_add_ps(_mm_loadu_ps(&p.age[i]), dt));
+	}
 }
 
-void Component::Particle::Update(float elapsedTime)
+static void ColorOverLife(Component::ParticleBuffer& p, size_t begin, size_t end, const Vector4& from, const Vector4& to)
 {
-	m_lifeTime += elapsedTime;
-	m_lifeTime = std::fmaxf(0.f, m_lifeTime);
-	if (m_lifeTime > m_randomLifetime)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 minLifetime = _mm_set1_ps(0.0001f);
+	const __m128 fromR = _mm_set1_ps(from.x), deltaR = _mm_set1_ps(to.x - from.x);
+	const __m128 fromG = _mm_set1_ps(from.y), deltaG = _mm_set1_ps(to.y - from.y);
+	const __m128 fromB = _mm_set1_ps(from.z), deltaB = _mm_set1_ps(to.z - from.z);
+	const __m128 fromA = _mm_set1_ps(from.w), deltaA = _mm_set1_ps(to.w - from.w);
+	for (size_t i = begin; i < end; i += 4)
 	{
-		Reset();
+		__m128 t = _mm_div_ps(_mm_loadu_ps(&p.age[i]), _mm_max_ps(_mm_loadu_ps(&p.lifetime[i]), minLifetime));
+		t = _mm_min_ps(_mm_max_ps(t, zero), one);
+		_mm_storeu_ps(&p.colorR[i], _mm_add_ps(fromR, _mm_mul_ps(deltaR, t)));
+		_mm_storeu_ps(&p.colorG[i], _mm_add_ps(fromG, _mm_mul_ps(deltaG, t)));
+		_mm_storeu_ps(&p.colorB[i], _mm_add_ps(fromB, _mm_mul_ps(deltaB, t)));
+		_mm_storeu_ps(&p.colorA[i], _mm_add_ps(fromA, _mm_mul_ps(deltaA, t)));
 	}
-	else if (m_lifeTime >= m_startTime)
+}
+
+// From the end, so the particle moved in place of a dead one was already tested
+static void KillParticles(Component::ParticleBuffer& p)
+{
+	for (size_t group = (p.aliveCount + 3) & ~size_t(3); group > 0; group -= 4)
 	{
-		float time = m_lifeTime - m_startTime;
-		m_position = m_offset + m_particleSystem->m_worldRotation * (m_direction * m_randomSpeed) * time
-			+ Vector3::Up() * -9.81f * m_randomGravityModifier * 0.5f * time * time;
-		if (m_particleSystem->m_enableColorOverTime)
+		size_t first = group - 4;
+		if (!_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(&p.age[first]), _mm_loadu_ps(&p.lifetime[first]))))
+			continue;
+		for (size_t i = std::min(group, p.aliveCount); i-- > first;)
+			if (p.age[i] >= p.lifetime[i])
+				p.Kill(i);
+	}
+}
+
+// Structure of arrays to the interleaved InstanceData, transposed 4 particles at once
+// The bounds grow by the size of each particle, "out" can be null to only get them
+static void WriteInstances(const Component::ParticleBuffer& p, size_t begin, size_t end, float* out, __m128& boundsMin, __m128& boundsMax)
+{
+	for (size_t i = begin; i < end; i += 4)
+	{
+		__m128 xyzs[4] = { _mm_loadu_ps(&p.positionX[i]), _mm_loadu_ps(&p.positionY[i]), _mm_loadu_ps(&p.positionZ[i]), _mm_loadu_ps(&p.size[i]) };
+		__m128 colors[4] = { _mm_loadu_ps(&p.colorR[i]), _mm_loadu_ps(&p.colorG[i]), _mm_loadu_ps(&p.colorB[i]), _mm_loadu_ps(&p.colorA[i]) };
+		_MM_TRANSPOSE4_PS(xyzs[0], xyzs[1], xyzs[2], xyzs[3]);
+		_MM_TRANSPOSE4_PS(colors[0], colors[1], colors[2], colors[3]);
+
+		size_t count = std::min<size_t>(4, end - i);
+		for (size_t k = 0; k < count; k++)
+		{
+			__m128 size = _mm_shuffle_ps(xyzs[k], xyzs[k], _MM_SHUFFLE(3, 3, 3, 3));
+			boundsMin = _mm_min_ps(boundsMin, _mm_sub_ps(xyzs[k], size));
+			boundsMax = _mm_max_ps(boundsMax, _mm_add_ps(xyzs[k], size));
+		}
+		if (!out)
+			continue;
+
+		float* instance = out + i * s_InstanceFloats;
+		for (size_t k = 0; k < count; k++)
 		{
-			float t = Arithmetics::Normalize(m_lifeTime, m_startTime, m_randomLifetime);
-			m_color = m_particleSystem->m_colorOverTime.Value.Min.Lerp(m_particleSystem->m_colorOverTime.Value.Max, t);
+			_mm_storeu_ps(instance + k * s_InstanceFloats, xyzs[k]);
+			_mm_storeu_ps(instance + k * s_InstanceFloats + 4, colors[k]);
 		}
-		m_alive = true;
 	}
-	else
+}
+
+// Lanes of the 4 particles at "i" inside their plane and moving toward it, the planes can differ per lane
+// A null normal never hits, the velocity along it is 0
+static int DetectHits(const Component::ParticleBuffer& p, size_t i, __m128 nx, __m128 ny, __m128 nz, __m128 d, __m128 radiusScale)
+{
+	__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(&p.positionX[i])), _mm_mul_ps(ny, _mm_loadu_ps(&p.positionY[i]))), _mm_mul_ps(nz, _mm_loadu_ps(&p.positionZ[i])));
+	distance = _mm_sub_ps(_mm_sub_ps(distance, d), _mm_mul_ps(_mm_loadu_ps(&p.size[i]), radiusScale));
+	__m128 speed = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, _mm_loadu_ps(&p.velocityX[i])), _mm_mul_ps(ny, _mm_loadu_ps(&p.velocityY[i]))), _mm_mul_ps(nz, _mm_loadu_ps(&p.velocityZ[i])));
+	const __m128 zero = _mm_setzero_ps();
+	return _mm_movemask_ps(_mm_and_ps(_mm_cmplt_ps(distance, zero), _mm_cmplt_ps(speed, zero)));
+}
+
+// Same as WriteInstances, in the order of "indices"
+static void WriteSortedInstances(const Component::ParticleBuffer& p, const uint32_t* indices, size_t begin, size_t end, float* out, __m128& boundsMin, __m128& boundsMax)
+{
+	for (size_t i = begin; i < end; i++)
 	{
-		m_alive = false;
+		const uint32_t j = indices[i];
+		__m128 xyzs = _mm_setr_ps(p.positionX[j], p.positionY[j], p.positionZ[j], p.size[j]);
+		__m128 size = _mm_set1_ps(p.size[j]);
+		boundsMin = _mm_min_ps(boundsMin, _mm_sub_ps(xyzs, size));
+		boundsMax = _mm_max_ps(boundsMax, _mm_add_ps(xyzs, size));
+		if (!out)
+			continue;
+		_mm_storeu_ps(out + i * s_InstanceFloats, xyzs);
+		_mm_storeu_ps(out + i * s_InstanceFloats + 4, _mm_setr_ps(p.colorR[j], p.colorG[j], p.colorB[j], p.colorA[j]));
 	}
-	Vector3 position = m_particleSystem->m_worldPosition + m_position;
 }
 
-void Component::Particle::Reset()
+// Least significant digit first, 8 bits per pass, the values follow their key
+static void RadixSort(std::vector<uint32_t>& keys, std::vector<uint32_t>& values, std::vector<uint32_t>& keysScratch, std::vector<uint32_t>& valuesScratch)
 {
-	if (m_particleSystem->m_loop && m_particleSystem->m_shouldRestart)
+	const size_t count = keys.size();
+	keysScratch.resize(count);
+	valuesScratch.resize(count);
+	for (uint32_t shift = 0; shift < 32; shift += 8)
 	{
-		m_lifeTime = 0;
-		m_position = 0;
-		Initialize();
+		size_t offsets[256] = {};
+		for (size_t i = 0; i < count; i++)
+			offsets[(keys[i] >> shift) & 0xFF]++;
+		// Every key has the same digit, nothing moves
+		if (offsets[(keys[0] >> shift) & 0xFF] == count)
+			continue;
+
+		size_t total = 0;
+		for (size_t& offset : offsets)
+		{
+			size_t digitCount = offset;
+			offset = total;
+			total += digitCount;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			size_t destination = offsets[(keys[i] >> shift) & 0xFF]++;
+			keysScratch[destination] = keys[i];
+			valuesScratch[destination] = values[i];
+		}
+		keys.swap(keysScratch);
+		values.swap(valuesScratch);
 	}
-	m_alive = false;
 }
 
-void Component::Particle::SetParameters()
+void Component::ParticleSystem::SpawnParticle(size_t index, ParticleRandom& random)
 {
-	m_seed = std::mt19937(std::random_device()());
-	m_randomLifetime = m_startTime + m_particleSystem->m_particleLifeTime.GetRandomValue(m_seed);
-	m_randomSpeed = m_particleSystem->m_startSpeed.GetRandomValue(m_seed);
-	m_randomGravityModifier = m_particleSystem->m_gravityModifier.GetRandomValue(m_seed);
-	m_size = m_particleSystem->m_startSize.GetRandomValue(m_seed);
-	if (m_particleSystem->m_enableShape) {
-		switch (m_particleSystem->m_shape)
+	Vector3 offset;
+	Vector3 direction = Vector3::Forward();
+	if (m_enableShape)
+	{
+		switch (m_shape)
 		{
 		case ParticleShape::Sphere:
 		{
-			m_offset = Utils::RandomPointInSphere(m_particleSystem->m_radius.GetRandomValue(m_seed));
-			m_direction = m_offset.GetNormalized();
+			float theta = 2.f * PI * random.Float();
+			float cosPhi = 2.f * random.Float() - 1.f;
+			float sinPhi = std::sqrt(1.f - cosPhi * cosPhi);
+			direction = Vector3(sinPhi * std::cos(theta), sinPhi * std::sin(theta), cosPhi);
+			offset = direction * m_radius.GetRandomValue(random) * std::cbrt(random.Float());
 			break;
 		}
 		case ParticleShape::Cone:
 		{
-			m_offset = Utils::RandomPointOnCircle(m_particleSystem->m_radius.GetRandomValue(m_seed), m_particleSystem->m_worldRotation * Vector3::Right());
-			m_direction = Utils::RandomDirectionCone(Vector3::Forward(), m_particleSystem->m_radius.GetRandomValue(m_seed), m_particleSystem->m_angle.GetRandomValue(m_seed));
+			float theta = 2.f * PI * random.Float();
+			float radius = m_radius.GetRandomValue(random) * std::sqrt(random.Float());
+			offset = Vector3(std::cos(theta) * radius, std::sin(theta) * radius, 0.f);
+			// Spread around the forward axis, up to the cone angle
+			float angle = m_angle.GetRandomValue(random) * DEG2RAD * std::sqrt(random.Float());
+			direction = Vector3(std::cos(theta) * std::sin(angle), std::sin(theta) * std::sin(angle), std::cos(angle));
 			break;
 		}
 		case ParticleShape::Rectangle:
 		{
-			m_offset = m_particleSystem->m_worldRotation * Utils::RandomPointOnRectangle(m_particleSystem->m_scale);
-			m_direction = Vector3::Forward();
+			offset = Vector3(random.Range(-m_scale.x / 2.f, m_scale.x / 2.f), random.Range(-m_scale.y / 2.f, m_scale.y / 2.f), 0.f);
 			break;
 		}
 		default:
 			break;
 		}
 	}
-	else {
-		m_offset = 0;
-		m_direction = Vector3::Forward();
+
+	Vector3 position = m_worldPosition + m_worldRotation * offset;
+	Vector3 velocity = m_worldRotation * direction * m_startSpeed.GetRandomValue(random);
+	const float gravityModifier = m_gravityModifier.GetRandomValue(random);
+	const float gravity = gravityModifier * s_Gravity;
+	// Emitted at any time of the step, not in bursts on each frame, it matters for the long catch up steps
+	const float age = random.Float() * m_pendingDeltaTime;
+	position += velocity * age;
+	position.y += 0.5f * gravity * age * age;
+	velocity.y += gravity * age;
+	const Vector4 color = m_enableColorOverTime ? m_colorOverTime.Value.Min : Vector4(1.f);
+
+	ParticleBuffer& p = m_particles;
+	p.positionX[index] = position.x;
+	p.positionY[index] = position.y;
+	p.positionZ[index] = position.z;
+	p.velocityX[index] = velocity.x;
+	p.velocityY[index] = velocity.y;
+	p.velocityZ[index] = velocity.z;
+	p.age[index] = age;
+	p.lifetime[index] = m_particleLifeTime.GetRandomValue(random);
+	p.size[index] = m_startSize.GetRandomValue(random);
+	p.gravity[index] = gravityModifier;
+	p.colorR[index] = color.x;
+	p.colorG[index] = color.y;
+	p.colorB[index] = color.z;
+	p.colorA[index] = color.w;
+	p.planeNormalX[index] = 0.f;
+	p.planeNormalY[index] = 0.f;
+	p.planeNormalZ[index] = 0.f;
+	p.planeDistance[index] = 0.f;
+	p.planeCollider[index] = nullptr;
+}
+
+void Component::ParticleSystem::BeginSimulation()
+{
+	m_simulationFrame++;
+	size_t chunkCount = m_enableCollision && m_collision.sendEvents ? (m_particles.capacity + Core::ParticleManager::ChunkSize - 1) / Core::ParticleManager::ChunkSize : 0;
+	m_chunkEvents.resize(chunkCount);
+	// The chunks past the alive particles are not simulated, their events of a previous frame must not be merged
+	for (std::vector<ParticleCollisionEvent>& events : m_chunkEvents)
+		events.clear();
+	m_mappedInstances = m_particles.capacity > 0 ? (float*)m_buffer2->NextStreamRegion() : nullptr;
+}
+
+void Component::ParticleSystem::SimulateRange(size_t begin, size_t end)
+{
+	IntegrateParticles(m_particles, begin, end, m_pendingDeltaTime);
+	if (m_enableCollision)
+	{
+		if (m_collision.mode == ParticleCollisionMode::World)
+			QueryWorldRange(begin, end);
+		CollideRange(begin, end);
+	}
+	if (m_enableColorOverTime)
+		ColorOverLife(m_particles, begin, end, m_colorOverTime.Value.Min, m_colorOverTime.Value.Max);
+}
+
+void Component::ParticleSystem::QueryWorldRange(size_t begin, size_t end)
+{
+	auto physic = Core::App::Get().physic;
+	if (!physic)
+		return;
+
+	thread_local std::vector<WrapperPhysic::RayQuery> rays;
+	thread_local std::vector<WrapperPhysic::RayQueryHit> hits;
+	thread_local std::vector<uint32_t> indices;
+	rays.clear();
+	indices.clear();
+
+	ParticleBuffer& p = m_particles;
+	const uint32_t interval = (uint32_t)std::max(m_collision.queryInterval, 1);
+	for (size_t i = begin; i < end; i++)
+	{
+		if ((i + m_simulationFrame) % interval != 0)
+			continue;
+		const Vector3 velocity(p.velocityX[i], p.velocityY[i], p.velocityZ[i]);
+		const float speed = velocity.Length();
+		if (speed < 0.0001f)
+			continue;
+		// Far enough to find the surface reached before the next query
+		rays.push_back({ Vector3(p.positionX[i], p.positionY[i], p.positionZ[i]), velocity / speed,
+			speed * m_pendingDeltaTime * interval + p.size[i] * m_collision.radiusScale });
+		indices.push_back((uint32_t)i);
+	}
+	if (rays.empty())
+		return;
+
+	hits.resize(rays.size());
+	physic->RayCastBatch(rays.data(), rays.size(), hits.data());
+	for (size_t q = 0; q < hits.size(); q++)
+	{
+		const uint32_t i = indices[q];
+		const WrapperPhysic::RayQueryHit& hit = hits[q];
+		p.planeNormalX[i] = hit.hit ? hit.normal.x : 0.f;
+		p.planeNormalY[i] = hit.hit ? hit.normal.y : 0.f;
+		p.planeNormalZ[i] = hit.hit ? hit.normal.z : 0.f;
+		p.planeDistance[i] = hit.hit ? hit.normal.Dot(hit.position) : 0.f;
+		p.planeCollider[i] = hit.hit && m_collision.sendEvents ? physic->GetColliderWithShape(hit.shape) : nullptr;
 	}
 }
 
+void Component::ParticleSystem::CollideRange(size_t begin, size_t end)
+{
+	ParticleBuffer& p = m_particles;
+	const ParticleCollisionSettings& settings = m_collision;
+	std::vector<ParticleCollisionEvent>* events = nullptr;
+	if (settings.sendEvents)
+		events = &m_chunkEvents[begin / Core::ParticleManager::ChunkSize];
+
+	// Rare, the response is done one particle at a time
+	auto respond = [&](size_t i, const Vector3& normal, float distance, Collider* collider)
+	{
+		Vector3 position(p.positionX[i], p.positionY[i], p.positionZ[i]);
+		Vector3 velocity(p.velocityX[i], p.velocityY[i], p.velocityZ[i]);
+		if (events && events->size() < settings.maxEvents)
+			events->push_back({ position, normal, velocity, collider });
+
+		// Pushed back on the surface, then reflected
+		position += normal * (distance - normal.Dot(position) + p.size[i] * settings.radiusScale);
+		const Vector3 normalVelocity = normal * normal.Dot(velocity);
+		velocity = (velocity - normalVelocity) * (1.f - settings.dampen) - normalVelocity * settings.bounce;
+
+		p.positionX[i] = position.x;
+		p.positionY[i] = position.y;
+		p.positionZ[i] = position.z;
+		p.velocityX[i] = velocity.x;
+		p.velocityY[i] = velocity.y;
+		p.velocityZ[i] = velocity.z;
+		p.lifetime[i] -= p.lifetime[i] * settings.lifetimeLoss;
+		if (settings.killOnHit)
+			p.age[i] = p.lifetime[i];
+	};
+
+	const __m128 radiusScale = _mm_set1_ps(settings.radiusScale);
+	for (size_t i = begin; i < end; i += 4)
+	{
+		const int lanes = end - i < 4 ? (1 << (end - i)) - 1 : 0xF;
+		if (settings.mode == ParticleCollisionMode::Planes)
+		{
+			for (const ParticleCollisionPlane& plane : settings.planes)
+			{
+				int mask = DetectHits(p, i, _mm_set1_ps(plane.normal.x), _mm_set1_ps(plane.normal.y), _mm_set1_ps(plane.normal.z), _mm_set1_ps(plane.distance), radiusScale) & lanes;
+				for (int lane = 0; mask; lane++, mask >>= 1)
+				{
+					if (mask & 1)
+						respond(i + lane, plane.normal, plane.distance, nullptr);
+				}
+			}
+		}
+		else
+		{
+			int mask = DetectHits(p, i, _mm_loadu_ps(&p.planeNormalX[i]), _mm_loadu_ps(&p.planeNormalY[i]), _mm_loadu_ps(&p.planeNormalZ[i]), _mm_loadu_ps(&p.planeDistance[i]), radiusScale) & lanes;
+			for (int lane = 0; mask; lane++, mask >>= 1)
+			{
+				if (!(mask & 1))
+					continue;
+				const size_t index = i + lane;
+				respond(index, Vector3(p.planeNormalX[index], p.planeNormalY[index], p.planeNormalZ[index]), p.planeDistance[index], p.planeCollider[index]);
+			}
+		}
+	}
+}
+
+void Component::ParticleSystem::EndSimulation()
+{
+	KillParticles(m_particles);
+	for (const std::vector<ParticleCollisionEvent>& events : m_chunkEvents)
+	{
+		for (size_t i = 0; i < events.size() && m_collisionEvents.size() < m_collision.maxEvents; i++)
+			m_collisionEvents.push_back(events[i]);
+	}
+	m_sorted = false;
+
+	m_spawnBegin = m_particles.aliveCount;
+	m_spawnCount = std::min(UpdateEmission(), m_particles.capacity - m_particles.aliveCount);
+}
+
+size_t Component::ParticleSystem::UpdateEmission()
+{
+	const float deltaTime = m_pendingDeltaTime;
+	const float emissionTime = m_time - m_currentStartDelay;
+	m_time += deltaTime;
+	if (!m_enableEmission || emissionTime + deltaTime < 0.f || (!m_loop && emissionTime >= m_duration))
+		return 0;
+
+	m_emissionAccumulator += std::max(m_rateOverTime.GetRandomValue(m_random), 0.f) * m_emissionScale * deltaTime;
+	size_t count = (size_t)m_emissionAccumulator;
+	m_emissionAccumulator -= (float)count;
+	return count;
+}
+
+void Component::ParticleSystem::SimulateOnGPU()
+{
+	const size_t count = UpdateEmission();
+
+	Render::GPUParticleEmitter emitter;
+	emitter.position = m_worldPosition;
+	emitter.rotation = m_worldRotation;
+	emitter.shape = m_enableShape ? (int)m_shape : -1;
+	// The constant values use their min on the CPU
+	auto range = [](const MinMaxValue<float>& value)
+	{
+		return Vector2(value.Value.Min, value.Mode == ValueMode::Random ? value.Value.Max : value.Value.Min);
+	};
+	emitter.radius = range(m_radius);
+	emitter.angle = range(m_angle);
+	emitter.scale = Vector2(m_scale.x, m_scale.y);
+	emitter.speed = range(m_startSpeed);
+	emitter.lifetime = range(m_particleLifeTime);
+	emitter.size = range(m_startSize);
+	emitter.gravity = range(m_gravityModifier) * s_Gravity;
+	emitter.colorOverLife = m_enableColorOverTime;
+	if (m_enableColorOverTime)
+	{
+		emitter.colorStart = m_colorOverTime.Value.Min;
+		emitter.colorEnd = m_colorOverTime.Value.Max;
+	}
+
+	m_gpu->Simulate(m_pendingDeltaTime, count, GetSpawnSeed(0), emitter);
+	if (count > 0)
+		m_spawnFrame++;
+}
+
+void Component::ParticleSystem::CommitSpawn(size_t count)
+{
+	m_spawnCount = std::min(count, m_spawnCount);
+	m_particles.aliveCount += m_spawnCount;
+	if (m_spawnCount > 0)
+		m_spawnFrame++;
+}
+
+uint32_t Component::ParticleSystem::GetSpawnSeed(size_t chunk) const
+{
+	// Murmur3 finalizer of the system seed, the frame and the chunk
+	uint32_t hash = m_currentSeed ^ (m_spawnFrame * 0x9E3779B9u) ^ ((uint32_t)chunk * 0x85EBCA6Bu);
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6Bu;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35u;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+void Component::ParticleSystem::SpawnRange(size_t begin, size_t end, ParticleRandom& random)
+{
+	for (size_t i = begin; i < end; i++)
+		SpawnParticle(m_spawnBegin + i, random);
+}
+
+void Component::ParticleSystem::SortParticles(const Vector3& viewPosition, const Vector3& viewForward)
+{
+	const size_t count = m_particles.aliveCount;
+	if (count == 0)
+		return;
+	m_sortKeys.resize(count);
+	m_sortIndices.resize(count);
+	const ParticleBuffer& p = m_particles;
+	for (size_t i = 0; i < count; i++)
+	{
+		float depth = (p.positionX[i] - viewPosition.x) * viewForward.x + (p.positionY[i] - viewPosition.y) * viewForward.y + (p.positionZ[i] - viewPosition.z) * viewForward.z;
+		uint32_t bits;
+		std::memcpy(&bits, &depth, sizeof(bits));
+		// Unsigned order of the floats, inverted so the farthest particle comes first
+		bits ^= (bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u;
+		m_sortKeys[i] = ~bits;
+		m_sortIndices[i] = (uint32_t)i;
+	}
+	RadixSort(m_sortKeys, m_sortIndices, m_sortKeysScratch, m_sortIndicesScratch);
+	m_sorted = true;
+}
+
+void Component::ParticleSystem::WriteRange(size_t begin, size_t end, Vector3& min, Vector3& max)
+{
+	__m128 boundsMin = _mm_set1_ps(FLT_MAX);
+	__m128 boundsMax = _mm_set1_ps(-FLT_MAX);
+	if (m_sorted)
+		WriteSortedInstances(m_particles, m_sortIndices.data(), begin, end, m_mappedInstances, boundsMin, boundsMax);
+	else
+		WriteInstances(m_particles, begin, end, m_mappedInstances, boundsMin, boundsMax);
+	float values[4];
+	_mm_storeu_ps(values, boundsMin);
+	min = Vector3(values[0], values[1], values[2]);
+	_mm_storeu_ps(values, boundsMax);
+	max = Vector3(values[0], values[1], values[2]);
+}
+
+float Component::ParticleSystem::GetEmitterExtent() const
+{
+	float extent = std::max(m_startSize.Value.Min, m_startSize.Mode == ValueMode::Random ? m_startSize.Value.Max : 0.f);
+	if (!m_enableShape)
+		return extent;
+	switch (m_shape)
+	{
+	case ParticleShape::Sphere:
+	case ParticleShape::Cone:
+		return extent + std::max(m_radius.Value.Min, m_radius.Mode == ValueMode::Random ? m_radius.Value.Max : 0.f);
+	case ParticleShape::Rectangle:
+		return extent + Vector2(m_scale.x, m_scale.y).Length() * 0.5f;
+	default:
+		return extent;
+	}
+}
+
+void Component::ParticleSystem::UpdateBounds()
+{
+	const float extent = GetEmitterExtent();
+	m_boundsMin = m_worldPosition - Vector3(extent, extent, extent);
+	m_boundsMax = m_worldPosition + Vector3(extent, extent, extent);
+	if (m_gpu)
+	{
+		// Never read back, the farthest any particle can travel
+		auto max = [](const MinMaxValue<float>& value) { return std::max(std::abs(value.Value.Min), value.Mode == ValueMode::Random ? std::abs(value.Value.Max) : 0.f); };
+		const float lifetime = max(m_particleLifeTime);
+		const float travel = max(m_startSpeed) * lifetime + 0.5f * max(m_gravityModifier) * std::abs(s_Gravity) * lifetime * lifetime;
+		m_boundsMin -= Vector3(travel, travel, travel);
+		m_boundsMax += Vector3(travel, travel, travel);
+		return;
+	}
+	if (m_particles.aliveCount == 0)
+		return;
+	for (size_t axis = 0; axis < 3; axis++)
+	{
+		m_boundsMin[axis] = std::min(m_boundsMin[axis], m_particlesMin[axis]);
+		m_boundsMax[axis] = std::max(m_boundsMax[axis], m_particlesMax[axis]);
+	}
+}
+
+bool Component::ParticleSystem::IsVisible(const Render::Frustum& frustum) const
+{
+	const Utils::AABB bounds(m_boundsMin, m_boundsMax);
+	for (const auto& plane : frustum.planes)
+	{
+		if (!bounds.isOnOrForwardPlane(plane))
+			return false;
+	}
+	return true;
+}
+
+void Component::ParticleSystem::EndUpload(const Vector3& min, const Vector3& max)
+{
+	m_particlesMin = min;
+	m_particlesMax = max;
+	UpdateBounds();
+	if (!m_mappedInstances)
+		return;
+	m_mappedInstances = nullptr;
+
+	// The instance attributes read the region written this frame
+	size_t offset = m_buffer2->StreamOffset();
+	m_buffer->Bind();
+	m_buffer2->BindVertexBuffer();
+	m_buffer->LinkAttribute(8, 4, PR_FLOAT, sizeof(InstanceData), (void*)offset);
+	m_buffer->LinkAttribute(9, 4, PR_FLOAT, sizeof(InstanceData), (void*)(offset + sizeof(float[4])));
+	m_buffer->Unbind();
+}
+
 #pragma endregion
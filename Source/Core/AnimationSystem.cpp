@@ -0,0 +1,145 @@
+#include "pch.h"
+#include <Core/AnimationSystem.h>
+#include <Core/App.h>
+#include <Core/GameObject.h>
+#include <Core/ThreadManager.h>
+
+#include <Components/Animator.h>
+#include <Components/SkeletalMeshComponent.h>
+#include <Components/Transform.h>
+#include <Resources/SkeletalMesh.h>
+#include <Render/Camera.h>
+
+void Core::AnimationSystem::Register(Component::Animator* animator)
+{
+	m_animators.push_back(animator);
+}
+
+void Core::AnimationSystem::Unregister(Component::Animator* animator)
+{
+	m_animators.erase(std::remove(m_animators.begin(), m_animators.end(), animator), m_animators.end());
+}
+
+void Core::AnimationSystem::UpdateLOD(Component::Animator* animator, const std::vector<Render::Camera*>& cameras) const
+{
+	using namespace Component;
+	animator->m_visible = true;
+	animator->m_screenSize = 1.f;
+	animator->m_lodLevel = 0;
+
+	const AnimatorLODSettings& lod = animator->m_lod;
+	Resources::SkeletalMesh* mesh = animator->m_skeletalMesh->GetMesh();
+	if (!lod.enabled || cameras.empty() || !mesh || !mesh->HasBeenSent())
+		return;
+
+	// Sphere around the bind pose bounds, the animated pose can go a bit outside
+	Transform* transform = animator->gameObject->transform;
+	const Math::Vector3 scale = transform->GetWorldScale();
+	const Math::Vector3 center{ transform->GetModelMatrix().GetTransposed() * Math::Vector4((mesh->MinAABB() + mesh->MaxAABB()) * 0.5f, 1.f) };
+	const float radius = (mesh->MaxAABB() - mesh->MinAABB()).Length() * 0.5f * std::max(std::max(scale.x, scale.y), scale.z);
+
+	bool visible = false;
+	float screenSize = 0.f;
+	float distance = FLT_MAX;
+	for (Render::Camera* camera : cameras)
+	{
+		bool inside = true;
+		for (const auto& plane : camera->frustum.planes)
+			inside &= plane.GetDistanceToPoint(center) > -radius;
+		if (!inside)
+			continue;
+
+		visible = true;
+		float cameraDistance = (center - camera->GetTransform()->GetWorldPosition()).Length();
+		float halfHeight = std::max(cameraDistance * std::tan(std::fabs(camera->fov) * 0.5f * DEG2RAD), 0.0001f);
+		screenSize = std::max(screenSize, radius / halfHeight);
+		distance = std::min(distance, cameraDistance);
+	}
+
+	animator->m_visible = visible;
+	animator->m_screenSize = screenSize;
+	if (!visible)
+	{
+		animator->m_lodLevel = AnimatorLODSettings::LevelCount - 1;
+		return;
+	}
+
+	const float bias = std::max(budget.lodBias, 0.0001f);
+	for (int i = 0; i < AnimatorLODSettings::LevelCount - 1; i++)
+	{
+		bool lower = lod.metric == AnimatorLODMetric::ScreenSize ? screenSize * bias < lod.thresholds[i] : distance > lod.thresholds[i] * bias;
+		if (lower)
+			animator->m_lodLevel = i + 1;
+	}
+}
+
+void Core::AnimationSystem::Update(const std::vector<Render::Camera*>& cameras)
+{
+	m_evaluationCount = 0;
+	if (m_animators.empty())
+		return;
+
+	const float deltaTime = WrapperUI::GetDeltaTime();
+	m_due.clear();
+	m_jobs.clear();
+
+	// Everything shared between animators is done here, the jobs only write their own animator and skeleton
+	for (Component::Animator* animator : m_animators)
+	{
+		animator->PrepareEvaluation();
+		UpdateLOD(animator, cameras);
+
+		animator->m_pendingDeltaTime += deltaTime;
+		animator->m_framesSinceEvaluation++;
+		bool frozen = !animator->m_visible && animator->m_lod.cullingMode == Component::AnimatorCullingMode::CullCompletely;
+		if (frozen)
+		{
+			animator->m_pendingDeltaTime = 0.f;
+			animator->m_framesSinceEvaluation = 0;
+		}
+
+		if (!frozen && animator->m_framesSinceEvaluation >= animator->GetUpdateInterval())
+			m_due.push_back(animator);
+		else
+			m_jobs.push_back({ animator, false });
+	}
+
+	if (budget.maxEvaluations > 0 && m_due.size() > budget.maxEvaluations)
+	{
+		auto priority = [](const Component::Animator* a, const Component::Animator* b)
+		{
+			int lateA = a->m_framesSinceEvaluation - a->GetUpdateInterval();
+			int lateB = b->m_framesSinceEvaluation - b->GetUpdateInterval();
+			if (lateA != lateB)
+				return lateA > lateB;
+			return a->m_screenSize > b->m_screenSize;
+		};
+		std::nth_element(m_due.begin(), m_due.begin() + budget.maxEvaluations, m_due.end(), priority);
+		for (size_t i = budget.maxEvaluations; i < m_due.size(); i++)
+			m_jobs.push_back({ m_due[i], false });
+		m_due.resize(budget.maxEvaluations);
+	}
+	for (Component::Animator* animator : m_due)
+		m_jobs.push_back({ animator, true });
+	m_evaluationCount = m_due.size();
+
+	auto run = [this](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			if (m_jobs[i].evaluate)
+				m_jobs[i].animator->Evaluate();
+			else
+				m_jobs[i].animator->SkipEvaluation();
+		}
+	};
+
+	// A few animators per batch, one skeleton is too small to pay for a job
+	constexpr size_t batchSize = 4;
+	if (ThreadManager* threadManager = Core::App::Get().threadManager)
+		threadManager->ParallelFor(m_jobs.size(), batchSize, run);
+	else
+		run(0, m_jobs.size());
+
+	m_animators.clear();
+}
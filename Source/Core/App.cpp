@@ -10,11 +10,15 @@
 #include <Render/Framebuffer.h>
 #include <Core/Wrappers/WrapperPhysic.h>
 #include <Core/Wrappers/WrapperRHI.h>
+#include <Core/Wrappers/RHIBackend.h>
 #include <Core/Wrappers/WrapperFont.h>
 #include <Core/Wrappers/WrapperAudio.h>
 
 #include <Core/SceneManager.h>
 #include <Core/Scene.h>
+#include <Core/AnimationSystem.h>
+#include <Core/ParticleManager.h>
+#include <Core/RenderQueue.h>
 #include <Resources/Shader.h>
 #include <Resources/Texture.h>
 #include <Resources/Model.h>
@@ -31,6 +35,7 @@
 #endif
 
 #include "Scripting\ScriptEngine.h"
+#include "Scripting\ScriptProfiler.h"
 
 using namespace Core;
 
@@ -38,8 +43,10 @@ App* App::m_instance = nullptr;
 
 void Core::App::InitializeUI()
 {
-	WrapperUI::Initialize(window->GetWindow());
+	if (!m_headless)
+		WrapperUI::Initialize(window->GetWindow());
 #ifndef PANDOR_GAME
+	// Created when headless too, the scenes read the size of its windows
 	m_editorUIManager = new EditorUI::EditorUiManager();
 #endif // PANDOR_GAME
 }
@@ -100,14 +107,20 @@ void Core::App::Init(AppInit init, const std::string& projectPath)
 
 	projectSettings = ProjectSettings();
 	projectSettings.Load(projectPath);
-	InitializeWindow(init);
+	m_headless = WrapperRHI::GetBackend() != nullptr;
+	m_headlessSize = Vector2((float)init.width, (float)init.height);
+	if (!m_headless)
+		InitializeWindow(init);
 	InitializeRHI();
 #ifdef PANDOR_GAME
-	if (projectSettings.fullscreen)
+	if (projectSettings.fullscreen && window)
 		window->SetFullscreen(true);
 #endif
 	InitializeUI();
 	InitializePhysic();
+	animationSystem = new AnimationSystem();
+	particleManager = new ParticleManager();
+	renderQueue = new RenderQueue();
 	InitializeResources();
 	InitializeAudio();
 
@@ -130,7 +143,9 @@ void Core::App::Init(AppInit init, const std::string& projectPath)
 	Component::ComponentsData::Create();
 	Component::ComponentsData::Get().Initialize();
 #ifndef PANDOR_GAME
-	LoadEngineParameters();
+	// The theme needs the UI
+	if (!m_headless)
+		LoadEngineParameters();
 #endif
 	InitializeScenes();
 }
@@ -165,19 +180,7 @@ void App::Update()
 
 		if (shouldCloseWindowEvent) { CloseAppPopup(); }
 
-		if (m_resourceToSend.size() != 0)
-		{
-			IResources* res = resourcesManager->Find<IResources>(m_resourceToSend.front());
-			if (res && !res->HasBeenSent()) {
-				res->SendResource();
-			}
-			if (!res || res->HasBeenSent()) {
-				if (appMutex.try_lock()) {
-					m_resourceToSend.pop_front();
-					appMutex.unlock();
-				}
-			}
-		}
+		SendNextResource();
 
 		if (WrapperUI::IsKeyPressed(Key::Key_F11))
 		{
@@ -185,6 +188,7 @@ void App::Update()
 		}
 
 		sceneManager->Update();
+		Scripting::ScriptProfiler::NewFrame();
 
 #ifdef PANDOR_GAME
 
@@ -196,6 +200,12 @@ void App::Update()
 		WrapperUI::SetNextWindowSize(Vector2(350, 0));
 		WrapperUI::SetNextWindowPos(window->GetWindowPos() + Vector2(window->GetSize().x - 350, 0));
 		WrapperUI::ShowPerformanceWindow("##PeformanceWindow", &performanceOpen);
+		if (performanceOpen)
+		{
+			if (WrapperUI::Begin("##PeformanceWindow", &performanceOpen, WindowFlags::NoDecoration))
+				Scripting::ScriptProfiler::ShowInWindow();
+			WrapperUI::End();
+		}
 #endif
 
 		EndFrame();
@@ -205,10 +215,42 @@ void App::Update()
 #endif
 }
 
+void Core::App::UpdateHeadless()
+{
+	ExecuteEventQueue();
+	SendNextResource();
+
+	Core::Scene* scene = sceneManager->GetCurrentScene();
+	if (scene && scene->GetSceneNode())
+		scene->UpdateHeadless();
+}
+
+Math::Vector2 Core::App::GetScreenSize() const
+{
+	return window ? window->GetSize() : m_headlessSize;
+}
+
+void Core::App::SendNextResource()
+{
+	if (m_resourceToSend.size() == 0)
+		return;
+
+	IResources* res = resourcesManager->Find<IResources>(m_resourceToSend.front());
+	if (res && !res->HasBeenSent()) {
+		res->SendResource();
+	}
+	if (!res || res->HasBeenSent()) {
+		if (appMutex.try_lock()) {
+			m_resourceToSend.pop_front();
+			appMutex.unlock();
+		}
+	}
+}
 
 void App::Clear()
 {
-	WrapperUI::Destroy();
+	if (!m_headless)
+		WrapperUI::Destroy();
 	Delete();
 }
 
@@ -224,10 +266,20 @@ void Core::App::Delete()
 	delete physic;
 	physic = nullptr;
 
+	delete animationSystem;
+	animationSystem = nullptr;
+
+	delete particleManager;
+	particleManager = nullptr;
+
+	delete renderQueue;
+	renderQueue = nullptr;
+
 	delete threadManager;
 	threadManager = nullptr;
 
-	window->Terminate();
+	if (window)
+		window->Terminate();
 	delete window;
 	window = nullptr;
 
@@ -461,6 +513,8 @@ void ProjectSettings::Save()
 		projectParametersFile << fullscreen << '\n';
 		projectParametersFile << screenSize << '\n';
 		projectParametersFile << resizableScreen << '\n';
+		projectParametersFile << profileScriptAllocations << '\n';
+		projectParametersFile << animationPositionTolerance << ' ' << animationRotationTolerance << '\n';
 	}
 
 	projectParametersFile.close();
@@ -485,6 +539,12 @@ void Core::ProjectSettings::Load(const std::string& projectPath)
 
 		if (getline(projectParametersFile, line))
 			this->resizableScreen = std::stoi(line);
+
+		if (getline(projectParametersFile, line))
+			this->profileScriptAllocations = std::stoi(line);
+
+		if (getline(projectParametersFile, line))
+			std::istringstream(line) >> this->animationPositionTolerance >> this->animationRotationTolerance;
 	}
 	else
 	{
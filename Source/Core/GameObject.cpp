@@ -105,6 +105,7 @@ Core::GameObject::~GameObject()
 		Core::SceneManager::Get()->GetCurrentScene()->RemoveObject(this);
 
 	Scripting::ScriptEngine::UpdateObjectRefs();
+	Scripting::ScriptEngine::ReleaseNativeHandle(this);
 
 	for (auto&& child : m_childrens)
 	{
@@ -0,0 +1,47 @@
+#include "pch.h"
+#include <Core/HeadlessBenchmark.h>
+#include <Core/App.h>
+
+#include <chrono>
+
+Core::HeadlessBenchmarkResult Core::RunHeadlessBenchmark(const std::string& projectPath, size_t frameCount)
+{
+	WrapperRHI::NullBackend backend;
+	WrapperRHI::SetBackend(&backend);
+
+	App::CreateInstance();
+	App& app = App::Get();
+	AppInit init = { 1600, 900, 4, 6, "Pandor Engine Benchmark", false };
+	app.Init(init, projectPath);
+
+	// The frames of the loading are not measured
+	while (!app.resourcesManager->IsEverythingLoaded() || !app.resourcesManager->IsEverythingSent())
+		app.UpdateHeadless();
+	backend.Reset();
+
+	HeadlessBenchmarkResult result;
+	double totalTime = 0.0;
+	for (size_t i = 0; i < frameCount; i++)
+	{
+		auto begin = std::chrono::high_resolution_clock::now();
+		app.UpdateHeadless();
+		auto end = std::chrono::high_resolution_clock::now();
+
+		double frameTime = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() * 1e-6;
+		totalTime += frameTime;
+		result.minFrameTime = i == 0 ? frameTime : std::min(result.minFrameTime, frameTime);
+		result.maxFrameTime = std::max(result.maxFrameTime, frameTime);
+	}
+	result.frames = frameCount;
+	result.averageFrameTime = frameCount > 0 ? totalTime / frameCount : 0.0;
+	result.stats = backend.stats;
+
+	PrintLog("Headless benchmark : %llu frames, %.3f ms average, %.3f ms min, %.3f ms max",
+		(unsigned long long)result.frames, result.averageFrameTime, result.minFrameTime, result.maxFrameTime);
+	PrintLog("Headless benchmark : %llu draw calls, %llu state changes, %llu vertices",
+		(unsigned long long)result.stats.GetDrawCalls(), (unsigned long long)result.stats.GetStateChanges(), (unsigned long long)result.stats.vertices);
+
+	app.Clear();
+	WrapperRHI::SetBackend(nullptr);
+	return result;
+}
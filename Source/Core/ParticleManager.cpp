@@ -0,0 +1,347 @@
+#include "pch.h"
+#include <Core/ParticleManager.h>
+#include <Core/App.h>
+#include <Core/ThreadManager.h>
+
+#include <Components/ParticleSystem.h>
+#include <Render/GPUParticles.h>
+#include <Components/Transform.h>
+#include <Render/Camera.h>
+#include <Resources/Mesh.h>
+#include <Core/SceneManager.h>
+#include <Core/Scene.h>
+
+Core::ParticleManager::~ParticleManager()
+{
+	for (Batch& batch : m_batches)
+	{
+		for (WrapperRHI::Buffer* buffer : { batch.vertices, batch.instances })
+		{
+			buffer->Delete();
+			delete buffer;
+		}
+	}
+	m_batches.clear();
+}
+
+void Core::ParticleManager::Register(Component::ParticleSystem* system)
+{
+	m_systems.push_back(system);
+}
+
+void Core::ParticleManager::Unregister(Component::ParticleSystem* system)
+{
+	m_systems.erase(std::remove(m_systems.begin(), m_systems.end(), system), m_systems.end());
+	m_submissions.erase(std::remove_if(m_submissions.begin(), m_submissions.end(),
+		[system](const Submission& submission) { return submission.system == system; }), m_submissions.end());
+}
+
+Core::ParticleManager::Visibility Core::ParticleManager::GetVisibility(Component::ParticleSystem* system, const std::vector<Render::Camera*>& cameras) const
+{
+	if (cameras.empty())
+		return { true, 0.f };
+
+	const Math::Vector3 center = (system->GetBoundsMin() + system->GetBoundsMax()) * 0.5f;
+	Visibility visibility = { false, FLT_MAX };
+	for (Render::Camera* camera : cameras)
+	{
+		if (!system->IsVisible(camera->frustum))
+			continue;
+		visibility.visible = true;
+		visibility.distance = std::min(visibility.distance, (center - camera->GetTransform()->GetWorldPosition()).Length());
+	}
+	return visibility;
+}
+
+void Core::ParticleManager::PrepareSystems(const std::vector<Render::Camera*>& cameras)
+{
+	m_distances.clear();
+	size_t kept = 0;
+	for (Component::ParticleSystem* system : m_systems)
+	{
+		Visibility visibility = GetVisibility(system, cameras);
+		if (!visibility.visible && system->m_pauseWhenInvisible)
+		{
+			system->m_skippedTime += system->m_pendingDeltaTime;
+			m_culledCount++;
+			m_particleCount += system->m_particles.aliveCount;
+			continue;
+		}
+		if (system->m_skippedTime > 0.f)
+		{
+			// Nothing older than the longest lifetime can still be alive
+			float lifetime = std::max(system->m_particleLifeTime.Value.Min, system->m_particleLifeTime.Value.Max);
+			system->m_pendingDeltaTime += std::min(system->m_skippedTime, std::min(lifetime, budget.maxCatchUpTime));
+			system->m_skippedTime = 0.f;
+		}
+
+		system->m_emissionScale = 1.f;
+		if (budget.distanceReduction && visibility.distance > budget.fullEmissionDistance)
+		{
+			float range = std::max(budget.reducedEmissionDistance - budget.fullEmissionDistance, 0.0001f);
+			float t = std::min((visibility.distance - budget.fullEmissionDistance) / range, 1.f);
+			system->m_emissionScale = 1.f + (budget.minEmissionScale - 1.f) * t;
+		}
+		// Dispatched now on the main thread, out of the jobs and of the budget
+		if (system->IsSimulatedOnGPU())
+		{
+			system->SimulateOnGPU();
+			continue;
+		}
+		m_systems[kept++] = system;
+		m_distances.push_back(visibility.distance);
+	}
+	m_systems.resize(kept);
+}
+
+void Core::ParticleManager::ApplyBudget()
+{
+	if (budget.maxParticles == 0)
+	{
+		for (Component::ParticleSystem* system : m_systems)
+			system->CommitSpawn(system->m_spawnCount);
+		return;
+	}
+
+	// The particles of the paused systems are already counted
+	size_t alive = m_particleCount;
+	for (Component::ParticleSystem* system : m_systems)
+		alive += system->m_particles.aliveCount;
+	size_t remaining = budget.maxParticles > alive ? budget.maxParticles - alive : 0;
+
+	m_order.resize(m_systems.size());
+	for (size_t i = 0; i < m_order.size(); i++)
+		m_order[i] = i;
+	std::sort(m_order.begin(), m_order.end(), [this](size_t a, size_t b)
+		{
+			if (m_systems[a]->GetPriority() != m_systems[b]->GetPriority())
+				return m_systems[a]->GetPriority() > m_systems[b]->GetPriority();
+			return m_distances[a] < m_distances[b];
+		});
+	for (size_t index : m_order)
+	{
+		Component::ParticleSystem* system = m_systems[index];
+		size_t count = std::min(system->m_spawnCount, remaining);
+		system->CommitSpawn(count);
+		remaining -= count;
+	}
+}
+
+template<typename Count>
+void Core::ParticleManager::BuildChunks(Count count)
+{
+	m_chunks.clear();
+	for (Component::ParticleSystem* system : m_systems)
+	{
+		size_t total = count(system);
+		for (size_t begin = 0; begin < total; begin += ChunkSize)
+			m_chunks.push_back({ system, begin, std::min(begin + ChunkSize, total) });
+	}
+}
+
+void Core::ParticleManager::RunChunks(void (*job)(Chunk& chunk))
+{
+	auto run = [this, job](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			job(m_chunks[i]);
+	};
+	if (ThreadManager* threadManager = Core::App::Get().threadManager; threadManager && m_chunks.size() > 1)
+		threadManager->ParallelFor(m_chunks.size(), 1, run);
+	else
+		run(0, m_chunks.size());
+}
+
+void Core::ParticleManager::RunSystems(const std::function<void(Component::ParticleSystem* system)>& job)
+{
+	auto run = [this, &job](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			job(m_systems[i]);
+	};
+	// Removing the dead particles is cheap, a few systems per batch
+	constexpr size_t batchSize = 4;
+	if (ThreadManager* threadManager = Core::App::Get().threadManager; threadManager && m_systems.size() > batchSize)
+		threadManager->ParallelFor(m_systems.size(), batchSize, run);
+	else
+		run(0, m_systems.size());
+}
+
+void Core::ParticleManager::Update(const std::vector<Render::Camera*>& cameras)
+{
+	m_particleCount = 0;
+	m_culledCount = 0;
+	if (m_systems.empty())
+		return;
+
+	PrepareSystems(cameras);
+
+	// The instance buffers are mapped by the main thread
+	for (Component::ParticleSystem* system : m_systems)
+		system->BeginSimulation();
+
+	BuildChunks([](Component::ParticleSystem* system) { return system->m_particles.aliveCount; });
+	RunChunks([](Chunk& chunk) { chunk.system->SimulateRange(chunk.begin, chunk.end); });
+
+	// Each system is compacted on its own, the emitted particles are placed after the alive ones
+	RunSystems([](Component::ParticleSystem* system) { system->EndSimulation(); });
+	ApplyBudget();
+
+	// Every chunk has its own generator, the spawned particles do not depend on the thread count
+	BuildChunks([](Component::ParticleSystem* system) { return system->m_spawnCount; });
+	RunChunks([](Chunk& chunk)
+		{
+			Component::ParticleRandom random(chunk.system->GetSpawnSeed(chunk.begin / ChunkSize));
+			chunk.system->SpawnRange(chunk.begin, chunk.end, random);
+		});
+
+	// One job per sorted system, the writes read the sorted order
+	if (!cameras.empty())
+	{
+		const Math::Vector3 viewPosition = cameras.front()->GetTransform()->GetWorldPosition();
+		const Math::Vector3 viewForward = cameras.front()->GetTransform()->GetForwardVector();
+		RunSystems([&](Component::ParticleSystem* system)
+			{
+				if (system->m_sortByDepth)
+					system->SortParticles(viewPosition, viewForward);
+			});
+	}
+
+	BuildChunks([](Component::ParticleSystem* system) { return system->m_particles.aliveCount; });
+	RunChunks([](Chunk& chunk) { chunk.system->WriteRange(chunk.begin, chunk.end, chunk.min, chunk.max); });
+
+	// The chunks of a system follow each other
+	size_t chunk = 0;
+	for (Component::ParticleSystem* system : m_systems)
+	{
+		Math::Vector3 min(FLT_MAX, FLT_MAX, FLT_MAX);
+		Math::Vector3 max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		for (; chunk < m_chunks.size() && m_chunks[chunk].system == system; chunk++)
+		{
+			for (size_t axis = 0; axis < 3; axis++)
+			{
+				min[axis] = std::min(min[axis], m_chunks[chunk].min[axis]);
+				max[axis] = std::max(max[axis], m_chunks[chunk].max[axis]);
+			}
+		}
+		system->EndUpload(min, max);
+		m_particleCount += system->m_particles.aliveCount;
+	}
+	m_systems.clear();
+}
+
+void Core::ParticleManager::Submit(Component::ParticleSystem* system)
+{
+	if (!system->m_mesh || !system->m_material || !system->m_shader || !system->m_buffer2)
+		return;
+	Render::Camera* camera = Core::SceneManager::Get()->GetCurrentScene()->currentCamera;
+	float distance = 0.f;
+	if (camera)
+		distance = ((system->GetBoundsMin() + system->GetBoundsMax()) * 0.5f - camera->GetTransform()->GetWorldPosition()).Length();
+	m_submissions.push_back({ system, distance });
+}
+
+Core::ParticleManager::Batch& Core::ParticleManager::GetBatch(Resources::Mesh* mesh, Resources::Material* material, Resources::Shader* shader)
+{
+	for (Batch& batch : m_batches)
+	{
+		if (batch.mesh == mesh && batch.material == material && batch.shader == shader)
+			return batch;
+	}
+
+	Batch& batch = m_batches.emplace_back();
+	batch.mesh = mesh;
+	batch.material = material;
+	batch.shader = shader;
+	std::vector<float> vertices = mesh->GetVertices();
+	batch.vertices = new WrapperRHI::Buffer(vertices.data(), vertices.size());
+	batch.vertices->LinkAttribute(0, 3, PR_FLOAT, 11 * sizeof(float), (void*)0);
+	batch.vertices->LinkAttribute(1, 2, PR_FLOAT, 11 * sizeof(float), (void*)(3 * sizeof(float)));
+	batch.vertices->LinkAttribute(2, 3, PR_FLOAT, 11 * sizeof(float), (void*)(5 * sizeof(float)));
+	batch.vertices->LinkAttribute(3, 3, PR_FLOAT, 11 * sizeof(float), (void*)(8 * sizeof(float)));
+
+	batch.instances = new WrapperRHI::Buffer();
+	batch.instances->GenVertexBuffer();
+	batch.vertices->LinkAttribute(8, 4, PR_FLOAT, sizeof(Component::InstanceData), (void*)0);
+	batch.vertices->AttribDivisor(8, 1);
+	batch.vertices->LinkAttribute(9, 4, PR_FLOAT, sizeof(Component::InstanceData), (void*)(sizeof(float[4])));
+	batch.vertices->AttribDivisor(9, 1);
+	batch.vertices->Unbind();
+	return batch;
+}
+
+void Core::ParticleManager::DrawGroup(size_t begin, size_t end)
+{
+	Component::ParticleSystem* first = m_submissions[begin].system;
+	m_drawCount++;
+	if (first->IsSimulatedOnGPU())
+	{
+		first->m_gpu->Draw(first->m_mesh, first->m_material, first->m_shader, first->m_buffer);
+		return;
+	}
+	if (end - begin == 1)
+	{
+		first->m_mesh->RenderInstancing(first->m_material, first->m_shader, first->m_particles.aliveCount, first->m_buffer);
+		return;
+	}
+
+	size_t total = 0;
+	for (size_t i = begin; i < end; i++)
+		total += m_submissions[i].system->m_particles.aliveCount;
+
+	Batch& batch = GetBatch(first->m_mesh, first->m_material, first->m_shader);
+	if (total > batch.capacity)
+	{
+		// Grows by half, the attributes keep pointing to the same buffer
+		batch.capacity = std::max(total, batch.capacity + batch.capacity / 2);
+		batch.instances->BufferData(batch.capacity * sizeof(Component::InstanceData), nullptr);
+	}
+
+	size_t offset = 0;
+	for (size_t i = begin; i < end; i++)
+	{
+		Component::ParticleSystem* system = m_submissions[i].system;
+		size_t size = system->m_particles.aliveCount * sizeof(Component::InstanceData);
+		WrapperRHI::Buffer::CopyData(*system->m_buffer2, system->m_buffer2->StreamOffset(), *batch.instances, offset, size);
+		offset += size;
+	}
+	first->m_mesh->RenderInstancing(first->m_material, first->m_shader, total, batch.vertices);
+}
+
+void Core::ParticleManager::DrawSubmitted()
+{
+	m_drawCount = 0;
+	m_submittedCount = m_submissions.size();
+	if (m_submissions.empty())
+		return;
+
+	// Grouped by mesh, material and shader, the farthest systems of a group first
+	std::sort(m_submissions.begin(), m_submissions.end(), [](const Submission& a, const Submission& b)
+		{
+			const Component::ParticleSystem* sa = a.system;
+			const Component::ParticleSystem* sb = b.system;
+			if (sa->m_mesh != sb->m_mesh)
+				return std::less<>()(sa->m_mesh, sb->m_mesh);
+			if (sa->m_material != sb->m_material)
+				return std::less<>()(sa->m_material, sb->m_material);
+			if (sa->m_shader != sb->m_shader)
+				return std::less<>()(sa->m_shader, sb->m_shader);
+			return a.distance > b.distance;
+		});
+
+	size_t begin = 0;
+	for (size_t i = 1; i <= m_submissions.size(); i++)
+	{
+		if (i < m_submissions.size())
+		{
+			const Component::ParticleSystem* a = m_submissions[begin].system;
+			const Component::ParticleSystem* b = m_submissions[i].system;
+			// The GPU systems are drawn alone, their instance count stays on the GPU
+			if (a->m_mesh == b->m_mesh && a->m_material == b->m_material && a->m_shader == b->m_shader && !a->IsSimulatedOnGPU() && !b->IsSimulatedOnGPU())
+				continue;
+		}
+		DrawGroup(begin, i);
+		begin = i;
+	}
+	m_submissions.clear();
+}
@@ -0,0 +1,223 @@
+#include "pch.h"
+#include <Core/RenderQueue.h>
+#include <Core/App.h>
+
+#include <Components/Transform.h>
+#include <Render/Camera.h>
+#include <Resources/Mesh.h>
+#include <Resources/Material.h>
+#include <Resources/Shader.h>
+#include <Resources/Texture.h>
+#include <Resources/Skybox.h>
+#include <Core/SceneManager.h>
+#include <Core/Scene.h>
+
+uint64_t Core::RenderQueue::GetIndex(std::unordered_map<const void*, uint64_t>& indices, const void* resource, uint64_t bits)
+{
+	// Past the bits the resources share the last index, they are still told apart when drawn
+	const uint64_t last = (1ull << bits) - 1;
+	auto it = indices.find(resource);
+	if (it != indices.end())
+		return it->second;
+	const uint64_t index = std::min<uint64_t>(indices.size(), last);
+	indices.emplace(resource, index);
+	return index;
+}
+
+void Core::RenderQueue::Submit(Resources::Mesh* mesh, Component::Transform* transform, const std::vector<Resources::Material*>& materials)
+{
+	if (!mesh || !mesh->HasBeenSent() || materials.empty())
+		return;
+	Core::Scene* scene = Core::SceneManager::Get()->GetCurrentScene();
+	const Math::Matrix4 model = transform->GetModelMatrix();
+	const Math::Matrix4 MVP = model * scene->GetVP();
+
+	// The bits of a positive float are in the same order as its value, the 24 high ones are enough
+	float distance = 0.f;
+	if (scene->currentCamera)
+		distance = (transform->GetWorldPosition() - scene->currentCamera->GetTransform()->GetWorldPosition()).Length();
+	uint32_t distanceBits;
+	std::memcpy(&distanceBits, &distance, sizeof(float));
+	const uint64_t depth = distanceBits >> 8;
+
+	const std::vector<Resources::SubMesh>& subMeshes = mesh->GetSubMeshes();
+	const uint64_t meshIndex = GetIndex(m_meshIndices, mesh, 12);
+	for (size_t i = 0; i < subMeshes.size(); i++)
+	{
+		// The submeshes past the materials use the first one, as Mesh::Render
+		Resources::Material* material = i < materials.size() ? materials[i] : materials[0];
+		if (!material || !material->GetShader() || !material->GetShader()->HasBeenSent())
+			continue;
+		Resources::Shader* shader = material->GetShader();
+		const uint64_t shaderIndex = GetIndex(m_shaderIndices, shader, 12);
+		const uint64_t materialIndex = GetIndex(m_materialIndices, material, 14);
+
+		uint64_t key;
+		if (material->GetDiffuse().w < 1.f)
+			key = ((uint64_t)RenderPass::Transparent << 62) | ((~depth & 0xFFFFFF) << 38) | (shaderIndex << 26) | (materialIndex << 12) | meshIndex;
+		else
+			key = ((uint64_t)RenderPass::Opaque << 62) | (shaderIndex << 50) | (materialIndex << 36) | (meshIndex << 24) | depth;
+
+		m_keys.push_back(key);
+		m_order.push_back((uint32_t)m_packets.size());
+		m_packets.push_back({ mesh, material, shader, subMeshes[i].StartIndex, subMeshes[i].Count, MVP, model });
+	}
+}
+
+void Core::RenderQueue::RadixSort()
+{
+	const size_t count = m_keys.size();
+	m_sortedKeys.resize(count);
+	m_sortedOrder.resize(count);
+	for (uint32_t shift = 0; shift < 64; shift += 8)
+	{
+		size_t offsets[256] = {};
+		for (uint64_t key : m_keys)
+			offsets[(key >> shift) & 0xFF]++;
+		// Most passes are skipped, few resources only fill the low bits of their fields
+		if (offsets[(m_keys[0] >> shift) & 0xFF] == count)
+			continue;
+
+		size_t total = 0;
+		for (size_t& offset : offsets)
+		{
+			const size_t bucket = offset;
+			offset = total;
+			total += bucket;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			const size_t destination = offsets[(m_keys[i] >> shift) & 0xFF]++;
+			m_sortedKeys[destination] = m_keys[i];
+			m_sortedOrder[destination] = m_order[i];
+		}
+		m_keys.swap(m_sortedKeys);
+		m_order.swap(m_sortedOrder);
+	}
+}
+
+void Core::RenderQueue::BeginShader(Resources::Shader* shader)
+{
+	m_shaderChanges++;
+	shader->Use();
+	WrapperRHI::ShaderSendMat4(shader->GetLocation("lightSpaceMatrix"), m_lightSpace);
+	WrapperRHI::ShaderSendVec3(shader->GetLocation("CamUp"), m_upVector);
+	WrapperRHI::ShaderSendVec3(shader->GetLocation("CamRight"), m_rightVector);
+	if (m_skybox)
+		WrapperRHI::ShaderSendInt(shader->GetLocation("skybox"), 4);
+	if (Core::App::Get().shadowMap)
+		WrapperRHI::ShaderSendInt(shader->GetLocation("shadowMap"), 5);
+}
+
+void Core::RenderQueue::BeginMaterial(Resources::Material* material, Resources::Shader* shader)
+{
+	m_materialChanges++;
+	WrapperRHI::ShaderSendVec4(shader->GetLocation("material.ambient"), material->GetAmbient());
+	WrapperRHI::ShaderSendVec4(shader->GetLocation("material.diffuse"), material->GetDiffuse());
+	WrapperRHI::ShaderSendVec4(shader->GetLocation("material.specular"), material->GetSpecular());
+	WrapperRHI::ShaderSendInt(shader->GetLocation("enableTexture"), material->GetTexture() != nullptr);
+	WrapperRHI::ShaderSendInt(shader->GetLocation("enableNormalMap"), material->GetNormalMap() != nullptr);
+	WrapperRHI::ShaderSendInt(shader->GetLocation("enableRoughnessMap"), material->GetRoughnessMap() != nullptr);
+	WrapperRHI::ShaderSendInt(shader->GetLocation("enableMetallicMap"), material->GetMetallicMap() != nullptr);
+	if (material->GetTexture() != nullptr) {
+		material->GetTexture()->Active(0);
+		material->GetTexture()->Bind();
+		WrapperRHI::ShaderSendInt(shader->GetLocation("tex0"), 0);
+	}
+	if (material->GetNormalMap() != nullptr) {
+		material->GetNormalMap()->Active(1);
+		material->GetNormalMap()->Bind();
+		WrapperRHI::ShaderSendInt(shader->GetLocation("normalMap"), 1);
+	}
+	if (material->GetRoughnessMap() != nullptr) {
+		material->GetRoughnessMap()->Active(2);
+		material->GetRoughnessMap()->Bind();
+		WrapperRHI::ShaderSendInt(shader->GetLocation("roughnessMap"), 2);
+	}
+	else {
+		WrapperRHI::ShaderSendFloat(shader->GetLocation("roughnessValue"), material->roughness);
+	}
+	if (material->GetMetallicMap() != nullptr) {
+		material->GetMetallicMap()->Active(3);
+		material->GetMetallicMap()->Bind();
+		WrapperRHI::ShaderSendInt(shader->GetLocation("metallicMap"), 3);
+	}
+	else {
+		WrapperRHI::ShaderSendFloat(shader->GetLocation("metallicValue"), material->metallic);
+	}
+	WrapperRHI::ShaderSendVec4(shader->GetLocation("ourColor"), material->GetDiffuse());
+}
+
+void Core::RenderQueue::DrawSubmitted()
+{
+	m_drawCount = 0;
+	m_shaderChanges = 0;
+	m_materialChanges = 0;
+	m_meshChanges = 0;
+	if (m_packets.empty())
+		return;
+
+	RadixSort();
+
+	Core::Scene* scene = Core::SceneManager::Get()->GetCurrentScene();
+	m_lightSpace = m_packets.front().mesh->ShadowVP();
+	m_upVector = scene->GetUpVector();
+	m_rightVector = scene->GetRightVector();
+	m_skybox = scene->currentCamera->skybox != nullptr;
+	// The units 4 and 5 are not used by the materials, bound once for every shader
+	if (m_skybox)
+	{
+		scene->currentCamera->skybox->Active(4);
+		scene->currentCamera->skybox->Bind();
+	}
+	if (Core::App::Get().shadowMap)
+	{
+		Core::App::Get().shadowMap->Active(5);
+		Core::App::Get().shadowMap->Bind();
+		if (Core::App::Get().shadowMap->stencilDepthTest)
+			WrapperRHI::StencilActive();
+	}
+	WrapperRHI::UseStencil();
+
+	// Compared by pointer, the resources sharing an index of the key are still sent
+	Resources::Shader* shader = nullptr;
+	Resources::Material* material = nullptr;
+	Resources::Mesh* mesh = nullptr;
+	for (uint32_t index : m_order)
+	{
+		const Packet& packet = m_packets[index];
+		if (packet.shader != shader)
+		{
+			shader = packet.shader;
+			BeginShader(shader);
+			// The uniforms of the material belong to the previous program
+			material = nullptr;
+		}
+		if (packet.material != material)
+		{
+			material = packet.material;
+			BeginMaterial(material, shader);
+		}
+		if (packet.mesh != mesh)
+		{
+			mesh = packet.mesh;
+			mesh->BindBuffer();
+			m_meshChanges++;
+		}
+		WrapperRHI::ShaderSendMat4(shader->GetLocation("MVP"), packet.MVP);
+		WrapperRHI::ShaderSendMat4(shader->GetLocation("model"), packet.model);
+		WrapperRHI::DrawArrays(packet.start, packet.count);
+		m_drawCount++;
+	}
+
+	WrapperRHI::DisableStencil();
+	// The textures bound without a unit go to the first one
+	WrapperRHI::ActivateTexture(0);
+
+	m_packets.clear();
+	m_keys.clear();
+	m_order.clear();
+	m_shaderIndices.clear();
+	m_materialIndices.clear();
+	m_meshIndices.clear();
+}
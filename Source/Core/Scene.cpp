@@ -3,9 +3,13 @@
 #include <Core/Scene.h>
 #include <Core/SceneManager.h>
 #include <Core/App.h>
+#include <Core/AnimationSystem.h>
+#include <Core/ParticleManager.h>
+#include <Core/RenderQueue.h>
 #include <Core/GameObject.h>
 #include <Resources/Skeleton.h>
 #include <Core/Wrappers/WrapperAudio.h>
+#include <Scripting/ScriptScheduler.h>
 
 #ifndef PANDOR_GAME
 #include <EditorUI/EditorUIManager.h>
@@ -103,6 +107,7 @@ bool Core::Scene::RenderMaterialThumbnail(const std::string& path)
 		camera->PreUpdate(1.f);
 		WrapperRHI::ClearColorAndBuffer(camera->ClearColor);
 		gameObject->DrawSelfAndChild(false);
+		Core::App::Get().renderQueue->DrawSubmitted();
 
 		material->SetShader(previousShader, false);
 
@@ -172,6 +177,7 @@ bool Scene::RenderModelThumbnail(const std::string& path)
 	camera->PreUpdate(1.f);
 	WrapperRHI::ClearColorAndBuffer(camera->ClearColor);
 	GO->DrawSelfAndChild(false);
+	Core::App::Get().renderQueue->DrawSubmitted();
 	camera->PostUpdate();
 
 	// Save thumbnail
@@ -347,6 +353,7 @@ bool Scene::RenderMeshThumbnail(const std::string& path)
 		camera->PreUpdate(1.f);
 		WrapperRHI::ClearColorAndBuffer(camera->ClearColor);
 		GOMesh->DrawSelfAndChild(false);
+		Core::App::Get().renderQueue->DrawSubmitted();
 		camera->PostUpdate();
 
 		// Save thumbnail
@@ -431,8 +438,27 @@ void Core::Scene::Update()
 	size_t index = 0;
 	m_sceneNode->UpdateSelfAndChild(index);
 
+	// Transforms are up to date, the skeletons are evaluated from them
+	// The frustums are the ones of the last frame, the cameras move after this
+	std::vector<Render::Camera*> cameras;
+#ifndef PANDOR_GAME
+	if (GetEditorCamera()->IsVisible())
+		cameras.push_back(GetEditorCamera());
+#endif
+	for (auto&& camera : m_cameraComponents)
+	{
+		if (camera->IsVisible())
+			cameras.push_back(camera);
+	}
+	Core::App::Get().animationSystem->Update(cameras);
+	Core::App::Get().particleManager->Update(cameras);
+
 	Core::App::Get().physic->Update();
 
+	// Coroutines and timers that are due this frame
+	if (Core::App::Get().GetGameState() == GameState::Play)
+		Scripting::ScriptScheduler::Update(WrapperUI::GetDeltaTime());
+
 #ifndef PANDOR_GAME
 	auto size = Core::App::Get().GetEditorUIManager().GetSceneWindow().GetWindowSize();
 	auto mouseWinPos = Core::App::Get().GetEditorUIManager().GetSceneWindow().GetMousePosition();
@@ -472,6 +498,8 @@ void Core::Scene::Update()
 
 
 		m_sceneNode->DrawSelfAndChild(true);
+		Core::App::Get().renderQueue->DrawSubmitted();
+		Core::App::Get().particleManager->DrawSubmitted();
 
 		if (Core::GameObject* gameObject = Core::App::Get().GetEditorUIManager().GetInspector().GetGameObjectSelected())
 		{
@@ -488,25 +516,9 @@ void Core::Scene::Update()
 	}
 	size = Core::App::Get().GetEditorUIManager().GetGameWindow().GetSize();
 #else
-	auto size = Core::App::Get().window->GetSize();
+	auto size = Core::App::Get().GetScreenSize();
 #endif
-	for (auto&& camera : m_cameraComponents)
-	{
-		if (!camera->IsVisible())
-			continue;
-		SetCurrentCamera(camera);
-
-		LowRenderer::LightManager::getInstance().SendLightToAllShaders();
-
-		currentCamera->PreUpdate(size.x / size.y);
-		WrapperRHI::DepthActive();
-		WrapperRHI::ClearColorAndBuffer(currentCamera->ClearColor);
-
-		currentCamera->DrawSkybox();
-		m_sceneNode->DrawSelfAndChild(false);
-
-		currentCamera->PostUpdate();
-	}
+	DrawCameras(size);
 #ifndef PANDOR_GAME
 	if (m_thumbnails.size() != 0) {
 		if (m_thumbnails.front().second == ResourcesType::Material) {
@@ -551,6 +563,48 @@ void Core::Scene::Update()
 #endif
 }
 
+void Core::Scene::UpdateHeadless()
+{
+	size_t index = 0;
+	m_sceneNode->UpdateSelfAndChild(index);
+
+	std::vector<Render::Camera*> cameras;
+	for (auto&& camera : m_cameraComponents)
+	{
+		if (camera->IsVisible())
+			cameras.push_back(camera);
+	}
+	Core::App::Get().animationSystem->Update(cameras);
+	Core::App::Get().particleManager->Update(cameras);
+
+	Core::App::Get().physic->Update();
+
+	DrawCameras(Core::App::Get().GetScreenSize());
+}
+
+void Core::Scene::DrawCameras(const Math::Vector2& size)
+{
+	for (auto&& camera : m_cameraComponents)
+	{
+		if (!camera->IsVisible())
+			continue;
+		SetCurrentCamera(camera);
+
+		LowRenderer::LightManager::getInstance().SendLightToAllShaders();
+
+		currentCamera->PreUpdate(size.x / size.y);
+		WrapperRHI::DepthActive();
+		WrapperRHI::ClearColorAndBuffer(currentCamera->ClearColor);
+
+		currentCamera->DrawSkybox();
+		m_sceneNode->DrawSelfAndChild(false);
+		Core::App::Get().renderQueue->DrawSubmitted();
+		Core::App::Get().particleManager->DrawSubmitted();
+
+		currentCamera->PostUpdate();
+	}
+}
+
 #ifndef PANDOR_GAME
 void Core::Scene::UpdatePrefabScene()
 {
@@ -562,6 +616,8 @@ void Core::Scene::UpdatePrefabScene()
 
 		size_t index = 0;
 		m_sceneNode->UpdateSelfAndChild(index);
+		Core::App::Get().animationSystem->Update({ GetEditorCamera() });
+		Core::App::Get().particleManager->Update({ GetEditorCamera() });
 
 		auto size = Core::App::Get().GetEditorUIManager().GetPrefabWindow().GetWindowSize();
 		auto mouseWinPos = Core::App::Get().GetEditorUIManager().GetPrefabWindow().GetMousePosition();
@@ -591,6 +647,8 @@ void Core::Scene::UpdatePrefabScene()
 		RenderClickedObject(false);
 
 		m_sceneNode->DrawSelfAndChild(true);
+		Core::App::Get().renderQueue->DrawSubmitted();
+		Core::App::Get().particleManager->DrawSubmitted();
 
 		if (Core::GameObject* gameObject = Core::App::Get().GetEditorUIManager().GetInspector().GetGameObjectSelected())
 		{
@@ -896,16 +954,14 @@ void Core::Scene::ReadSceneFile(std::string filePath)
 
 GameObject* Core::Scene::GetObjectByID(uint64_t ID)
 {
-	GameObject* null = nullptr;
 	if (ID == 0)
-		return null;
+		return nullptr;
 
-	if (m_objectMap.count(ID))
-	{
-		return m_objectMap[ID];
-	}
+	auto it = m_objectMap.find(ID);
+	if (it != m_objectMap.end())
+		return it->second;
 
-	return null;
+	return nullptr;
 }
 
 GameObject* Core::Scene::GetObjectByName(std::string_view name)
@@ -975,6 +1031,10 @@ void Core::Scene::LoadAllScenesResources(std::fstream& sceneFile)
 			if (getline(sceneFile, line) && line != "end")
 				Resources::ResourcesManager::Get()->GetOrLoad<Resources::VertexShader>(line);
 			break;
+		case Resources::ResourcesType::ComputeShader:
+			if (getline(sceneFile, line) && line != "end")
+				Resources::ResourcesManager::Get()->GetOrLoad<Resources::ComputeShader>(line);
+			break;
 		case Resources::ResourcesType::Shader:
 			if (getline(sceneFile, line) && line != "end")
 				ParseShaderName(line);
@@ -13,11 +13,23 @@ ThreadManager::ThreadManager(const int& maxThread)
         std::thread thread {&ThreadManager::Life, this};
         m_threadList.push_back(std::move(thread));
     }
+
+    // The thread calling ParallelFor is the last worker
+    for (int i = 0; i < m_maxThreads - 1; i++)
+        m_jobThreads.emplace_back(&ThreadManager::JobLife, this);
 }
 
 ThreadManager::~ThreadManager()
 {
-    m_shouldStopThreads.store(true);
+    {
+        std::lock_guard lock(m_jobMutex);
+        m_shouldStopThreads.store(true);
+    }
+    m_jobStart.notify_all();
+    for (std::thread& curThread : m_jobThreads)
+        curThread.join();
+    m_jobThreads.clear();
+
     for (std::thread& curThread : m_threadList)
         curThread.join();
 
@@ -57,6 +69,70 @@ void ThreadManager::Life()
     }
 }
 
+void ThreadManager::JobLife()
+{
+    uint64_t generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock lock(m_jobMutex);
+            m_jobStart.wait(lock, [&] { return m_shouldStopThreads || m_jobGeneration != generation; });
+            if (m_shouldStopThreads)
+                return;
+            generation = m_jobGeneration;
+            m_jobWorkers++;
+        }
+
+        while (RunJobBatch()) {}
+
+        {
+            std::lock_guard lock(m_jobMutex);
+            m_jobWorkers--;
+        }
+        m_jobDone.notify_all();
+    }
+}
+
+bool ThreadManager::RunJobBatch()
+{
+    size_t begin = m_jobNext.fetch_add(m_jobBatch);
+    if (begin >= m_jobCount)
+        return false;
+    (*m_job)(begin, std::min(begin + m_jobBatch, m_jobCount));
+    return true;
+}
+
+void ThreadManager::ParallelFor(size_t count, size_t batchSize, const std::function<void(size_t begin, size_t end)>& job)
+{
+    if (count == 0)
+        return;
+    batchSize = std::max<size_t>(batchSize, 1);
+    if (m_jobThreads.empty() || count <= batchSize)
+    {
+        job(0, count);
+        return;
+    }
+
+    {
+        // Threads still leaving the previous job would read the new one half written
+        std::unique_lock lock(m_jobMutex);
+        m_jobDone.wait(lock, [&] { return m_jobWorkers == 0; });
+        m_job = &job;
+        m_jobCount = count;
+        m_jobBatch = batchSize;
+        m_jobNext = 0;
+        m_jobGeneration++;
+    }
+    m_jobStart.notify_all();
+
+    while (RunJobBatch()) {}
+
+    // Every batch is taken, wait for the ones still running
+    std::unique_lock lock(m_jobMutex);
+    m_jobDone.wait(lock, [&] { return m_jobWorkers == 0; });
+    m_job = nullptr;
+}
+
 void ThreadManager::Lock()
 {
 #ifdef MULTITHREAD
@@ -0,0 +1,73 @@
+#include "pch.h"
+#include <Core/Wrappers/RHIBackend.h>
+
+using namespace Core::Wrapper::WrapperRHI;
+
+size_t BackendStats::GetDrawCalls() const
+{
+	return GetCount(CommandType::Draw) + GetCount(CommandType::DrawIndirect);
+}
+
+size_t BackendStats::GetStateChanges() const
+{
+	size_t changes = 0;
+	for (CommandType type : { CommandType::BindProgram, CommandType::BindVertexArray, CommandType::BindBuffer, CommandType::BindTexture,
+		CommandType::BindFramebuffer, CommandType::SetState, CommandType::SetViewport })
+		changes += GetCount(type);
+	return changes;
+}
+
+void NullBackend::Submit(const Command& command)
+{
+	stats.commands[(size_t)command.type]++;
+	switch (command.type)
+	{
+	case CommandType::Draw:
+		stats.vertices += command.count * std::max<size_t>(command.instances, 1);
+		stats.instances += command.instances;
+		break;
+	case CommandType::Uniform:
+		stats.uniformBytes += command.bytes;
+		break;
+	case CommandType::BufferUpload:
+	case CommandType::BufferCopy:
+		stats.bufferBytes += command.bytes;
+		break;
+	case CommandType::TextureUpload:
+		stats.textureBytes += command.bytes;
+		break;
+	default:
+		break;
+	}
+	if (recording)
+		commands.push_back(command);
+}
+
+int NullBackend::GetUniformLocation(unsigned int program, const char* name)
+{
+	std::unordered_map<std::string, int>& locations = m_locations[program];
+	auto it = locations.find(name);
+	if (it != locations.end())
+		return it->second;
+	int location = (int)locations.size();
+	locations.emplace(name, location);
+	return location;
+}
+
+void* NullBackend::MapBuffer(unsigned int buffer, size_t size)
+{
+	std::vector<char>& memory = m_mappedBuffers[buffer];
+	memory.resize(size);
+	return memory.data();
+}
+
+void NullBackend::UnmapBuffer(unsigned int buffer)
+{
+	m_mappedBuffers.erase(buffer);
+}
+
+void NullBackend::Reset()
+{
+	stats = BackendStats();
+	commands.clear();
+}
@@ -6,6 +6,7 @@
 #include <Core/Scene.h>
 #include <Core/SceneManager.h>
 #include <Core/GameObject.h>
+#include <Scripting/ScriptScheduler.h>
 #ifndef PANDOR_GAME
 #include <EditorUI/EditorUIManager.h>
 #include <EditorUI/SceneWindow.h>
@@ -391,6 +392,9 @@ void Core::Wrapper::WrapperPhysic::PhysicManager::Update()
 		physx::PxTransform globalPos = body->getGlobalPose();
 		rb->gameObject->transform->SetWorldTransform(ToVector3(globalPos.p), ToQuaternion(globalPos.q), false);
 	}
+
+	// Resume the coroutines waiting for the physic step
+	Scripting::ScriptScheduler::FixedUpdate();
 }
 
 void Core::Wrapper::WrapperPhysic::PhysicManager::CreateRigidbody(Component::Rigidbody* rb)
@@ -626,6 +630,28 @@ bool Core::Wrapper::WrapperPhysic::PhysicManager::RayCast(const Math::Vector3& o
 	hit = ToRayCastHit(hitBuffer);
 	return true;
 }
+void Core::Wrapper::WrapperPhysic::PhysicManager::RayCastBatch(const RayQuery* rays, size_t count, RayQueryHit* hits) const
+{
+	if (!m_scene)
+	{
+		for (size_t i = 0; i < count; i++)
+			hits[i] = RayQueryHit();
+		return;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		physx::PxRaycastBuffer hitBuffer;
+		RayQueryHit& hit = hits[i];
+		hit.hit = m_scene->raycast(ToPxVec3(rays[i].origin), ToPxVec3(rays[i].direction), rays[i].distance, hitBuffer) && hitBuffer.hasBlock;
+		if (!hit.hit)
+			continue;
+		hit.distance = hitBuffer.block.distance;
+		hit.position = ToVector3(hitBuffer.block.position);
+		hit.normal = ToVector3(hitBuffer.block.normal);
+		hit.shape = hitBuffer.block.shape;
+	}
+}
+
 Physic::RaycastHit Core::Wrapper::WrapperPhysic::PhysicManager::ToRayCastHit(const physx::PxRaycastBuffer& hit)
 {
 	Physic::RaycastHit raycastHit;
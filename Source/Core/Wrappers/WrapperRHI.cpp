@@ -16,17 +16,231 @@
 using namespace Core::Wrapper;
 using namespace Core::Wrapper::WrapperRHI;
 
+// Plugged backend, OpenGL when null
+static Backend* s_backend = nullptr;
+
+// The command went to the plugged backend instead of OpenGL
+static bool Forward(const Command& command)
+{
+	if (!s_backend)
+		return false;
+	s_backend->Submit(command);
+	return true;
+}
+
+void Core::Wrapper::WrapperRHI::SetBackend(Backend* backend)
+{
+	s_backend = backend;
+	InvalidateStateCache();
+}
+
+Backend* Core::Wrapper::WrapperRHI::GetBackend()
+{
+	return s_backend;
+}
+
+// Last state sent to OpenGL, the calls setting it again are skipped
+// A state changed without the functions below is unknown until InvalidateStateCache
+struct StateCache
+{
+	static constexpr unsigned int Unknown = 0xFFFFFFFF;
+	static constexpr unsigned int TextureUnits = 16;
+
+	unsigned int program = Unknown;
+	unsigned int vertexArray = Unknown;
+	unsigned int activeUnit = Unknown;
+	// Per unit, the 2D and cube map bindings are separate
+	unsigned int textures[TextureUnits];
+	unsigned int cubeMaps[TextureUnits];
+	// 0 disabled, 1 enabled
+	unsigned int depthTest = Unknown;
+	unsigned int stencilTest = Unknown;
+	unsigned int cullFace = Unknown;
+	unsigned int blend = Unknown;
+	unsigned int polygonMode = Unknown;
+	// Unknown while the size is negative
+	int viewport[4] = { 0, 0, -1, -1 };
+};
+static StateCache s_state;
+static bool s_validateState = false;
+
+void Core::Wrapper::WrapperRHI::InvalidateStateCache()
+{
+	s_state = StateCache();
+	std::fill(std::begin(s_state.textures), std::end(s_state.textures), StateCache::Unknown);
+	std::fill(std::begin(s_state.cubeMaps), std::end(s_state.cubeMaps), StateCache::Unknown);
+}
+
+void Core::Wrapper::WrapperRHI::SetStateValidation(bool enabled)
+{
+	s_validateState = enabled;
+}
+
+static void SetProgram(unsigned int ID)
+{
+	if (s_state.program == ID)
+		return;
+	s_state.program = ID;
+	if (Forward({ CommandType::BindProgram, ID }))
+		return;
+	glUseProgram(ID);
+}
+
+static void SetVertexArray(unsigned int VAO)
+{
+	if (s_state.vertexArray == VAO)
+		return;
+	s_state.vertexArray = VAO;
+	if (Forward({ CommandType::BindVertexArray, VAO }))
+		return;
+	glBindVertexArray(VAO);
+}
+
+static void SetActiveUnit(unsigned int unit)
+{
+	if (s_state.activeUnit == unit)
+		return;
+	s_state.activeUnit = unit;
+	if (Forward({ CommandType::SetState }))
+		return;
+	glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+// Binds to the active unit, the other targets are always sent
+static void SetTexture(unsigned int type, unsigned int ID)
+{
+	unsigned int* binding = nullptr;
+	if (s_state.activeUnit < StateCache::TextureUnits)
+	{
+		if (type == GL_TEXTURE_2D)
+			binding = &s_state.textures[s_state.activeUnit];
+		else if (type == GL_TEXTURE_CUBE_MAP)
+			binding = &s_state.cubeMaps[s_state.activeUnit];
+	}
+	if (binding)
+	{
+		if (*binding == ID)
+			return;
+		*binding = ID;
+	}
+	if (Forward({ CommandType::BindTexture, ID }))
+		return;
+	glBindTexture(type, ID);
+}
+
+// OpenGL unbinds the deleted textures and can give their names again
+static void ForgetTexture(unsigned int ID)
+{
+	for (unsigned int unit = 0; unit < StateCache::TextureUnits; unit++)
+	{
+		if (s_state.textures[unit] == ID)
+			s_state.textures[unit] = 0;
+		if (s_state.cubeMaps[unit] == ID)
+			s_state.cubeMaps[unit] = 0;
+	}
+}
+
+static void SetCapability(unsigned int capability, unsigned int& cached, bool enabled)
+{
+	if (cached == (unsigned int)enabled)
+		return;
+	cached = enabled;
+	if (Forward({ CommandType::SetState }))
+		return;
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+}
+
+static void SetPolygonMode(unsigned int mode)
+{
+	if (s_state.polygonMode == mode)
+		return;
+	s_state.polygonMode = mode;
+	if (Forward({ CommandType::SetState }))
+		return;
+	glPolygonMode(GL_FRONT_AND_BACK, mode);
+}
+
+static void SetViewport(int x, int y, int width, int height)
+{
+	int* viewport = s_state.viewport;
+	if (viewport[0] == x && viewport[1] == y && viewport[2] == width && viewport[3] == height)
+		return;
+	viewport[0] = x;
+	viewport[1] = y;
+	viewport[2] = width;
+	viewport[3] = height;
+	if (Forward({ CommandType::SetViewport }))
+		return;
+	glViewport(x, y, width, height);
+}
+
+// Reads back the whole cached state, only when the validation is enabled
+static void ValidateStateCache()
+{
+	auto check = [](const char* name, unsigned int cached, int actual)
+		{
+			if (cached != StateCache::Unknown && cached != (unsigned int)actual)
+				PrintError("State cache : %s is %d in OpenGL, %d in the cache", name, actual, cached);
+		};
+
+	GLint value;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &value);
+	check("program", s_state.program, value);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &value);
+	check("vertex array", s_state.vertexArray, value);
+	GLint activeTexture;
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+	check("active texture unit", s_state.activeUnit, activeTexture - GL_TEXTURE0);
+	for (unsigned int unit = 0; unit < StateCache::TextureUnits; unit++)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glGetIntegerv(GL_TEXTURE_BINDING_2D, &value);
+		check(("texture 2D of unit " + std::to_string(unit)).c_str(), s_state.textures[unit], value);
+		glGetIntegerv(GL_TEXTURE_BINDING_CUBE_MAP, &value);
+		check(("cube map of unit " + std::to_string(unit)).c_str(), s_state.cubeMaps[unit], value);
+	}
+	glActiveTexture(activeTexture);
+	check("depth test", s_state.depthTest, glIsEnabled(GL_DEPTH_TEST));
+	check("stencil test", s_state.stencilTest, glIsEnabled(GL_STENCIL_TEST));
+	check("cull face", s_state.cullFace, glIsEnabled(GL_CULL_FACE));
+	check("blend", s_state.blend, glIsEnabled(GL_BLEND));
+	GLint polygonMode[2];
+	glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+	check("polygon mode", s_state.polygonMode, polygonMode[0]);
+	GLint viewport[4];
+	glGetIntegerv(GL_VIEWPORT, viewport);
+	if (s_state.viewport[2] >= 0 && std::memcmp(viewport, s_state.viewport, sizeof(viewport)) != 0)
+		PrintError("State cache : viewport is %d %d %d %d in OpenGL, %d %d %d %d in the cache", viewport[0], viewport[1], viewport[2], viewport[3],
+			s_state.viewport[0], s_state.viewport[1], s_state.viewport[2], s_state.viewport[3]);
+}
+
+// The cull and polygon modes are set before each draw instead of being restored after it
+static void BeginDraw(bool wireframe = false, bool cullface = true)
+{
+	SetCapability(GL_CULL_FACE, s_state.cullFace, cullface);
+	SetPolygonMode(wireframe ? GL_LINE : GL_FILL);
+	if (s_validateState && !s_backend)
+		ValidateStateCache();
+}
+
 // =============================================[Shader]============================================== \\
 
 // Use Shader
 void Core::Wrapper::WrapperRHI::ShaderUse(unsigned int& ID)
 {
-	glUseProgram(ID);
+	SetProgram(ID);
 }
 
 // Delete Shader
 void Core::Wrapper::WrapperRHI::ShaderDelete(unsigned int& ID)
 {
+	if (s_state.program == ID)
+		s_state.program = StateCache::Unknown;
+	if (Forward({ CommandType::Delete, ID }))
+		return;
 	glDeleteProgram(ID);
 }
 
@@ -35,6 +249,8 @@ void Core::Wrapper::WrapperRHI::ShaderDelete(unsigned int& ID)
 
 void Core::Wrapper::WrapperRHI::ShaderSendSampler(const int shaderData, const char* name, const int value)
 {
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(int) }))
+		return;
 	glUniform1i(glGetUniformLocation(shaderData, name), value);
 }
 
@@ -42,11 +258,15 @@ void Core::Wrapper::WrapperRHI::ShaderSendSampler(int location, const int value)
 {
 	if (location == -1)
 		return;
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(int) }))
+		return;
 	glUniform1i(location, value);
 }
 
 void Core::Wrapper::WrapperRHI::ShaderSendInt(const int shaderData, const char* name, const int value)
 {
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(int) }))
+		return;
 	glUniform1i(glGetUniformLocation(shaderData, name), value);
 }
 
@@ -54,11 +274,15 @@ void Core::Wrapper::WrapperRHI::ShaderSendInt(int location, const int value)
 {
 	if (location == -1)
 		return;
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(int) }))
+		return;
 	glUniform1i(location, value);
 }
 
 void Core::Wrapper::WrapperRHI::ShaderSendFloat(const int shaderData, const char* name, const float value)
 {
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(float) }))
+		return;
 	glUniform1fv(glGetUniformLocation(shaderData, name), 1, &value);
 }
 
@@ -66,11 +290,15 @@ void Core::Wrapper::WrapperRHI::ShaderSendFloat(int location, const float value)
 {
 	if (location == -1)
 		return;
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(float) }))
+		return;
 	glUniform1f(location, value);
 }
 
 void Core::Wrapper::WrapperRHI::ShaderSendVec2(const int shaderProgram, const char* name, const Math::Vector2& value)
 {
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(value) }))
+		return;
 	glUniform2fv(glGetUniformLocation(shaderProgram, name), 1, &value.x);
 }
 
@@ -78,11 +306,15 @@ void Core::Wrapper::WrapperRHI::ShaderSendVec2(int location, const Math::Vector2
 {
 	if (location == -1)
 		return;
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(value) }))
+		return;
 	glUniform2fv(location, 1, &value.x);
 }
 
 void Core::Wrapper::WrapperRHI::ShaderSendVec3(const int shaderData, const char* name, const Math::Vector3& value)
 {
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(value) }))
+		return;
 	glUniform3fv(glGetUniformLocation(shaderData, name), 1, &value.x);
 }
 
@@ -90,11 +322,15 @@ void Core::Wrapper::WrapperRHI::ShaderSendVec3(int location, const Math::Vector3
 {
 	if (location == -1)
 		return;
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(value) }))
+		return;
 	glUniform3fv(location, 1, &value.x);
 }
 
 void Core::Wrapper::WrapperRHI::ShaderSendVec4(const int shaderProgram, const char* name, const Math::Vector4& value)
 {
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(value) }))
+		return;
 	glUniform4fv(glGetUniformLocation(shaderProgram, name), 1, &value.x);
 }
 
@@ -102,11 +338,15 @@ void Core::Wrapper::WrapperRHI::ShaderSendVec4(int location, const Math::Vector4
 {
 	if (location == -1)
 		return;
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(value) }))
+		return;
 	glUniform4fv(location, 1, &value.x);
 }
 
 void Core::Wrapper::WrapperRHI::ShaderSendBool(const int shaderProgram, const char* name, const bool& value)
 {
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(int) }))
+		return;
 	glUniform1i(glGetUniformLocation(shaderProgram, name), value);
 }
 
@@ -114,11 +354,15 @@ void Core::Wrapper::WrapperRHI::ShaderSendBool(int location, const bool& value)
 {
 	if (location == -1)
 		return;
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(int) }))
+		return;
 	glUniform1i(location, value);
 }
 
 void Core::Wrapper::WrapperRHI::ShaderSendMat4(const int shaderData, const char* name, const Math::Matrix4& value, bool transpose /*= true*/)
 {
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(value) }))
+		return;
 	glUniformMatrix4fv(glGetUniformLocation(shaderData, name), 1, transpose, &value[0][0]);
 }
 
@@ -126,6 +370,8 @@ void Core::Wrapper::WrapperRHI::ShaderSendMat4(int location, const Math::Matrix4
 {
 	if (location == -1)
 		return;
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(value) }))
+		return;
 	glUniformMatrix4fv(location, 1, transpose, &value[0][0]);
 }
 
@@ -133,6 +379,8 @@ void Core::Wrapper::WrapperRHI::ShaderSendMat4(int location, const std::vector<M
 {
 	if (location == -1)
 		return;
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(Math::Matrix4) * count }))
+		return;
 	glUniformMatrix4fv(location, count, transpose, &value.data()[0][0][0]);
 }
 
@@ -143,41 +391,57 @@ void Core::Wrapper::WrapperRHI::ShaderSendMat4(int location, const std::vector<M
 
 void Core::Wrapper::WrapperRHI::ShaderGetSampler(const int shaderID, const int& index, int* value)
 {
+	if (Forward({ CommandType::Readback, (unsigned int)shaderID }))
+		return;
 	glGetUniformiv(shaderID, index, value);
 }
 
 void Core::Wrapper::WrapperRHI::ShaderGetInt(const int shaderID, const int& index, int* value)
 {
+	if (Forward({ CommandType::Readback, (unsigned int)shaderID }))
+		return;
 	glGetUniformiv(shaderID, index, value);
 }
 
 void Core::Wrapper::WrapperRHI::ShaderGetFloat(const int shaderID, const int& index, float* value)
 {
+	if (Forward({ CommandType::Readback, (unsigned int)shaderID }))
+		return;
 	glGetUniformfv(shaderID, index, value);
 }
 
 void Core::Wrapper::WrapperRHI::ShaderGetVec2(const int shaderID, const int& index, float* value)
 {
+	if (Forward({ CommandType::Readback, (unsigned int)shaderID }))
+		return;
 	glGetUniformfv(shaderID, index, value);
 }
 
 void Core::Wrapper::WrapperRHI::ShaderGetVec3(const int shaderID, const int& index, float* value)
 {
+	if (Forward({ CommandType::Readback, (unsigned int)shaderID }))
+		return;
 	glGetUniformfv(shaderID, index, value);
 }
 
 void Core::Wrapper::WrapperRHI::ShaderGetVec4(const int shaderID, const int& index, float* value)
 {
+	if (Forward({ CommandType::Readback, (unsigned int)shaderID }))
+		return;
 	glGetUniformfv(shaderID, index, value);
 }
 
 void Core::Wrapper::WrapperRHI::ShaderGetMat4(const int shaderID, const int& index, float* value)
 {
+	if (Forward({ CommandType::Readback, (unsigned int)shaderID }))
+		return;
 	glGetUniformfv(shaderID, index, value);
 }
 
 void Core::Wrapper::WrapperRHI::ShaderGetBool(const int shaderID, const int& index, bool* value)
 {
+	if (Forward({ CommandType::Readback, (unsigned int)shaderID }))
+		return;
 	int iBool = 0;
 	glGetUniformiv(shaderID, index, &iBool);
 	*value = iBool ? true : false;
@@ -194,6 +458,8 @@ void Core::Wrapper::WrapperRHI::ShaderGetBool(const int shaderID, const int& ind
 //Texture Uniform
 void Core::Wrapper::WrapperRHI::TextureData(Resources::Shader* shaderData, const char* name, unsigned int unit)
 {
+	if (Forward({ CommandType::Uniform, 0, 0, 0, sizeof(int) }))
+		return;
 	GLuint texUni = glGetUniformLocation(shaderData->ID, name);
 	shaderData->Use();
 	glUniform1i(texUni, unit);
@@ -202,26 +468,35 @@ void Core::Wrapper::WrapperRHI::TextureData(Resources::Shader* shaderData, const
 //Bind Texture
 void Core::Wrapper::WrapperRHI::TextureBind(unsigned int ID, unsigned int type /*= PR_TEXTURE2D*/)
 {
-	glBindTexture(type, ID);
+	SetTexture(type, ID);
 }
 
 //Unbind Texture
 void Core::Wrapper::WrapperRHI::TextureUnBind(unsigned int type)
 {
-	glBindTexture(type, 0);
+	SetTexture(type, 0);
 }
 
 //Texture Delete
 void Core::Wrapper::WrapperRHI::TextureDelete(unsigned int& ID)
 {
+	ForgetTexture(ID);
+	if (Forward({ CommandType::Delete, ID }))
+		return;
 	glDeleteTextures(1, &ID);
 }
 
 void Core::Wrapper::WrapperRHI::SendTexture(unsigned int& ID, unsigned int format, unsigned int texType, unsigned int slot, unsigned int pixelType, const int& widthImg, const int& heightImg, unsigned char* bytes, int filter /*= PR_NEAREST*/)
 {
-	glActiveTexture(GL_TEXTURE0 + slot);
+	if (s_backend)
+	{
+		ID = s_backend->CreateObject();
+		Forward({ CommandType::TextureUpload, ID, 0, 0, (size_t)widthImg * heightImg * (format == GL_RGBA ? 4 : 3) });
+		return;
+	}
+	SetActiveUnit(slot);
 	glGenTextures(1, &ID);
-	glBindTexture(texType, ID);
+	SetTexture(texType, ID);
 
 	glTexParameteri(texType, GL_TEXTURE_MIN_FILTER, filter);
 	glTexParameteri(texType, GL_TEXTURE_MAG_FILTER, filter);
@@ -232,14 +507,45 @@ void Core::Wrapper::WrapperRHI::SendTexture(unsigned int& ID, unsigned int forma
 	glTexImage2D(texType, 0, format, widthImg, heightImg, 0, format, pixelType, bytes);
 	glGenerateMipmap(texType);
 
-	glBindTexture(texType, 0);
+	SetTexture(texType, 0);
+}
+
+void Core::Wrapper::WrapperRHI::SendFloatTexture(unsigned int& ID, int width, int height, const float* data)
+{
+	if (s_backend)
+	{
+		if (!ID)
+			ID = s_backend->CreateObject();
+		Forward({ CommandType::TextureUpload, ID, 0, 0, (size_t)width * height * sizeof(float[4]) });
+		return;
+	}
+	if (!ID)
+		glGenTextures(1, &ID);
+	SetTexture(GL_TEXTURE_2D, ID);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, height, 0, GL_RGBA, GL_FLOAT, data);
+
+	SetTexture(GL_TEXTURE_2D, 0);
 }
 
 void Core::Wrapper::WrapperRHI::GenVertex(unsigned int& VAO, unsigned int& VBO, float vertices[], std::size_t size)
 {
+	if (s_backend)
+	{
+		VAO = s_backend->CreateObject();
+		VBO = s_backend->CreateObject();
+		Forward({ CommandType::BufferUpload, VBO, 0, 0, size * sizeof(float) });
+		return;
+	}
 	glGenVertexArrays(1, &VAO);
 	glGenBuffers(1, &VBO);
-	glBindVertexArray(VAO);
+	SetVertexArray(VAO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBufferData(GL_ARRAY_BUFFER, size * sizeof(float), vertices, GL_STATIC_DRAW);
 	glEnableVertexAttribArray(0);
@@ -248,11 +554,13 @@ void Core::Wrapper::WrapperRHI::GenVertex(unsigned int& VAO, unsigned int& VBO,
 
 void Core::Wrapper::WrapperRHI::BindVAO(unsigned int& VAO)
 {
-	glBindVertexArray(VAO);
+	SetVertexArray(VAO);
 }
 
 void Core::Wrapper::WrapperRHI::SetDephtFunc(bool value)
 {
+	if (Forward({ CommandType::SetState }))
+		return;
 	if (value)
 		glDepthFunc(GL_LEQUAL);
 	else
@@ -271,8 +579,14 @@ void copyPixels(unsigned char* src, unsigned char* dst, int faceWidth, int faceH
 
 void Core::Wrapper::WrapperRHI::SendCubeMap(unsigned int& ID, int texWidth, int texHeight, int nrChannels, unsigned char* texData)
 {
+	if (s_backend)
+	{
+		ID = s_backend->CreateObject();
+		Forward({ CommandType::TextureUpload, ID, 0, 0, (size_t)(texWidth / 4) * (texHeight / 3) * nrChannels * 6 });
+		return;
+	}
 	glGenTextures(1, &ID);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, ID);
+	SetTexture(GL_TEXTURE_CUBE_MAP, ID);
 
 	int faceWidth = texWidth / 4;
 	int faceHeight = texHeight / 3;
@@ -317,8 +631,17 @@ void Core::Wrapper::WrapperRHI::SendCubeMap(unsigned int& ID, int texWidth, int
 
 void Core::Wrapper::WrapperRHI::SendSixSided(unsigned int& ID, int texWidths[6], int texHeights[6], unsigned char* texData[6])
 {
+	if (s_backend)
+	{
+		ID = s_backend->CreateObject();
+		size_t bytes = 0;
+		for (int i = 0; i < 6; i++)
+			bytes += (size_t)texWidths[i] * texHeights[i] * 3;
+		Forward({ CommandType::TextureUpload, ID, 0, 0, bytes });
+		return;
+	}
 	glGenTextures(1, &ID);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, ID);
+	SetTexture(GL_TEXTURE_CUBE_MAP, ID);
 
 	for (int i = 0; i < 6; i++)
 		glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, texWidths[i], texHeights[i], 0, GL_RGB, GL_UNSIGNED_BYTE, texData[i]);
@@ -332,6 +655,13 @@ void Core::Wrapper::WrapperRHI::SendSixSided(unsigned int& ID, int texWidths[6],
 
 bool Core::Wrapper::WrapperRHI::SendShader(std::string& vertShader, std::string& fragShader, unsigned int& ID, Resources::Shader* shader)
 {
+	// Nothing is compiled, the uniform locations come from the backend
+	if (s_backend)
+	{
+		ID = s_backend->CreateObject();
+		Forward({ CommandType::Create, ID });
+		return true;
+	}
 	const char* vFile = vertShader.c_str();
 	const char* fFile = fragShader.c_str();
 
@@ -386,8 +716,95 @@ bool Core::Wrapper::WrapperRHI::SendShader(std::string& vertShader, std::string&
 	return true;
 }
 
+bool Core::Wrapper::WrapperRHI::SendComputeShader(std::string& computeShader, unsigned int& ID, const std::string& path)
+{
+	if (s_backend)
+	{
+		ID = s_backend->CreateObject();
+		Forward({ CommandType::Create, ID });
+		return true;
+	}
+	const char* cFile = computeShader.c_str();
+
+	GLuint m_computeShader = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(m_computeShader, 1, &cFile, NULL);
+	glCompileShader(m_computeShader);
+
+	int success;
+	char infoLog[512];
+	glGetShaderiv(m_computeShader, GL_COMPILE_STATUS, &success);
+	if (!success)
+	{
+		glGetShaderInfoLog(m_computeShader, 512, NULL, infoLog);
+		PrintError("ERROR::SHADER::COMPUTE::COMPILATION_FAILED %s", infoLog);
+		glDeleteShader(m_computeShader);
+		return false;
+	}
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, m_computeShader);
+	glLinkProgram(program);
+	glDeleteShader(m_computeShader);
+
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success) {
+		glGetProgramInfoLog(program, 512, NULL, infoLog);
+		PrintError("ERROR::SHADER::PROGRAM::LINKING_FAILED %s", infoLog);
+		glDeleteProgram(program);
+		return false;
+	}
+	// The previous program stays in use until the new one links
+	if (ID)
+	{
+		if (s_state.program == ID)
+			s_state.program = StateCache::Unknown;
+		glDeleteProgram(ID);
+	}
+	ID = program;
+	PrintLog("Successfully link Compute Shader %s", path.c_str());
+	return true;
+}
+
+void Core::Wrapper::WrapperRHI::DispatchCompute(unsigned int groupsX, unsigned int groupsY /*= 1*/, unsigned int groupsZ /*= 1*/)
+{
+	if (Forward({ CommandType::Dispatch, 0, (size_t)groupsX * groupsY * groupsZ }))
+		return;
+	glDispatchCompute(groupsX, groupsY, groupsZ);
+}
+
+void Core::Wrapper::WrapperRHI::DispatchComputeIndirect(size_t offset)
+{
+	if (Forward({ CommandType::Dispatch }))
+		return;
+	glDispatchComputeIndirect((GLintptr)offset);
+}
+
+void Core::Wrapper::WrapperRHI::ComputeBarrier(bool beforeDraw /*= false*/)
+{
+	if (Forward({ CommandType::Barrier }))
+		return;
+	GLbitfield barriers = GL_SHADER_STORAGE_BARRIER_BIT;
+	if (beforeDraw)
+		barriers |= GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT;
+	glMemoryBarrier(barriers);
+}
+
+bool Core::Wrapper::WrapperRHI::SupportsCompute()
+{
+	// The compute paths are measured as well
+	if (s_backend)
+		return true;
+	return GLAD_GL_VERSION_4_3;
+}
+
 void Core::Wrapper::WrapperRHI::GetAllUniform(Resources::Shader* shaderData)
 {
+	// No uniform can be listed without a program
+	if (Forward({ CommandType::Readback, shaderData->ID }))
+	{
+		shaderData->SetUniformSet();
+		return;
+	}
 	Vector3 v = { 1,1,1 };
 	ShaderSendVec3(shaderData->ID, "testV", v);
 	// Get total number of uniforms
@@ -433,8 +850,16 @@ void Core::Wrapper::WrapperRHI::GetAllUniform(Resources::Shader* shaderData)
 
 Core::Wrapper::WrapperRHI::Buffer::Buffer(float* vertices, size_t numVertices, unsigned int* indices, size_t numIndices)
 {
+	if (s_backend)
+	{
+		VertexArray = s_backend->CreateObject();
+		VertexBuffer = s_backend->CreateObject();
+		IndexBuffer = s_backend->CreateObject();
+		Forward({ CommandType::BufferUpload, VertexBuffer, 0, 0, numVertices * sizeof(float) + numIndices * sizeof(unsigned int) });
+		return;
+	}
 	glGenVertexArrays(1, &VertexArray);
-	glBindVertexArray(VertexArray);
+	SetVertexArray(VertexArray);
 
 	glGenBuffers(1, &VertexBuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
@@ -447,8 +872,15 @@ Core::Wrapper::WrapperRHI::Buffer::Buffer(float* vertices, size_t numVertices, u
 
 Core::Wrapper::WrapperRHI::Buffer::Buffer(float* vertices, size_t numVertices)
 {
+	if (s_backend)
+	{
+		VertexArray = s_backend->CreateObject();
+		VertexBuffer = s_backend->CreateObject();
+		Forward({ CommandType::BufferUpload, VertexBuffer, 0, 0, numVertices * sizeof(float) });
+		return;
+	}
 	glGenVertexArrays(1, &VertexArray);
-	glBindVertexArray(VertexArray);
+	SetVertexArray(VertexArray);
 
 	glGenBuffers(1, &VertexBuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
@@ -457,72 +889,272 @@ Core::Wrapper::WrapperRHI::Buffer::Buffer(float* vertices, size_t numVertices)
 
 void Core::Wrapper::WrapperRHI::Buffer::BufferSubData(unsigned int offset, size_t size, const void* data)
 {
+	if (Forward({ CommandType::BufferUpload, VertexBuffer, 0, 0, size }))
+		return;
 	glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
 }
 
 void Core::Wrapper::WrapperRHI::Buffer::BufferData(size_t size, const void* data)
 {
+	if (Forward({ CommandType::BufferUpload, VertexBuffer, 0, 0, size }))
+		return;
 	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, size, data, GL_DYNAMIC_DRAW);
 }
 
+void Buffer::CopyData(const Buffer& source, size_t sourceOffset, const Buffer& destination, size_t destinationOffset, size_t size)
+{
+	if (Forward({ CommandType::BufferCopy, destination.VertexBuffer, 0, 0, size }))
+		return;
+	glCopyNamedBufferSubData(source.VertexBuffer, destination.VertexBuffer, sourceOffset, destinationOffset, size);
+}
+
+void Buffer::GenStreamBuffer(size_t regionSize)
+{
+	StreamRegionSize = regionSize;
+	StreamRegion = 0;
+	if (s_backend)
+	{
+		VertexBuffer = s_backend->CreateObject();
+		StreamData = s_backend->MapBuffer(VertexBuffer, regionSize * StreamRegionCount);
+		Forward({ CommandType::Create, VertexBuffer, 0, 0, regionSize * StreamRegionCount });
+		return;
+	}
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &VertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+	glBufferStorage(GL_ARRAY_BUFFER, regionSize * StreamRegionCount, nullptr, flags);
+	StreamData = glMapBufferRange(GL_ARRAY_BUFFER, 0, regionSize * StreamRegionCount, flags);
+	if (!StreamData)
+		PrintError("Failed to map the stream buffer %d", VertexBuffer);
+}
+
+void* Buffer::NextStreamRegion()
+{
+	if (!StreamData)
+		return nullptr;
+	// Nothing reads the regions, no need to fence them
+	if (s_backend)
+	{
+		StreamRegion = (StreamRegion + 1) % StreamRegionCount;
+		return (char*)StreamData + StreamOffset();
+	}
+	// The draws reading the current region are already submitted
+	if (StreamFences[StreamRegion])
+		glDeleteSync((GLsync)StreamFences[StreamRegion]);
+	StreamFences[StreamRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	StreamRegion = (StreamRegion + 1) % StreamRegionCount;
+	if (GLsync fence = (GLsync)StreamFences[StreamRegion])
+	{
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		while (result == GL_TIMEOUT_EXPIRED)
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		glDeleteSync(fence);
+		StreamFences[StreamRegion] = nullptr;
+	}
+	return (char*)StreamData + StreamOffset();
+}
+
 void Buffer::GenVertexBuffer()
 {
+	if (s_backend)
+	{
+		VertexBuffer = s_backend->CreateObject();
+		Forward({ CommandType::BindBuffer, VertexBuffer });
+		return;
+	}
 	glGenBuffers(1, &VertexBuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
 }
 
 void Buffer::AttribDivisor(unsigned int index, unsigned int divisor)
 {
+	if (Forward({ CommandType::SetState, VertexArray }))
+		return;
 	glVertexAttribDivisor(index, divisor);
 }
 
 void Buffer::InitializePlane()
 {
+	if (s_backend)
+	{
+		VertexArray = s_backend->CreateObject();
+		VertexBuffer = s_backend->CreateObject();
+		Forward({ CommandType::Create, VertexBuffer, 0, 0, sizeof(float) * 6 * 4 });
+		return;
+	}
 	glGenVertexArrays(1, &VertexArray);
 	glGenBuffers(1, &VertexBuffer);
-	glBindVertexArray(VertexArray);
+	SetVertexArray(VertexArray);
 	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
 	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	SetVertexArray(0);
 }
 
 void Buffer::UnbindVertexBuffer()
 {
+	if (Forward({ CommandType::BindBuffer }))
+		return;
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void Buffer::BindVertexBuffer()
 {
+	if (Forward({ CommandType::BindBuffer, VertexBuffer }))
+		return;
 	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
 }
 
 void Buffer::LinkAttribute(unsigned int layout, unsigned int numComponents, unsigned int type, unsigned int stride, void* offset)
 {
+	if (Forward({ CommandType::SetState, VertexArray }))
+		return;
 	glVertexAttribPointer(layout, numComponents, type, GL_FALSE, stride, offset);
 	glEnableVertexAttribArray(layout);
 }
 
 void Buffer::Bind()
 {
-	glBindVertexArray(VertexArray);
+	SetVertexArray(VertexArray);
 }
 
 void Buffer::Unbind()
 {
-	glBindVertexArray(0);
+	SetVertexArray(0);
 }
 
 void Buffer::Delete()
 {
+	if (s_state.vertexArray == VertexArray)
+		s_state.vertexArray = 0;
+	if (s_backend)
+	{
+		if (StreamData)
+			s_backend->UnmapBuffer(VertexBuffer);
+		StreamData = nullptr;
+		Forward({ CommandType::Delete, VertexBuffer });
+		return;
+	}
+	for (void*& fence : StreamFences)
+	{
+		if (fence)
+			glDeleteSync((GLsync)fence);
+		fence = nullptr;
+	}
+	if (StreamData)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		StreamData = nullptr;
+	}
 	glDeleteBuffers(1, &VertexBuffer);
 	glDeleteBuffers(1, &IndexBuffer);
 	glDeleteVertexArrays(1, &VertexArray);
 }
 
+void UniformBuffer::Generate(size_t size)
+{
+	if (s_backend)
+	{
+		if (!ID)
+			ID = s_backend->CreateObject();
+		Forward({ CommandType::Create, ID, 0, 0, size });
+		Size = size;
+		return;
+	}
+	if (!ID)
+		glGenBuffers(1, &ID);
+	glBindBuffer(GL_UNIFORM_BUFFER, ID);
+	glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	Size = size;
+}
+
+void UniformBuffer::SetData(size_t offset, size_t size, const void* data)
+{
+	if (Forward({ CommandType::BufferUpload, ID, 0, 0, size }))
+		return;
+	glBindBuffer(GL_UNIFORM_BUFFER, ID);
+	glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UniformBuffer::BindBase(unsigned int binding)
+{
+	if (Forward({ CommandType::BindBuffer, ID }))
+		return;
+	glBindBufferBase(GL_UNIFORM_BUFFER, binding, ID);
+}
+
+void UniformBuffer::Delete()
+{
+	if (ID && !Forward({ CommandType::Delete, ID }))
+		glDeleteBuffers(1, &ID);
+	ID = 0;
+	Size = 0;
+}
+
+void StorageBuffer::Generate(size_t size, const void* data /*= nullptr*/)
+{
+	if (s_backend)
+	{
+		if (!ID)
+			ID = s_backend->CreateObject();
+		Forward({ (data ? CommandType::BufferUpload : CommandType::Create), ID, 0, 0, size });
+		Size = size;
+		return;
+	}
+	if (!ID)
+		glGenBuffers(1, &ID);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ID);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, size, data, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	Size = size;
+}
+
+void StorageBuffer::SetData(size_t offset, size_t size, const void* data)
+{
+	if (Forward({ CommandType::BufferUpload, ID, 0, 0, size }))
+		return;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ID);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, offset, size, data);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void StorageBuffer::BindBase(unsigned int binding)
+{
+	if (Forward({ CommandType::BindBuffer, ID }))
+		return;
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, ID);
+}
+
+void StorageBuffer::BindVertexBuffer()
+{
+	if (Forward({ CommandType::BindBuffer, ID }))
+		return;
+	glBindBuffer(GL_ARRAY_BUFFER, ID);
+}
+
+void StorageBuffer::BindIndirect()
+{
+	if (Forward({ CommandType::BindBuffer, ID }))
+		return;
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ID);
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, ID);
+}
+
+void StorageBuffer::Delete()
+{
+	if (ID && !Forward({ CommandType::Delete, ID }))
+		glDeleteBuffers(1, &ID);
+	ID = 0;
+	Size = 0;
+}
+
 // =================================================================================================== \\
 
 
@@ -531,6 +1163,13 @@ void Buffer::Delete()
 //Initializes the GLAD library to load the OpenGL functions.
 void Core::Wrapper::WrapperRHI::InitializeAPI()
 {
+	InvalidateStateCache();
+	// No context to load the functions from
+	if (s_backend)
+	{
+		PrintLog("Rendering with the %s backend", s_backend->GetName());
+		return;
+	}
 	if (!gladLoadGLLoader((GLADloadproc)WrapperWindow::GetProcAddress)) {
 		PrintError("Failed to initialize GLAD");
 		return;
@@ -544,6 +1183,8 @@ void Core::Wrapper::WrapperRHI::InitializeAPI()
 //Enables debugging output for OpenGL error messages.
 void Core::Wrapper::WrapperRHI::EnableDebugOutput()
 {
+	if (Forward({ CommandType::SetState }))
+		return;
 	GLint flags;
 	glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
 	if (flags & GL_CONTEXT_FLAG_DEBUG_BIT) {
@@ -552,9 +1193,9 @@ void Core::Wrapper::WrapperRHI::EnableDebugOutput()
 		glDebugMessageCallback(DebugOutput, nullptr);
 		glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
 	}
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_CULL_FACE);
-	glEnable(GL_BLEND);
+	SetCapability(GL_DEPTH_TEST, s_state.depthTest, true);
+	SetCapability(GL_CULL_FACE, s_state.cullFace, true);
+	SetCapability(GL_BLEND, s_state.blend, true);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glCullFace(GL_BACK);
 }
@@ -574,17 +1215,19 @@ void Core::Wrapper::WrapperRHI::CreateBuffer(Buffer*& buffer, float* vertices, s
 
 void Core::Wrapper::WrapperRHI::DepthActive()
 {
-	glEnable(GL_DEPTH_TEST);
+	SetCapability(GL_DEPTH_TEST, s_state.depthTest, true);
 }
 
 void Core::Wrapper::WrapperRHI::DepthDisable()
 {
-	glDisable(GL_DEPTH_TEST);
+	SetCapability(GL_DEPTH_TEST, s_state.depthTest, false);
 }
 
 void Core::Wrapper::WrapperRHI::StencilActive()
 {
-	glEnable(GL_STENCIL_TEST);
+	SetCapability(GL_STENCIL_TEST, s_state.stencilTest, true);
+	if (Forward({ CommandType::Clear }))
+		return;
 	glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
 	glClearStencil(0);
 	glClear(GL_STENCIL_BUFFER_BIT);
@@ -592,6 +1235,8 @@ void Core::Wrapper::WrapperRHI::StencilActive()
 
 void Core::Wrapper::WrapperRHI::UseStencil()
 {
+	if (Forward({ CommandType::SetState }))
+		return;
 	glStencilFunc(GL_ALWAYS, 1, 0xFF);
 	glStencilMask(0xFF);
 }
@@ -600,31 +1245,38 @@ void Core::Wrapper::WrapperRHI::DrawStencil(Resources::Shader* shaderData, Vecto
 {
 	if (shaderData->HasBeenSent())
 	{
-		glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-		glStencilMask(0x00);
+		if (!Forward({ CommandType::SetState }))
+		{
+			glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
+			glStencilMask(0x00);
+		}
 		ShaderSendVec3(shaderData->GetLocation("OutlineColor"), Color);
 	}
 }
 
 void Core::Wrapper::WrapperRHI::MaskStencil()
 {
+	if (Forward({ CommandType::SetState }))
+		return;
 	glStencilMask(0xFF);
 	glStencilFunc(GL_ALWAYS, 0, 0xFF);
 }
 
 void Core::Wrapper::WrapperRHI::DisableStencil()
 {
-	glDisable(GL_STENCIL_TEST);
+	SetCapability(GL_STENCIL_TEST, s_state.stencilTest, false);
 }
 
 void Core::Wrapper::WrapperRHI::DepthRange(Vector2 r)
 {
+	if (Forward({ CommandType::SetState }))
+		return;
 	glDepthRange(r.x, r.y);
 }
 
 void Core::Wrapper::WrapperRHI::CameraData(Resources::Shader*& shaderData, const char* name, Math::Matrix4 MVP)
 {
-	if (shaderData->HasBeenSent())
+	if (shaderData->HasBeenSent() && !Forward({ CommandType::Uniform, 0, 0, 0, sizeof(MVP) }))
 		glUniformMatrix4fv(glGetUniformLocation(shaderData->ID, name), 1, GL_FALSE, &MVP[0][0]);
 }
 // =================================================================================================== \\
@@ -672,26 +1324,35 @@ void Core::Wrapper::WrapperRHI::DebugOutput(unsigned int source, unsigned int ty
 
 void Core::Wrapper::WrapperRHI::ViewPort(int x, int y, int sizeX, int sizeY)
 {
-	glViewport(x, y, sizeX, sizeY);
+	SetViewport(x, y, sizeX, sizeY);
 }
 
 const char* Core::Wrapper::WrapperRHI::GetVersion()
 {
+	if (s_backend)
+		return s_backend->GetName();
 	return (const char*)glGetString(GL_VERSION);
 }
 
 const char* Core::Wrapper::WrapperRHI::GetVendor()
 {
+	if (s_backend)
+		return s_backend->GetName();
 	return (const char*)glGetString(GL_VENDOR);
 }
 
 const char* Core::Wrapper::WrapperRHI::GetRenderer()
 {
+	if (s_backend)
+		return s_backend->GetName();
 	return (const char*)glGetString(GL_RENDERER);
 }
 
 void Core::Wrapper::WrapperRHI::DrawElements(int count)
 {
+	BeginDraw();
+	if (Forward({ CommandType::Draw, 0, (size_t)count }))
+		return;
 	glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_INT, 0);
 }
 
@@ -700,44 +1361,57 @@ void Core::Wrapper::WrapperRHI::DrawArrays(size_t start, size_t count, bool wire
 	Core::App::Get().drawCall += 1;
 	Core::App::Get().verticeCount += count;
 	Core::App::Get().triangleCount += count / 3;
-	int polygonMode;
-	// Enable Wire frame.
-	if (!cullface) {
-		glDisable(GL_CULL_FACE);
-		glGetIntegerv(GL_POLYGON_MODE, &polygonMode);
-	}
-	if (wireframe)
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	BeginDraw(wireframe, cullface);
+	if (Forward({ CommandType::Draw, 0, count }))
+		return;
 	glDrawArrays(GL_TRIANGLES, (GLsizei)start, (GLsizei)count);
-
-	if (!cullface) {
-		glEnable(GL_CULL_FACE);
-		glPolygonMode(GL_FRONT_AND_BACK, polygonMode);
-	}
-
-	if (wireframe)
-		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 }
 
 void Core::Wrapper::WrapperRHI::ClearColorAndBuffer(Vector4 clearColor)
 {
+	if (Forward({ CommandType::Clear }))
+		return;
 	glClearColor(clearColor.x, clearColor.y, clearColor.z, clearColor.w); //0.2f, 0.3f, 0.3f, 1.0f
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
 void Core::Wrapper::WrapperRHI::ClearColor(Vector4 clearColor)
 {
+	if (Forward({ CommandType::Clear }))
+		return;
 	glClearColor(clearColor.x, clearColor.y, clearColor.z, clearColor.w); //0.2f, 0.3f, 0.3f, 1.0f
 	glClear(GL_COLOR_BUFFER_BIT);
 }
 
 int Core::Wrapper::WrapperRHI::ShaderGetLocation(unsigned int& ID, const char* name)
 {
+	if (s_backend)
+		return s_backend->GetUniformLocation(ID, name);
 	return glGetUniformLocation(ID, name);
 }
 
+int Core::Wrapper::WrapperRHI::ShaderGetUniformBlock(unsigned int& ID, const char* name)
+{
+	// Every block is found, the uniform buffer paths are measured
+	if (s_backend)
+		return s_backend->GetUniformLocation(ID, name);
+	GLuint index = glGetUniformBlockIndex(ID, name);
+	return index == GL_INVALID_INDEX ? -1 : (int)index;
+}
+
+void Core::Wrapper::WrapperRHI::ShaderBindUniformBlock(unsigned int& ID, int blockIndex, unsigned int binding)
+{
+	if (blockIndex == -1)
+		return;
+	if (Forward({ CommandType::SetState, ID }))
+		return;
+	glUniformBlockBinding(ID, blockIndex, binding);
+}
+
 void Core::Wrapper::WrapperRHI::PushToGPU(unsigned char* data, int x, int y)
 {
+	if (Forward({ CommandType::Readback, 0, 0, 0, 4 }))
+		return;
 	glFlush();
 	glFinish();
 
@@ -747,16 +1421,25 @@ void Core::Wrapper::WrapperRHI::PushToGPU(unsigned char* data, int x, int y)
 
 void Core::Wrapper::WrapperRHI::PixelStore(unsigned int type, int value)
 {
+	if (Forward({ CommandType::SetState }))
+		return;
 	glPixelStorei(type, value);
 }
 
 void Core::Wrapper::WrapperRHI::GenerateTexture(unsigned int& tex)
 {
+	if (s_backend)
+	{
+		tex = s_backend->CreateObject();
+		return;
+	}
 	glGenTextures(1, &tex);
 }
 
 void Core::Wrapper::WrapperRHI::FontTexture(unsigned int width, unsigned int rows, unsigned char* buffer)
 {
+	if (Forward({ CommandType::TextureUpload, 0, 0, 0, (size_t)width * rows }))
+		return;
 	glTexImage2D(
 		GL_TEXTURE_2D,
 		0,
@@ -777,12 +1460,14 @@ void Core::Wrapper::WrapperRHI::FontTexture(unsigned int width, unsigned int row
 
 void Core::Wrapper::WrapperRHI::ActivateTexture(unsigned int index /*= 0*/)
 {
-	glActiveTexture(GL_TEXTURE0 + index);
+	SetActiveUnit(index);
 }
 
 void Core::Wrapper::WrapperRHI::UpdateTexture(unsigned int& ID, int filter /*= PR_NEAREST*/, int wrap /*= PR_REPEAT*/)
 {
-	glBindTexture(GL_TEXTURE_2D, ID);
+	if (Forward({ CommandType::SetState, ID }))
+		return;
+	SetTexture(GL_TEXTURE_2D, ID);
 
 	// Set the texture filter mode to nearest neighbor
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
@@ -792,20 +1477,33 @@ void Core::Wrapper::WrapperRHI::UpdateTexture(unsigned int& ID, int filter /*= P
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
 
 	// Unbind the texture
-	glBindTexture(GL_TEXTURE_2D, 0);
+	SetTexture(GL_TEXTURE_2D, 0);
 }
 
 void Core::Wrapper::WrapperRHI::DrawInstance(size_t first, size_t count, size_t number)
 {
+	BeginDraw();
+	if (Forward({ CommandType::Draw, 0, count, number }))
+		return;
 	glDrawArraysInstanced(GL_TRIANGLES, (GLint)first, (GLsizei)count, (GLsizei)number);
 }
 
+void Core::Wrapper::WrapperRHI::DrawInstanceIndirect(size_t offset)
+{
+	BeginDraw();
+	if (Forward({ CommandType::DrawIndirect }))
+		return;
+	glDrawArraysIndirect(GL_TRIANGLES, (const void*)offset);
+}
+
 Core::Wrapper::WrapperRHI::RenderBuffer::RenderBuffer()
 {
 }
 
 Core::Wrapper::WrapperRHI::RenderBuffer::~RenderBuffer()
 {
+	if (Forward({ CommandType::Delete, frameBuffer }))
+		return;
 	if (frameBuffer != 0)
 		glDeleteFramebuffers(1, &frameBuffer);
 	if (renderBuffer != 0)
@@ -814,19 +1512,32 @@ Core::Wrapper::WrapperRHI::RenderBuffer::~RenderBuffer()
 
 void Core::Wrapper::WrapperRHI::RenderBuffer::UnBind()
 {
+	if (Forward({ CommandType::BindFramebuffer }))
+		return;
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	glBindRenderbuffer(GL_RENDERBUFFER, 0);
 }
 
 void Core::Wrapper::WrapperRHI::RenderBuffer::Bind()
 {
+	if (Forward({ CommandType::BindFramebuffer, frameBuffer }))
+		return;
 	glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
 	glBindRenderbuffer(GL_RENDERBUFFER, renderBuffer);
 }
 
 void Core::Wrapper::WrapperRHI::RenderBuffer::Generate(unsigned int& texture, const Math::Vector2& size, unsigned int texUnit /*= 0*/)
 {
+	if (s_backend)
+	{
+		frameBuffer = s_backend->CreateObject();
+		renderBuffer = s_backend->CreateObject();
+		Forward({ CommandType::Create, frameBuffer });
+		return;
+	}
 	glBindTextureUnit(texUnit, texture);
+	if (texUnit < StateCache::TextureUnits)
+		s_state.textures[texUnit] = texture;
 
 	glGenFramebuffers(1, &frameBuffer);
 	glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
@@ -849,6 +1560,8 @@ void Core::Wrapper::WrapperRHI::RenderBuffer::Generate(unsigned int& texture, co
 
 void Core::Wrapper::WrapperRHI::RenderBuffer::Resize(const Math::Vector2& windowSize)
 {
+	if (Forward({ CommandType::TextureUpload, 0, 0, 0, (size_t)(windowSize.x * windowSize.y) * sizeof(float[4]) }))
+		return;
 	if (windowSize.x * windowSize.y != 0) {
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, (GLsizei)windowSize.x, (GLsizei)windowSize.y, 0, GL_RGBA, GL_FLOAT, NULL);
 		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, (GLsizei)windowSize.x, (GLsizei)windowSize.y);
@@ -857,6 +1570,8 @@ void Core::Wrapper::WrapperRHI::RenderBuffer::Resize(const Math::Vector2& window
 
 void Core::Wrapper::WrapperRHI::RenderBuffer::Read(int width, int height, unsigned char*& data)
 {
+	if (Forward({ CommandType::Readback, frameBuffer, 0, 0, (size_t)width * height * 4 }))
+		return;
 	Bind();
 	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data);
 }
@@ -885,9 +1600,16 @@ Core::Wrapper::WrapperRHI::Line::~Line() { m_shader = nullptr; }
 void Core::Wrapper::WrapperRHI::Line::Initialize()
 {
 	m_shader = Resources::ResourcesManager::Get()->GetOrLoad<Resources::Shader>(ENGINEPATH"Shaders/unlit");
+	if (s_backend)
+	{
+		m_VAO = s_backend->CreateObject();
+		m_VBO = s_backend->CreateObject();
+		m_initialized = true;
+		return;
+	}
 	glGenVertexArrays(1, &m_VAO);
 	glGenBuffers(1, &m_VBO);
-	glBindVertexArray(m_VAO);
+	SetVertexArray(m_VAO);
 
 	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
 	glBufferData(GL_ARRAY_BUFFER, 3 * sizeof(float) + 3 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
@@ -910,6 +1632,14 @@ void Core::Wrapper::WrapperRHI::Line::Draw(Math::Vector3 p1, Math::Vector3 p2)
 	{
 		return;
 	}
+	if (s_backend)
+	{
+		Forward({ CommandType::BufferUpload, m_VBO, 0, 0, sizeof(p1) + sizeof(p2) });
+		m_shader->Use();
+		Forward({ CommandType::Uniform, 0, 0, 0, sizeof(Math::Matrix4) + sizeof(Color) + sizeof(int) });
+		Forward({ CommandType::Draw, m_VAO, 2 });
+		return;
+	}
 	// Bind Position
 	glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
 	glBufferSubData(GL_ARRAY_BUFFER, 0, 3 * sizeof(float), &p1);
@@ -928,9 +1658,9 @@ void Core::Wrapper::WrapperRHI::Line::Draw(Math::Vector3 p1, Math::Vector3 p2)
 	glUniform1i(m_shader->GetLocation("enableTexture"), false);
 
 	// Draw vertices
-	glBindVertexArray(m_VAO);
+	SetVertexArray(m_VAO);
 	glDrawArrays(GL_LINES, 0, 9);
-	glBindVertexArray(0);
+	SetVertexArray(0);
 
 	glLineWidth(defaultWidth);
 	//glDepthRange(0.01, 1);
@@ -1023,10 +1753,17 @@ void Line::DrawCircle(const Math::Vector3& position, const Math::Vector3& direct
 
 void Core::Wrapper::WrapperRHI::ShadowMap::InitShadow()
 {
+	if (s_backend)
+	{
+		m_buffer = s_backend->CreateObject();
+		m_shadowMap = s_backend->CreateObject();
+		Forward({ CommandType::TextureUpload, m_shadowMap, 0, 0, (size_t)SHADOW_WIDTH * SHADOW_HEIGHT * sizeof(float) });
+		return;
+	}
 	glGenFramebuffers(1, &m_buffer);
 
 	glGenTextures(1, &m_shadowMap);
-	glBindTexture(GL_TEXTURE_2D, m_shadowMap);
+	SetTexture(GL_TEXTURE_2D, m_shadowMap);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
@@ -1044,18 +1781,28 @@ void Core::Wrapper::WrapperRHI::ShadowMap::InitShadow()
 
 void Core::Wrapper::WrapperRHI::ShadowMap::BeginShadowMapGeneration()
 {
-	glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+	if (Forward({ CommandType::BindFramebuffer, m_buffer }))
+	{
+		stencilDepthTest = false;
+		return;
+	}
+	SetViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
 	glBindFramebuffer(GL_FRAMEBUFFER, m_buffer);
 	glClear(GL_DEPTH_BUFFER_BIT);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, m_shadowMap);
+	SetActiveUnit(0);
+	SetTexture(GL_TEXTURE_2D, m_shadowMap);
 	stencilDepthTest = false;
 }
 
 void Core::Wrapper::WrapperRHI::ShadowMap::EndShadowMapGeneration(unsigned int width, unsigned int height)
 {
+	if (Forward({ CommandType::BindFramebuffer }))
+	{
+		stencilDepthTest = true;
+		return;
+	}
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	glViewport(0, 0, width, height);
+	SetViewport(0, 0, width, height);
 	stencilDepthTest = true;
 }
 
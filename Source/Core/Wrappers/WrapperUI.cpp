@@ -2466,32 +2466,61 @@ void Core::Wrapper::WrapperUI::DrawAnimatorList(Resources::AnimationController*
 	if (controller) {
 		if (WrapperUI::Button("Add Parameter"))
 		{
-			controller->AddParameter("New bool");
+			WrapperUI::OpenPopup("AddParameter");
+		}
+		if (WrapperUI::BeginPopup("AddParameter"))
+		{
+			if (WrapperUI::MenuItem("Bool"))
+				controller->AddParameter("New bool", Resources::AnimatorParameterType::Bool);
+			if (WrapperUI::MenuItem("Float"))
+				controller->AddParameter("New float", Resources::AnimatorParameterType::Float);
+			if (WrapperUI::MenuItem("Int"))
+				controller->AddParameter("New int", Resources::AnimatorParameterType::Int);
+			if (WrapperUI::MenuItem("Trigger"))
+				controller->AddParameter("New trigger", Resources::AnimatorParameterType::Trigger);
+			WrapperUI::EndPopup();
 		}
-		int id = 0;
 		bool change = false;
-		static std::pair<const std::string, bool>* rightClicked = nullptr;
-		for (auto&& param : controller->parameters)
+		static int rightClicked = -1;
+		for (int id = 0; id < controller->parameters.size(); id++)
 		{
+			Resources::AnimatorParameter& param = controller->parameters[id];
 			bool selected = false;
-			PushID(id++);
+			PushID(id);
 			WrapperUI::BeginGroup();
-			WrapperUI::Selectable(param.first.c_str(), &selected, SelectableFlags::AllowItemOverlap);
+			WrapperUI::Selectable(param.name.c_str(), &selected, SelectableFlags::AllowItemOverlap);
 			WrapperUI::SameLine();
 			WrapperUI::SetCursorPosX(WrapperUI::GetCursorPosX() + 50.f + WrapperUI::GetWindowWidth() * 0.1f);
 			WrapperUI::SetCursorPosY(WrapperUI::GetCursorPosY() - 2.f);
-			if (WrapperUI::Checkbox("##", &param.second))
-				controller->parameterUpdated = true;
+			switch (param.type)
+			{
+			case Resources::AnimatorParameterType::Float:
+				WrapperUI::SetNextItemWidth(60.f);
+				if (WrapperUI::DragFloat("##", &param.defaultValue.f, 0.01f))
+					controller->parameterUpdated = true;
+				break;
+			case Resources::AnimatorParameterType::Int:
+				WrapperUI::SetNextItemWidth(60.f);
+				if (WrapperUI::DragInt("##", &param.defaultValue.i))
+					controller->parameterUpdated = true;
+				break;
+			default:
+				if (WrapperUI::Checkbox("##", &param.defaultValue.b))
+					controller->parameterUpdated = true;
+				break;
+			}
 			WrapperUI::EndGroup();
 
 			if (WrapperUI::IsItemHovered() && WrapperUI::IsMouseClicked(MouseButton::Right))
 			{
 				change = true;
-				rightClicked = &param;
+				rightClicked = id;
 			}
 			PopID();
 		}
-		if (rightClicked)
+		if (rightClicked >= (int)controller->parameters.size())
+			rightClicked = -1;
+		if (rightClicked >= 0)
 		{
 			if (change)
 			{
@@ -2500,16 +2529,21 @@ void Core::Wrapper::WrapperUI::DrawAnimatorList(Resources::AnimationController*
 			if (WrapperUI::BeginPopup("RightClickParameter"))
 			{
 				char Name[64];
-				strcpy_s(Name, 64, rightClicked->first.c_str());
+				strcpy_s(Name, 64, controller->parameters[rightClicked].name.c_str());
+				int type = (int)controller->parameters[rightClicked].type;
 				if (WrapperUI::InputText("Rename", Name, 64, InputTextFlags::EnterReturnsTrue) && Name[0] != '\0')
 				{
-					controller->RenameParameter(rightClicked->first, Name);
-					rightClicked = nullptr;
+					controller->RenameParameter(controller->parameters[rightClicked].name, Name);
+					rightClicked = -1;
+				}
+				else if (WrapperUI::Combo("Type", &type, "Bool\0Float\0Int\0Trigger\0"))
+				{
+					controller->SetParameterType(rightClicked, (Resources::AnimatorParameterType)type);
 				}
-				if (WrapperUI::Button("Delete"))
+				else if (WrapperUI::Button("Delete"))
 				{
-					controller->DeleteParameter(rightClicked->first);
-					rightClicked = nullptr;
+					controller->DeleteParameter(controller->parameters[rightClicked].name);
+					rightClicked = -1;
 				}
 				WrapperUI::EndPopup();
 			}
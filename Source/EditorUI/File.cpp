@@ -122,6 +122,11 @@ EditorUI::File::File(std::string filename) {
 		this->type = EditorUI::FileType::Shdr;
 		this->resourceLink = ResourcesManager::Get()->Find<FragmentShader>(directory);
 	}
+	else if (extension == "comp")
+	{
+		this->type = EditorUI::FileType::Shdr;
+		this->resourceLink = ResourcesManager::Get()->Find<ComputeShader>(directory);
+	}
 	else if (extension == "scn")
 	{
 		this->type = EditorUI::FileType::Scn;
@@ -339,6 +339,10 @@ void EditorUI::FileExplorer::RightClickWindow()
 					{
 						fragShader->Recompile();
 					}
+					else if (auto computeShader = dynamic_cast<Resources::ComputeShader*>(m_rightClicked->resourceLink))
+					{
+						computeShader->Recompile();
+					}
 					WrapperUI::CloseCurrentPopup();
 				}
 				if (WrapperUI::Button("Edit"))
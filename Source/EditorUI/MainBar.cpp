@@ -216,6 +216,11 @@ void EditorUI::MainBar::Draw()
 				WrapperUI::InputFloat2("Window Size", &settings.screenSize.x);
 				WrapperUI::Checkbox("Resizable", &settings.resizableScreen);
 				WrapperUI::EndDisabled();
+				WrapperUI::SeparatorText("Scripting");
+				WrapperUI::Checkbox("Profile Managed Allocations (restart)", &settings.profileScriptAllocations);
+				WrapperUI::SeparatorText("Animation Import");
+				WrapperUI::DragFloat("Position Tolerance", &settings.animationPositionTolerance, 0.0001f, 0.f, 1.f, "%.5f");
+				WrapperUI::DragFloat("Rotation Tolerance", &settings.animationRotationTolerance, 0.0001f, 0.f, 1.f, "%.5f");
 				if (WrapperUI::Button("Save & Close"))
 				{
 					Core::App::Get().projectSettings.Save();
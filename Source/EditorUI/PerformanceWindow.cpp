@@ -3,6 +3,7 @@
 #include <Core/App.h>
 #include <EditorUI/PerformanceWindow.h>
 #include <Core/Wrappers/WrapperRHI.h>
+#include <Scripting/ScriptProfiler.h>
 
 EditorUI::PerformanceWindow::PerformanceWindow()
 {
@@ -16,5 +17,12 @@ EditorUI::PerformanceWindow::~PerformanceWindow()
 void EditorUI::PerformanceWindow::Draw()
 {
 	WrapperUI::ShowPerformanceWindow("Performance", &p_open);
+	if (!p_open)
+		return;
+
+	// Appended to the window opened above
+	if (WrapperUI::Begin("Performance", &p_open))
+		Scripting::ScriptProfiler::ShowInWindow();
+	WrapperUI::End();
 }
 
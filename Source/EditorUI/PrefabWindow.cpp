@@ -1,6 +1,7 @@
 #include "pch.h"
 #include <EditorUI/PrefabWindow.h>
 #include <Core/App.h>
+#include <Core/RenderQueue.h>
 #include <Core/SceneManager.h>
 #include <Core/Scene.h>
 #include <Core/GameObject.h>
@@ -56,6 +57,7 @@ void EditorUI::PrefabWindow::Draw()
 					}
 					if (dragged) {
 						dragged->DrawSelfAndChild(true);
+						Core::App::Get().renderQueue->DrawSubmitted();
 						auto Direction = prefabScene->GetEditorCamera()->UnProject({ GetMousePosition(), 20.f });
 						dragged->transform->SetWorldPosition(Direction);
 					}
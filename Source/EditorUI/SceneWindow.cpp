@@ -2,6 +2,7 @@
 
 #include <EditorUI/SceneWindow.h>
 #include <Core/App.h>
+#include <Core/RenderQueue.h>
 #include <Core/SceneManager.h>
 #include <Core/Scene.h>
 #include <Core/GameObject.h>
@@ -68,6 +69,7 @@ void EditorUI::SceneWindow::Draw()
 					dragged->transform->SetWorldPosition(Direction);
 					dragged->transform->ForceUpdate();
 					dragged->DrawSelfAndChild(true);
+					Core::App::Get().renderQueue->DrawSubmitted();
 				}
 				if (WrapperUI::IsMouseReleased(MouseButton::Left) && dragged)
 				{
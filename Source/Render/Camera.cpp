@@ -411,7 +411,7 @@ Math::Vector2 Camera::GetScreenResolution()
 #ifndef	PANDOR_GAME
 	return Core::App::Get().GetEditorUIManager().GetSceneWindow().GetWindowSize();
 #else
-	return Core::App::Get().window->GetSize();
+	return Core::App::Get().GetScreenSize();
 #endif
 }
 
@@ -73,7 +73,7 @@ void Render::Framebuffer::Initialize(const Math::Vector2& size)
 }
 void Render::Framebuffer::PreUpdate()
 {
-	auto windowSize = Core::App::Get().window->GetSize();
+	auto windowSize = Core::App::Get().GetScreenSize();
 	if (!m_postProcess && m_enablePostProcessing) {
 		m_postProcess = new Render::Framebuffer();
 		m_postProcess->Initialize(windowSize);
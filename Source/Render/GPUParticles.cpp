@@ -0,0 +1,144 @@
+#include "pch.h"
+#include <Render/GPUParticles.h>
+
+#include <Resources/ResourcesManager.h>
+#include <Resources/Shader.h>
+#include <Resources/Mesh.h>
+
+Render::GPUParticles::~GPUParticles()
+{
+	Delete();
+}
+
+bool Render::GPUParticles::IsSupported()
+{
+	return WrapperRHI::SupportsCompute();
+}
+
+void Render::GPUParticles::Initialize(size_t capacity, size_t vertexCount)
+{
+	if (!m_simulateShader)
+	{
+		m_simulateShader = Resources::ResourcesManager::Get()->GetOrLoad<Resources::ComputeShader>(ENGINEPATH"Shaders/ParticleCompute/simulate.comp");
+		m_emitShader = Resources::ResourcesManager::Get()->GetOrLoad<Resources::ComputeShader>(ENGINEPATH"Shaders/ParticleCompute/emit.comp");
+		m_finalizeShader = Resources::ResourcesManager::Get()->GetOrLoad<Resources::ComputeShader>(ENGINEPATH"Shaders/ParticleCompute/finalize.comp");
+	}
+
+	m_capacity = capacity;
+	m_vertexCount = vertexCount;
+	for (WrapperRHI::StorageBuffer*& particles : m_particles)
+	{
+		if (!particles)
+			particles = new WrapperRHI::StorageBuffer();
+		particles->Generate(std::max<size_t>(capacity, 1) * sizeof(Particle));
+	}
+	if (!m_state)
+		m_state = new WrapperRHI::StorageBuffer();
+	Clear();
+}
+
+void Render::GPUParticles::Clear()
+{
+	if (!m_state)
+		return;
+	State state = {};
+	state.vertexCount = (uint32_t)m_vertexCount;
+	state.groupsY = 1;
+	state.groupsZ = 1;
+	m_state->Generate(sizeof(State), &state);
+	m_current = 0;
+}
+
+bool Render::GPUParticles::IsReady() const
+{
+	for (Resources::ComputeShader* shader : { m_simulateShader, m_emitShader, m_finalizeShader })
+	{
+		if (!shader || !shader->HasBeenSent())
+			return false;
+	}
+	return m_state != nullptr;
+}
+
+void Render::GPUParticles::Simulate(float deltaTime, size_t spawnCount, uint32_t seed, const GPUParticleEmitter& emitter)
+{
+	if (!IsReady() || m_capacity == 0)
+		return;
+
+	m_particles[m_current]->BindBase(0);
+	m_particles[1 - m_current]->BindBase(1);
+	m_state->BindBase(2);
+	m_state->BindIndirect();
+
+	// The dead particles are dropped by not being written
+	m_simulateShader->Use();
+	WrapperRHI::ShaderSendFloat(m_simulateShader->GetLocation("deltaTime"), deltaTime);
+	WrapperRHI::ShaderSendInt(m_simulateShader->GetLocation("colorOverLife"), emitter.colorOverLife);
+	WrapperRHI::ShaderSendVec4(m_simulateShader->GetLocation("colorStart"), emitter.colorStart);
+	WrapperRHI::ShaderSendVec4(m_simulateShader->GetLocation("colorEnd"), emitter.colorEnd);
+	WrapperRHI::DispatchComputeIndirect(DispatchArgumentsOffset);
+	WrapperRHI::ComputeBarrier();
+
+	if (spawnCount > 0)
+	{
+		// More than the capacity is never written, no need to dispatch it
+		spawnCount = std::min(spawnCount, m_capacity);
+		m_emitShader->Use();
+		WrapperRHI::ShaderSendFloat(m_emitShader->GetLocation("deltaTime"), deltaTime);
+		WrapperRHI::ShaderSendInt(m_emitShader->GetLocation("spawnCount"), (int)spawnCount);
+		WrapperRHI::ShaderSendInt(m_emitShader->GetLocation("capacity"), (int)m_capacity);
+		WrapperRHI::ShaderSendInt(m_emitShader->GetLocation("seed"), (int)seed);
+		WrapperRHI::ShaderSendVec3(m_emitShader->GetLocation("emitterPosition"), emitter.position);
+		WrapperRHI::ShaderSendVec4(m_emitShader->GetLocation("emitterRotation"), Math::Vector4(emitter.rotation.x, emitter.rotation.y, emitter.rotation.z, emitter.rotation.w));
+		WrapperRHI::ShaderSendInt(m_emitShader->GetLocation("shape"), emitter.shape);
+		WrapperRHI::ShaderSendVec2(m_emitShader->GetLocation("radius"), emitter.radius);
+		WrapperRHI::ShaderSendVec2(m_emitShader->GetLocation("angle"), emitter.angle);
+		WrapperRHI::ShaderSendVec2(m_emitShader->GetLocation("scale"), emitter.scale);
+		WrapperRHI::ShaderSendVec2(m_emitShader->GetLocation("speed"), emitter.speed);
+		WrapperRHI::ShaderSendVec2(m_emitShader->GetLocation("lifetime"), emitter.lifetime);
+		WrapperRHI::ShaderSendVec2(m_emitShader->GetLocation("size"), emitter.size);
+		WrapperRHI::ShaderSendVec2(m_emitShader->GetLocation("gravity"), emitter.gravity);
+		WrapperRHI::ShaderSendVec4(m_emitShader->GetLocation("color"), emitter.colorStart);
+		WrapperRHI::DispatchCompute((unsigned int)((spawnCount + GroupSize - 1) / GroupSize));
+		WrapperRHI::ComputeBarrier();
+	}
+
+	m_finalizeShader->Use();
+	WrapperRHI::ShaderSendInt(m_finalizeShader->GetLocation("capacity"), (int)m_capacity);
+	WrapperRHI::DispatchCompute(1);
+	WrapperRHI::ComputeBarrier(true);
+
+	m_current = 1 - m_current;
+}
+
+void Render::GPUParticles::Draw(Resources::Mesh* mesh, Resources::Material* material, Resources::Shader* shader, WrapperRHI::Buffer* vertices)
+{
+	if (!IsReady() || m_capacity == 0 || !vertices)
+		return;
+
+	// The particles are read in place, the compaction keeps the alive ones at the front
+	vertices->Bind();
+	m_particles[m_current]->BindVertexBuffer();
+	vertices->LinkAttribute(8, 4, PR_FLOAT, sizeof(Particle), (void*)0);
+	vertices->LinkAttribute(9, 4, PR_FLOAT, sizeof(Particle), (void*)(sizeof(float[4])));
+	m_state->BindIndirect();
+	mesh->RenderInstancingIndirect(material, shader, DrawArgumentsOffset, vertices);
+	vertices->Unbind();
+}
+
+size_t Render::GPUParticles::GetMemorySize() const
+{
+	return m_capacity * sizeof(Particle) * 2 + sizeof(State);
+}
+
+void Render::GPUParticles::Delete()
+{
+	for (WrapperRHI::StorageBuffer** buffer : { &m_particles[0], &m_particles[1], &m_state })
+	{
+		if (!*buffer)
+			continue;
+		(*buffer)->Delete();
+		delete *buffer;
+		*buffer = nullptr;
+	}
+	m_capacity = 0;
+}
@@ -9,6 +9,7 @@
 #include <Math/Maths.h>
 #include <Core/Scene.h>
 #include <Core/App.h>
+#include <Core/RenderQueue.h>
 #include <Core/SceneManager.h>
 #include <EditorUI/EditorUIManager.h>
 #include <EditorUI/SceneWindow.h>
@@ -109,6 +110,8 @@ void Render::Gizmo::Draw(Component::Transform* trans, bool sceneWindow /*= true*
 	if (m_gizmo != nullptr)
 	{
 		m_gizmo->DrawSelfAndChild(true);
+		// Drawn now, inside the depth range of the gizmo
+		Core::App::Get().renderQueue->DrawSubmitted();
 		m_gizmo->transform->SetLocalPosition(trans->GetWorldPosition());
 		if (m_GizModel == GizmoModels::SCALE || GetGizmoMode() == GizmoMode::Local)
 			m_gizmo->transform->SetLocalRotation(trans->GetWorldRotation());
@@ -3,6 +3,169 @@
 
 #include <Utils/Loader.h>
 
+#pragma region Quantization
+
+// Smallest three components of a unit quaternion are within +-1/sqrt(2)
+static constexpr float s_QuaternionRange = 0.70710678f;
+static constexpr float s_Max15Bits = 32767.f;
+static constexpr float s_Max16Bits = 65535.f;
+
+static void EncodeQuaternion(Math::Quaternion q, uint16_t* out)
+{
+	q.Normalize();
+	float components[4] = { q.x, q.y, q.z, q.w };
+
+	int largest = 0;
+	for (int i = 1; i < 4; i++)
+		if (std::fabs(components[i]) > std::fabs(components[largest]))
+			largest = i;
+
+	// q and -q are the same rotation, the largest one is always rebuilt positive
+	float sign = components[largest] < 0.f ? -1.f : 1.f;
+
+	int j = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+		float normalized = std::clamp(components[i] * sign / s_QuaternionRange * 0.5f + 0.5f, 0.f, 1.f);
+		out[j++] = (uint16_t)std::lroundf(normalized * s_Max15Bits);
+	}
+	out[0] |= (uint16_t)((largest & 1) << 15);
+	out[1] |= (uint16_t)((largest >> 1) << 15);
+}
+
+static Math::Quaternion DecodeQuaternion(const uint16_t* in)
+{
+	int largest = (in[0] >> 15) | ((in[1] >> 15) << 1);
+
+	float components[4];
+	float sum = 0.f;
+	int j = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		if (i == largest)
+			continue;
+		components[i] = ((in[j++] & 0x7FFF) / s_Max15Bits - 0.5f) * 2.f * s_QuaternionRange;
+		sum += components[i] * components[i];
+	}
+	components[largest] = std::sqrt(std::max(0.f, 1.f - sum));
+	return Math::Quaternion(components[0], components[1], components[2], components[3]);
+}
+
+Math::Vector3 Resources::CompressedPositionCurve::GetKey(size_t index) const
+{
+	const uint16_t* key = &values[index * 3];
+	return Math::Vector3(
+		min.x + key[0] / s_Max16Bits * extent.x,
+		min.y + key[1] / s_Max16Bits * extent.y,
+		min.z + key[2] / s_Max16Bits * extent.z);
+}
+
+Math::Quaternion Resources::CompressedRotationCurve::GetKey(size_t index) const
+{
+	return DecodeQuaternion(&values[index * 3]);
+}
+
+#pragma endregion
+
+#pragma region Sampling
+
+// Index of the key starting the segment containing "time", the time must be strictly inside the curve
+static uint32_t FindKey(const std::vector<uint16_t>& times, float time, uint32_t hint)
+{
+	const uint32_t last = (uint32_t)times.size() - 2;
+
+	// Playing forward, the segment is almost always the cached one or the next
+	if (hint <= last && times[hint] <= time)
+	{
+		if (time < times[hint + 1])
+			return hint;
+		if (hint < last && time < times[hint + 2])
+			return hint + 1;
+	}
+
+	auto it = std::upper_bound(times.begin(), times.end(), time, [](float value, uint16_t key) { return value < key; });
+	size_t index = it == times.begin() ? 0 : (size_t)(it - times.begin()) - 1;
+	return (uint32_t)std::min<size_t>(index, last);
+}
+
+// Only the two keys around the time are decompressed
+template<typename Curve, typename Interpolate>
+static auto SampleCurve(const Curve& curve, float time, uint32_t& hint, Interpolate interpolate)
+{
+	if (curve.times.size() == 1 || time <= curve.times.front())
+		return curve.GetKey(0);
+	if (time >= curve.times.back())
+		return curve.GetKey(curve.times.size() - 1);
+
+	hint = FindKey(curve.times, time, hint);
+	float t = (time - curve.times[hint]) / (float)(curve.times[hint + 1] - curve.times[hint]);
+	return interpolate(curve.GetKey(hint), curve.GetKey(hint + 1), t);
+}
+
+#pragma endregion
+
+#pragma region Reduction
+
+static float PositionError(const Math::Vector3& a, const Math::Vector3& b)
+{
+	return (a - b).Length();
+}
+
+static float RotationError(const Math::Quaternion& a, const Math::Quaternion& b)
+{
+	float dot = std::min(std::fabs(a.Dot(b)), 1.f);
+	return 2.f * std::acos(dot);
+}
+
+// Indices of the keys to keep, a key is dropped when the interpolation of its kept neighbours is within the tolerance of every dropped key
+template<typename T, typename Interpolate, typename Error>
+static std::vector<size_t> ReduceKeys(const Resources::AnimationCurve<T>& curve, float tolerance, Interpolate interpolate, Error error)
+{
+	const size_t count = curve.times.size();
+	std::vector<size_t> kept;
+	if (count == 0)
+		return kept;
+
+	kept.push_back(0);
+	size_t anchor = 0;
+	for (size_t next = 2; next < count; next++)
+	{
+		float span = curve.times[next] - curve.times[anchor];
+		for (size_t k = anchor + 1; k < next; k++)
+		{
+			float t = (curve.times[k] - curve.times[anchor]) / span;
+			if (error(interpolate(curve.values[anchor], curve.values[next], t), curve.values[k]) > tolerance)
+			{
+				anchor = next - 1;
+				kept.push_back(anchor);
+				break;
+			}
+		}
+	}
+	if (count > 1)
+		kept.push_back(count - 1);
+
+	// A constant curve only needs one key
+	if (kept.size() == 2)
+	{
+		bool constant = true;
+		for (size_t k = 1; k < count && constant; k++)
+			constant = error(curve.values[0], curve.values[k]) <= tolerance;
+		if (constant)
+			kept.pop_back();
+	}
+	return kept;
+}
+
+static uint16_t QuantizeTime(float time)
+{
+	return (uint16_t)std::clamp(std::lroundf(time), 0l, (long)UINT16_MAX);
+}
+
+#pragma endregion
+
 Resources::Animation::~Animation()
 {
 }
@@ -16,104 +179,144 @@ void Resources::Animation::Load()
 
 void Resources::Animation::SendResource()
 {
-	auto max_size_position = [&](const std::vector < std::unordered_map<int, Math::Vector3>>& a) -> int
+	UpdateKeyCount();
+	hasBeenSent = true;
+}
+
+void Resources::Animation::UpdateKeyCount()
+{
+	uint16_t end = 0;
+	for (auto& curve : PositionCurves)
+		if (!curve.IsEmpty())
+			end = std::max(end, curve.times.back());
+	for (auto& curve : RotationCurves)
+		if (!curve.IsEmpty())
+			end = std::max(end, curve.times.back());
+	KeyCount = end;
+}
+
+size_t Resources::Animation::GetMemorySize() const
+{
+	size_t size = 0;
+	for (auto& curve : PositionCurves)
+		size += sizeof(curve) + (curve.times.size() + curve.values.size()) * sizeof(uint16_t);
+	for (auto& curve : RotationCurves)
+		size += sizeof(curve) + (curve.times.size() + curve.values.size()) * sizeof(uint16_t);
+	return size;
+}
+
+void Resources::Animation::Compress(const std::vector<AnimationCurve<Math::Vector3>>& positions, const std::vector<AnimationCurve<Math::Quaternion>>& rotations,
+	const AnimationCompressionSettings& settings)
+{
+	auto toleranceScale = [&](size_t id) { return id < settings.boneTolerances.size() ? settings.boneTolerances[id] : 1.f; };
+
+	size_t sourceKeys = 0;
+	size_t keptKeys = 0;
+
+	PositionCurves.assign(positions.size(), {});
+	for (size_t i = 0; i < positions.size(); i++)
 	{
-		int max = 0;
+		const AnimationCurve<Math::Vector3>& source = positions[i];
+		CompressedPositionCurve& curve = PositionCurves[i];
+		std::vector<size_t> kept = ReduceKeys(source, settings.positionTolerance * toleranceScale(i), Math::Vector3::Lerp, PositionError);
+		if (kept.empty())
+			continue;
 
-		for (int x = 0; x < a.size(); x++)
+		Math::Vector3 max = source.values[kept[0]];
+		curve.min = max;
+		for (size_t k : kept)
 		{
-			for (auto& i : a[x])
+			for (size_t c = 0; c < 3; c++)
 			{
-				max = std::max(i.first, max);
+				curve.min[c] = std::min(curve.min[c], source.values[k][c]);
+				max[c] = std::max(max[c], source.values[k][c]);
 			}
 		}
-		return max;
-	};
-
-	auto max_size_rotation = [&](const std::vector < std::unordered_map<int, Math::Quaternion>>& a) -> int
-	{
-		int max = 0;
+		curve.extent = max - curve.min;
 
-		for (int x = 0; x < a.size(); x++)
+		curve.times.reserve(kept.size());
+		curve.values.reserve(kept.size() * 3);
+		for (size_t k : kept)
 		{
-			for (auto& i : a[x])
+			curve.times.push_back(QuantizeTime(source.times[k]));
+			for (size_t c = 0; c < 3; c++)
 			{
-				max = std::max(i.first, max);
+				float normalized = curve.extent[c] > 0.f ? (source.values[k][c] - curve.min[c]) / curve.extent[c] : 0.f;
+				curve.values.push_back((uint16_t)std::lroundf(normalized * s_Max16Bits));
 			}
 		}
-		return max;
-	};
+		sourceKeys += source.times.size();
+		keptKeys += kept.size();
+	}
 
-	auto nearest_values_pos = [&](const std::unordered_map<int, Math::Vector3>& m, int target) -> std::pair<int, int>
+	RotationCurves.assign(rotations.size(), {});
+	for (size_t i = 0; i < rotations.size(); i++)
 	{
-		int lower = -1, upper = -1;
-		for (auto i : m) {
-			if (i.first < target) {
-				lower = i.first;
-			}
-			else if (i.first > target) {
-				upper = i.first;
-				break;
-			}
-		}
-		return std::make_pair(lower, upper);
-	};
+		const AnimationCurve<Math::Quaternion>& source = rotations[i];
+		CompressedRotationCurve& curve = RotationCurves[i];
+		std::vector<size_t> kept = ReduceKeys(source, settings.rotationTolerance * toleranceScale(i), Math::Quaternion::SLerp, RotationError);
 
-	auto nearest_values_rot = [&](const std::unordered_map<int, Math::Quaternion>& m, int target) -> std::pair<int, int>
-	{
-		int lower = -1, upper = -1;
-		for (auto& i : m) {
-			if (i.first < target) {
-				lower = i.first;
-			}
-			else if (i.first > target) {
-				upper = i.first;
-				break;
-			}
+		curve.times.reserve(kept.size());
+		curve.values.resize(kept.size() * 3);
+		for (size_t k = 0; k < kept.size(); k++)
+		{
+			curve.times.push_back(QuantizeTime(source.times[kept[k]]));
+			EncodeQuaternion(source.values[kept[k]], &curve.values[k * 3]);
 		}
-		return std::make_pair(lower, upper);
-	};
+		sourceKeys += source.times.size();
+		keptKeys += kept.size();
+	}
 
-	KeyCount = std::max(max_size_rotation(KeyRotations), max_size_position(KeyPositions));
-	hasBeenSent = true;
+	UpdateKeyCount();
+	if (sourceKeys > 0)
+		PrintLog("Animation %s compressed : %zu / %zu keys kept, %zu bytes", p_name.c_str(), keptKeys, sourceKeys, GetMemorySize());
 }
 
-void Resources::Animation::GetAnimAtFrame(int id, float time, Math::Vector3& Position, Math::Quaternion& Rotation)
+void Resources::Animation::GetAnimAtFrame(int id, float time, Math::Vector3& Position, Math::Quaternion& Rotation) const
 {
-	int pt0, pt1, rt0, rt1;
-	if (time >= 0) {
-		// Position
-		if (KeyPositions.size() > id && KeyPositions[id].size() > 1) {
-			pt0 = (int)std::floorf(abs(time)) % (KeyPositions[id].size() - 1);
-			pt1 = (int)std::ceilf(abs(time)) % (KeyPositions[id].size() - 1);
-			if (pt1 == pt0)
-				pt1 += 1;
+	if (id < 0)
+		return;
 
-			// Lerp The Position
-			Math::Vector3 PreviousFramePos = KeyPositions[id][pt0];
-			Math::Vector3 NextFramePos = KeyPositions[id][pt1];
-			Position = Math::Vector3::Lerp(PreviousFramePos, NextFramePos, (float)(time - pt0) / (float)(pt1 - pt0));
-		}
-		else if (KeyPositions.size() > id && KeyPositions[id].size() > 0)
-		{
-			Position = KeyPositions[id].begin()->second;
-		}
+	uint32_t hint = 0;
+	if ((size_t)id < PositionCurves.size() && !PositionCurves[id].IsEmpty())
+		Position = SampleCurve(PositionCurves[id], time, hint, Math::Vector3::Lerp);
 
-		// Rotation
-		if (KeyRotations.size() > id && KeyRotations[id].size() > 1) {
-			rt0 = (int)std::floorf(abs(time)) % (KeyRotations[id].size() - 1);
-			rt1 = (int)std::ceilf(abs(time)) % (KeyRotations[id].size() - 1);
-			if (rt1 == rt0)
-				rt1 += 1;
-
-			// Lerp The Rotation
-			Math::Quaternion PreviousFrameRot = KeyRotations[id][rt0];
-			Math::Quaternion NextFrameRot = KeyRotations[id][rt1];
-			Rotation = Math::Quaternion::SLerp(PreviousFrameRot, NextFrameRot, (float)(time - rt0) / (float)(rt1 - rt0));
-		}
-		else if (KeyRotations.size() > id && KeyRotations[id].size() > 0)
-		{
-			Rotation = KeyRotations[id].begin()->second;
-		}
+	hint = 0;
+	if ((size_t)id < RotationCurves.size() && !RotationCurves[id].IsEmpty())
+		Rotation = SampleCurve(RotationCurves[id], time, hint, Math::Quaternion::SLerp);
+}
+
+void Resources::Animation::SampleAll(float time, Math::Vector3* positions, Math::Quaternion* rotations, size_t count, AnimationCursor* cursor, const uint8_t* mask) const
+{
+	// Also reset when the clip was reloaded with another bone count
+	if (cursor && (cursor->animation != this || cursor->positionKeys.size() != PositionCurves.size() || cursor->rotationKeys.size() != RotationCurves.size()))
+	{
+		cursor->animation = this;
+		cursor->positionKeys.assign(PositionCurves.size(), 0);
+		cursor->rotationKeys.assign(RotationCurves.size(), 0);
+	}
+
+	size_t positionCount = std::min(count, PositionCurves.size());
+	for (size_t i = 0; i < positionCount; i++)
+	{
+		const CompressedPositionCurve& curve = PositionCurves[i];
+		if (curve.IsEmpty() || (mask && !mask[i]))
+			continue;
+		uint32_t hint = cursor ? cursor->positionKeys[i] : 0;
+		positions[i] = SampleCurve(curve, time, hint, Math::Vector3::Lerp);
+		if (cursor)
+			cursor->positionKeys[i] = hint;
+	}
+
+	size_t rotationCount = std::min(count, RotationCurves.size());
+	for (size_t i = 0; i < rotationCount; i++)
+	{
+		const CompressedRotationCurve& curve = RotationCurves[i];
+		if (curve.IsEmpty() || (mask && !mask[i]))
+			continue;
+		uint32_t hint = cursor ? cursor->rotationKeys[i] : 0;
+		rotations[i] = SampleCurve(curve, time, hint, Math::Quaternion::SLerp);
+		if (cursor)
+			cursor->rotationKeys[i] = hint;
 	}
 }
@@ -15,6 +15,8 @@
 #include <Components/Animator.h>
 #include <Components/SkeletalMeshComponent.h>
 
+#include <optional>
+
 Resources::AnimationController::~AnimationController()
 {
 	for (auto& state : states)
@@ -37,6 +39,7 @@ void Resources::AnimationController::Load()
 		return;
 	p_shouldBeLoaded = true;
 	Utils::Loader::ANIMC::Load(this, p_fullPath);
+	MarkGraphDirty();
 	isLoaded = true;
 	hasBeenSent = true;
 }
@@ -58,149 +61,557 @@ void Resources::AnimationController::Create()
 
 void Resources::AnimationController::Update(Component::Animator* animator)
 {
-	if (animator->m_play) {
-		UpdateConditions(animator);
-		if (auto current = animator->m_currentState)
+	if (!animator->m_play)
+		return;
+
+	// Not recompiled here, the animators are evaluated in parallel
+	const CompiledStateMachine& machine = m_stateMachine;
+	AnimatorStateBlock& block = animator->m_state;
+	if (block.graphVersion != m_graphVersion || animator->m_layerStates.size() != m_compiledLayers.size())
+	{
+		// The graph was recompiled, the indices of the animator are no longer valid
+		block = AnimatorStateBlock();
+		block.currentState = machine.entryState;
+		block.graphVersion = m_graphVersion;
+		animator->m_layerStates.assign(m_compiledLayers.size(), AnimatorStateBlock());
+		for (size_t i = 0; i < m_compiledLayers.size(); i++)
 		{
-			if (animator->m_transitionLink && animator->m_transitionLink->hasExitTime && !animator->m_endExitTime)
-				UpdateExitTime(animator);
-			else if (!animator->m_transitionLink)
-				UpdateAnimation(animator, animator->m_currentState->animation);
-			else
-				UpdateTransition(animator);
+			animator->m_layerStates[i].currentState = m_compiledLayers[i].machine.entryState;
+			animator->m_layerStates[i].graphVersion = m_graphVersion;
+		}
+	}
+
+	// The parameters are shared, a change reaches the conditions of every layer
+	const bool conditionUpdated = block.conditionUpdated;
+	BlendPose* pose = UpdateMachine(machine, animator, block, 0);
+
+	auto skel = animator->m_evaluatePose ? animator->m_skeletalMesh->GetSkeleton() : nullptr;
+	for (size_t i = 0; i < m_compiledLayers.size(); i++)
+	{
+		const CompiledLayer& layer = m_compiledLayers[i];
+		AnimatorStateBlock& layerBlock = animator->m_layerStates[i];
+		layerBlock.conditionUpdated |= conditionUpdated;
+
+		// Played even without weight, its time keeps advancing
+		size_t slot = (i + 1) * SlotsPerMachine;
+		BlendPose* layerPose = UpdateMachine(layer.machine, animator, layerBlock, slot);
+		if (!pose || !layerPose || layer.weight <= 0.f)
+			continue;
+
+		if (layer.mode == BlendMode::Additive)
+		{
+			// The slots of the previous state are free once the transition is blended
+			const BlendPose& reference = SampleAdditiveReference(skel, layer.machine, layerBlock, animator, slot + 1 + BlendTree::MaxMotions);
+			PoseBlending::MakeAdditive(*layerPose, reference, *layerPose);
 		}
+		PoseBlending::ApplyLayer(*pose, *layerPose, layer.weight, layer.mode, layer.mask.weights.empty() ? nullptr : &layer.mask);
 	}
+
+	if (pose)
+		skel->SetPose(*pose);
 }
 
-void Resources::AnimationController::UpdateConditions(Component::Animator* animator)
+Resources::BlendPose* Resources::AnimationController::UpdateMachine(const CompiledStateMachine& machine, Component::Animator* animator, AnimatorStateBlock& block, size_t slot)
 {
-	if (!animator->m_conditionUpdated)
-		return;
-	if (auto anyState = GetLinkByOutputState(GetStateByName("Any State")))
+	UpdateConditions(machine, animator, block);
+	if (block.currentState < 0)
+		return nullptr;
+
+	if (block.transition >= 0 && machine.transitions[block.transition].hasExitTime && !block.endExitTime)
+		return UpdateExitTime(machine, animator, block, slot);
+	else if (block.transition < 0)
+		return UpdateAnimation(machine, animator, block, machine.states[block.currentState], slot);
+	else
+		return UpdateTransition(machine, animator, block, slot);
+}
+
+bool Resources::CompiledStateMachine::Evaluate(const CompiledTransition& transition, std::vector<AnimatorValue>& values) const
+{
+	const ConditionInstruction* begin = conditions.data() + transition.firstCondition;
+	const ConditionInstruction* end = begin + transition.conditionCount;
+	for (const ConditionInstruction* instruction = begin; instruction != end; instruction++)
 	{
-		if (anyState->state2 != animator->m_currentState) {
-			bool value = true;
-			for (auto& condition : anyState->conditions)
-			{
-				if (condition.first && animator->m_parameters[condition.first->first] != condition.second)
-					value = false;
-			}
-			ChangeAnimation(value, anyState, animator);
+		const AnimatorValue& value = values[instruction->parameter];
+		bool pass = false;
+		switch (instruction->op)
+		{
+		case ConditionOp::BoolTrue:		pass = value.b; break;
+		case ConditionOp::BoolFalse:	pass = !value.b; break;
+		case ConditionOp::Trigger:		pass = value.b; break;
+		case ConditionOp::FloatGreater:	pass = value.f > instruction->operand.f; break;
+		case ConditionOp::FloatLess:	pass = value.f < instruction->operand.f; break;
+		case ConditionOp::IntGreater:	pass = value.i > instruction->operand.i; break;
+		case ConditionOp::IntLess:		pass = value.i < instruction->operand.i; break;
+		case ConditionOp::IntEquals:	pass = value.i == instruction->operand.i; break;
+		case ConditionOp::IntNotEqual:	pass = value.i != instruction->operand.i; break;
+		default:						break;
+		}
+		if (!pass)
+			return false;
+	}
 
+	for (const ConditionInstruction* instruction = begin; instruction != end; instruction++)
+	{
+		if (instruction->op == ConditionOp::Trigger)
+			values[instruction->parameter].b = false;
+	}
+	return true;
+}
+
+void Resources::AnimationController::UpdateConditions(const CompiledStateMachine& machine, Component::Animator* animator, AnimatorStateBlock& block)
+{
+	if (!block.conditionUpdated)
+		return;
+
+	for (uint32_t i = machine.firstAnyTransition; i < machine.firstAnyTransition + machine.anyTransitionCount; i++)
+	{
+		if (machine.transitions[i].target != block.currentState && machine.Evaluate(machine.transitions[i], animator->m_parameters))
+		{
+			ChangeAnimation(machine, i, block);
+			break;
 		}
 	}
-	if (auto link = GetLinkByOutputState(animator->m_currentState))
+	if (block.currentState >= 0)
 	{
-		bool value = true;
-		for (auto& condition : link->conditions)
+		const CompiledState& state = machine.states[block.currentState];
+		for (uint32_t i = state.firstTransition; i < state.firstTransition + state.transitionCount; i++)
 		{
-			if (condition.first && animator->m_parameters[condition.first->first] != condition.second)
-				value = false;
+			if (machine.Evaluate(machine.transitions[i], animator->m_parameters))
+			{
+				ChangeAnimation(machine, i, block);
+				break;
+			}
 		}
-		ChangeAnimation(value, link, animator);
 	}
-	animator->m_conditionUpdated = false;
+	block.conditionUpdated = false;
 }
 
-void Resources::AnimationController::ChangeAnimation(bool value, Resources::Link* link, Component::Animator* animator)
+void Resources::AnimationController::ChangeAnimation(const CompiledStateMachine& machine, int transition, AnimatorStateBlock& block)
 {
-	if (!value)
-		return;
-	if (link->state2 && !link->hasExitTime)
+	block.previousState = block.currentState;
+	block.currentState = machine.transitions[transition].target;
+	block.transition = transition;
+	if (machine.transitions[transition].hasExitTime)
 	{
-		animator->m_lastAnimation = animator->m_currentState->animation;
-		animator->m_currentState = link->state2;
-		animator->SetTransitionLink(link);
+		block.endExitTime = false;
 	}
-	else if (link->state2)
+	else
 	{
-		animator->m_lastAnimation = animator->m_currentState->animation;
-		animator->m_currentState = link->state2;
-		animator->m_transitionLink = link;
-		animator->m_endExitTime = false;
+		block.previousTime = block.currentTime;
+		block.currentTime = 0.f;
+		block.elapsedTime = 0.f;
 	}
 }
 
 void Resources::AnimationController::UpdateParameters(Component::Animator* animator, bool UpdateValue /*= false*/)
 {
-	if (!parameterUpdated)
-		return;
-	if (UpdateValue)
-		animator->m_parameters = parameters;
-	else
+	if (animator->m_parameterVersion != parameterVersion)
 	{
-		// Check for all parameters of animator if existing inside controller
-		// If not find then erase
-		auto it = animator->m_parameters.begin();
-		while (it != animator->m_parameters.end()) {
-			if (!parameters.count(it->first)) {
-				it = animator->m_parameters.erase(it);
-			}
-			else {
-				++it;
-			}
-		}
-		// Check for all parameters of controller if existing inside animator
-		// If not find then create it
-		for (auto& param : parameters)
+		// Parameters were added, removed, renamed or retyped : keep the values of the ones that still exist
+		std::vector<AnimatorValue> values(parameters.size());
+		std::vector<int> ids(parameters.size());
+		for (size_t i = 0; i < parameters.size(); i++)
 		{
-			if (!animator->m_parameters.count(param.first))
+			values[i] = parameters[i].defaultValue;
+			ids[i] = parameters[i].id;
+			for (size_t j = 0; j < animator->m_parameterIDs.size(); j++)
 			{
-				animator->m_parameters[param.first] = param.second;
+				if (animator->m_parameterIDs[j] == parameters[i].id && animator->m_parameterTypes[j] == parameters[i].type)
+				{
+					values[i] = animator->m_parameters[j];
+					break;
+				}
 			}
 		}
+		animator->m_parameters = std::move(values);
+		animator->m_parameterIDs = std::move(ids);
+		animator->m_parameterTypes.resize(parameters.size());
+		for (size_t i = 0; i < parameters.size(); i++)
+			animator->m_parameterTypes[i] = parameters[i].type;
+		animator->m_parameterVersion = parameterVersion;
+		animator->m_state.conditionUpdated = true;
+	}
+	else if (UpdateValue && parameterUpdated)
+	{
+		for (size_t i = 0; i < parameters.size(); i++)
+			animator->m_parameters[i] = parameters[i].defaultValue;
 	}
 }
 
-void Resources::AnimationController::UpdateExitTime(Component::Animator* animator)
+Resources::BlendPose* Resources::AnimationController::UpdateExitTime(const CompiledStateMachine& machine, Component::Animator* animator, AnimatorStateBlock& block, size_t slot)
 {
+	const CompiledState* previous = block.previousState >= 0 ? &machine.states[block.previousState] : nullptr;
+
+	float length = 0.f;
+	if (previous)
+	{
+		float weights[BlendTree::MaxMotions];
+		ComputeBlendWeights(machine, *previous, animator, weights);
+		length = GetStateLength(machine, *previous, weights);
+	}
+
 	float normal = 0.f;
-	if (animator->m_lastAnimation)
-		normal = Arithmetics::Normalize(animator->m_currentTime, 0.f, (float)animator->m_lastAnimation->KeyCount);
-	if (normal < animator->m_transitionLink->exitTime && animator->m_lastAnimation)
+	if (length > 0.f)
+		normal = Arithmetics::Normalize(block.currentTime, 0.f, length);
+	if (normal < machine.transitions[block.transition].exitTime && length > 0.f)
+		return UpdateAnimation(machine, animator, block, *previous, slot);
+
+	block.endExitTime = true;
+	block.previousTime = block.currentTime;
+	block.currentTime = 0.f;
+	block.elapsedTime = 0.f;
+	return nullptr;
+}
+
+Resources::BlendPose* Resources::AnimationController::UpdateTransition(const CompiledStateMachine& machine, Component::Animator* animator, AnimatorStateBlock& block, size_t slot)
+{
+	const CompiledTransition& transition = machine.transitions[block.transition];
+	const CompiledState& current = machine.states[block.currentState];
+	const CompiledState* previous = block.previousState >= 0 ? &machine.states[block.previousState] : nullptr;
+
+	float currentWeights[BlendTree::MaxMotions];
+	float previousWeights[BlendTree::MaxMotions];
+	ComputeBlendWeights(machine, current, animator, currentWeights);
+	float currentLength = GetStateLength(machine, current, currentWeights);
+	float previousLength = 0.f;
+	if (previous)
 	{
-		UpdateAnimation(animator, animator->m_lastAnimation);
+		ComputeBlendWeights(machine, *previous, animator, previousWeights);
+		previousLength = GetStateLength(machine, *previous, previousWeights);
 	}
-	else
+	if (previousLength <= 0.f || currentLength <= 0.f) {
+		block.transition = -1;
+		return nullptr;
+	}
+
+	// Both states keep playing during the transition
+	animator->IncrementTime(*previous, previousLength, block.previousTime);
+	animator->IncrementTime(current, currentLength, block.currentTime);
+
+	// Culled by the animation lod, only the time advances
+	BlendPose* pose = nullptr;
+	auto skel = animator->m_evaluatePose ? animator->m_skeletalMesh->GetSkeleton() : nullptr;
+	if (skel)
+	{
+		BlendPose& to = SampleState(skel, machine, current, block.currentTime, currentWeights, slot);
+		BlendPose& from = SampleState(skel, machine, *previous, block.previousTime, previousWeights, slot + 1 + BlendTree::MaxMotions);
+		float t = transition.duration > 0.f ? std::clamp(block.elapsedTime / transition.duration, 0.f, 1.f) : 1.f;
+		PoseBlending::Blend(from, to, t, to);
+		pose = &to;
+	}
+
+	block.elapsedTime += animator->m_deltaTime;
+	if (block.elapsedTime >= transition.duration)
 	{
-		animator->m_endExitTime = true;
-		animator->SetTransitionLink(animator->m_transitionLink);
+		block.transition = -1;
 	}
+	return pose;
 }
 
-void Resources::AnimationController::UpdateTransition(Component::Animator* animator)
+Resources::BlendPose* Resources::AnimationController::UpdateAnimation(const CompiledStateMachine& machine, Component::Animator* animator, AnimatorStateBlock& block, const CompiledState& state, size_t slot)
 {
-	if (!animator->m_lastAnimation || !animator->m_transitionLink->state2->animation) {
-		animator->m_transitionLink = nullptr;
+	float weights[BlendTree::MaxMotions];
+	ComputeBlendWeights(machine, state, animator, weights);
+	float length = GetStateLength(machine, state, weights);
+	if (length <= 0.f)
+		return nullptr;
+	animator->IncrementTime(state, length, block.currentTime);
+
+	auto skel = animator->m_evaluatePose ? animator->m_skeletalMesh->GetSkeleton() : nullptr;
+	if (!skel)
+		return nullptr;
+	return &SampleState(skel, machine, state, block.currentTime, weights, slot);
+}
+
+void Resources::AnimationController::ComputeBlendWeights(const CompiledStateMachine& machine, const CompiledState& state, const Component::Animator* animator, float* weights) const
+{
+	if (state.blendTree < 0)
+		return;
+	const CompiledBlendTree& tree = machine.blendTrees[state.blendTree];
+	if (tree.motionCount == 0)
 		return;
+
+	auto readParameter = [&](int index) { return index >= 0 && index < (int)animator->m_parameters.size() ? animator->m_parameters[index].f : 0.f; };
+	Math::Vector2 value(readParameter(tree.parameterX), readParameter(tree.parameterY));
+	PoseBlending::ComputeBlendTreeWeights(tree.type, &machine.motionPositions[tree.firstMotion], tree.motionCount, value, weights);
+
+	// The weight of the motions still loading goes to the others
+	float total = 0.f;
+	for (uint32_t i = 0; i < tree.motionCount; i++)
+	{
+		Resources::Animation* animation = machine.motionAnimations[tree.firstMotion + i];
+		if (!animation->HasBeenSent() || animation->KeyCount == 0)
+			weights[i] = 0.f;
+		total += weights[i];
 	}
+	for (uint32_t i = 0; i < tree.motionCount; i++)
+		weights[i] = total > 0.f ? weights[i] / total : 0.f;
+}
 
-	animator->IncrementTime(animator->m_currentState->animation);
+float Resources::AnimationController::GetStateLength(const CompiledStateMachine& machine, const CompiledState& state, const float* weights) const
+{
+	if (state.blendTree < 0)
+		return state.animation && state.animation->HasBeenSent() ? (float)state.animation->KeyCount : 0.f;
 
-	auto skel = animator->m_skeletalMesh->GetSkeleton();
-	if (skel && skel->RootBone)
+	const CompiledBlendTree& tree = machine.blendTrees[state.blendTree];
+	float length = 0.f;
+	for (uint32_t i = 0; i < tree.motionCount; i++)
 	{
-		skel->RootBone->CrossUpdate(animator->m_transitionLink->transitionDuration, animator->m_elapsedTime, animator->m_lastAnimation, animator->m_transitionLink->state2->animation);
+		if (weights[i] > 0.f)
+			length += weights[i] * (float)machine.motionAnimations[tree.firstMotion + i]->KeyCount;
 	}
+	return length;
+}
 
-	animator->m_elapsedTime += WrapperUI::GetDeltaTime();
-	if (animator->m_elapsedTime >= animator->m_transitionLink->transitionDuration)
+Resources::BlendPose& Resources::AnimationController::SampleState(Skeleton* skel, const CompiledStateMachine& machine, const CompiledState& state, float time, const float* weights, size_t slot) const
+{
+	PoseSlot& output = skel->GetPoseSlot(slot);
+	if (state.blendTree < 0)
 	{
-		animator->m_currentTime = 0.f;
-		animator->m_transitionLink = nullptr;
+		skel->SampleBlendPose(state.animation, time, output.pose, &output.cursor);
+		return output.pose;
 	}
+
+	const CompiledBlendTree& tree = machine.blendTrees[state.blendTree];
+	const float length = GetStateLength(machine, state, weights);
+	const BlendPose* poses[BlendTree::MaxMotions];
+	float poseWeights[BlendTree::MaxMotions];
+	size_t count = 0;
+	for (uint32_t i = 0; i < tree.motionCount; i++)
+	{
+		if (weights[i] <= 0.f)
+			continue;
+		Resources::Animation* animation = machine.motionAnimations[tree.firstMotion + i];
+		PoseSlot& motion = skel->GetPoseSlot(slot + 1 + i);
+		// Every motion is at the same normalized time so the cycles stay in phase
+		skel->SampleBlendPose(animation, time / length * (float)animation->KeyCount, motion.pose, &motion.cursor);
+		poses[count] = &motion.pose;
+		poseWeights[count] = weights[i];
+		count++;
+	}
+
+	if (count > 0)
+		PoseBlending::BlendN(poses, poseWeights, count, output.pose);
+	else
+		skel->SampleBlendPose(nullptr, 0.f, output.pose);
+	return output.pose;
 }
 
-void Resources::AnimationController::UpdateAnimation(Component::Animator* animator, Resources::Animation* anim)
+Resources::BlendPose& Resources::AnimationController::SampleAdditiveReference(Skeleton* skel, const CompiledStateMachine& machine, const AnimatorStateBlock& block, const Component::Animator* animator, size_t slot) const
 {
-	if (!anim || !anim->HasBeenSent())
-		return;
-	animator->IncrementTime(anim);
+	// The previous state plays until the exit time of the transition
+	int index = block.currentState;
+	if (block.transition >= 0 && machine.transitions[block.transition].hasExitTime && !block.endExitTime && block.previousState >= 0)
+		index = block.previousState;
+
+	const CompiledState& state = machine.states[index];
+	float weights[BlendTree::MaxMotions];
+	ComputeBlendWeights(machine, state, animator, weights);
+	if (GetStateLength(machine, state, weights) > 0.f)
+		return SampleState(skel, machine, state, 0.f, weights, slot);
+
+	PoseSlot& output = skel->GetPoseSlot(slot);
+	skel->SampleBlendPose(nullptr, 0.f, output.pose);
+	return output.pose;
+}
 
-	auto skel = animator->m_skeletalMesh->GetSkeleton();
-	if (skel && skel->RootBone)
+// Graph version of the controller of a layer, the controllers still loading have none
+static uint32_t GetLayerVersion(Resources::AnimationController* controller)
+{
+	return controller && controller->HasBeenSent() ? controller->GetGraphVersion() : (uint32_t)-1;
+}
+
+const Resources::CompiledStateMachine& Resources::AnimationController::GetStateMachine()
+{
+	bool layersChanged = m_layerVersions.size() != layers.size();
+	for (size_t i = 0; i < layers.size() && !layersChanged; i++)
+		layersChanged = m_layerVersions[i] != GetLayerVersion(layers[i].controller);
+	if (layersChanged)
+		MarkGraphDirty();
+
+	if (m_compiledVersion != m_graphVersion)
+		Compile();
+	return m_stateMachine;
+}
+
+// Blend tree of a state, the motions without animation are dropped
+static int CompileBlendTree(const Resources::BlendTree& tree, const std::vector<Resources::AnimatorParameter>& parameters, Resources::CompiledStateMachine& machine)
+{
+	using namespace Resources;
+	auto floatParameter = [&](int index) { return index >= 0 && index < (int)parameters.size() && parameters[index].type == AnimatorParameterType::Float ? index : -1; };
+
+	CompiledBlendTree compiled;
+	compiled.type = tree.type;
+	compiled.parameterX = floatParameter(tree.parameterX);
+	compiled.parameterY = tree.type == BlendTreeType::Freeform2D ? floatParameter(tree.parameterY) : -1;
+	compiled.firstMotion = (uint32_t)machine.motionAnimations.size();
+	for (const BlendTreeMotion& motion : tree.motions)
 	{
-		skel->RootBone->UpdateBone(anim, animator->m_currentTime);
+		if (!motion.animation || machine.motionAnimations.size() - compiled.firstMotion >= BlendTree::MaxMotions)
+			continue;
+		machine.motionAnimations.push_back(motion.animation);
+		machine.motionPositions.push_back(motion.position);
+	}
+	compiled.motionCount = (uint32_t)machine.motionAnimations.size() - compiled.firstMotion;
+	machine.blendTrees.push_back(compiled);
+	return (int)machine.blendTrees.size() - 1;
+}
+
+// Compile one editor condition, nullopt for the conditions without parameter that are ignored
+static std::optional<Resources::ConditionInstruction> CompileCondition(const Resources::Condition& condition, const std::vector<Resources::AnimatorParameter>& parameters)
+{
+	using namespace Resources;
+	if (condition.parameter < 0)
+		return std::nullopt;
+
+	ConditionInstruction instruction = { ConditionOp::Never, 0, {} };
+	if (condition.parameter >= (int)parameters.size())
+		return instruction;
+
+	instruction.parameter = (uint16_t)condition.parameter;
+	switch (parameters[condition.parameter].type)
+	{
+	case AnimatorParameterType::Bool:
+		instruction.op = condition.mode == ConditionMode::IfNot ? ConditionOp::BoolFalse : ConditionOp::BoolTrue;
+		break;
+	case AnimatorParameterType::Trigger:
+		instruction.op = ConditionOp::Trigger;
+		break;
+	case AnimatorParameterType::Float:
+		instruction.operand.f = condition.threshold;
+		if (condition.mode == ConditionMode::Greater)
+			instruction.op = ConditionOp::FloatGreater;
+		else if (condition.mode == ConditionMode::Less)
+			instruction.op = ConditionOp::FloatLess;
+		break;
+	case AnimatorParameterType::Int:
+		instruction.operand.i = (int)condition.threshold;
+		switch (condition.mode)
+		{
+		case ConditionMode::Greater:	instruction.op = ConditionOp::IntGreater; break;
+		case ConditionMode::Less:		instruction.op = ConditionOp::IntLess; break;
+		case ConditionMode::Equals:		instruction.op = ConditionOp::IntEquals; break;
+		case ConditionMode::NotEqual:	instruction.op = ConditionOp::IntNotEqual; break;
+		default:						break;
+		}
+		break;
+	}
+	return instruction;
+}
+
+void Resources::AnimationController::Compile()
+{
+	CompiledStateMachine machine;
+	CompileGraph(parameters, machine);
+	m_stateMachine = std::move(machine);
+
+	// The graph of a layer reads the parameter values of this controller
+	m_compiledLayers.assign(layers.size(), CompiledLayer());
+	m_layerVersions.resize(layers.size());
+	for (size_t i = 0; i < layers.size(); i++)
+	{
+		const AnimationLayer& layer = layers[i];
+		CompiledLayer& compiled = m_compiledLayers[i];
+		compiled.weight = std::clamp(layer.weight, 0.f, 1.f);
+		compiled.mode = layer.mode;
+		compiled.mask = layer.mask;
+		m_layerVersions[i] = GetLayerVersion(layer.controller);
+		// The layers of the controller of a layer are not played
+		if (layer.controller && layer.controller != this && layer.controller->HasBeenSent())
+			layer.controller->CompileGraph(parameters, compiled.machine);
+	}
+	m_compiledVersion = m_graphVersion;
+}
+
+void Resources::AnimationController::CompileGraph(const std::vector<AnimatorParameter>& animatorParameters, CompiledStateMachine& machine)
+{
+	// Index of each parameter of this controller in "animatorParameters", -1 when it has no value there
+	std::vector<int> remap(parameters.size(), -1);
+	for (size_t i = 0; i < parameters.size(); i++)
+	{
+		for (size_t j = 0; j < animatorParameters.size(); j++)
+		{
+			if (animatorParameters[j].id == parameters[i].id && animatorParameters[j].type == parameters[i].type)
+			{
+				remap[i] = (int)j;
+				break;
+			}
+		}
+	}
+	auto remapParameter = [&](int index) { return index >= 0 && index < (int)remap.size() ? remap[index] : -1; };
+
+	// Integer ids for the states, the AnyState only keeps its transitions
+	StateRect* anyState = GetStateByName("AnyState");
+	if (!anyState)
+		anyState = GetStateByName("Any State");
+
+	std::unordered_map<const StateRect*, int> stateIndices;
+	std::vector<const StateRect*> sources;
+	for (auto& [name, state] : states)
+	{
+		if (state == anyState)
+			continue;
+		stateIndices[state] = (int)machine.states.size();
+		sources.push_back(state);
+
+		CompiledState compiled;
+		compiled.animation = state->animation;
+		compiled.speed = state->speed;
+		compiled.loop = state->loop;
+		if (state->useBlendTree)
+		{
+			BlendTree tree = state->blendTree;
+			tree.parameterX = remapParameter(tree.parameterX);
+			tree.parameterY = remapParameter(tree.parameterY);
+			compiled.blendTree = CompileBlendTree(tree, animatorParameters, machine);
+		}
+		machine.states.push_back(compiled);
+	}
+	if (StateRect* entry = GetStateByName("Entry"))
+		machine.entryState = stateIndices[entry];
+
+	auto compileTransitions = [&](const StateRect* source)
+	{
+		uint32_t first = (uint32_t)machine.transitions.size();
+		for (const Link* link : links)
+		{
+			if (link->state1 != source || !link->state2 || !stateIndices.count(link->state2))
+				continue;
+
+			CompiledTransition transition;
+			transition.target = stateIndices[link->state2];
+			transition.hasExitTime = link->hasExitTime;
+			transition.exitTime = link->exitTime;
+			transition.duration = link->transitionDuration;
+			transition.firstCondition = (uint32_t)machine.conditions.size();
+			for (Condition condition : link->conditions)
+			{
+				// A parameter without value never passes
+				if (condition.parameter >= 0)
+				{
+					int index = remapParameter(condition.parameter);
+					condition.parameter = index >= 0 ? index : (int)animatorParameters.size();
+				}
+				if (auto instruction = CompileCondition(condition, animatorParameters))
+					machine.conditions.push_back(*instruction);
+			}
+			transition.conditionCount = (uint32_t)machine.conditions.size() - transition.firstCondition;
+			machine.transitions.push_back(transition);
+		}
+		return std::make_pair(first, (uint32_t)machine.transitions.size() - first);
+	};
+
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		auto [first, count] = compileTransitions(sources[i]);
+		machine.states[i].firstTransition = first;
+		machine.states[i].transitionCount = count;
+	}
+	if (anyState)
+	{
+		auto [first, count] = compileTransitions(anyState);
+		machine.firstAnyTransition = first;
+		machine.anyTransitionCount = count;
 	}
 }
 
@@ -214,68 +625,134 @@ Resources::StateRect* Resources::AnimationController::GetStateByName(const std::
 	return nullptr;
 }
 
-void Resources::AnimationController::AddParameter(std::string name)
+// First valid condition mode for a parameter type
+static Resources::ConditionMode DefaultConditionMode(Resources::AnimatorParameterType type)
 {
-	if (parameters.count(name) > 0) {
-		// if the key already exists, add a number at the end until a new key is formed
+	switch (type)
+	{
+	case Resources::AnimatorParameterType::Float:	return Resources::ConditionMode::Greater;
+	case Resources::AnimatorParameterType::Int:		return Resources::ConditionMode::Equals;
+	default:										return Resources::ConditionMode::If;
+	}
+}
+
+void Resources::AnimationController::AddParameter(std::string name, AnimatorParameterType type)
+{
+	if (GetParameterIndex(name) >= 0) {
+		// if the name already exists, add a number at the end until a new name is formed
 		int i = 1;
 		std::string newKey = name + std::to_string(i);
-		while (parameters.count(newKey) > 0) {
+		while (GetParameterIndex(newKey) >= 0) {
 			i++;
 			newKey = name + std::to_string(i);
 		}
-		// insert the new key-value pair into the map
-		parameters[newKey] = false;
-	}
-	else {
-		// insert the key-value pair directly into the map
-		parameters[name] = false;
+		name = newKey;
 	}
+	AnimatorParameter parameter;
+	parameter.name = name;
+	parameter.id = Component::Animator::StringToHash(name);
+	parameter.type = type;
+	parameters.push_back(parameter);
+
+	parameterVersion++;
+	MarkGraphDirty();
 	parameterUpdated = true;
 }
 
 void Resources::AnimationController::RenameParameter(const std::string name, const std::string newName)
 {
-	auto it = parameters.find(name);
-	if (it != parameters.end())
+	int index = GetParameterIndex(name);
+	if (index < 0 || GetParameterIndex(newName) >= 0)
+		return;
+
+	// Conditions reference the parameter by index, they don't change
+	parameters[index].name = newName;
+	parameters[index].id = Component::Animator::StringToHash(newName);
+	parameterVersion++;
+	MarkGraphDirty();
+	parameterUpdated = true;
+}
+
+void Resources::AnimationController::DeleteParameter(const std::string& name)
+{
+	int index = GetParameterIndex(name);
+	if (index < 0)
+		return;
+
+	// Remove the conditions on this parameter and shift the indices after it
+	auto shiftIndex = [index](int& parameter)
+	{
+		if (parameter == index)
+			parameter = -1;
+		else if (parameter > index)
+			parameter--;
+	};
+	for (auto& [stateName, state] : states)
+	{
+		shiftIndex(state->blendTree.parameterX);
+		shiftIndex(state->blendTree.parameterY);
+	}
+	for (auto& link : links)
 	{
-		parameters[newName] = it->second;
-		// Check if a link get this parameter.
-		for (auto& link : links)
+		for (int i = 0; i < link->conditions.size(); i++)
 		{
-			for (int i = 0; i < link->conditions.size(); i++)
+			if (link->conditions[i].parameter == index)
 			{
-				if (link->conditions[i].first->first == name)
-				{
-					link->conditions[i] = std::make_pair(&(*parameters.find(newName)), link->conditions[i].second);
-				}
+				link->conditions.erase(link->conditions.begin() + i);
+				i--;
+			}
+			else if (link->conditions[i].parameter > index)
+			{
+				link->conditions[i].parameter--;
 			}
 		}
-		parameters.erase(it);
 	}
+	parameters.erase(parameters.begin() + index);
+	parameterVersion++;
+	MarkGraphDirty();
 	parameterUpdated = true;
 }
 
-void Resources::AnimationController::DeleteParameter(const std::string& name)
+void Resources::AnimationController::SetParameterType(int index, AnimatorParameterType type)
 {
-	if (parameters.count(name))
+	if (index < 0 || index >= (int)parameters.size() || parameters[index].type == type)
+		return;
+
+	parameters[index].type = type;
+	parameters[index].defaultValue = {};
+	for (auto& link : links)
 	{
-		// Check if a link get this parameter.
-		for (auto& link : links)
+		for (auto& condition : link->conditions)
 		{
-			for (int i = 0; i < link->conditions.size(); i++)
-			{
-				if (link->conditions[i].first->first == name)
-				{
-					link->conditions.erase(link->conditions.begin() + i);
-				}
-			}
+			if (condition.parameter == index)
+				condition.mode = DefaultConditionMode(type);
 		}
-		parameters.erase(name);
 	}
+	parameterVersion++;
+	MarkGraphDirty();
 	parameterUpdated = true;
 }
 
+int Resources::AnimationController::GetParameterIndex(int id) const
+{
+	for (int i = 0; i < (int)parameters.size(); i++)
+	{
+		if (parameters[i].id == id)
+			return i;
+	}
+	return -1;
+}
+
+int Resources::AnimationController::GetParameterIndex(const std::string& name) const
+{
+	for (int i = 0; i < (int)parameters.size(); i++)
+	{
+		if (parameters[i].name == name)
+			return i;
+	}
+	return -1;
+}
+
 Resources::StateRect* Resources::AnimationController::AddState(std::string name, Math::Vector2 pos, const Math::Vector4& color)
 {
 	std::string newKey = name;
@@ -294,6 +771,7 @@ Resources::StateRect* Resources::AnimationController::AddState(std::string name,
 		// insert the key-value pair directly into the map
 		states[newKey] = (new StateRect{ newKey, nullptr, pos, color });
 	}
+	MarkGraphDirty();
 	return states[newKey];
 }
 
@@ -304,6 +782,7 @@ void Resources::AnimationController::RenameState(const std::string name, const s
 	{
 		states[newName] = it->second;
 		states.erase(it);
+		MarkGraphDirty();
 	}
 }
 
@@ -327,6 +806,7 @@ void Resources::AnimationController::RemoveState(StateRect* _state)
 			delete state.second;
 			state.second = nullptr;
 			states.erase(state.first);
+			MarkGraphDirty();
 			break;
 		}
 		index++;
@@ -338,6 +818,7 @@ Resources::Link* Resources::AnimationController::AddLink(StateRect* state1, Stat
 {
 	links.push_back(new Link{ state1, state2 });
 	links.back()->animC = this;
+	MarkGraphDirty();
 	return links.back();
 }
 
@@ -366,6 +847,7 @@ void Resources::AnimationController::RemoveLink(Link* _link)
 			delete link;
 			link = nullptr;
 			links.erase(links.begin() + index);
+			MarkGraphDirty();
 			break;
 		}
 		index++;
@@ -379,25 +861,105 @@ void Resources::AnimationController::ShowInInspector()
 	auto animatorWindow = Core::App::Get().GetEditorUIManager().GetAnimatorWindow();
 	if (animatorWindow.m_linkSelected)
 	{
-		animatorWindow.m_linkSelected->ShowInInspector();
+		if (animatorWindow.m_linkSelected->ShowInInspector())
+			MarkGraphDirty();
 	}
 	else if (animatorWindow.m_stateSelected)
 	{
 		std::string lastName = animatorWindow.m_stateSelected->name;
-		animatorWindow.m_stateSelected->ShowInInspector();
+		if (animatorWindow.m_stateSelected->ShowInInspector(this))
+			MarkGraphDirty();
 		if (lastName != animatorWindow.m_stateSelected->name)
 		{
 			RenameState(lastName, animatorWindow.m_stateSelected->name);
 		}
 	}
+	ShowLayersInInspector();
 #endif
 }
 
+void Resources::AnimationController::ShowLayersInInspector()
+{
+	if (!WrapperUI::CollapsingHeader("Layers"))
+		return;
 
-void Resources::StateRect::ShowInInspector()
+	bool changed = false;
+	if (WrapperUI::Button("Add Layer"))
+	{
+		layers.push_back(AnimationLayer());
+		layers.back().name = "Layer " + std::to_string(layers.size());
+		changed = true;
+	}
+
+	for (int i = 0; i < (int)layers.size(); i++)
+	{
+		AnimationLayer& layer = layers[i];
+		WrapperUI::PushID(i);
+		WrapperUI::Separator();
+
+		char name[64];
+		strcpy_s(name, 64, layer.name.c_str());
+		if (WrapperUI::InputText("Name", name, 64, InputTextFlags::EnterReturnsTrue))
+			layer.name = name;
+
+		// The states and links of another controller
+		if (WrapperUI::Button("State Machine"))
+			WrapperUI::OpenPopup("LayerPopup");
+		if (auto controller = Resources::ResourcesManager::Get()->ResourcePopup<Resources::AnimationController>("LayerPopup"))
+		{
+			layer.controller = Resources::ResourcesManager::Get()->GetOrLoad<Resources::AnimationController>(controller->GetPath());
+			changed = true;
+		}
+		WrapperUI::SameLine();
+		WrapperUI::TextUnformatted(layer.controller ? layer.controller->GetName().c_str() : "None");
+
+		changed |= WrapperUI::SliderFloat("Weight", &layer.weight, 0.f, 1.f);
+		int mode = (int)layer.mode;
+		if (WrapperUI::Combo("Blending", &mode, "Override\0Additive\0"))
+		{
+			layer.mode = (BlendMode)mode;
+			changed = true;
+		}
+
+		// Indexed like the bones of the skeleton
+		if (WrapperUI::Button("Add Bone Weight"))
+		{
+			layer.mask.weights.push_back(1.f);
+			changed = true;
+		}
+		WrapperUI::SameLine();
+		WrapperUI::BeginDisabled(layer.mask.weights.empty());
+		if (WrapperUI::Button("Remove Bone Weight"))
+		{
+			layer.mask.weights.pop_back();
+			changed = true;
+		}
+		WrapperUI::EndDisabled();
+		for (int bone = 0; bone < (int)layer.mask.weights.size(); bone++)
+		{
+			std::string label = "Bone " + std::to_string(bone);
+			changed |= WrapperUI::SliderFloat(label.c_str(), &layer.mask.weights[bone], 0.f, 1.f);
+		}
+
+		bool removed = WrapperUI::Button("Remove Layer");
+		WrapperUI::PopID();
+		if (removed)
+		{
+			layers.erase(layers.begin() + i);
+			changed = true;
+			break;
+		}
+	}
+	if (changed)
+		MarkGraphDirty();
+}
+
+
+bool Resources::StateRect::ShowInInspector(AnimationController* animC)
 {
 	if (color != Vector4(0.97f, 0.469f, 0.0f, 1.0f))
-		return;
+		return false;
+	bool changed = false;
 	char Name[64];
 	strcpy_s(Name, 64, name.c_str());
 	if (WrapperUI::InputText("Rename", Name, 64, InputTextFlags::EnterReturnsTrue))
@@ -411,80 +973,191 @@ void Resources::StateRect::ShowInInspector()
 	if (auto anim = Resources::ResourcesManager::Get()->ResourcePopup<Resources::Animation>("AnimationPopup"))
 	{
 		this->animation = Resources::ResourcesManager::Get()->GetOrLoad<Resources::Animation>(anim->GetPath());
+		changed = true;
 	}
 	WrapperUI::SameLine();
 	WrapperUI::TextUnformatted(this->animation ? this->animation->GetName().c_str() : "None");
-	WrapperUI::InputFloat("Speed", &speed);
-	WrapperUI::Checkbox("Loop", &loop);
+	changed |= WrapperUI::InputFloat("Speed", &speed);
+	changed |= WrapperUI::Checkbox("Loop", &loop);
+
+	WrapperUI::Separator();
+	changed |= WrapperUI::Checkbox("Blend Tree", &useBlendTree);
+	if (!useBlendTree)
+		return changed;
+
+	const char* types[] = { "1D", "2D Freeform" };
+	int type = (int)blendTree.type;
+	if (WrapperUI::Combo("Type", &type, types, 2))
+	{
+		blendTree.type = (BlendTreeType)type;
+		changed = true;
+	}
+
+	// Only the float parameters can drive the blend
+	std::vector<const char*> options = { "None" };
+	std::vector<int> indices = { -1 };
+	for (int i = 0; i < (int)animC->parameters.size(); i++)
+	{
+		if (animC->parameters[i].type != AnimatorParameterType::Float)
+			continue;
+		options.push_back(animC->parameters[i].name.c_str());
+		indices.push_back(i);
+	}
+	auto parameterCombo = [&](const char* label, int& parameter)
+	{
+		int selected = (int)(std::find(indices.begin(), indices.end(), parameter) - indices.begin());
+		if (selected >= (int)indices.size())
+			selected = 0;
+		if (WrapperUI::Combo(label, &selected, options.data(), (int)options.size()))
+		{
+			parameter = indices[selected];
+			changed = true;
+		}
+	};
+	parameterCombo("Parameter X", blendTree.parameterX);
+	if (blendTree.type == BlendTreeType::Freeform2D)
+		parameterCombo("Parameter Y", blendTree.parameterY);
+
+	WrapperUI::BeginDisabled(blendTree.motions.size() >= BlendTree::MaxMotions);
+	if (WrapperUI::Button("Add Motion"))
+	{
+		blendTree.motions.push_back(BlendTreeMotion());
+		changed = true;
+	}
+	WrapperUI::EndDisabled();
+
+	for (int i = 0; i < (int)blendTree.motions.size(); i++)
+	{
+		BlendTreeMotion& motion = blendTree.motions[i];
+		WrapperUI::PushID(i);
+		if (WrapperUI::Button("Motion"))
+			WrapperUI::OpenPopup("MotionPopup");
+		if (auto anim = Resources::ResourcesManager::Get()->ResourcePopup<Resources::Animation>("MotionPopup"))
+		{
+			motion.animation = Resources::ResourcesManager::Get()->GetOrLoad<Resources::Animation>(anim->GetPath());
+			changed = true;
+		}
+		WrapperUI::SameLine();
+		WrapperUI::TextUnformatted(motion.animation ? motion.animation->GetName().c_str() : "None");
+		if (blendTree.type == BlendTreeType::Simple1D)
+			changed |= WrapperUI::DragFloat("Threshold", &motion.position.x, 0.01f);
+		else
+			changed |= WrapperUI::DragFloat2("Position", &motion.position.x, 0.01f);
+		bool removed = WrapperUI::Button("Remove");
+		WrapperUI::PopID();
+		if (removed)
+		{
+			blendTree.motions.erase(blendTree.motions.begin() + i);
+			changed = true;
+			break;
+		}
+	}
+	return changed;
 }
 
-void Resources::Link::ShowInInspector()
+bool Resources::Link::ShowInInspector()
 {
-	WrapperUI::Checkbox("Has Exit Time", &hasExitTime);
+	bool changed = false;
+	changed |= WrapperUI::Checkbox("Has Exit Time", &hasExitTime);
 	WrapperUI::BeginDisabled(!hasExitTime);
-	WrapperUI::InputFloat("Exit Time", &exitTime);
+	changed |= WrapperUI::InputFloat("Exit Time", &exitTime);
 	WrapperUI::EndDisabled();
-	WrapperUI::DragFloat("Transition Duration", &transitionDuration);
+	changed |= WrapperUI::DragFloat("Transition Duration", &transitionDuration);
 	WrapperUI::Separator();
 	if (WrapperUI::Button("Add Condition"))
 	{
-		this->conditions.push_back(std::make_pair(nullptr, true));
+		this->conditions.push_back(Condition());
+		changed = true;
 	}
-	int i = 0;
 	// Define an array of option strings for the combo box
 	std::vector<const char*> options;
 	for (auto& parameter : animC->parameters)
 	{
-		options.push_back(parameter.first.c_str());
+		options.push_back(parameter.name.c_str());
 	}
 	const char** optionPtrs = options.data();
 	int numOptions = static_cast<int>(options.size());
 
-	for (auto& condition : conditions)
+	for (int i = 0; i < conditions.size(); i++)
 	{
+		Condition& condition = conditions[i];
 		WrapperUI::PushID(i);
 
-		// Get the index of the currently selected option
-		int selectedIndex = -1;
-		for (int j = 0; j < numOptions; j++)
-		{
-			if (condition.first != nullptr && strcmp(condition.first->first.c_str(), options[j]) == 0)
-			{
-				selectedIndex = j;
-				break;
-			}
-		}
-
-
 		// Show the combo box and update the selected option
+		int selectedIndex = condition.parameter;
 		if (WrapperUI::Combo("##conditionCombo", &selectedIndex, optionPtrs, numOptions))
 		{
 			if (selectedIndex >= 0 && selectedIndex < numOptions)
 			{
-				const char* selectedOption = options[selectedIndex];
-				condition.first = &(*animC->parameters.find(selectedOption));
+				condition.parameter = selectedIndex;
+				condition.mode = DefaultConditionMode(animC->parameters[selectedIndex].type);
 			}
 			else
 			{
-				condition.first = nullptr;
+				condition.parameter = -1;
 			}
+			animC->parameterUpdated = true;
+			changed = true;
 		}
-		if (condition.first != nullptr)
+		if (condition.parameter >= 0 && condition.parameter < numOptions)
 		{
-			WrapperUI::SameLine();
-			if (WrapperUI::Checkbox("##conditionCheckbox", &condition.second))
+			switch (animC->parameters[condition.parameter].type)
+			{
+			case AnimatorParameterType::Bool:
 			{
-				animC->parameterUpdated = true;
+				bool value = condition.mode != ConditionMode::IfNot;
+				WrapperUI::SameLine();
+				if (WrapperUI::Checkbox("##conditionCheckbox", &value))
+				{
+					condition.mode = value ? ConditionMode::If : ConditionMode::IfNot;
+					animC->parameterUpdated = true;
+					changed = true;
+				}
+				break;
+			}
+			case AnimatorParameterType::Float:
+			case AnimatorParameterType::Int:
+			{
+				// Greater and Less for floats, every mode for ints
+				bool isInt = animC->parameters[condition.parameter].type == AnimatorParameterType::Int;
+				int mode = (int)condition.mode - (int)ConditionMode::Greater;
+				WrapperUI::SameLine();
+				WrapperUI::SetNextItemWidth(80.f);
+				if (WrapperUI::Combo("##conditionMode", &mode, isInt ? "Greater\0Less\0Equals\0NotEqual\0" : "Greater\0Less\0"))
+				{
+					condition.mode = (ConditionMode)(mode + (int)ConditionMode::Greater);
+					changed = true;
+				}
+				WrapperUI::SameLine();
+				WrapperUI::SetNextItemWidth(80.f);
+				if (isInt)
+				{
+					int threshold = (int)condition.threshold;
+					if (WrapperUI::InputInt("##conditionThreshold", &threshold, 0, 0))
+					{
+						condition.threshold = (float)threshold;
+						changed = true;
+					}
+				}
+				else
+				{
+					changed |= WrapperUI::InputFloat("##conditionThreshold", &condition.threshold);
+				}
+				break;
+			}
+			default:
+				break;
 			}
 		}
 		WrapperUI::SameLine();
 		if (WrapperUI::Button("Remove"))
 		{
 			conditions.erase(conditions.begin() + i);
+			i--;
+			changed = true;
 		}
-		i++;
 		WrapperUI::PopID();
 	}
-
+	return changed;
 }
 
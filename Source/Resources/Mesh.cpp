@@ -259,34 +259,18 @@ void Resources::Mesh::Render(const Math::Matrix4& MVP, const Math::Matrix4& mode
 			WrapperRHI::DepthRange({ 0.2f , 1 });
 		}
 #endif
-
-		if (mat->GetMetallicMap()) {
-			mat->GetMetallicMap()->Active(3);
-			mat->GetMetallicMap()->UnBind();
-		}
-		if (mat->GetRoughnessMap()) {
-			mat->GetRoughnessMap()->Active(2);
-			mat->GetRoughnessMap()->UnBind();
-		}
-		if (mat->GetNormalMap()) {
-			mat->GetNormalMap()->Active(1);
-			mat->GetNormalMap()->UnBind();
-		}
-		if (mat->GetTexture()) {
-			mat->GetTexture()->Active(0);
-			mat->GetTexture()->UnBind();
-		}
-
 	}
 
+	// The textures stay bound, the next submesh with the same material does not bind them again
+	WrapperRHI::ActivateTexture(0);
 	WrapperRHI::DisableStencil();
 
 }
 
-void Resources::Mesh::RenderInstancing(class Material* material, class Shader* shader, size_t count, WrapperRHI::Buffer* buffer /*= nullptr*/)
+bool Resources::Mesh::BeginInstancing(class Material* material, class Shader* shader, WrapperRHI::Buffer* buffer)
 {
 	if (!m_buffer || !shader || !shader->HasBeenSent() || !material)
-		return;
+		return false;
 	if (!buffer)
 		m_buffer->Bind();
 	else
@@ -334,7 +318,23 @@ void Resources::Mesh::RenderInstancing(class Material* material, class Shader* s
 		WrapperRHI::ShaderSendFloat(shader->GetLocation("metallicValue"), material->metallic);
 	}
 	WrapperRHI::ShaderSendVec4(shader->GetLocation("ourColor"), material->GetDiffuse());
-	WrapperRHI::DrawInstance(0, m_subMeshes[0].Count, count);
+	return true;
+}
+
+void Resources::Mesh::RenderInstancing(class Material* material, class Shader* shader, size_t count, WrapperRHI::Buffer* buffer /*= nullptr*/)
+{
+	if (!BeginInstancing(material, shader, buffer))
+		return;
+	// The submeshes follow each other, all of them are drawn with the first material
+	const SubMesh& last = m_subMeshes.back();
+	WrapperRHI::DrawInstance(0, last.StartIndex + last.Count, count);
+}
+
+void Resources::Mesh::RenderInstancingIndirect(class Material* material, class Shader* shader, size_t offset, WrapperRHI::Buffer* buffer /*= nullptr*/)
+{
+	if (!BeginInstancing(material, shader, buffer))
+		return;
+	WrapperRHI::DrawInstanceIndirect(offset);
 }
 
 void Resources::Mesh::RenderInstancingPicking(class Shader* shader, size_t count, int ID)
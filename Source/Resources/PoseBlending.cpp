@@ -0,0 +1,347 @@
+#include "pch.h"
+#include <Resources/PoseBlending.h>
+
+#include <xmmintrin.h>
+
+#pragma region BlendPose
+
+void Resources::BlendPose::Resize(size_t boneCount)
+{
+	count = boneCount;
+	size_t padded = (boneCount + 3) & ~size_t(3);
+	tx.resize(padded, 0.f);
+	ty.resize(padded, 0.f);
+	tz.resize(padded, 0.f);
+	qx.resize(padded, 0.f);
+	qy.resize(padded, 0.f);
+	qz.resize(padded, 0.f);
+	qw.resize(padded, 1.f);
+}
+
+void Resources::BlendPose::SetIdentity()
+{
+	std::fill(tx.begin(), tx.end(), 0.f);
+	std::fill(ty.begin(), ty.end(), 0.f);
+	std::fill(tz.begin(), tz.end(), 0.f);
+	std::fill(qx.begin(), qx.end(), 0.f);
+	std::fill(qy.begin(), qy.end(), 0.f);
+	std::fill(qz.begin(), qz.end(), 0.f);
+	std::fill(qw.begin(), qw.end(), 1.f);
+}
+
+void Resources::BlendPose::SetBone(size_t index, const Math::Vector3& position, const Math::Quaternion& rotation)
+{
+	tx[index] = position.x;
+	ty[index] = position.y;
+	tz[index] = position.z;
+	qx[index] = rotation.x;
+	qy[index] = rotation.y;
+	qz[index] = rotation.z;
+	qw[index] = rotation.w;
+}
+
+Math::Vector3 Resources::BlendPose::GetPosition(size_t index) const
+{
+	return Math::Vector3(tx[index], ty[index], tz[index]);
+}
+
+Math::Quaternion Resources::BlendPose::GetRotation(size_t index) const
+{
+	return Math::Quaternion(qx[index], qy[index], qz[index], qw[index]);
+}
+
+#pragma endregion
+
+#pragma region Kernels
+
+// 4 bones, one register per channel
+struct PoseLanes
+{
+	__m128 tx, ty, tz;
+	__m128 qx, qy, qz, qw;
+};
+
+static inline PoseLanes LoadLanes(const Resources::BlendPose& pose, size_t i)
+{
+	return {
+		_mm_loadu_ps(&pose.tx[i]), _mm_loadu_ps(&pose.ty[i]), _mm_loadu_ps(&pose.tz[i]),
+		_mm_loadu_ps(&pose.qx[i]), _mm_loadu_ps(&pose.qy[i]), _mm_loadu_ps(&pose.qz[i]), _mm_loadu_ps(&pose.qw[i]) };
+}
+
+static inline void StoreLanes(Resources::BlendPose& pose, size_t i, const PoseLanes& lanes)
+{
+	_mm_storeu_ps(&pose.tx[i], lanes.tx);
+	_mm_storeu_ps(&pose.ty[i], lanes.ty);
+	_mm_storeu_ps(&pose.tz[i], lanes.tz);
+	_mm_storeu_ps(&pose.qx[i], lanes.qx);
+	_mm_storeu_ps(&pose.qy[i], lanes.qy);
+	_mm_storeu_ps(&pose.qz[i], lanes.qz);
+	_mm_storeu_ps(&pose.qw[i], lanes.qw);
+}
+
+// Weight of 4 bones, the bones missing from the mask keep the full weight
+static inline __m128 LoadWeights(float weight, const Resources::BoneMask* mask, size_t i)
+{
+	__m128 result = _mm_set1_ps(weight);
+	if (!mask)
+		return result;
+
+	float lanes[4];
+	for (size_t k = 0; k < 4; k++)
+		lanes[k] = i + k < mask->weights.size() ? mask->weights[i + k] : 1.f;
+	return _mm_mul_ps(result, _mm_loadu_ps(lanes));
+}
+
+static inline __m128 MultiplyAdd(__m128 a, __m128 b, __m128 c)
+{
+	return _mm_add_ps(_mm_mul_ps(a, b), c);
+}
+
+static inline __m128 Dot(const PoseLanes& a, const PoseLanes& b)
+{
+	__m128 dot = _mm_mul_ps(a.qx, b.qx);
+	dot = MultiplyAdd(a.qy, b.qy, dot);
+	dot = MultiplyAdd(a.qz, b.qz, dot);
+	return MultiplyAdd(a.qw, b.qw, dot);
+}
+
+// Flips the rotations of "lanes" where the dot product is negative, to blend on the shortest path
+static inline void AlignRotations(PoseLanes& lanes, __m128 dot)
+{
+	__m128 sign = _mm_and_ps(dot, _mm_set1_ps(-0.f));
+	lanes.qx = _mm_xor_ps(lanes.qx, sign);
+	lanes.qy = _mm_xor_ps(lanes.qy, sign);
+	lanes.qz = _mm_xor_ps(lanes.qz, sign);
+	lanes.qw = _mm_xor_ps(lanes.qw, sign);
+}
+
+static inline void NormalizeRotations(PoseLanes& lanes)
+{
+	__m128 lengthSq = _mm_mul_ps(lanes.qx, lanes.qx);
+	lengthSq = MultiplyAdd(lanes.qy, lanes.qy, lengthSq);
+	lengthSq = MultiplyAdd(lanes.qz, lanes.qz, lengthSq);
+	lengthSq = MultiplyAdd(lanes.qw, lanes.qw, lengthSq);
+	__m128 inverse = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(_mm_max_ps(lengthSq, _mm_set1_ps(1e-12f))));
+	lanes.qx = _mm_mul_ps(lanes.qx, inverse);
+	lanes.qy = _mm_mul_ps(lanes.qy, inverse);
+	lanes.qz = _mm_mul_ps(lanes.qz, inverse);
+	lanes.qw = _mm_mul_ps(lanes.qw, inverse);
+}
+
+static inline __m128 Lerp(__m128 a, __m128 b, __m128 t)
+{
+	return MultiplyAdd(_mm_sub_ps(b, a), t, a);
+}
+
+// Hamilton product a * b of the rotations, translations are left untouched
+static inline void MultiplyRotations(const PoseLanes& a, const PoseLanes& b, PoseLanes& out)
+{
+	__m128 x = _mm_sub_ps(MultiplyAdd(a.qw, b.qx, MultiplyAdd(a.qx, b.qw, _mm_mul_ps(a.qy, b.qz))), _mm_mul_ps(a.qz, b.qy));
+	__m128 y = _mm_sub_ps(MultiplyAdd(a.qw, b.qy, MultiplyAdd(a.qy, b.qw, _mm_mul_ps(a.qz, b.qx))), _mm_mul_ps(a.qx, b.qz));
+	__m128 z = _mm_sub_ps(MultiplyAdd(a.qw, b.qz, MultiplyAdd(a.qz, b.qw, _mm_mul_ps(a.qx, b.qy))), _mm_mul_ps(a.qy, b.qx));
+	__m128 w = _mm_sub_ps(_mm_mul_ps(a.qw, b.qw), MultiplyAdd(a.qx, b.qx, MultiplyAdd(a.qy, b.qy, _mm_mul_ps(a.qz, b.qz))));
+	out.qx = x;
+	out.qy = y;
+	out.qz = z;
+	out.qw = w;
+}
+
+#pragma endregion
+
+void Resources::PoseBlending::Blend(const BlendPose& a, const BlendPose& b, float t, BlendPose& out, const BoneMask* mask, bool slerp)
+{
+	if (out.count != a.count)
+		out.Resize(a.count);
+
+	const size_t padded = a.tx.size();
+	for (size_t i = 0; i < padded; i += 4)
+	{
+		__m128 weight = LoadWeights(t, mask, i);
+		PoseLanes from = LoadLanes(a, i);
+		PoseLanes to = LoadLanes(b, i);
+		AlignRotations(to, Dot(from, to));
+
+		PoseLanes result;
+		result.tx = Lerp(from.tx, to.tx, weight);
+		result.ty = Lerp(from.ty, to.ty, weight);
+		result.tz = Lerp(from.tz, to.tz, weight);
+		result.qx = Lerp(from.qx, to.qx, weight);
+		result.qy = Lerp(from.qy, to.qy, weight);
+		result.qz = Lerp(from.qz, to.qz, weight);
+		result.qw = Lerp(from.qw, to.qw, weight);
+		NormalizeRotations(result);
+		StoreLanes(out, i, result);
+	}
+
+	if (!slerp)
+		return;
+
+	// Constant angular velocity, for the large angles where the normalized lerp is visible
+	for (size_t i = 0; i < a.count; i++)
+	{
+		float weight = t * (mask && i < mask->weights.size() ? mask->weights[i] : 1.f);
+		Math::Quaternion rotation = Math::Quaternion::SLerp(a.GetRotation(i), b.GetRotation(i), weight);
+		out.qx[i] = rotation.x;
+		out.qy[i] = rotation.y;
+		out.qz[i] = rotation.z;
+		out.qw[i] = rotation.w;
+	}
+}
+
+void Resources::PoseBlending::BlendN(const BlendPose* const* poses, const float* weights, size_t count, BlendPose& out)
+{
+	if (count == 0)
+		return;
+
+	float totalWeight = 0.f;
+	for (size_t p = 0; p < count; p++)
+		totalWeight += std::max(weights[p], 0.f);
+	if (totalWeight <= 0.f)
+		return;
+	const float normalize = 1.f / totalWeight;
+
+	if (out.count != poses[0]->count)
+		out.Resize(poses[0]->count);
+
+	const size_t padded = poses[0]->tx.size();
+	const __m128 zero = _mm_setzero_ps();
+	for (size_t i = 0; i < padded; i += 4)
+	{
+		// The rotations are aligned on the first pose
+		PoseLanes reference = LoadLanes(*poses[0], i);
+		PoseLanes result = { zero, zero, zero, zero, zero, zero, zero };
+		for (size_t p = 0; p < count; p++)
+		{
+			if (weights[p] <= 0.f)
+				continue;
+			__m128 weight = _mm_set1_ps(weights[p] * normalize);
+			PoseLanes pose = LoadLanes(*poses[p], i);
+			AlignRotations(pose, Dot(reference, pose));
+
+			result.tx = MultiplyAdd(pose.tx, weight, result.tx);
+			result.ty = MultiplyAdd(pose.ty, weight, result.ty);
+			result.tz = MultiplyAdd(pose.tz, weight, result.tz);
+			result.qx = MultiplyAdd(pose.qx, weight, result.qx);
+			result.qy = MultiplyAdd(pose.qy, weight, result.qy);
+			result.qz = MultiplyAdd(pose.qz, weight, result.qz);
+			result.qw = MultiplyAdd(pose.qw, weight, result.qw);
+		}
+		NormalizeRotations(result);
+		StoreLanes(out, i, result);
+	}
+}
+
+void Resources::PoseBlending::MakeAdditive(const BlendPose& pose, const BlendPose& reference, BlendPose& out)
+{
+	if (out.count != pose.count)
+		out.Resize(pose.count);
+
+	const size_t padded = pose.tx.size();
+	const __m128 signBit = _mm_set1_ps(-0.f);
+	for (size_t i = 0; i < padded; i += 4)
+	{
+		PoseLanes current = LoadLanes(pose, i);
+		PoseLanes inverse = LoadLanes(reference, i);
+		// Conjugate, the rotations are unit quaternions
+		inverse.qx = _mm_xor_ps(inverse.qx, signBit);
+		inverse.qy = _mm_xor_ps(inverse.qy, signBit);
+		inverse.qz = _mm_xor_ps(inverse.qz, signBit);
+
+		PoseLanes result;
+		result.tx = _mm_sub_ps(current.tx, inverse.tx);
+		result.ty = _mm_sub_ps(current.ty, inverse.ty);
+		result.tz = _mm_sub_ps(current.tz, inverse.tz);
+		MultiplyRotations(inverse, current, result);
+		NormalizeRotations(result);
+		StoreLanes(out, i, result);
+	}
+}
+
+void Resources::PoseBlending::ApplyLayer(BlendPose& base, const BlendPose& layer, float weight, BlendMode mode, const BoneMask* mask)
+{
+	if (mode == BlendMode::Override)
+	{
+		Blend(base, layer, weight, base, mask);
+		return;
+	}
+
+	const size_t padded = std::min(base.tx.size(), layer.tx.size());
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	for (size_t i = 0; i < padded; i += 4)
+	{
+		__m128 w = LoadWeights(weight, mask, i);
+		PoseLanes current = LoadLanes(base, i);
+		PoseLanes delta = LoadLanes(layer, i);
+
+		// Scale the delta rotation from identity
+		PoseLanes identity = { zero, zero, zero, zero, zero, zero, one };
+		AlignRotations(delta, Dot(identity, delta));
+		delta.qx = Lerp(zero, delta.qx, w);
+		delta.qy = Lerp(zero, delta.qy, w);
+		delta.qz = Lerp(zero, delta.qz, w);
+		delta.qw = Lerp(one, delta.qw, w);
+		NormalizeRotations(delta);
+
+		PoseLanes result;
+		result.tx = MultiplyAdd(delta.tx, w, current.tx);
+		result.ty = MultiplyAdd(delta.ty, w, current.ty);
+		result.tz = MultiplyAdd(delta.tz, w, current.tz);
+		MultiplyRotations(current, delta, result);
+		NormalizeRotations(result);
+		StoreLanes(base, i, result);
+	}
+}
+
+void Resources::PoseBlending::ComputeBlendTreeWeights(BlendTreeType type, const Math::Vector2* positions, size_t count, const Math::Vector2& value, float* weights)
+{
+	if (count == 0)
+		return;
+	std::fill(weights, weights + count, 0.f);
+
+	if (type == BlendTreeType::Simple1D)
+	{
+		// Closest threshold on each side of the value
+		int lower = -1;
+		int upper = -1;
+		for (size_t i = 0; i < count; i++)
+		{
+			float threshold = positions[i].x;
+			if (threshold <= value.x && (lower < 0 || threshold > positions[lower].x))
+				lower = (int)i;
+			if (threshold >= value.x && (upper < 0 || threshold < positions[upper].x))
+				upper = (int)i;
+		}
+
+		if (lower < 0)
+			weights[upper] = 1.f;
+		else if (upper < 0 || lower == upper || positions[upper].x == positions[lower].x)
+			weights[lower] = 1.f;
+		else
+		{
+			float t = (value.x - positions[lower].x) / (positions[upper].x - positions[lower].x);
+			weights[lower] = 1.f - t;
+			weights[upper] = t;
+		}
+		return;
+	}
+
+	float total = 0.f;
+	for (size_t i = 0; i < count; i++)
+	{
+		float dx = value.x - positions[i].x;
+		float dy = value.y - positions[i].y;
+		float distanceSq = dx * dx + dy * dy;
+		// On a motion, it is played alone
+		if (distanceSq < 1e-8f)
+		{
+			std::fill(weights, weights + count, 0.f);
+			weights[i] = 1.f;
+			return;
+		}
+		weights[i] = 1.f / distanceSq;
+		total += weights[i];
+	}
+	for (size_t i = 0; i < count; i++)
+		weights[i] /= total;
+}
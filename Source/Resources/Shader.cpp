@@ -133,6 +133,7 @@ void Shader::Recompile()
 	{
 		PrintLog("Recompile Shader %s", p_path.c_str());
 		auto success = WrapperRHI::SendShader(vertShader->vertexFile, fragShader->fragmentFile, ID, this);
+		m_blocks.clear();
 	}
 }
 
@@ -147,6 +148,20 @@ int Resources::Shader::GetLocation(const std::string& locationName)
 
 }
 
+bool Resources::Shader::BindUniformBlock(const std::string& blockName, unsigned int binding)
+{
+	if (!HasBeenSent())
+		return false;
+	auto it = m_blocks.find(blockName);
+	if (it != m_blocks.end())
+		return it->second != -1;
+
+	int index = WrapperRHI::ShaderGetUniformBlock(ID, blockName.c_str());
+	WrapperRHI::ShaderBindUniformBlock(ID, index, binding);
+	m_blocks[blockName] = index;
+	return index != -1;
+}
+
 /* ===================================================================================================== */
 /*											Fragment Shader Class										 */
 /* ===================================================================================================== */
@@ -222,3 +237,83 @@ void VertexShader::Recompile()
 		shaders->Recompile();
 	}
 }
+
+
+/* ===================================================================================================== */
+/*											Compute Shader Class										 */
+/* ===================================================================================================== */
+
+ComputeShader::ComputeShader(std::string _name, ResourcesType _type) : IResources(_name, _type)
+{
+}
+
+ComputeShader::~ComputeShader()
+{
+}
+
+void ComputeShader::Load()
+{
+	p_shouldBeLoaded = true;
+	computeFile.clear();
+	Core::App::Get().threadManager->Lock();
+	computeFile = Utils::Loader::ReadFile(p_path);
+	Core::App::Get().threadManager->Unlock();
+
+	isLoaded = true;
+	PrintLog("Compute Shader Loaded : %s", p_path.c_str());
+	// Never sent without compute support, the users fall back to the CPU
+	if (WrapperRHI::SupportsCompute())
+		Core::App::Get().AddResourceToSend(p_path);
+	else
+		PrintError("Compute Shader %s needs OpenGL 4.3", p_path.c_str());
+}
+
+void ComputeShader::SendResource()
+{
+	if (!IsLoaded())
+		return;
+	if (!WrapperRHI::SendComputeShader(computeFile, ID, p_path))
+		return;
+	hasBeenSent = true;
+}
+
+void ComputeShader::Recompile()
+{
+	computeFile = Utils::Loader::ReadFile(p_path);
+	if (hasBeenSent)
+	{
+		PrintLog("Recompile Compute Shader %s", p_path.c_str());
+		if (WrapperRHI::SendComputeShader(computeFile, ID, p_path))
+			m_locations.clear();
+	}
+}
+
+int ComputeShader::GetLocation(const std::string& locationName)
+{
+	if (!HasBeenSent())
+		return -1;
+	auto it = m_locations.find(locationName);
+	if (it != m_locations.end())
+		return it->second;
+	return m_locations[locationName] = WrapperRHI::ShaderGetLocation(ID, locationName.c_str());
+}
+
+void ComputeShader::Use()
+{
+	if (hasBeenSent)
+		WrapperRHI::ShaderUse(ID);
+}
+
+void ComputeShader::Dispatch(unsigned int groupsX, unsigned int groupsY /*= 1*/, unsigned int groupsZ /*= 1*/)
+{
+	if (hasBeenSent)
+		WrapperRHI::DispatchCompute(groupsX, groupsY, groupsZ);
+}
+
+void ComputeShader::Delete()
+{
+	if (ID)
+		WrapperRHI::ShaderDelete(ID);
+	ID = 0;
+	hasBeenSent = false;
+}
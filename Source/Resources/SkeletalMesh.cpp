@@ -72,6 +72,14 @@ void Resources::SkeletalMesh::SendResource()
 	m_boudingBox = Utils::AABB::GenerateAABB(this);
 }
 
+// Shaders declaring "SkinningBlock" read the palette bound by Skeleton::BindPalette, the others get the uniform array
+static void SendPalette(Resources::Shader* shader, const std::vector<Math::Matrix4>& palette)
+{
+	if (shader->BindUniformBlock("SkinningBlock", Resources::Skeleton::PaletteBinding))
+		return;
+	WrapperRHI::ShaderSendMat4(shader->GetLocation("skinningMatrices"), palette, (int)palette.size());
+}
+
 void Resources::SkeletalMesh::Render(const Math::Matrix4& model, const std::vector<Resources::Material*>& materials, class Skeleton* skel, bool outline)
 {
 	if (!m_buffer || !hasBeenSent || materials.empty())
@@ -89,6 +97,11 @@ void Resources::SkeletalMesh::Render(const Math::Matrix4& model, const std::vect
 
 	auto V = Core::SceneManager::Get()->GetCurrentScene()->GetViewMatrix();
 	auto P = Core::SceneManager::Get()->GetCurrentScene()->GetProjectionMatrix();
+	// Shared by every submesh, the uniform array is only sent once to each shader without the block
+	const std::vector<Math::Matrix4>& palette = skel->GetBonesMatrices();
+	skel->BindPalette();
+	Resources::Shader* paletteShader = nullptr;
+	bool outlinePaletteSent = false;
 	WrapperRHI::StencilActive();
 	for (size_t i = 0; i < m_subMeshes.size(); i++)
 	{
@@ -108,7 +121,11 @@ void Resources::SkeletalMesh::Render(const Math::Matrix4& model, const std::vect
 		WrapperRHI::ShaderSendMat4(mat->GetShader()->GetLocation("modelMatrix"), model);
 		WrapperRHI::ShaderSendMat4(mat->GetShader()->GetLocation("viewMatrix"), V);
 		WrapperRHI::ShaderSendMat4(mat->GetShader()->GetLocation("projectionMatrix"), P);
-		WrapperRHI::ShaderSendMat4(mat->GetShader()->GetLocation("skinningMatrices"), skel->GetBonesMatrices(), (int)skel->Bones.size());
+		if (paletteShader != mat->GetShader())
+		{
+			paletteShader = mat->GetShader();
+			SendPalette(paletteShader, palette);
+		}
 
 		WrapperRHI::ShaderSendVec4(mat->GetShader()->GetLocation("material.ambient"), mat->GetAmbient());
 		WrapperRHI::ShaderSendVec4(mat->GetShader()->GetLocation("material.diffuse"), mat->GetDiffuse());
@@ -164,7 +181,11 @@ void Resources::SkeletalMesh::Render(const Math::Matrix4& model, const std::vect
 			WrapperRHI::ShaderSendMat4(shaderData->GetLocation("modelMatrix"), model);
 			WrapperRHI::ShaderSendMat4(shaderData->GetLocation("viewMatrix"), V);
 			WrapperRHI::ShaderSendMat4(shaderData->GetLocation("projectionMatrix"), P);
-			WrapperRHI::ShaderSendMat4(shaderData->GetLocation("skinningMatrices"), skel->GetBonesMatrices(), (int)skel->Bones.size());
+			if (!outlinePaletteSent)
+			{
+				SendPalette(shaderData, palette);
+				outlinePaletteSent = true;
+			}
 
 			WrapperRHI::DrawArrays(m_subMeshes[i].StartIndex, m_subMeshes[i].Count, true, false);
 			WrapperRHI::MaskStencil();
@@ -212,14 +233,14 @@ void Resources::SkeletalMesh::PickingResource(const Math::Matrix4& model, std::v
 
 	auto V = Core::SceneManager::Get()->GetCurrentScene()->GetViewMatrix();
 	auto P = Core::SceneManager::Get()->GetCurrentScene()->GetProjectionMatrix();
-	for (int i = 0; i < m_subMeshes.size(); i++)
-	{
-		WrapperRHI::ShaderSendMat4(shaderData->GetLocation("modelMatrix"), model);
-		WrapperRHI::ShaderSendMat4(shaderData->GetLocation("viewMatrix"), V);
-		WrapperRHI::ShaderSendMat4(shaderData->GetLocation("projectionMatrix"), P);
-		WrapperRHI::ShaderSendMat4(shaderData->GetLocation("skinningMatrices"), skel->GetBonesMatrices(), (int)skel->Bones.size());
+	// Every submesh uses the same shader, the uniforms are sent once
+	WrapperRHI::ShaderSendMat4(shaderData->GetLocation("modelMatrix"), model);
+	WrapperRHI::ShaderSendMat4(shaderData->GetLocation("viewMatrix"), V);
+	WrapperRHI::ShaderSendMat4(shaderData->GetLocation("projectionMatrix"), P);
+	skel->BindPalette();
+	SendPalette(shaderData, skel->GetBonesMatrices());
+	WrapperRHI::ShaderSendVec4(shaderData->GetLocation("PickingColor"), { r / 255.0f, g / 255.0f, b / 255.0f, 1.0f });
 
-		WrapperRHI::ShaderSendVec4(shaderData->GetLocation("PickingColor"), { r / 255.0f, g / 255.0f, b / 255.0f, 1.0f });
+	for (int i = 0; i < m_subMeshes.size(); i++)
 		WrapperRHI::DrawArrays(m_subMeshes[i].StartIndex, m_subMeshes[i].Count);
-	}
 }
\ No newline at end of file
@@ -41,65 +41,26 @@ void Resources::Bone::ShowInInspector()
 		WrapperUI::TreePush(m_name.c_str());
 		for (auto child : m_childrens)
 		{
-			dynamic_cast<Bone*>(child)->ShowInInspector();
+			if (auto bone = dynamic_cast<Bone*>(child))
+				bone->ShowInInspector();
 		}
 		WrapperUI::TreePop();
 	}
 }
 
-void Resources::Bone::UpdateBone(Animation* anim, float time)
+void Resources::Bone::SetDefault()
 {
-	Math::Vector3 Position = DefaultPosition;
-	Math::Quaternion Rotation;
-	anim->GetAnimAtFrame(Id, time, Position, Rotation);
-
-	transform->SetLocalPosition(Position);
-	transform->SetLocalRotation(DefaultRotation * Rotation);
-
-	for (auto& child : m_childrens)
+	if (m_skeleton)
 	{
-		if (auto bone = dynamic_cast<Bone*>(child))
-			bone->UpdateBone(anim, time);
+		for (auto& bone : m_skeleton->Bones)
+		{
+			bone->transform->SetLocalPosition(bone->DefaultPosition);
+			bone->transform->SetLocalRotation(bone->DefaultRotation);
+		}
+		m_skeleton->ResetPose();
+		return;
 	}
 
-}
-
-void Resources::Bone::CrossUpdate(float CrossFadeDuration, float Time, class Animation* currentAnimation, class Animation* nextAnimation)
-{
-	// Define the duration and offset of the transition
-	float transitionDuration = CrossFadeDuration; // in seconds
-	float transitionOffset = 0.0f; // in seconds
-
-	// Calculate the weight of each animation during the transition
-	float t = Time / transitionDuration;
-	t = std::fmaxf(0.0f, std::fminf(1.0f, t)); // clamp t to the range [0, 1]
-
-
-	Math::Vector3 Position = DefaultPosition;
-	Math::Quaternion Rotation;
-	currentAnimation->GetAnimAtFrame(Id, Time, Position, Rotation);
-	Rotation = DefaultRotation * Rotation;
-
-	Math::Vector3 Position2 = DefaultPosition;
-	Math::Quaternion Rotation2;
-	nextAnimation->GetAnimAtFrame(Id, 0, Position2, Rotation2);
-	Rotation2 = DefaultRotation * Rotation2;
-
-	// Interpolate between the keyframes of the two animations
-	Vector3 position = Vector3::Lerp(Position, Position2, t);
-	Quaternion rotation = Quaternion::SLerp(Rotation, Rotation2, t);
-
-	// Apply the blended animation to your object
-	transform->SetLocalPosition(position);
-	transform->SetLocalRotation(rotation);
-
-	for (auto child : m_childrens)
-		if (auto bone = dynamic_cast<Bone*>(child))
-			bone->CrossUpdate(CrossFadeDuration, Time, currentAnimation, nextAnimation);
-}
-
-void Resources::Bone::SetDefault()
-{
 	transform->SetLocalPosition(DefaultPosition);
 	transform->SetLocalRotation(DefaultRotation);
 
@@ -117,7 +78,11 @@ std::vector<Resources::Bone*> Resources::Bone::GetAllBones()
 	std::vector<Bone*> out;
 	for (auto&& c : m_childrens)
 	{
-		auto vec = dynamic_cast<Bone*>(c)->GetAllBones();
+		// Objects attached to the bone are not part of the skeleton
+		auto bone = dynamic_cast<Bone*>(c);
+		if (!bone)
+			continue;
+		auto vec = bone->GetAllBones();
 		out.insert(out.end(), vec.begin(), vec.end());
 	}
 	out.push_back(this);
@@ -126,22 +91,52 @@ std::vector<Resources::Bone*> Resources::Bone::GetAllBones()
 
 Math::Matrix4 Resources::Bone::GetBoneMatrix()
 {
+	if (m_skeleton && m_boneIndex >= 0)
+		return m_skeleton->GetBonesMatrices()[m_boneIndex];
 	auto result = DefaultMatrix * transform->GetModelMatrix();
 	return result;
 }
 
 void Resources::Bone::DrawDebug()
 {
-	for (auto& child : m_childrens)
+	if (!m_skeleton)
+		return;
+
+	m_skeleton->GetBonesMatrices();
+	WrapperRHI::Line::Get().Color = 1;
+	for (size_t i = 0; i < m_skeleton->Bones.size(); i++)
 	{
-		if (auto boneChild = dynamic_cast<Bone*>(child)) {
-			auto pos = boneChild->transform->GetWorldPosition();
-			auto pos2 = transform->GetWorldPosition();
-			WrapperRHI::Line::Get().Color = 1;
-			WrapperRHI::Line::Get().Draw(pos, pos2);
-			boneChild->DrawDebug();
-		}
+		int parent = m_skeleton->m_parents[i];
+		if (parent < 0)
+			continue;
+		WrapperRHI::Line::Get().Draw(m_skeleton->m_modelMatrices[i].GetPosition(), m_skeleton->m_modelMatrices[parent].GetPosition());
+	}
+}
+
+void Resources::Bone::UpdateSelfAndChild(size_t& _index)
+{
+	if (!m_active)
+		return;
+	if (!m_skeleton || m_boneIndex < 0 || (size_t)m_boneIndex >= m_skeleton->m_attachments.size())
+	{
+		GameObject::UpdateSelfAndChild(_index);
+		return;
 	}
+
+	if (m_skeleton->RootBone == this)
+		m_skeleton->UpdateAttachments();
+
+	if (m_skeleton->m_attachments[m_boneIndex] & Skeleton::BranchAttached)
+		GameObject::UpdateSelfAndChild(_index);
+	else
+		UpdateIndex(_index);
+}
+
+void Resources::Bone::DrawSelfAndChild(bool editorCamera /*= false*/)
+{
+	if (!m_skeleton || m_boneIndex < 0 || (size_t)m_boneIndex >= m_skeleton->m_attachments.size()
+		|| (m_skeleton->m_attachments[m_boneIndex] & Skeleton::BranchAttached))
+		GameObject::DrawSelfAndChild(editorCamera);
 }
 
 Resources::Bone* Resources::Bone::Clone()
@@ -264,6 +259,7 @@ std::ostream& Resources::Bone::operator<<(std::ostream& os)
 
 Resources::Skeleton::~Skeleton()
 {
+	m_paletteBuffer.Delete();
 	if (!RootBone->GetParent())
 	{
 		delete RootBone;
@@ -271,16 +267,286 @@ Resources::Skeleton::~Skeleton()
 	}
 }
 
-std::vector<Math::Matrix4> Resources::Skeleton::GetBonesMatrices()
+const std::vector<Math::Matrix4>& Resources::Skeleton::GetBonesMatrices()
+{
+	if (m_parents.size() != Bones.size())
+		SortBones();
+	if (m_poseDirty || GetRootParentMatrix() != m_rootParentMatrix)
+		EvaluatePose();
+	return m_palette;
+}
+
+void Resources::Skeleton::BindPalette()
+{
+	const std::vector<Math::Matrix4>& palette = GetBonesMatrices();
+	if (palette.empty())
+		return;
+
+	size_t size = palette.size() * sizeof(Math::Matrix4);
+	if (m_paletteBuffer.Size != size)
+	{
+		m_paletteBuffer.Generate(size);
+		m_uploadedPaletteVersion = UINT64_MAX;
+	}
+	if (m_uploadedPaletteVersion != m_paletteVersion)
+	{
+		m_paletteBuffer.SetData(0, size, palette.data());
+		m_uploadedPaletteVersion = m_paletteVersion;
+	}
+	m_paletteBuffer.BindBase(PaletteBinding);
+}
+
+void Resources::Skeleton::UpdatePose(Animation* anim, float time)
+{
+	if (m_parents.size() != Bones.size())
+		SortBones();
+	SamplePose(anim, time, m_pose, &m_cursor);
+	for (size_t i = 0; i < Bones.size(); i++)
+	{
+		int id = Bones[i]->Id;
+		if (id < 0)
+			continue;
+		m_localPositions[i] = m_pose.positions[id];
+		m_localRotations[i] = Bones[i]->DefaultRotation * m_pose.rotations[id];
+	}
+	CommitPose();
+}
+
+void Resources::Skeleton::SampleBlendPose(Animation* anim, float time, BlendPose& out, AnimationCursor* cursor)
 {
-	std::vector<Math::Matrix4> Matrix;
-	//Matrix.resize(52);
+	if (m_parents.size() != Bones.size())
+		SortBones();
+	SamplePose(anim, time, m_pose, cursor);
+	out.Resize(Bones.size());
 	for (size_t i = 0; i < Bones.size(); i++)
 	{
-		//Matrix.push_back(Math::Matrix4());
-		Matrix.push_back(Bones[i]->GetBoneMatrix());
+		const Bone* bone = Bones[i];
+		if (bone->Id < 0)
+			out.SetBone(i, bone->DefaultPosition, bone->DefaultRotation);
+		else
+			out.SetBone(i, m_pose.positions[bone->Id], bone->DefaultRotation * m_pose.rotations[bone->Id]);
 	}
-	return Matrix;
+}
+
+void Resources::Skeleton::SetPose(const BlendPose& pose)
+{
+	if (m_parents.size() != Bones.size())
+		SortBones();
+	WriteLocalPose(pose);
+	CommitPose();
+}
+
+void Resources::Skeleton::ComputeModelPalette(const BlendPose& pose, std::vector<Math::Matrix4>& palette) const
+{
+	std::vector<Math::Matrix4> modelMatrices(Bones.size());
+	palette.resize(Bones.size());
+	for (int i : m_evaluationOrder)
+	{
+		int parent = m_parents[i];
+		modelMatrices[i] = Math::GetTransformMatrix(pose.GetPosition(i), pose.GetRotation(i), m_localScales[i]);
+		if (parent >= 0)
+			modelMatrices[i] = modelMatrices[i] * modelMatrices[parent];
+		palette[i] = Bones[i]->DefaultMatrix * modelMatrices[i];
+	}
+}
+
+Resources::PoseSlot& Resources::Skeleton::GetPoseSlot(size_t index)
+{
+	if (index >= m_poseSlots.size())
+		m_poseSlots.resize(index + 1);
+	return m_poseSlots[index];
+}
+
+void Resources::Skeleton::BeginPoseInterpolation(int frames)
+{
+	if (m_parents.size() != Bones.size())
+		SortBones();
+	m_interpolationFrames = std::max(frames, 1);
+	if (m_interpolationFrames > 1)
+		ReadLocalPose(m_interpolationFrom);
+}
+
+void Resources::Skeleton::StepPoseInterpolation()
+{
+	// Keeps the pose of the animator instead of reading the bone transforms
+	m_animated = true;
+	if (m_interpolationFrames <= 1 || m_interpolationStep >= m_interpolationFrames || m_interpolationTarget.count != Bones.size())
+		return;
+
+	m_interpolationStep++;
+	float t = (float)m_interpolationStep / (float)m_interpolationFrames;
+	PoseBlending::Blend(m_interpolationFrom, m_interpolationTarget, t, m_interpolatedPose);
+	WriteLocalPose(m_interpolatedPose);
+	m_poseFromBones = false;
+	EvaluatePose();
+}
+
+void Resources::Skeleton::SetMaxBoneDepth(int depth)
+{
+	if (m_parents.size() != Bones.size())
+		SortBones();
+	if (depth == m_maxBoneDepth && (depth < 0 || !m_sampleMask.empty()))
+		return;
+
+	m_maxBoneDepth = depth;
+	m_sampleMask.clear();
+	if (depth < 0)
+		return;
+
+	// Bones with something attached are always sampled
+	m_sampleMask.assign(Bones.empty() ? 0 : (size_t)std::max(Bones.back()->Id + 1, 0), 0);
+	for (size_t i = 0; i < Bones.size(); i++)
+	{
+		int id = Bones[i]->Id;
+		if (id >= 0)
+			m_sampleMask[id] = m_boneDepth[i] <= (uint32_t)depth || (m_attachments[i] & BranchAttached);
+	}
+}
+
+void Resources::Skeleton::CommitPose()
+{
+	m_animated = true;
+	m_poseFromBones = false;
+	if (m_interpolationFrames <= 1)
+	{
+		EvaluatePose();
+		return;
+	}
+	ReadLocalPose(m_interpolationTarget);
+	m_interpolationStep = 0;
+	StepPoseInterpolation();
+}
+
+void Resources::Skeleton::ReadLocalPose(BlendPose& out) const
+{
+	out.Resize(Bones.size());
+	for (size_t i = 0; i < Bones.size(); i++)
+		out.SetBone(i, m_localPositions[i], m_localRotations[i]);
+}
+
+void Resources::Skeleton::WriteLocalPose(const BlendPose& pose)
+{
+	size_t count = std::min(pose.count, Bones.size());
+	for (size_t i = 0; i < count; i++)
+	{
+		m_localPositions[i] = pose.GetPosition(i);
+		m_localRotations[i] = pose.GetRotation(i);
+	}
+}
+
+void Resources::Skeleton::ResetPose()
+{
+	if (m_parents.size() != Bones.size())
+		SortBones();
+	for (size_t i = 0; i < Bones.size(); i++)
+	{
+		m_localPositions[i] = Bones[i]->DefaultPosition;
+		m_localRotations[i] = Bones[i]->DefaultRotation;
+	}
+	m_poseFromBones = false;
+	m_poseDirty = true;
+}
+
+void Resources::Skeleton::ReadPoseFromBones()
+{
+	for (size_t i = 0; i < Bones.size(); i++)
+	{
+		Component::Transform* transform = Bones[i]->transform;
+		m_localPositions[i] = transform->GetLocalPosition();
+		m_localRotations[i] = transform->GetLocalRotation();
+		m_localScales[i] = transform->GetLocalScale();
+	}
+	m_poseFromBones = true;
+	m_poseDirty = true;
+}
+
+Math::Matrix4 Resources::Skeleton::GetRootParentMatrix() const
+{
+	if (RootBone && RootBone->GetParent())
+		return RootBone->GetParent()->transform->GetModelMatrix();
+	return Math::Matrix4();
+}
+
+void Resources::Skeleton::EvaluatePose()
+{
+	m_rootParentMatrix = GetRootParentMatrix();
+	for (int i : m_evaluationOrder)
+	{
+		int parent = m_parents[i];
+		const Math::Matrix4& parentMatrix = parent >= 0 ? m_modelMatrices[parent] : m_rootParentMatrix;
+		m_modelMatrices[i] = Math::GetTransformMatrix(m_localPositions[i], m_localRotations[i], m_localScales[i]) * parentMatrix;
+		m_palette[i] = Bones[i]->DefaultMatrix * m_modelMatrices[i];
+	}
+	m_paletteVersion++;
+	m_poseDirty = false;
+
+	// The transforms are already the pose
+	if (m_poseFromBones)
+		return;
+
+	// Only the bones with something attached, and their parents, have their transform written
+	for (int i : m_evaluationOrder)
+	{
+		uint8_t attachment = m_attachments[i];
+		if (!(attachment & BranchAttached))
+			continue;
+
+		Component::Transform* transform = Bones[i]->transform;
+		transform->SetLocalPosition(m_localPositions[i]);
+		transform->SetLocalRotation(m_localRotations[i]);
+		transform->SetLocalScale(m_localScales[i]);
+		int parent = m_parents[i];
+		transform->ComputeModelMatrix(parent >= 0 ? m_modelMatrices[parent] : m_rootParentMatrix);
+
+		if (!(attachment & BoneAttached))
+			continue;
+		for (auto child : Bones[i]->m_childrens)
+		{
+			if (!dynamic_cast<Bone*>(child))
+				child->transform->ForceUpdate();
+		}
+	}
+}
+
+void Resources::Skeleton::UpdateAttachments()
+{
+	for (size_t i = 0; i < Bones.size(); i++)
+	{
+		Bone* bone = Bones[i];
+		// Selected bones are kept in sync for the gizmo
+		bool attached = !bone->m_components.empty() || bone->m_childrens.size() != m_boneChildCount[i] || bone->IsSelected();
+		m_attachments[i] = attached ? (BoneAttached | BranchAttached) : 0;
+	}
+	// Children after their parents, the reverse order reaches the parents last
+	for (auto it = m_evaluationOrder.rbegin(); it != m_evaluationOrder.rend(); ++it)
+	{
+		int parent = m_parents[*it];
+		if (parent >= 0 && (m_attachments[*it] & BranchAttached))
+			m_attachments[parent] |= BranchAttached;
+	}
+
+	// Without animator the bone transforms are the pose, as in the editor
+	if (!m_animated)
+		ReadPoseFromBones();
+	m_animated = false;
+}
+
+void Resources::Skeleton::SamplePose(Animation* anim, float time, SkeletonPose& pose, AnimationCursor* cursor) const
+{
+	size_t count = Bones.empty() ? 0 : (size_t)std::max(Bones.back()->Id + 1, 0);
+	pose.positions.resize(count);
+	pose.rotations.resize(count);
+	for (auto& bone : Bones)
+	{
+		if (bone->Id < 0)
+			continue;
+		pose.positions[bone->Id] = bone->DefaultPosition;
+		pose.rotations[bone->Id] = Math::Quaternion();
+	}
+
+	const uint8_t* mask = m_sampleMask.size() == count ? m_sampleMask.data() : nullptr;
+	if (anim)
+		anim->SampleAll(time, pose.positions.data(), pose.rotations.data(), count, cursor, mask);
 }
 
 bool compareById(Bone* a, Bone* b) {
@@ -290,6 +556,55 @@ bool compareById(Bone* a, Bone* b) {
 void Resources::Skeleton::SortBones()
 {
 	std::sort(Bones.begin(), Bones.end(), compareById);
+
+	const size_t count = Bones.size();
+	std::unordered_map<Core::GameObject*, int> indices;
+	for (size_t i = 0; i < count; i++)
+	{
+		Bones[i]->m_boneIndex = (int)i;
+		indices[Bones[i]] = (int)i;
+	}
+
+	m_parents.assign(count, -1);
+	m_boneChildCount.assign(count, 0);
+	for (size_t i = 0; i < count; i++)
+	{
+		auto it = indices.find(Bones[i]->GetParent());
+		if (it == indices.end())
+			continue;
+		m_parents[i] = it->second;
+		m_boneChildCount[it->second]++;
+	}
+
+	// Breadth first from the roots so every parent is evaluated before its children
+	std::vector<std::vector<int>> children(count);
+	m_evaluationOrder.clear();
+	m_evaluationOrder.reserve(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		if (m_parents[i] >= 0)
+			children[m_parents[i]].push_back((int)i);
+		else
+			m_evaluationOrder.push_back((int)i);
+	}
+	for (size_t i = 0; i < m_evaluationOrder.size(); i++)
+		for (int child : children[m_evaluationOrder[i]])
+			m_evaluationOrder.push_back(child);
+
+	m_boneDepth.assign(count, 0);
+	for (int i : m_evaluationOrder)
+		if (m_parents[i] >= 0)
+			m_boneDepth[i] = m_boneDepth[m_parents[i]] + 1;
+	// Rebuilt by the next SetMaxBoneDepth
+	m_sampleMask.clear();
+
+	m_localPositions.resize(count);
+	m_localRotations.resize(count);
+	m_localScales.resize(count);
+	m_modelMatrices.resize(count);
+	m_palette.resize(count);
+	m_attachments.assign(count, 0);
+	ReadPoseFromBones();
 }
 
 Resources::Skeleton* Resources::Skeleton::Clone() const
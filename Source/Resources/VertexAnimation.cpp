@@ -0,0 +1,206 @@
+#include "pch.h"
+#include <Resources/VertexAnimation.h>
+#include <Resources/SkeletalMesh.h>
+#include <Resources/Skeleton.h>
+#include <Resources/Animation.h>
+
+#pragma region Skinning
+
+// Row vectors, the translation is on the last row
+static Math::Vector3 TransformPoint(const Math::Vector3& p, const Math::Matrix4& m)
+{
+	return Math::Vector3(
+		p.x * m[0][0] + p.y * m[1][0] + p.z * m[2][0] + m[3][0],
+		p.x * m[0][1] + p.y * m[1][1] + p.z * m[2][1] + m[3][1],
+		p.x * m[0][2] + p.y * m[1][2] + p.z * m[2][2] + m[3][2]);
+}
+
+static Math::Vector3 TransformDirection(const Math::Vector3& d, const Math::Matrix4& m)
+{
+	return Math::Vector3(
+		d.x * m[0][0] + d.y * m[1][0] + d.z * m[2][0],
+		d.x * m[0][1] + d.y * m[1][1] + d.z * m[2][1],
+		d.x * m[0][2] + d.y * m[1][2] + d.z * m[2][2]);
+}
+
+static void WriteTexel(std::vector<float>& texture, size_t offset, const Math::Vector3& value, float w)
+{
+	texture[offset + 0] = value.x;
+	texture[offset + 1] = value.y;
+	texture[offset + 2] = value.z;
+	texture[offset + 3] = w;
+}
+
+#pragma endregion
+
+float Resources::VertexAnimationClip::GetFrame(float time) const
+{
+	if (frameCount < 2)
+		return (float)firstFrame;
+	float span = (float)(frameCount - 1);
+	float frame = std::fmod(time * sampleRate, span);
+	if (frame < 0.f)
+		frame += span;
+	return firstFrame + frame;
+}
+
+size_t Resources::VertexAnimationData::GetTexelOffset(uint32_t frame, uint32_t index) const
+{
+	size_t x = index % width;
+	size_t y = (size_t)frame * rowsPerFrame + index / width;
+	return (y * width + x) * 4;
+}
+
+Math::Vector3 Resources::VertexAnimationData::GetPosition(uint32_t frame, uint32_t vertex) const
+{
+	const float* texel = &positions[GetTexelOffset(frame, vertex)];
+	return Math::Vector3(texel[0], texel[1], texel[2]);
+}
+
+Math::Vector3 Resources::VertexAnimationData::GetNormal(uint32_t frame, uint32_t vertex) const
+{
+	const float* texel = &normals[GetTexelOffset(frame, vertex)];
+	return Math::Vector3(texel[0], texel[1], texel[2]);
+}
+
+Math::Matrix4 Resources::VertexAnimationData::GetBoneMatrix(uint32_t frame, uint32_t bone) const
+{
+	Math::Matrix4 matrix;
+	for (int column = 0; column < 3; column++)
+	{
+		const float* texel = &positions[GetTexelOffset(frame, bone * 3 + column)];
+		for (int row = 0; row < 4; row++)
+			matrix[row][column] = texel[row];
+	}
+	return matrix;
+}
+
+size_t Resources::VertexAnimationData::GetMemorySize() const
+{
+	return (positions.size() + normals.size()) * sizeof(float);
+}
+
+bool Resources::VertexAnimationBaker::Bake(SkeletalMesh* mesh, Skeleton* skeleton, const std::vector<Animation*>& animations,
+	const VertexAnimationBakeSettings& settings, VertexAnimationData& out)
+{
+	out = VertexAnimationData();
+	if (!mesh || !skeleton || skeleton->Bones.empty() || animations.empty() || settings.sampleRate <= 0.f || settings.maxWidth == 0)
+		return false;
+
+	const std::vector<float>& vertices = mesh->GetVertices();
+	const size_t vertexCount = vertices.size() / SkeletalMesh::VertexStride;
+	const size_t boneCount = skeleton->Bones.size();
+	if (vertexCount == 0)
+		return false;
+
+	out.mode = settings.mode;
+	out.texelsPerFrame = (uint32_t)(settings.mode == VertexAnimationMode::Vertices ? vertexCount : boneCount * 3);
+	out.width = std::min(out.texelsPerFrame, settings.maxWidth);
+	out.rowsPerFrame = (out.texelsPerFrame + out.width - 1) / out.width;
+
+	for (Animation* animation : animations)
+	{
+		if (!animation || !animation->HasBeenSent())
+		{
+			PrintError("Vertex animation bake of %s : missing or not loaded animation", mesh->GetPath().c_str());
+			out = VertexAnimationData();
+			return false;
+		}
+		float frameRate = animation->FrameRate > 0.f ? animation->FrameRate : 30.f;
+
+		VertexAnimationClip clip;
+		clip.name = animation->GetName();
+		clip.firstFrame = out.frameCount;
+		clip.duration = animation->KeyCount / frameRate;
+		clip.frameCount = std::max(1u, (uint32_t)std::ceil(clip.duration * settings.sampleRate)) + 1;
+		clip.sampleRate = clip.duration > 0.f ? (clip.frameCount - 1) / clip.duration : settings.sampleRate;
+		out.frameCount += clip.frameCount;
+		out.clips.push_back(clip);
+	}
+	out.height = out.frameCount * out.rowsPerFrame;
+
+	const size_t textureSize = (size_t)out.width * out.height * 4;
+	out.positions.assign(textureSize, 0.f);
+	if (settings.mode == VertexAnimationMode::Vertices)
+		out.normals.assign(textureSize, 0.f);
+
+	BlendPose pose;
+	AnimationCursor cursor;
+	std::vector<Math::Matrix4> palette;
+	bool firstBound = true;
+	for (size_t c = 0; c < animations.size(); c++)
+	{
+		Animation* animation = animations[c];
+		const VertexAnimationClip& clip = out.clips[c];
+		for (uint32_t f = 0; f < clip.frameCount; f++)
+		{
+			float time = clip.frameCount > 1 ? animation->KeyCount * f / (float)(clip.frameCount - 1) : 0.f;
+			skeleton->SampleBlendPose(animation, time, pose, &cursor);
+			skeleton->ComputeModelPalette(pose, palette);
+			uint32_t frame = clip.firstFrame + f;
+
+			if (settings.mode == VertexAnimationMode::Bones)
+			{
+				for (uint32_t bone = 0; bone < boneCount; bone++)
+				{
+					for (int column = 0; column < 3; column++)
+					{
+						const Math::Matrix4& m = palette[bone];
+						size_t offset = out.GetTexelOffset(frame, bone * 3 + column);
+						WriteTexel(out.positions, offset, Math::Vector3(m[0][column], m[1][column], m[2][column]), m[3][column]);
+					}
+				}
+			}
+
+			// The bounds are computed in both modes, they are used to cull the instances
+			for (size_t v = 0; v < vertexCount; v++)
+			{
+				const float* vertex = &vertices[v * SkeletalMesh::VertexStride];
+				const Math::Vector3 restPosition(vertex[0], vertex[1], vertex[2]);
+				const Math::Vector3 restNormal(vertex[5], vertex[6], vertex[7]);
+
+				Math::Vector3 position;
+				Math::Vector3 normal;
+				float totalWeight = 0.f;
+				for (size_t i = 0; i < SkeletalMesh::MaxBoneWeights; i++)
+				{
+					float weight = vertex[SkeletalMesh::BoneWeightsOffset + i];
+					size_t bone = (size_t)vertex[SkeletalMesh::BoneIndicesOffset + i];
+					if (weight <= 0.f || bone >= palette.size())
+						continue;
+					position += TransformPoint(restPosition, palette[bone]) * weight;
+					normal += TransformDirection(restNormal, palette[bone]) * weight;
+					totalWeight += weight;
+				}
+				if (totalWeight <= 0.f)
+				{
+					position = restPosition;
+					normal = restNormal;
+				}
+
+				if (firstBound)
+				{
+					out.boundsMin = position;
+					out.boundsMax = position;
+					firstBound = false;
+				}
+				for (size_t axis = 0; axis < 3; axis++)
+				{
+					out.boundsMin[axis] = std::min(out.boundsMin[axis], position[axis]);
+					out.boundsMax[axis] = std::max(out.boundsMax[axis], position[axis]);
+				}
+
+				if (settings.mode == VertexAnimationMode::Vertices)
+				{
+					size_t offset = out.GetTexelOffset(frame, (uint32_t)v);
+					WriteTexel(out.positions, offset, position, 1.f);
+					WriteTexel(out.normals, offset, normal.GetNormalized(), 0.f);
+				}
+			}
+		}
+	}
+
+	PrintLog("Vertex animation of %s baked : %zu clips, %u frames, %ux%u texels, %zu bytes", mesh->GetPath().c_str(),
+		out.clips.size(), out.frameCount, out.width, out.height, out.GetMemorySize());
+	return true;
+}
@@ -4,6 +4,9 @@
 #include <Core/App.h>
 
 #include "Scripting/ScriptGlue.h"
+#include "Scripting/ScriptProfiler.h"
+#include "Scripting/ScriptJobs.h"
+#include "Scripting/ScriptScheduler.h"
 
 #include "mono/jit/jit.h"
 #include "mono/metadata/assembly.h"
@@ -183,28 +186,6 @@ namespace Scripting
 		Component::BaseComponent* ref;
 	};
 
-	struct CollisionMethods
-	{
-		CollisionMethods(std::shared_ptr<ScriptClass> scriptClass)
-		{
-			onCollisionEnter = scriptClass->GetMethod("OnCollisionEnter", 1);
-			onCollisionStay = scriptClass->GetMethod("OnCollisionStay", 1);
-			onCollisionExit = scriptClass->GetMethod("OnCollisionExit", 1);
-
-			onTriggerEnter = scriptClass->GetMethod("OnTriggerEnter", 1);
-			onTriggerStay = scriptClass->GetMethod("OnTriggerStay", 1);
-			onTriggerExit = scriptClass->GetMethod("OnTriggerExit", 1);
-		}
-
-		MonoMethod* onCollisionEnter = nullptr;
-		MonoMethod* onCollisionStay = nullptr;
-		MonoMethod* onCollisionExit = nullptr;
-
-		MonoMethod* onTriggerEnter = nullptr;
-		MonoMethod* onTriggerStay = nullptr;
-		MonoMethod* onTriggerExit = nullptr;
-	};
-
 	struct ScriptEngineData
 	{
 		ScriptEngineData();
@@ -230,7 +211,6 @@ namespace Scripting
 		MonoMethod* gameObjectCtor = nullptr;
 
 		std::map<std::string, std::shared_ptr<ScriptClass>> scriptClasses;
-		std::map<std::string, std::shared_ptr<CollisionMethods>> collisionMethods;
 
 		std::vector<std::string> assemblyClasses;
 
@@ -246,6 +226,16 @@ namespace Scripting
 		// Fields that contains a reference (script, gameobject, component)
 		std::vector<ObjectRef> objectRefs;
 		std::vector<ComponentRef> componentRefs;
+
+		// Objects behind the native handles, main thread only
+		struct NativeHandleSlot
+		{
+			Core::GameObject* object = nullptr;
+			uint32_t generation = 1;
+		};
+		std::vector<NativeHandleSlot> handleSlots;
+		std::vector<uint32_t> freeHandleSlots;
+		std::unordered_map<const Core::GameObject*, uint32_t> handleIndices;
 	};
 
 	ScriptEngineData::ScriptEngineData()
@@ -289,6 +279,8 @@ namespace Scripting
 
 	void ScriptEngine::Shutdown()
 	{
+		ScriptJobs::ReleaseAll();
+		ScriptScheduler::Clear();
 		ShutdownMono();
 		delete s_data;
 		s_data = nullptr;
@@ -297,6 +289,7 @@ namespace Scripting
 	void ScriptEngine::InitMono()
 	{
 		mono_set_assemblies_path("mono/lib");
+		ScriptProfiler::InstallMonoProfiler(Core::App::Get().projectSettings.profileScriptAllocations);
 
 		MonoDomain* rootDomain = mono_jit_init("PandorJITRuntime");
 		if (rootDomain == nullptr)
@@ -380,6 +373,11 @@ namespace Scripting
 
 	void ScriptEngine::ReloadAssembly()
 	{
+		// Jobs run code from the domain that is about to be unloaded
+		ScriptJobs::ReleaseAll();
+		ScriptJobs::ClearCache();
+		ScriptScheduler::Clear();
+
 		mono_domain_set(mono_get_root_domain(), false);
 
 		mono_domain_unload(s_data->appDomain);
@@ -393,11 +391,14 @@ namespace Scripting
 
 	void ScriptEngine::OnStart(Core::Scene* scene)
 	{
+		ScriptScheduler::Clear();
 		s_data->sceneContext = scene;
 	}
 
 	void ScriptEngine::OnStop()
 	{
+		ScriptJobs::ReleaseAll();
+		ScriptScheduler::Clear();
 		s_data->sceneContext = nullptr;
 		s_data->objectRefs.clear();
 		s_data->componentRefs.clear();
@@ -522,6 +523,7 @@ namespace Scripting
 
 	void ScriptEngine::DestroyScrpitInstance(Component::ScriptComponent& scriptComponent)
 	{
+		ScriptScheduler::StopAll(scriptComponent.uuid);
 		if (scriptComponent.instance && scriptComponent.instance->m_instance)
 		{
 			mono_gchandle_free(mono_gchandle_new(scriptComponent.instance->m_instance, TRUE));
@@ -634,6 +636,60 @@ namespace Scripting
 		}
 	}
 
+	uint64_t ScriptEngine::GetNativeHandle(Core::GameObject* gameObject)
+	{
+		if (!s_data || !gameObject)
+			return 0;
+
+		uint32_t index;
+		auto it = s_data->handleIndices.find(gameObject);
+		if (it != s_data->handleIndices.end())
+		{
+			index = it->second;
+		}
+		else
+		{
+			if (!s_data->freeHandleSlots.empty())
+			{
+				index = s_data->freeHandleSlots.back();
+				s_data->freeHandleSlots.pop_back();
+			}
+			else
+			{
+				index = (uint32_t)s_data->handleSlots.size();
+				s_data->handleSlots.emplace_back();
+			}
+			s_data->handleSlots[index].object = gameObject;
+			s_data->handleIndices.emplace(gameObject, index);
+		}
+		// The index is offset by one, 0 stays the null handle
+		return ((uint64_t)s_data->handleSlots[index].generation << 32) | (index + 1);
+	}
+
+	Core::GameObject* ScriptEngine::ResolveNativeHandle(uint64_t handle)
+	{
+		const uint32_t index = (uint32_t)handle - 1;
+		if (!s_data || handle == 0 || index >= s_data->handleSlots.size())
+			return nullptr;
+		const ScriptEngineData::NativeHandleSlot& slot = s_data->handleSlots[index];
+		return slot.generation == (uint32_t)(handle >> 32) ? slot.object : nullptr;
+	}
+
+	void ScriptEngine::ReleaseNativeHandle(Core::GameObject* gameObject)
+	{
+		if (!s_data)
+			return;
+
+		auto it = s_data->handleIndices.find(gameObject);
+		if (it == s_data->handleIndices.end())
+			return;
+		ScriptEngineData::NativeHandleSlot& slot = s_data->handleSlots[it->second];
+		slot.object = nullptr;
+		slot.generation++;
+		s_data->freeHandleSlots.push_back(it->second);
+		s_data->handleIndices.erase(it);
+	}
+
 	void ScriptEngine::UpdateComponentRefs()
 	{
 		if (!s_data)
@@ -676,6 +732,11 @@ namespace Scripting
 		return s_data->scriptClasses.at(name);
 	}
 
+	MonoDomain* ScriptEngine::GetAppDomain()
+	{
+		return s_data->appDomain;
+	}
+
 	MonoImage* ScriptEngine::GetCoreAssemblyImage()
 	{
 		return s_data->coreAssemblyImage;
@@ -763,7 +824,6 @@ namespace Scripting
 	{
 		s_data->scriptClasses.clear();
 		s_data->assemblyClasses.clear();
-		s_data->collisionMethods.clear();
 
 		// Store core assembly class names
 		const MonoTableInfo* coreTypeDefinitionsTable = mono_image_get_table_info(s_data->coreAssemblyImage, MONO_TABLE_TYPEDEF);
@@ -814,8 +874,6 @@ namespace Scripting
 
 			std::shared_ptr<ScriptClass> scriptClass = std::make_shared<ScriptClass>(nameSpace, className);
 			s_data->scriptClasses.emplace(fullName, scriptClass);
-			std::shared_ptr<CollisionMethods> collisionMethods = std::make_shared<CollisionMethods>(scriptClass);
-			s_data->collisionMethods.emplace(fullName, collisionMethods);
 
 			// This routine is an iterator routine for retrieving the fields in a class.
 			// You must pass a gpointer that points to zero and is treated as an opaque handle
@@ -853,6 +911,31 @@ namespace Scripting
 		: m_classNamespace(classNamespace), m_className(className)
 	{
 		m_monoClass = mono_class_from_name(isCore ? s_data->coreAssemblyImage : s_data->gameAssemblyImage, classNamespace.c_str(), className.c_str());
+		if (m_monoClass)
+			BindThunks();
+	}
+
+	template<typename T>
+	static T GetMethodThunk(ScriptClass& scriptClass, const char* name, int parameterCount)
+	{
+		MonoMethod* method = scriptClass.GetMethod(name, parameterCount);
+		if (!method)
+			return nullptr;
+		return reinterpret_cast<T>(mono_method_get_unmanaged_thunk(method));
+	}
+
+	void ScriptClass::BindThunks()
+	{
+		m_thunks.onCreate = GetMethodThunk<ScriptThunks::VoidThunk>(*this, "OnCreate", 0);
+		m_thunks.onUpdate = GetMethodThunk<ScriptThunks::UpdateThunk>(*this, "OnUpdate", 1);
+
+		m_thunks.onCollisionEnter = GetMethodThunk<ScriptThunks::ColliderThunk>(*this, "OnCollisionEnter", 1);
+		m_thunks.onCollisionStay = GetMethodThunk<ScriptThunks::ColliderThunk>(*this, "OnCollisionStay", 1);
+		m_thunks.onCollisionExit = GetMethodThunk<ScriptThunks::ColliderThunk>(*this, "OnCollisionExit", 1);
+
+		m_thunks.onTriggerEnter = GetMethodThunk<ScriptThunks::ColliderThunk>(*this, "OnTriggerEnter", 1);
+		m_thunks.onTriggerStay = GetMethodThunk<ScriptThunks::ColliderThunk>(*this, "OnTriggerStay", 1);
+		m_thunks.onTriggerExit = GetMethodThunk<ScriptThunks::ColliderThunk>(*this, "OnTriggerExit", 1);
 	}
 
 	MonoObject* ScriptClass::Instantiate()
@@ -889,24 +972,29 @@ namespace Scripting
 
 		if (exception != nullptr)
 		{
-			// Exception occurred, retrieve information
-			MonoClass* exceptionClass = mono_object_get_class(exception);
-			const char* exceptionTypeName = mono_class_get_name(exceptionClass);
-
-			// Get the exception message property
-			MonoProperty* exceptionMessageProperty = mono_class_get_property_from_name(exceptionClass, "Message");
-			MonoMethod* exceptionMessageGetMethod = mono_property_get_get_method(exceptionMessageProperty);
-			MonoString* exceptionMessage = reinterpret_cast<MonoString*>(mono_runtime_invoke(exceptionMessageGetMethod, exception, nullptr, nullptr));
-			const char* exceptionMessageString = mono_string_to_utf8(exceptionMessage);
-			const char* methodName = mono_method_get_name(method);
-
-			// Print the exception type and message
-			PrintError("Exception Type: %s\nClass: %s | Method: %s => %s", exceptionTypeName, m_className.c_str(), methodName, exceptionMessageString);
+			PrintException(exception, mono_method_get_name(method));
 			return false;
 		}
 		return true;
 	}
 
+	void ScriptClass::PrintException(MonoObject* exception, const char* methodName)
+	{
+		// Exception occurred, retrieve information
+		MonoClass* exceptionClass = mono_object_get_class(exception);
+		const char* exceptionTypeName = mono_class_get_name(exceptionClass);
+
+		// Get the exception message property
+		MonoProperty* exceptionMessageProperty = mono_class_get_property_from_name(exceptionClass, "Message");
+		MonoMethod* exceptionMessageGetMethod = mono_property_get_get_method(exceptionMessageProperty);
+		MonoString* exceptionMessage = reinterpret_cast<MonoString*>(mono_runtime_invoke(exceptionMessageGetMethod, exception, nullptr, nullptr));
+		char* exceptionMessageString = mono_string_to_utf8(exceptionMessage);
+
+		// Print the exception type and message
+		PrintError("Exception Type: %s\nClass: %s | Method: %s => %s", exceptionTypeName, m_className.c_str(), methodName, exceptionMessageString);
+		mono_free(exceptionMessageString);
+	}
+
 	void ScriptClass::InvokeMethodVoid(MonoObject* instance, MonoMethod* method)
 	{
 		InvokeMethod(instance, method);
@@ -918,8 +1006,10 @@ namespace Scripting
 		m_instance = scriptClass->Instantiate();
 
 		m_constructor = s_data->componentCtor;
-		m_onCreateMethod = scriptClass->GetMethod("OnCreate", 0);
-		m_onUpdateMethod = scriptClass->GetMethod("OnUpdate", 1);
+		m_onCreate = scriptClass->GetThunks().onCreate;
+		m_onUpdate = scriptClass->GetThunks().onUpdate;
+		m_onCreateSample = ScriptProfiler::GetSample(scriptClass->GetName(), "OnCreate");
+		m_onUpdateSample = ScriptProfiler::GetSample(scriptClass->GetName(), "OnUpdate");
 
 		// Call contructor
 		void* param[2] = { &objectID, &componentID };
@@ -928,42 +1018,61 @@ namespace Scripting
 
 	void ScriptInstance::InvokeOnCreate()
 	{
-		if (m_onCreateMethod)
-			m_scriptClass->InvokeMethod(m_instance, m_onCreateMethod);
+		if (m_onCreate)
+		{
+			ScriptProfiler::Scope scope(m_onCreateSample);
+			MonoException* exception = nullptr;
+			m_onCreate(m_instance, &exception);
+			if (exception)
+				m_scriptClass->PrintException((MonoObject*)exception, "OnCreate");
+		}
 	}
 
 	void ScriptInstance::InvokeOnUpdate(float dt)
 	{
-		if (m_onUpdateMethod)
+		if (m_onUpdate)
 		{
-			void* param = &dt;
-			if (!m_scriptClass->InvokeMethod(m_instance, m_onUpdateMethod, &param))
-				m_onUpdateMethod = nullptr;
+			ScriptProfiler::Scope scope(m_onUpdateSample);
+			MonoException* exception = nullptr;
+			m_onUpdate(m_instance, dt, &exception);
+			if (exception)
+			{
+				m_scriptClass->PrintException((MonoObject*)exception, "OnUpdate");
+				m_onUpdate = nullptr;
+			}
 		}
 	}
 
+	bool ScriptInstance::InvokeColliderThunk(ScriptThunks::ColliderThunk thunk, Component::Collider* collider, const char* methodName)
+	{
+		if (!thunk)
+			return false;
+
+		ScriptProfiler::Scope scope(ScriptProfiler::IsEnabled() ? ScriptProfiler::GetSample(m_scriptClass->GetName(), methodName) : nullptr);
+		MonoObject* instance = ScriptEngine::CreateComponentInstance(collider->gameObject->uuid, collider->uuid);
+		MonoException* exception = nullptr;
+		thunk(m_instance, instance, &exception);
+		if (exception)
+		{
+			m_scriptClass->PrintException((MonoObject*)exception, methodName);
+			return false;
+		}
+		return true;
+	}
+
 	void ScriptInstance::InvokeOnCollision(Physic::CollisionType type, Component::Collider* collider)
 	{
-		std::shared_ptr<CollisionMethods> methods = s_data->collisionMethods.find(m_scriptClass->GetName())->second;
+		const ScriptThunks& thunks = m_scriptClass->GetThunks();
 		switch (type)
 		{
 		case Physic::CollisionType::ENTER:
-			if (methods->onCollisionEnter) {
-				void* instance = ScriptEngine::CreateComponentInstance(collider->gameObject->uuid, collider->uuid);
-				m_scriptClass->InvokeMethod(m_instance, methods->onCollisionEnter, &instance);
-			}
+			InvokeColliderThunk(thunks.onCollisionEnter, collider, "OnCollisionEnter");
 			break;
 		case Physic::CollisionType::STAY:
-			if (methods->onCollisionStay) {
-				void* instance = ScriptEngine::CreateComponentInstance(collider->gameObject->uuid, collider->uuid);
-				m_scriptClass->InvokeMethod(m_instance, methods->onCollisionStay, &instance);
-			}
+			InvokeColliderThunk(thunks.onCollisionStay, collider, "OnCollisionStay");
 			break;
 		case Physic::CollisionType::EXIT:
-			if (methods->onCollisionExit) {
-				void* instance = ScriptEngine::CreateComponentInstance(collider->gameObject->uuid, collider->uuid);
-				m_scriptClass->InvokeMethod(m_instance, methods->onCollisionExit, &instance);
-			}
+			InvokeColliderThunk(thunks.onCollisionExit, collider, "OnCollisionExit");
 			break;
 		default:
 			break;
@@ -972,26 +1081,17 @@ namespace Scripting
 
 	void ScriptInstance::InvokeOnTrigger(Physic::CollisionType type, Component::Collider* collider)
 	{
-		std::shared_ptr<CollisionMethods> methods = s_data->collisionMethods.find(m_scriptClass->GetName())->second;
+		const ScriptThunks& thunks = m_scriptClass->GetThunks();
 		switch (type)
 		{
 		case Physic::CollisionType::ENTER:
-			if (methods->onTriggerEnter) {
-				void* instance = ScriptEngine::CreateComponentInstance(collider->gameObject->uuid, collider->uuid);
-				m_scriptClass->InvokeMethod(m_instance, methods->onTriggerEnter, &instance);
-			}
+			InvokeColliderThunk(thunks.onTriggerEnter, collider, "OnTriggerEnter");
 			break;
 		case Physic::CollisionType::STAY:
-			if (methods->onTriggerStay) {
-				void* instance = ScriptEngine::CreateComponentInstance(collider->gameObject->uuid, collider->uuid);
-				m_scriptClass->InvokeMethod(m_instance, methods->onTriggerStay, &instance);
-			}
+			InvokeColliderThunk(thunks.onTriggerStay, collider, "OnTriggerStay");
 			break;
 		case Physic::CollisionType::EXIT:
-			if (methods->onTriggerExit) {
-				void* instance = ScriptEngine::CreateComponentInstance(collider->gameObject->uuid, collider->uuid);
-				m_scriptClass->InvokeMethod(m_instance, methods->onTriggerExit, &instance);
-			}
+			InvokeColliderThunk(thunks.onTriggerExit, collider, "OnTriggerExit");
 			break;
 		default:
 			break;
@@ -5,6 +5,9 @@
 
 #include "Scripting/ScriptGlue.h"
 #include "Scripting/ScriptEngine.h"
+#include "Scripting/ScriptProfiler.h"
+#include "Scripting/ScriptJobs.h"
+#include "Scripting/ScriptScheduler.h"
 #include "Core/GameObject.h"
 #include "Core/App.h"
 #include "Core/Scene.h"
@@ -524,6 +527,105 @@ namespace Scripting
 	}
 #pragma endregion
 
+#pragma region NativeHandle
+	// The managed GameObject caches this handle once so the following calls skip the UUID lookup.
+	// Once the object is destroyed the handle resolves to nullptr and the calls do nothing.
+	static uint64_t Object_GetNativeHandle(uint64_t objectID)
+	{
+		return ScriptEngine::GetNativeHandle(ScriptEngine::GetSceneContext()->GetObjectByID(objectID));
+	}
+
+	static void Transform_GetPositionByHandle(uint64_t handle, Vector3* outPosition)
+	{
+		if (Core::GameObject* gameObject = ScriptEngine::ResolveNativeHandle(handle))
+			*outPosition = gameObject->transform->GetWorldPosition();
+	}
+	static void Transform_SetPositionByHandle(uint64_t handle, Vector3* position)
+	{
+		if (Core::GameObject* gameObject = ScriptEngine::ResolveNativeHandle(handle))
+			gameObject->transform->SetWorldPosition(*position);
+	}
+
+	static void Transform_GetRotationByHandle(uint64_t handle, Quaternion* outRotation)
+	{
+		if (Core::GameObject* gameObject = ScriptEngine::ResolveNativeHandle(handle))
+			*outRotation = gameObject->transform->GetWorldRotation();
+	}
+	static void Transform_SetRotationByHandle(uint64_t handle, Quaternion* rotation)
+	{
+		if (Core::GameObject* gameObject = ScriptEngine::ResolveNativeHandle(handle))
+			gameObject->transform->SetWorldRotation(*rotation);
+	}
+
+	static void Transform_GetLocalPositionByHandle(uint64_t handle, Vector3* outLocalPosition)
+	{
+		if (Core::GameObject* gameObject = ScriptEngine::ResolveNativeHandle(handle))
+			*outLocalPosition = gameObject->transform->GetLocalPosition();
+	}
+	static void Transform_SetLocalPositionByHandle(uint64_t handle, Vector3* localPosition)
+	{
+		if (Core::GameObject* gameObject = ScriptEngine::ResolveNativeHandle(handle))
+			gameObject->transform->SetLocalPosition(*localPosition);
+	}
+#pragma endregion
+
+#pragma region TransformBulk
+	// Run func over the first "count" (handle, value) pairs of two managed arrays (long[] and Vector3[] / Quaternion[])
+	// The handles are the ones of Object_GetNativeHandle, the ones of destroyed objects are skipped
+	// Both arrays are read in place, so one transition covers the whole batch
+	template<typename T, typename F>
+	static void ForEachHandle(MonoArray* handles, MonoArray* values, int count, F&& func)
+	{
+		if (!handles || !values || count <= 0)
+			return;
+
+		uintptr_t size = std::min<uintptr_t>({ (uintptr_t)count, mono_array_length(handles), mono_array_length(values) });
+		uint64_t* objects = mono_array_addr(handles, uint64_t, 0);
+		T* data = mono_array_addr(values, T, 0);
+		for (uintptr_t i = 0; i < size; i++)
+		{
+			if (Core::GameObject* gameObject = ScriptEngine::ResolveNativeHandle(objects[i]))
+				func(gameObject->transform, data[i]);
+		}
+	}
+
+	static void Transform_GetPositions(MonoArray* handles, MonoArray* outPositions, int count)
+	{
+		ForEachHandle<Vector3>(handles, outPositions, count, [](Component::Transform* transform, Vector3& value) { value = transform->GetWorldPosition(); });
+	}
+	static void Transform_SetPositions(MonoArray* handles, MonoArray* positions, int count)
+	{
+		ForEachHandle<Vector3>(handles, positions, count, [](Component::Transform* transform, Vector3& value) { transform->SetWorldPosition(value); });
+	}
+
+	static void Transform_GetRotations(MonoArray* handles, MonoArray* outRotations, int count)
+	{
+		ForEachHandle<Quaternion>(handles, outRotations, count, [](Component::Transform* transform, Quaternion& value) { value = transform->GetWorldRotation(); });
+	}
+	static void Transform_SetRotations(MonoArray* handles, MonoArray* rotations, int count)
+	{
+		ForEachHandle<Quaternion>(handles, rotations, count, [](Component::Transform* transform, Quaternion& value) { transform->SetWorldRotation(value); });
+	}
+
+	static void Transform_GetLocalPositions(MonoArray* handles, MonoArray* outLocalPositions, int count)
+	{
+		ForEachHandle<Vector3>(handles, outLocalPositions, count, [](Component::Transform* transform, Vector3& value) { value = transform->GetLocalPosition(); });
+	}
+	static void Transform_SetLocalPositions(MonoArray* handles, MonoArray* localPositions, int count)
+	{
+		ForEachHandle<Vector3>(handles, localPositions, count, [](Component::Transform* transform, Vector3& value) { transform->SetLocalPosition(value); });
+	}
+
+	static void Transform_GetLocalRotations(MonoArray* handles, MonoArray* outLocalRotations, int count)
+	{
+		ForEachHandle<Quaternion>(handles, outLocalRotations, count, [](Component::Transform* transform, Quaternion& value) { value = transform->GetLocalRotation(); });
+	}
+	static void Transform_SetLocalRotations(MonoArray* handles, MonoArray* localRotations, int count)
+	{
+		ForEachHandle<Quaternion>(handles, localRotations, count, [](Component::Transform* transform, Quaternion& value) { transform->SetLocalRotation(value); });
+	}
+#pragma endregion
+
 #pragma region Input
     static bool Input_IsKeyDown(Key key)
     {
@@ -719,6 +821,7 @@ namespace Scripting
 #pragma endregion
 
 #pragma region Animator
+	// Kept for scripts built against older cores, Animator_StringToHash + typed setters don't marshal a string each call
 	static void Animator_SetBoolean(uint64_t objectID, uint64_t componentID, MonoString* name, bool value)
 	{
 		Core::GameObject* gameObject = ScriptEngine::GetSceneContext()->GetObjectByID(objectID);
@@ -726,9 +829,63 @@ namespace Scripting
 		{
 			char* nameStr = mono_string_to_utf8(name);
 			animator->SetBoolean(nameStr, value);
+			mono_free(nameStr);
 			return;
 		}
 	}
+	static int Animator_StringToHash(MonoString* name)
+	{
+		char* nameStr = mono_string_to_utf8(name);
+		int id = Component::Animator::StringToHash(nameStr);
+		mono_free(nameStr);
+		return id;
+	}
+	// Same as the transform handles, a null or destroyed handle does nothing
+	static Component::Animator* GetAnimator(uint64_t handle, uint64_t componentID)
+	{
+		Core::GameObject* gameObject = ScriptEngine::ResolveNativeHandle(handle);
+		return gameObject ? gameObject->GetComponentByID<Component::Animator>(componentID) : nullptr;
+	}
+	static void Animator_SetBool(uint64_t handle, uint64_t componentID, int id, bool value)
+	{
+		if (Component::Animator* animator = GetAnimator(handle, componentID))
+			animator->SetBool(id, value);
+	}
+	static void Animator_SetFloat(uint64_t handle, uint64_t componentID, int id, float value)
+	{
+		if (Component::Animator* animator = GetAnimator(handle, componentID))
+			animator->SetFloat(id, value);
+	}
+	static void Animator_SetInteger(uint64_t handle, uint64_t componentID, int id, int value)
+	{
+		if (Component::Animator* animator = GetAnimator(handle, componentID))
+			animator->SetInteger(id, value);
+	}
+	static void Animator_SetTrigger(uint64_t handle, uint64_t componentID, int id)
+	{
+		if (Component::Animator* animator = GetAnimator(handle, componentID))
+			animator->SetTrigger(id);
+	}
+	static void Animator_ResetTrigger(uint64_t handle, uint64_t componentID, int id)
+	{
+		if (Component::Animator* animator = GetAnimator(handle, componentID))
+			animator->ResetTrigger(id);
+	}
+	static bool Animator_GetBool(uint64_t handle, uint64_t componentID, int id)
+	{
+		Component::Animator* animator = GetAnimator(handle, componentID);
+		return animator ? animator->GetBool(id) : false;
+	}
+	static float Animator_GetFloat(uint64_t handle, uint64_t componentID, int id)
+	{
+		Component::Animator* animator = GetAnimator(handle, componentID);
+		return animator ? animator->GetFloat(id) : 0.f;
+	}
+	static int Animator_GetInteger(uint64_t handle, uint64_t componentID, int id)
+	{
+		Component::Animator* animator = GetAnimator(handle, componentID);
+		return animator ? animator->GetInteger(id) : 0;
+	}
 #pragma endregion
 #pragma region SoundEmitter
 
@@ -773,6 +930,64 @@ namespace Scripting
 	}
 #pragma endregion
 
+#pragma region Coroutines
+	static uint64_t Coroutine_Start(uint64_t componentID, MonoObject* enumerator)
+	{
+		return ScriptScheduler::StartCoroutine(componentID, enumerator);
+	}
+	static void Coroutine_Stop(uint64_t handle)
+	{
+		ScriptScheduler::Stop(handle);
+	}
+	static void Coroutine_StopAll(uint64_t componentID)
+	{
+		ScriptScheduler::StopAll(componentID);
+	}
+	static uint64_t Timer_Start(uint64_t componentID, float delay, float interval, MonoObject* callback)
+	{
+		return ScriptScheduler::StartTimer(componentID, delay, interval, callback);
+	}
+	static void Timer_Stop(uint64_t handle)
+	{
+		ScriptScheduler::Stop(handle);
+	}
+#pragma endregion
+
+#pragma region Jobs
+	static uint64_t Job_Schedule(MonoObject* job, uint64_t dependency)
+	{
+		return ScriptJobs::Schedule(job, dependency);
+	}
+	static uint64_t Job_ScheduleParallelFor(MonoObject* job, int length, int batchSize, uint64_t dependency)
+	{
+		return ScriptJobs::ScheduleParallelFor(job, length, batchSize, dependency);
+	}
+	static void Job_Complete(uint64_t handle)
+	{
+		ScriptJobs::Complete(handle);
+	}
+	static bool Job_IsCompleted(uint64_t handle)
+	{
+		return ScriptJobs::IsCompleted(handle);
+	}
+
+	// Unmanaged memory for the NativeArrays shared between jobs
+	static void* NativeArray_Allocate(int size)
+	{
+		if (size <= 0)
+			return nullptr;
+		void* data = _aligned_malloc(size, 16);
+		if (!data)
+			return nullptr;
+		memset(data, 0, size);
+		return data;
+	}
+	static void NativeArray_Free(void* data)
+	{
+		_aligned_free(data);
+	}
+#pragma endregion
+
 #pragma region Application
 	static void Application_QuitRequest()
 	{
@@ -821,7 +1036,48 @@ namespace Scripting
 		RegisterComponent<Component::SoundEmitter>();
 	}
 
-#define ADD_INTERNAL_CALL(Name) mono_add_internal_call("Pandor.InternalCalls::" #Name, Name)
+	// Registered in place of every internal call so each one is timed in the script profiler
+	// and refused when called from a job without being job safe
+	template<auto Func, typename Signature = decltype(Func)>
+	struct InternalCall;
+
+	template<auto Func, typename R, typename... Args>
+	struct InternalCall<Func, R(*)(Args...)>
+	{
+		inline static ScriptProfiler::Sample* s_Sample = nullptr;
+		inline static const char* s_Name = "";
+		inline static bool s_JobSafe = false;
+
+		static R Call(Args... args)
+		{
+			if (ScriptJobs::IsJobThread())
+			{
+				if (s_JobSafe)
+					return Func(args...);
+
+				PrintError("InternalCalls.%s can't be used inside a job", s_Name);
+				if constexpr (std::is_void_v<R>)
+					return;
+				else
+					return R();
+			}
+
+			// Samples are not thread safe, calls from jobs are not profiled
+
+			ScriptProfiler::Scope scope(s_Sample);
+			return Func(args...);
+		}
+	};
+
+#define REGISTER_INTERNAL_CALL(Name, JobSafe) \
+	InternalCall<Name>::s_Sample = ScriptProfiler::GetSample("InternalCalls", #Name); \
+	InternalCall<Name>::s_Name = #Name; \
+	InternalCall<Name>::s_JobSafe = JobSafe; \
+	mono_add_internal_call("Pandor.InternalCalls::" #Name, InternalCall<Name>::Call)
+
+#define ADD_INTERNAL_CALL(Name) REGISTER_INTERNAL_CALL(Name, false)
+// Only for calls that never touch the scene, the resources or the UI
+#define ADD_JOB_SAFE_INTERNAL_CALL(Name) REGISTER_INTERNAL_CALL(Name, true)
 
 	void ScriptGlue::RegisterFunctions()
 	{
@@ -889,6 +1145,23 @@ namespace Scripting
 		ADD_INTERNAL_CALL(Transform_GetRight);
 		ADD_INTERNAL_CALL(Transform_RotateArround);
 
+		ADD_INTERNAL_CALL(Object_GetNativeHandle);
+		ADD_INTERNAL_CALL(Transform_GetPositionByHandle);
+		ADD_INTERNAL_CALL(Transform_SetPositionByHandle);
+		ADD_INTERNAL_CALL(Transform_GetRotationByHandle);
+		ADD_INTERNAL_CALL(Transform_SetRotationByHandle);
+		ADD_INTERNAL_CALL(Transform_GetLocalPositionByHandle);
+		ADD_INTERNAL_CALL(Transform_SetLocalPositionByHandle);
+
+		ADD_INTERNAL_CALL(Transform_GetPositions);
+		ADD_INTERNAL_CALL(Transform_SetPositions);
+		ADD_INTERNAL_CALL(Transform_GetRotations);
+		ADD_INTERNAL_CALL(Transform_SetRotations);
+		ADD_INTERNAL_CALL(Transform_GetLocalPositions);
+		ADD_INTERNAL_CALL(Transform_SetLocalPositions);
+		ADD_INTERNAL_CALL(Transform_GetLocalRotations);
+		ADD_INTERNAL_CALL(Transform_SetLocalRotations);
+
 		ADD_INTERNAL_CALL(Physic_Raycast);
 
 		ADD_INTERNAL_CALL(Text_GetText);
@@ -920,6 +1193,15 @@ namespace Scripting
 		ADD_INTERNAL_CALL(SceneManager_LoadScene);
 
 		ADD_INTERNAL_CALL(Animator_SetBoolean);
+		ADD_JOB_SAFE_INTERNAL_CALL(Animator_StringToHash);
+		ADD_INTERNAL_CALL(Animator_SetBool);
+		ADD_INTERNAL_CALL(Animator_SetFloat);
+		ADD_INTERNAL_CALL(Animator_SetInteger);
+		ADD_INTERNAL_CALL(Animator_SetTrigger);
+		ADD_INTERNAL_CALL(Animator_ResetTrigger);
+		ADD_INTERNAL_CALL(Animator_GetBool);
+		ADD_INTERNAL_CALL(Animator_GetFloat);
+		ADD_INTERNAL_CALL(Animator_GetInteger);
 
 		ADD_INTERNAL_CALL(SoundEmitter_Play);
 		ADD_INTERNAL_CALL(SoundEmitter_Stop);
@@ -929,8 +1211,21 @@ namespace Scripting
 
 		ADD_INTERNAL_CALL(AudioManager_PlaySoundByName);
 
+		ADD_INTERNAL_CALL(Coroutine_Start);
+		ADD_INTERNAL_CALL(Coroutine_Stop);
+		ADD_INTERNAL_CALL(Coroutine_StopAll);
+		ADD_INTERNAL_CALL(Timer_Start);
+		ADD_INTERNAL_CALL(Timer_Stop);
+
+		ADD_INTERNAL_CALL(Job_Schedule);
+		ADD_INTERNAL_CALL(Job_ScheduleParallelFor);
+		ADD_INTERNAL_CALL(Job_Complete);
+		ADD_JOB_SAFE_INTERNAL_CALL(Job_IsCompleted);
+		ADD_JOB_SAFE_INTERNAL_CALL(NativeArray_Allocate);
+		ADD_JOB_SAFE_INTERNAL_CALL(NativeArray_Free);
+
 		ADD_INTERNAL_CALL(Application_QuitRequest);
-		ADD_INTERNAL_CALL(Application_GetTimeScale);
+		ADD_JOB_SAFE_INTERNAL_CALL(Application_GetTimeScale);
 		ADD_INTERNAL_CALL(Application_SetTimeScale);
 	}
 
@@ -0,0 +1,338 @@
+#include "pch.h"
+#include "Scripting/ScriptJobs.h"
+#include "Scripting/ScriptEngine.h"
+
+#include "Core/App.h"
+#include "Core/ThreadManager.h"
+
+#include "mono/metadata/object.h"
+#include "mono/metadata/threads.h"
+#include "mono/metadata/appdomain.h"
+
+#include <mutex>
+#include <condition_variable>
+
+namespace Scripting
+{
+	using ExecuteThunk = void(__stdcall*)(MonoObject* job, MonoException** exception);
+	using ExecuteForThunk = void(__stdcall*)(MonoObject* job, int index, MonoException** exception);
+
+	struct JobState
+	{
+		JobHandle handle = 0;
+		uint32_t gcHandle = 0;
+
+		ExecuteThunk execute = nullptr;
+		ExecuteForThunk executeFor = nullptr;
+
+		int length = 1;
+		int batchSize = 1;
+		int batchCount = 1;
+
+		std::atomic<int> nextBatch = 0;
+		std::atomic<int> remainingBatches = 0;
+		std::atomic<bool> dispatched = false;
+
+		// Protected by ScriptJobsData::mutex
+		bool completed = false;
+		std::string error;
+		std::shared_ptr<JobState> dependency;
+		std::vector<std::shared_ptr<JobState>> dependents;
+	};
+
+	struct ScriptJobsData
+	{
+		std::mutex mutex;
+		std::condition_variable finished;
+
+		JobHandle nextHandle = 1;
+		std::unordered_map<JobHandle, std::shared_ptr<JobState>> jobs;
+
+		// Execute thunks resolved once per job struct
+		std::unordered_map<MonoClass*, ExecuteThunk> executeThunks;
+		std::unordered_map<MonoClass*, ExecuteForThunk> executeForThunks;
+
+		// Worker threads attached to Mono, they can only be detached from their own thread
+		std::atomic<int> attachedWorkers = 0;
+	};
+
+	static ScriptJobsData s_jobsData;
+
+	thread_local static bool s_IsJobThread = false;
+	thread_local static MonoDomain* s_AttachedDomain = nullptr;
+	thread_local static MonoThread* s_AttachedThread = nullptr;
+
+	static void Dispatch(const std::shared_ptr<JobState>& state);
+
+	static void FinishJob(const std::shared_ptr<JobState>& state)
+	{
+		std::vector<std::shared_ptr<JobState>> dependents;
+		{
+			std::scoped_lock<std::mutex> lock(s_jobsData.mutex);
+			state->completed = true;
+			state->dependency.reset();
+			std::swap(dependents, state->dependents);
+		}
+		mono_gchandle_free(state->gcHandle);
+		s_jobsData.finished.notify_all();
+
+		for (const std::shared_ptr<JobState>& dependent : dependents)
+			Dispatch(dependent);
+	}
+
+	static void RunBatches(const std::shared_ptr<JobState>& state)
+	{
+		// Worker threads are attached lazily, and again after an assembly reload
+		MonoDomain* domain = ScriptEngine::GetAppDomain();
+		if (s_AttachedDomain != domain)
+		{
+			MonoThread* thread = mono_thread_attach(domain);
+			// The main thread runs batches too, it is attached by Mono itself and never detached here
+			if (!s_AttachedThread && thread != mono_thread_get_main())
+			{
+				s_AttachedThread = thread;
+				s_jobsData.attachedWorkers++;
+			}
+			s_AttachedDomain = domain;
+		}
+
+		bool wasJobThread = s_IsJobThread;
+		s_IsJobThread = true;
+
+		int batch;
+		while ((batch = state->nextBatch.fetch_add(1)) < state->batchCount)
+		{
+			MonoObject* job = mono_gchandle_get_target(state->gcHandle);
+			MonoException* exception = nullptr;
+			if (state->executeFor)
+			{
+				int end = std::min(state->length, (batch + 1) * state->batchSize);
+				for (int i = batch * state->batchSize; i < end && !exception; i++)
+					state->executeFor(job, i, &exception);
+			}
+			else
+			{
+				state->execute(job, &exception);
+			}
+
+			if (exception)
+			{
+				MonoString* message = mono_object_to_string((MonoObject*)exception, nullptr);
+				char* messageStr = message ? mono_string_to_utf8(message) : nullptr;
+
+				std::scoped_lock<std::mutex> lock(s_jobsData.mutex);
+				if (state->error.empty())
+					state->error = messageStr ? messageStr : "Unknown exception";
+				if (messageStr)
+					mono_free(messageStr);
+			}
+
+			if (state->remainingBatches.fetch_sub(1) == 1)
+				FinishJob(state);
+		}
+
+		s_IsJobThread = wasJobThread;
+	}
+
+	static void Dispatch(const std::shared_ptr<JobState>& state)
+	{
+		if (state->dispatched.exchange(true))
+			return;
+
+		// Without worker threads the batches are run by Complete
+		Core::ThreadManager* threadManager = Core::App::Get().threadManager;
+		if (!threadManager)
+			return;
+
+		int workerCount = std::min(state->batchCount, threadManager->GetThreadCount());
+		for (int i = 0; i < workerCount; i++)
+			threadManager->AddtaskFunction([state]() { RunBatches(state); });
+	}
+
+	static JobHandle ScheduleInternal(MonoObject* job, ExecuteThunk execute, ExecuteForThunk executeFor, int length, int batchSize, JobHandle dependency)
+	{
+		std::shared_ptr<JobState> state = std::make_shared<JobState>();
+		state->gcHandle = mono_gchandle_new(job, false);
+		state->execute = execute;
+		state->executeFor = executeFor;
+		state->length = length;
+		state->batchSize = std::max(batchSize, 1);
+		state->batchCount = executeFor ? (length + state->batchSize - 1) / state->batchSize : 1;
+		state->remainingBatches = state->batchCount;
+
+		bool waitForDependency = false;
+		{
+			std::scoped_lock<std::mutex> lock(s_jobsData.mutex);
+			state->handle = s_jobsData.nextHandle++;
+			s_jobsData.jobs[state->handle] = state;
+
+			auto it = s_jobsData.jobs.find(dependency);
+			if (it != s_jobsData.jobs.end() && !it->second->completed)
+			{
+				state->dependency = it->second;
+				it->second->dependents.push_back(state);
+				waitForDependency = true;
+			}
+		}
+
+		if (state->batchCount == 0)
+		{
+			state->dispatched = true;
+			FinishJob(state);
+		}
+		else if (!waitForDependency)
+		{
+			Dispatch(state);
+		}
+		return state->handle;
+	}
+
+	JobHandle ScriptJobs::Schedule(MonoObject* job, JobHandle dependency)
+	{
+		if (!job)
+			return 0;
+
+		MonoClass* jobClass = mono_object_get_class(job);
+		auto it = s_jobsData.executeThunks.find(jobClass);
+		if (it == s_jobsData.executeThunks.end())
+		{
+			MonoMethod* method = mono_class_get_method_from_name(jobClass, "Execute", 0);
+			ExecuteThunk thunk = method ? reinterpret_cast<ExecuteThunk>(mono_method_get_unmanaged_thunk(method)) : nullptr;
+			it = s_jobsData.executeThunks.emplace(jobClass, thunk).first;
+		}
+
+		if (!it->second)
+		{
+			PrintError("Job %s has no Execute() method", mono_class_get_name(jobClass));
+			return 0;
+		}
+		return ScheduleInternal(job, it->second, nullptr, 1, 1, dependency);
+	}
+
+	JobHandle ScriptJobs::ScheduleParallelFor(MonoObject* job, int length, int batchSize, JobHandle dependency)
+	{
+		if (!job || length < 0)
+			return 0;
+
+		MonoClass* jobClass = mono_object_get_class(job);
+		auto it = s_jobsData.executeForThunks.find(jobClass);
+		if (it == s_jobsData.executeForThunks.end())
+		{
+			MonoMethod* method = mono_class_get_method_from_name(jobClass, "Execute", 1);
+			ExecuteForThunk thunk = method ? reinterpret_cast<ExecuteForThunk>(mono_method_get_unmanaged_thunk(method)) : nullptr;
+			it = s_jobsData.executeForThunks.emplace(jobClass, thunk).first;
+		}
+
+		if (!it->second)
+		{
+			PrintError("Job %s has no Execute(int) method", mono_class_get_name(jobClass));
+			return 0;
+		}
+		return ScheduleInternal(job, nullptr, it->second, length, batchSize, dependency);
+	}
+
+	void ScriptJobs::Complete(JobHandle handle)
+	{
+		std::shared_ptr<JobState> state;
+		std::shared_ptr<JobState> dependency;
+		{
+			std::scoped_lock<std::mutex> lock(s_jobsData.mutex);
+			auto it = s_jobsData.jobs.find(handle);
+			if (it == s_jobsData.jobs.end())
+				return;
+			state = it->second;
+			dependency = state->dependency;
+		}
+
+		if (dependency)
+			Complete(dependency->handle);
+
+		// Help the workers instead of waiting for them
+		Dispatch(state);
+		RunBatches(state);
+
+		std::string error;
+		{
+			std::unique_lock<std::mutex> lock(s_jobsData.mutex);
+			s_jobsData.finished.wait(lock, [&state]() { return state->completed; });
+			error = std::move(state->error);
+			s_jobsData.jobs.erase(handle);
+		}
+
+		if (!error.empty())
+			PrintError("Exception in job : %s", error.c_str());
+	}
+
+	bool ScriptJobs::IsCompleted(JobHandle handle)
+	{
+		std::scoped_lock<std::mutex> lock(s_jobsData.mutex);
+		auto it = s_jobsData.jobs.find(handle);
+		return it == s_jobsData.jobs.end() || it->second->completed;
+	}
+
+	void ScriptJobs::CompleteAll()
+	{
+		std::vector<JobHandle> handles;
+		{
+			std::scoped_lock<std::mutex> lock(s_jobsData.mutex);
+			for (auto& [handle, state] : s_jobsData.jobs)
+				handles.push_back(handle);
+		}
+
+		for (JobHandle handle : handles)
+			Complete(handle);
+	}
+
+	void ScriptJobs::ReleaseAll()
+	{
+		// Complete erases the entries, the jobs the scripts never completed included
+		CompleteAll();
+
+		Core::ThreadManager* threadManager = Core::App::Get().threadManager;
+		if (!threadManager || s_jobsData.attachedWorkers == 0)
+			return;
+
+		// One task per worker, each waits for the others so every task runs on a different thread
+		struct Barrier
+		{
+			std::mutex mutex;
+			std::condition_variable arrived;
+			int remaining;
+		};
+		std::shared_ptr<Barrier> barrier = std::make_shared<Barrier>();
+		barrier->remaining = threadManager->GetThreadCount();
+		for (int i = 0; i < threadManager->GetThreadCount(); i++)
+		{
+			threadManager->AddtaskFunction([barrier]()
+				{
+					if (s_AttachedThread)
+					{
+						mono_thread_detach(s_AttachedThread);
+						s_AttachedThread = nullptr;
+						s_AttachedDomain = nullptr;
+						s_jobsData.attachedWorkers--;
+					}
+
+					std::unique_lock<std::mutex> lock(barrier->mutex);
+					if (--barrier->remaining == 0)
+						barrier->arrived.notify_all();
+					else
+						barrier->arrived.wait(lock, [&barrier]() { return barrier->remaining == 0; });
+				});
+		}
+
+		std::unique_lock<std::mutex> lock(barrier->mutex);
+		barrier->arrived.wait(lock, [&barrier]() { return barrier->remaining == 0; });
+	}
+
+	void ScriptJobs::ClearCache()
+	{
+		s_jobsData.executeThunks.clear();
+		s_jobsData.executeForThunks.clear();
+	}
+
+	bool ScriptJobs::IsJobThread()
+	{
+		return s_IsJobThread;
+	}
+}
@@ -0,0 +1,274 @@
+#include "pch.h"
+#include "Scripting/ScriptProfiler.h"
+
+#include "mono/metadata/profiler.h"
+
+#include <mutex>
+
+// Mono lets the embedder define its own profiler state
+struct _MonoProfiler
+{
+	int unused;
+};
+
+namespace Scripting
+{
+	static constexpr size_t s_MaxGCPauses = 64;
+
+	struct ScriptProfilerData
+	{
+		std::unordered_map<std::string, ScriptProfiler::Sample> samples;
+
+		// Written from the allocating threads
+		std::atomic<uint64_t> frameAllocations = 0;
+		uint64_t lastFrameAllocations = 0;
+		uint64_t totalAllocations = 0;
+
+		// Written from the GC thread
+		std::mutex gcMutex;
+		std::vector<ScriptProfiler::GCPause> gcPauses;
+		std::chrono::high_resolution_clock::time_point gcStart;
+		uint32_t gcGeneration = 0;
+
+		uint64_t frame = 0;
+
+		MonoProfiler profiler = {};
+		MonoProfilerHandle handle = nullptr;
+		bool countAllocations = false;
+	};
+
+	static ScriptProfilerData s_profilerData;
+
+#pragma region Mono Callbacks
+	static void OnGCAllocation(MonoProfiler* profiler, MonoObject* object)
+	{
+		if (ScriptProfiler::IsEnabled())
+			s_profilerData.frameAllocations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static void OnGCEvent(MonoProfiler* profiler, MonoProfilerGCEvent event, uint32_t generation, mono_bool isSerial)
+	{
+		if (!ScriptProfiler::IsEnabled())
+			return;
+
+		switch (event)
+		{
+		case MONO_GC_EVENT_START:
+			s_profilerData.gcGeneration = generation;
+			break;
+		case MONO_GC_EVENT_PRE_STOP_WORLD:
+			s_profilerData.gcStart = std::chrono::high_resolution_clock::now();
+			break;
+		case MONO_GC_EVENT_POST_START_WORLD:
+		{
+			double pause = std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - s_profilerData.gcStart).count();
+
+			std::scoped_lock<std::mutex> lock(s_profilerData.gcMutex);
+			if (s_profilerData.gcPauses.size() >= s_MaxGCPauses)
+				s_profilerData.gcPauses.erase(s_profilerData.gcPauses.begin());
+			s_profilerData.gcPauses.push_back({ s_profilerData.frame, s_profilerData.gcGeneration, pause });
+			break;
+		}
+		default:
+			break;
+		}
+	}
+#pragma endregion
+
+	void ScriptProfiler::InstallMonoProfiler(bool allocations)
+	{
+		if (s_profilerData.handle)
+			return;
+
+		s_profilerData.handle = mono_profiler_create(&s_profilerData.profiler);
+		if (allocations)
+		{
+			mono_profiler_enable_allocations();
+			mono_profiler_set_gc_allocation_callback(s_profilerData.handle, OnGCAllocation);
+			s_profilerData.countAllocations = true;
+		}
+		mono_profiler_set_gc_event_callback(s_profilerData.handle, OnGCEvent);
+	}
+
+	void ScriptProfiler::SetEnabled(bool enabled)
+	{
+		if (enabled && !s_Enabled)
+			Reset();
+		s_Enabled = enabled;
+	}
+
+	void ScriptProfiler::AddTime(Sample* sample, double microseconds)
+	{
+		sample->callCount++;
+		sample->totalMicroseconds += microseconds;
+		sample->maxMicroseconds = std::max(sample->maxMicroseconds, microseconds);
+	}
+
+	void ScriptProfiler::NewFrame()
+	{
+		if (!s_Enabled)
+			return;
+
+		for (auto& [key, sample] : s_profilerData.samples)
+		{
+			sample.lastCallCount = sample.callCount;
+			sample.lastTotalMicroseconds = sample.totalMicroseconds;
+			sample.lastMaxMicroseconds = sample.maxMicroseconds;
+			sample.peakMicroseconds = std::max(sample.peakMicroseconds, sample.totalMicroseconds);
+
+			sample.callCount = 0;
+			sample.totalMicroseconds = 0.0;
+			sample.maxMicroseconds = 0.0;
+		}
+
+		s_profilerData.lastFrameAllocations = s_profilerData.frameAllocations.exchange(0, std::memory_order_relaxed);
+		s_profilerData.totalAllocations += s_profilerData.lastFrameAllocations;
+		s_profilerData.frame++;
+	}
+
+	void ScriptProfiler::Reset()
+	{
+		// Samples are only zeroed: their addresses are cached by the script instances
+		for (auto& [key, sample] : s_profilerData.samples)
+		{
+			std::string owner = std::move(sample.owner);
+			std::string method = std::move(sample.method);
+			sample = Sample();
+			sample.owner = std::move(owner);
+			sample.method = std::move(method);
+		}
+
+		s_profilerData.frameAllocations = 0;
+		s_profilerData.lastFrameAllocations = 0;
+		s_profilerData.totalAllocations = 0;
+		s_profilerData.frame = 0;
+
+		std::scoped_lock<std::mutex> lock(s_profilerData.gcMutex);
+		s_profilerData.gcPauses.clear();
+	}
+
+	ScriptProfiler::Sample* ScriptProfiler::GetSample(const std::string& owner, const std::string& method)
+	{
+		auto [it, inserted] = s_profilerData.samples.try_emplace(owner + "::" + method);
+		if (inserted)
+		{
+			it->second.owner = owner;
+			it->second.method = method;
+		}
+		return &it->second;
+	}
+
+	uint64_t ScriptProfiler::GetLastFrameAllocations()
+	{
+		return s_profilerData.lastFrameAllocations;
+	}
+
+	uint64_t ScriptProfiler::GetTotalAllocations()
+	{
+		return s_profilerData.totalAllocations;
+	}
+
+	void ScriptProfiler::ShowInWindow()
+	{
+		if (!WrapperUI::CollapsingHeader("Scripts"))
+			return;
+
+		bool enabled = s_Enabled;
+		if (WrapperUI::Checkbox("Profile Scripts", &enabled))
+			SetEnabled(enabled);
+		WrapperUI::SameLine();
+		if (WrapperUI::Button("Export"))
+		{
+			std::string path = "ScriptProfile.csv";
+			if (Export(path))
+				PrintLog("Script profile exported to %s", path.c_str());
+		}
+
+		if (!s_Enabled)
+			return;
+
+		if (s_profilerData.countAllocations)
+			WrapperUI::Text("Managed Allocations : %llu (total %llu)", s_profilerData.lastFrameAllocations, s_profilerData.totalAllocations);
+		else
+			WrapperUI::TextDisabled("Managed Allocations : off, enabled in the project settings");
+
+		// Sort by last frame cost, the slowest scripts come first
+		std::vector<const Sample*> sorted;
+		sorted.reserve(s_profilerData.samples.size());
+		for (auto& [key, sample] : s_profilerData.samples)
+		{
+			if (sample.lastCallCount != 0 || sample.peakMicroseconds != 0.0)
+				sorted.push_back(&sample);
+		}
+		std::sort(sorted.begin(), sorted.end(), [](const Sample* a, const Sample* b) { return a->lastTotalMicroseconds > b->lastTotalMicroseconds; });
+
+		TableFlags flags = (TableFlags)((int)TableFlags::RowBg | (int)TableFlags::Borders | (int)TableFlags::Resizable);
+		if (WrapperUI::BeginTable("ScriptProfiler", 6, flags))
+		{
+			WrapperUI::TableSetupColumn("Class", TableColumnFlags::None);
+			WrapperUI::TableSetupColumn("Method", TableColumnFlags::None);
+			WrapperUI::TableSetupColumn("Calls", TableColumnFlags::None);
+			WrapperUI::TableSetupColumn("Total (us)", TableColumnFlags::None);
+			WrapperUI::TableSetupColumn("Max (us)", TableColumnFlags::None);
+			WrapperUI::TableSetupColumn("Peak (us)", TableColumnFlags::None);
+			WrapperUI::TableHeadersRow();
+			for (const Sample* sample : sorted)
+			{
+				WrapperUI::TableNextRow();
+				WrapperUI::TableNextColumn();
+				WrapperUI::TextUnformatted(sample->owner.c_str());
+				WrapperUI::TableNextColumn();
+				WrapperUI::TextUnformatted(sample->method.c_str());
+				WrapperUI::TableNextColumn();
+				WrapperUI::Text("%u", sample->lastCallCount);
+				WrapperUI::TableNextColumn();
+				WrapperUI::Text("%.1f", sample->lastTotalMicroseconds);
+				WrapperUI::TableNextColumn();
+				WrapperUI::Text("%.1f", sample->lastMaxMicroseconds);
+				WrapperUI::TableNextColumn();
+				WrapperUI::Text("%.1f", sample->peakMicroseconds);
+			}
+			WrapperUI::EndTable();
+		}
+
+		if (WrapperUI::TreeNode("GC Pauses"))
+		{
+			std::scoped_lock<std::mutex> lock(s_profilerData.gcMutex);
+			for (auto it = s_profilerData.gcPauses.rbegin(); it != s_profilerData.gcPauses.rend(); it++)
+			{
+				WrapperUI::Text("Frame %llu | Gen %u : %.1f us", it->frame, it->generation, it->microseconds);
+			}
+			WrapperUI::TreePop();
+		}
+	}
+
+	bool ScriptProfiler::Export(const std::string& path)
+	{
+		std::ofstream file(path);
+		if (!file.is_open())
+		{
+			PrintError("Failed to open file: %s", path.c_str());
+			return false;
+		}
+
+		file << "Class,Method,Calls,Total (us),Max (us),Peak (us)\n";
+		for (auto& [key, sample] : s_profilerData.samples)
+		{
+			file << sample.owner << ',' << sample.method << ',' << sample.lastCallCount << ',' << sample.lastTotalMicroseconds << ','
+				<< sample.lastMaxMicroseconds << ',' << sample.peakMicroseconds << '\n';
+		}
+
+		file << "\nManaged Allocations (last frame),Managed Allocations (total)\n";
+		file << s_profilerData.lastFrameAllocations << ',' << s_profilerData.totalAllocations << '\n';
+
+		file << "\nGC Frame,Generation,Pause (us)\n";
+		std::scoped_lock<std::mutex> lock(s_profilerData.gcMutex);
+		for (const GCPause& pause : s_profilerData.gcPauses)
+		{
+			file << pause.frame << ',' << pause.generation << ',' << pause.microseconds << '\n';
+		}
+
+		file.close();
+		return true;
+	}
+}
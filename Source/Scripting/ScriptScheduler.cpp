@@ -0,0 +1,478 @@
+#include "pch.h"
+#include "Scripting/ScriptScheduler.h"
+#include "Scripting/ScriptEngine.h"
+
+#include "mono/metadata/object.h"
+#include "mono/metadata/class.h"
+#include "mono/metadata/appdomain.h"
+
+namespace Scripting
+{
+	using MoveNextThunk = MonoBoolean(__stdcall*)(MonoObject* enumerator, MonoException** exception);
+	using CurrentThunk = MonoObject*(__stdcall*)(MonoObject* enumerator, MonoException** exception);
+	using PredicateThunk = MonoBoolean(__stdcall*)(MonoObject* predicate, MonoException** exception);
+	using ActionThunk = void(__stdcall*)(MonoObject* action, MonoException** exception);
+
+	// 256 slots of 10ms : a full turn of the wheel is 2.56s, longer waits stay in their slot for several turns
+	static constexpr uint32_t s_WheelSize = 256;
+	static constexpr double s_TickDuration = 0.01;
+
+	enum class WaitType
+	{
+		Frame,
+		Seconds,
+		FixedUpdate,
+		Until,
+	};
+
+	struct Coroutine
+	{
+		uint64_t owner = 0;
+		uint32_t gcHandle = 0;
+		MoveNextThunk moveNext = nullptr;
+		CurrentThunk current = nullptr;
+
+		WaitType wait = WaitType::Frame;
+		// Frame of the last yield, a coroutine is resumed at most once per frame
+		uint64_t frame = 0;
+
+		uint32_t predicateHandle = 0;
+		PredicateThunk predicate = nullptr;
+	};
+
+	struct Timer
+	{
+		uint64_t owner = 0;
+		uint32_t gcHandle = 0;
+		ActionThunk invoke = nullptr;
+		float interval = 0.f;
+	};
+
+	struct WheelEntry
+	{
+		ScheduleHandle handle;
+		uint64_t tick;
+	};
+
+	struct EnumeratorThunks
+	{
+		MoveNextThunk moveNext = nullptr;
+		CurrentThunk current = nullptr;
+	};
+
+	struct ScriptSchedulerData
+	{
+		ScheduleHandle nextHandle = 1;
+
+		// Stopped handles are only removed from these maps, the wait lists skip them lazily
+		std::unordered_map<ScheduleHandle, Coroutine> coroutines;
+		std::unordered_map<ScheduleHandle, Timer> timers;
+
+		std::vector<WheelEntry> wheel[s_WheelSize];
+		uint64_t currentTick = 0;
+		double time = 0.0;
+
+		std::vector<ScheduleHandle> frameWaits;
+		std::vector<ScheduleHandle> fixedWaits;
+		uint64_t frame = 1;
+
+		// Resolved lazily, they belong to the current domain
+		bool classesLoaded = false;
+		MonoMethod* moveNextMethod = nullptr;
+		MonoMethod* currentMethod = nullptr;
+		MonoClass* waitForSecondsClass = nullptr;
+		MonoClass* waitForFixedUpdateClass = nullptr;
+		MonoClass* waitUntilClass = nullptr;
+		MonoClassField* secondsField = nullptr;
+		MonoClassField* predicateField = nullptr;
+
+		std::unordered_map<MonoClass*, EnumeratorThunks> enumeratorThunks;
+		std::unordered_map<MonoClass*, void*> invokeThunks;
+	};
+
+	static ScriptSchedulerData s_schedulerData;
+
+	static void PrintException(MonoException* exception, const char* context)
+	{
+		MonoString* message = mono_object_to_string((MonoObject*)exception, nullptr);
+		char* messageStr = message ? mono_string_to_utf8(message) : nullptr;
+		PrintError("Exception in %s : %s", context, messageStr ? messageStr : "Unknown exception");
+		if (messageStr)
+			mono_free(messageStr);
+	}
+
+	static void LoadClasses()
+	{
+		if (s_schedulerData.classesLoaded)
+			return;
+		s_schedulerData.classesLoaded = true;
+
+		MonoClass* enumeratorClass = mono_class_from_name(mono_get_corlib(), "System.Collections", "IEnumerator");
+		s_schedulerData.moveNextMethod = mono_class_get_method_from_name(enumeratorClass, "MoveNext", 0);
+		s_schedulerData.currentMethod = mono_class_get_method_from_name(enumeratorClass, "get_Current", 0);
+
+		MonoImage* coreImage = ScriptEngine::GetCoreAssemblyImage();
+		s_schedulerData.waitForSecondsClass = mono_class_from_name(coreImage, "Pandor", "WaitForSeconds");
+		s_schedulerData.waitForFixedUpdateClass = mono_class_from_name(coreImage, "Pandor", "WaitForFixedUpdate");
+		s_schedulerData.waitUntilClass = mono_class_from_name(coreImage, "Pandor", "WaitUntil");
+
+		if (s_schedulerData.waitForSecondsClass)
+			s_schedulerData.secondsField = mono_class_get_field_from_name(s_schedulerData.waitForSecondsClass, "seconds");
+		if (s_schedulerData.waitUntilClass)
+			s_schedulerData.predicateField = mono_class_get_field_from_name(s_schedulerData.waitUntilClass, "predicate");
+	}
+
+	static const EnumeratorThunks& GetEnumeratorThunks(MonoObject* enumerator)
+	{
+		MonoClass* enumeratorClass = mono_object_get_class(enumerator);
+		auto it = s_schedulerData.enumeratorThunks.find(enumeratorClass);
+		if (it != s_schedulerData.enumeratorThunks.end())
+			return it->second;
+
+		// Iterator classes implement IEnumerator.Current explicitly, the interface methods are resolved on the object
+		EnumeratorThunks thunks;
+		MonoMethod* moveNext = s_schedulerData.moveNextMethod ? mono_object_get_virtual_method(enumerator, s_schedulerData.moveNextMethod) : nullptr;
+		MonoMethod* current = s_schedulerData.currentMethod ? mono_object_get_virtual_method(enumerator, s_schedulerData.currentMethod) : nullptr;
+		if (moveNext && current)
+		{
+			thunks.moveNext = reinterpret_cast<MoveNextThunk>(mono_method_get_unmanaged_thunk(moveNext));
+			thunks.current = reinterpret_cast<CurrentThunk>(mono_method_get_unmanaged_thunk(current));
+		}
+		return s_schedulerData.enumeratorThunks.emplace(enumeratorClass, thunks).first->second;
+	}
+
+	static void* GetInvokeThunk(MonoObject* delegate)
+	{
+		MonoClass* delegateClass = mono_object_get_class(delegate);
+		auto it = s_schedulerData.invokeThunks.find(delegateClass);
+		if (it != s_schedulerData.invokeThunks.end())
+			return it->second;
+
+		MonoMethod* invoke = mono_get_delegate_invoke(delegateClass);
+		void* thunk = invoke ? mono_method_get_unmanaged_thunk(invoke) : nullptr;
+		return s_schedulerData.invokeThunks.emplace(delegateClass, thunk).first->second;
+	}
+
+	static void AddToWheel(ScheduleHandle handle, float seconds)
+	{
+		uint64_t tick = (uint64_t)std::ceil((s_schedulerData.time + std::max(seconds, 0.f)) / s_TickDuration);
+		tick = std::max(tick, s_schedulerData.currentTick + 1);
+		s_schedulerData.wheel[tick % s_WheelSize].push_back({ handle, tick });
+	}
+
+	static void FreeCoroutine(Coroutine& coroutine)
+	{
+		mono_gchandle_free(coroutine.gcHandle);
+		if (coroutine.predicateHandle)
+			mono_gchandle_free(coroutine.predicateHandle);
+	}
+
+	// Put the coroutine in the wait list matching what it yielded
+	static void Wait(ScheduleHandle handle, Coroutine& coroutine, MonoObject* yielded)
+	{
+		if (coroutine.predicateHandle)
+		{
+			mono_gchandle_free(coroutine.predicateHandle);
+			coroutine.predicateHandle = 0;
+			coroutine.predicate = nullptr;
+		}
+		coroutine.frame = s_schedulerData.frame;
+
+		MonoClass* yieldedClass = yielded ? mono_object_get_class(yielded) : nullptr;
+		if (yieldedClass && yieldedClass == s_schedulerData.waitForSecondsClass && s_schedulerData.secondsField)
+		{
+			float seconds = 0.f;
+			mono_field_get_value(yielded, s_schedulerData.secondsField, &seconds);
+			coroutine.wait = WaitType::Seconds;
+			AddToWheel(handle, seconds);
+			return;
+		}
+		if (yieldedClass && yieldedClass == s_schedulerData.waitForFixedUpdateClass)
+		{
+			coroutine.wait = WaitType::FixedUpdate;
+			s_schedulerData.fixedWaits.push_back(handle);
+			return;
+		}
+		if (yieldedClass && yieldedClass == s_schedulerData.waitUntilClass && s_schedulerData.predicateField)
+		{
+			MonoObject* predicate = nullptr;
+			mono_field_get_value(yielded, s_schedulerData.predicateField, &predicate);
+			if (predicate)
+			{
+				coroutine.predicate = reinterpret_cast<PredicateThunk>(GetInvokeThunk(predicate));
+				if (coroutine.predicate)
+					coroutine.predicateHandle = mono_gchandle_new(predicate, false);
+			}
+			coroutine.wait = coroutine.predicate ? WaitType::Until : WaitType::Frame;
+			s_schedulerData.frameWaits.push_back(handle);
+			return;
+		}
+
+		coroutine.wait = WaitType::Frame;
+		s_schedulerData.frameWaits.push_back(handle);
+	}
+
+	static void Resume(ScheduleHandle handle)
+	{
+		auto it = s_schedulerData.coroutines.find(handle);
+		if (it == s_schedulerData.coroutines.end())
+			return;
+
+		MonoObject* enumerator = mono_gchandle_get_target(it->second.gcHandle);
+		MoveNextThunk moveNext = it->second.moveNext;
+		CurrentThunk current = it->second.current;
+
+		MonoException* exception = nullptr;
+		bool running = moveNext(enumerator, &exception);
+		MonoObject* yielded = nullptr;
+		if (running && !exception)
+			yielded = current(enumerator, &exception);
+
+		if (exception)
+			PrintException(exception, "coroutine");
+
+		// The coroutine may have stopped itself
+		it = s_schedulerData.coroutines.find(handle);
+		if (it == s_schedulerData.coroutines.end())
+			return;
+
+		if (!running || exception)
+		{
+			FreeCoroutine(it->second);
+			s_schedulerData.coroutines.erase(it);
+			return;
+		}
+		Wait(handle, it->second, yielded);
+	}
+
+	static void Fire(ScheduleHandle handle)
+	{
+		auto it = s_schedulerData.timers.find(handle);
+		if (it == s_schedulerData.timers.end())
+			return;
+
+		MonoException* exception = nullptr;
+		it->second.invoke(mono_gchandle_get_target(it->second.gcHandle), &exception);
+		if (exception)
+			PrintException(exception, "timer");
+
+		// The callback may have stopped the timer
+		it = s_schedulerData.timers.find(handle);
+		if (it == s_schedulerData.timers.end())
+			return;
+
+		if (exception || it->second.interval <= 0.f)
+		{
+			mono_gchandle_free(it->second.gcHandle);
+			s_schedulerData.timers.erase(it);
+			return;
+		}
+		AddToWheel(handle, it->second.interval);
+	}
+
+	ScheduleHandle ScriptScheduler::StartCoroutine(uint64_t owner, MonoObject* enumerator)
+	{
+		if (!enumerator)
+			return 0;
+
+		LoadClasses();
+		const EnumeratorThunks& thunks = GetEnumeratorThunks(enumerator);
+		if (!thunks.moveNext)
+		{
+			PrintError("StartCoroutine : %s is not an IEnumerator", mono_class_get_name(mono_object_get_class(enumerator)));
+			return 0;
+		}
+
+		ScheduleHandle handle = s_schedulerData.nextHandle++;
+		Coroutine& coroutine = s_schedulerData.coroutines[handle];
+		coroutine.owner = owner;
+		coroutine.gcHandle = mono_gchandle_new(enumerator, false);
+		coroutine.moveNext = thunks.moveNext;
+		coroutine.current = thunks.current;
+
+		Resume(handle);
+		return handle;
+	}
+
+	ScheduleHandle ScriptScheduler::StartTimer(uint64_t owner, float delay, float interval, MonoObject* callback)
+	{
+		if (!callback)
+			return 0;
+
+		ActionThunk invoke = reinterpret_cast<ActionThunk>(GetInvokeThunk(callback));
+		if (!invoke)
+		{
+			PrintError("StartTimer : %s is not a delegate", mono_class_get_name(mono_object_get_class(callback)));
+			return 0;
+		}
+
+		ScheduleHandle handle = s_schedulerData.nextHandle++;
+		Timer& timer = s_schedulerData.timers[handle];
+		timer.owner = owner;
+		timer.gcHandle = mono_gchandle_new(callback, false);
+		timer.invoke = invoke;
+		timer.interval = interval;
+
+		AddToWheel(handle, delay);
+		return handle;
+	}
+
+	void ScriptScheduler::Stop(ScheduleHandle handle)
+	{
+		if (auto it = s_schedulerData.coroutines.find(handle); it != s_schedulerData.coroutines.end())
+		{
+			FreeCoroutine(it->second);
+			s_schedulerData.coroutines.erase(it);
+		}
+		else if (auto it = s_schedulerData.timers.find(handle); it != s_schedulerData.timers.end())
+		{
+			mono_gchandle_free(it->second.gcHandle);
+			s_schedulerData.timers.erase(it);
+		}
+	}
+
+	void ScriptScheduler::StopAll(uint64_t owner)
+	{
+		for (auto it = s_schedulerData.coroutines.begin(); it != s_schedulerData.coroutines.end();)
+		{
+			if (it->second.owner == owner)
+			{
+				FreeCoroutine(it->second);
+				it = s_schedulerData.coroutines.erase(it);
+			}
+			else
+				it++;
+		}
+		for (auto it = s_schedulerData.timers.begin(); it != s_schedulerData.timers.end();)
+		{
+			if (it->second.owner == owner)
+			{
+				mono_gchandle_free(it->second.gcHandle);
+				it = s_schedulerData.timers.erase(it);
+			}
+			else
+				it++;
+		}
+	}
+
+	void ScriptScheduler::Clear()
+	{
+		for (auto& [handle, coroutine] : s_schedulerData.coroutines)
+			FreeCoroutine(coroutine);
+		for (auto& [handle, timer] : s_schedulerData.timers)
+			mono_gchandle_free(timer.gcHandle);
+
+		s_schedulerData.coroutines.clear();
+		s_schedulerData.timers.clear();
+		for (std::vector<WheelEntry>& slot : s_schedulerData.wheel)
+			slot.clear();
+		s_schedulerData.frameWaits.clear();
+		s_schedulerData.fixedWaits.clear();
+		s_schedulerData.currentTick = 0;
+		s_schedulerData.time = 0.0;
+
+		s_schedulerData.classesLoaded = false;
+		s_schedulerData.enumeratorThunks.clear();
+		s_schedulerData.invokeThunks.clear();
+	}
+
+	void ScriptScheduler::FixedUpdate()
+	{
+		if (s_schedulerData.fixedWaits.empty())
+			return;
+
+		std::vector<ScheduleHandle> waits;
+		std::swap(waits, s_schedulerData.fixedWaits);
+		for (ScheduleHandle handle : waits)
+			Resume(handle);
+	}
+
+	void ScriptScheduler::Update(float dt)
+	{
+		// Timer wheel : only the slots between the last tick and the current one are visited
+		s_schedulerData.time += dt;
+		uint64_t targetTick = (uint64_t)(s_schedulerData.time / s_TickDuration);
+		if (targetTick > s_schedulerData.currentTick)
+		{
+			std::vector<WheelEntry> due;
+			uint64_t lastTick = std::min(targetTick, s_schedulerData.currentTick + s_WheelSize);
+			for (uint64_t tick = s_schedulerData.currentTick + 1; tick <= lastTick; tick++)
+			{
+				std::vector<WheelEntry>& slot = s_schedulerData.wheel[tick % s_WheelSize];
+				for (size_t i = 0; i < slot.size();)
+				{
+					if (slot[i].tick <= targetTick)
+					{
+						due.push_back(slot[i]);
+						slot[i] = slot.back();
+						slot.pop_back();
+					}
+					else
+						i++;
+				}
+			}
+			s_schedulerData.currentTick = targetTick;
+
+			std::stable_sort(due.begin(), due.end(), [](const WheelEntry& a, const WheelEntry& b) { return a.tick < b.tick; });
+			for (const WheelEntry& entry : due)
+			{
+				if (s_schedulerData.coroutines.count(entry.handle))
+					Resume(entry.handle);
+				else
+					Fire(entry.handle);
+			}
+		}
+
+		// Coroutines waiting for the next frame or for a predicate
+		if (!s_schedulerData.frameWaits.empty())
+		{
+			std::vector<ScheduleHandle> waits;
+			std::swap(waits, s_schedulerData.frameWaits);
+			for (ScheduleHandle handle : waits)
+			{
+				auto it = s_schedulerData.coroutines.find(handle);
+				if (it == s_schedulerData.coroutines.end())
+					continue;
+
+				// Yielded during this frame's OnUpdate
+				if (it->second.frame == s_schedulerData.frame)
+				{
+					s_schedulerData.frameWaits.push_back(handle);
+					continue;
+				}
+
+				if (it->second.wait == WaitType::Until)
+				{
+					MonoException* exception = nullptr;
+					bool done = it->second.predicate(mono_gchandle_get_target(it->second.predicateHandle), &exception);
+					if (exception)
+					{
+						PrintException(exception, "WaitUntil predicate");
+						Stop(handle);
+						continue;
+					}
+					if (!s_schedulerData.coroutines.count(handle))
+						continue;
+					if (!done)
+					{
+						s_schedulerData.frameWaits.push_back(handle);
+						continue;
+					}
+				}
+				Resume(handle);
+			}
+		}
+
+		s_schedulerData.frame++;
+	}
+
+	size_t ScriptScheduler::GetCoroutineCount()
+	{
+		return s_schedulerData.coroutines.size();
+	}
+
+	size_t ScriptScheduler::GetTimerCount()
+	{
+		return s_schedulerData.timers.size();
+	}
+}
@@ -9,12 +9,17 @@
 #include <Resources/SkeletalMesh.h>
 #include <Resources/Animation.h>
 #include <Resources/AnimationController.h>
+#include <Components/Animator.h>
 #include <Resources/Skeleton.h>
 #include <Resources/Material.h>
 #include <OpenFBX/ofbx.h>
 
 #define FBXScale 0.01f
 
+// Header of the compressed animation clips
+static constexpr char s_AnimMagic[4] = { 'P', 'A', 'N', 'M' };
+static constexpr uint32_t s_AnimVersion = 1;
+
 std::string ExtractName(std::string path)
 {
 	if (path.empty())
@@ -145,7 +150,7 @@ void LoadMultithread(Resources::Model* model, ofbx::IScene* scene, const std::st
 	Utils::Loader::FBX::LoadMeshes(model, scene, path);
 	for (int i = 0, n = scene->getAnimationStackCount(); i < n; ++i)
 	{
-		Utils::Loader::FBX::LoadAnimation(scene, scene->getAnimationStack(i), path);
+		Utils::Loader::FBX::LoadAnimation(scene, scene->getAnimationStack(i), path, Utils::Loader::ANIM::LoadImportSettings(path));
 		break;
 	}
 	scene->destroy();
@@ -484,6 +489,7 @@ void Utils::Loader::FBX::LoadSkeleton(const ofbx::Skin* Skel, std::string path,
 		NewSkel->RootBone = root;
 
 	NewSkel->Bones = Bones;
+	NewSkel->SortBones();
 
 	auto getIndices = [&](int index, int i) -> int
 	{
@@ -595,7 +601,7 @@ Resources::Material* Utils::Loader::FBX::LoadMaterial(std::string matPath, const
 	return mat;
 }
 
-void Utils::Loader::FBX::LoadAnimation(ofbx::IScene* scene, const ofbx::AnimationStack* stack, std::string path)
+void Utils::Loader::FBX::LoadAnimation(ofbx::IScene* scene, const ofbx::AnimationStack* stack, std::string path, const Resources::AnimationCompressionSettings& settings)
 {
 	// Return if no curve node
 	if (!stack->getLayer(0)->getCurveNode(0))
@@ -608,6 +614,10 @@ void Utils::Loader::FBX::LoadAnimation(ofbx::IScene* scene, const ofbx::Animatio
 	Animation->FrameRate = scene->getSceneFrameRate();
 	if (const ofbx::AnimationLayer* layer = stack->getLayer(0))
 	{
+		// Full precision keys, compressed once every curve is read
+		std::vector<Resources::AnimationCurve<Math::Vector3>> positions;
+		std::vector<Resources::AnimationCurve<Math::Quaternion>> rotations;
+
 		for (int k = 0; layer->getCurveNode(k); ++k)
 		{
 			// Get the k-th curve node
@@ -615,8 +625,8 @@ void Utils::Loader::FBX::LoadAnimation(ofbx::IScene* scene, const ofbx::Animatio
 
 			// Check if the curve node is for translation ("T") or rotation ("R")
 			if (!std::strcmp(node->name, "T")) {
-				// Add a new vector of Math::Vec3 to the KeyPositions field
-				Animation->KeyPositions.push_back(std::unordered_map<int, Math::Vector3>());
+				// Add a new position curve
+				positions.emplace_back();
 				size_t i = 0;
 
 				if (node->getCurve((int)i)) {
@@ -633,13 +643,13 @@ void Utils::Loader::FBX::LoadAnimation(ofbx::IScene* scene, const ofbx::Animatio
 							}
 						}
 						i = 0;
-						Animation->KeyPositions.back()[keyPosition] = (Position);
+						positions.back().AddKey((float)keyPosition, Position);
 					}
 				}
 			}
 			else if (!std::strcmp(node->name, "R")) {
-				// Add a new vector of Math::Quat to the KeyRotations field
-				Animation->KeyRotations.push_back(std::unordered_map<int, Math::Quaternion>());
+				// Add a new rotation curve
+				rotations.emplace_back();
 				size_t i = 0;
 
 				if (node->getCurve((int)i)) {
@@ -656,13 +666,14 @@ void Utils::Loader::FBX::LoadAnimation(ofbx::IScene* scene, const ofbx::Animatio
 							}
 						}
 						i = 0;
-						Animation->KeyRotations.back()[keyPosition] = (Rotation.ToQuaternion());
+						rotations.back().AddKey((float)keyPosition, Rotation.ToQuaternion());
 					}
 				}
 			}
 
 		}
 
+		Animation->Compress(positions, rotations, settings);
 		Animation->SendResource();
 		ResourcesManager::Get()->Add(Animation->GetPath(), Animation);
 		Utils::Loader::ANIM::Save(Animation);
@@ -1076,52 +1087,146 @@ void Utils::Loader::ANIM::Load(Resources::Animation* anim, const std::string& pa
 	auto data = Utils::Loader::ReadFile(path.c_str(), size, sucess);
 	if (sucess)
 	{
-		Parse(anim, data, size);
+		// Text files are the clips saved before the compression
+		if (size >= sizeof(s_AnimMagic) && std::memcmp(data, s_AnimMagic, sizeof(s_AnimMagic)) == 0)
+		{
+			if (!ParseBinary(anim, data, size))
+				PrintError("Animation file %s is corrupted", path.c_str());
+		}
+		else
+		{
+			Parse(anim, data, size);
+			// Converted once, the next loads read the compressed keys
+			Save(anim);
+		}
 	}
 	delete[] data;
 	data = nullptr;
 }
 
+// Binary clip, little endian :
+// magic, version, frame rate, key count
+// position curve count, for each : key count, min, extent, times[keys], values[keys * 3]
+// rotation curve count, for each : key count, times[keys], values[keys * 3]
 void Utils::Loader::ANIM::Save(Resources::Animation* anim)
 {
 	if (!anim)
 		return;
-	std::string  output;
-	output += "Translation\n";
-	for (int i = 0; i < anim->KeyPositions.size(); i++)
+	std::vector<char> output;
+	auto write = [&output](const void* value, size_t size)
 	{
-		for (int j = 0; j < anim->KeyPositions[i].size(); j++)
-		{
-			output += StringFormat("%d, %d, %s\n", i, j, anim->KeyPositions[i][j].ToString().c_str());
-		}
-	}
+		output.insert(output.end(), (const char*)value, (const char*)value + size);
+	};
+	auto writeU32 = [&write](uint32_t value) { write(&value, sizeof(value)); };
 
-	output += "Rotation\n";
-	for (int i = 0; i < anim->KeyRotations.size(); i++)
+	write(s_AnimMagic, sizeof(s_AnimMagic));
+	writeU32(s_AnimVersion);
+	write(&anim->FrameRate, sizeof(float));
+	writeU32((uint32_t)anim->KeyCount);
+
+	writeU32((uint32_t)anim->PositionCurves.size());
+	for (auto& curve : anim->PositionCurves)
 	{
-		for (int j = 0; j < anim->KeyRotations[i].size(); j++)
-		{
-			output += StringFormat("%d, %d, %s\n", i, j, anim->KeyRotations[i][j].ToString().c_str());
-		}
+		writeU32((uint32_t)curve.times.size());
+		write(&curve.min, sizeof(float) * 3);
+		write(&curve.extent, sizeof(float) * 3);
+		write(curve.times.data(), curve.times.size() * sizeof(uint16_t));
+		write(curve.values.data(), curve.values.size() * sizeof(uint16_t));
 	}
 
-	output += "FrameRate : " + std::to_string(anim->FrameRate) + '\n';
-	output += "KeyCount : " + std::to_string(anim->KeyCount) + '\n';
+	writeU32((uint32_t)anim->RotationCurves.size());
+	for (auto& curve : anim->RotationCurves)
+	{
+		writeU32((uint32_t)curve.times.size());
+		write(curve.times.data(), curve.times.size() * sizeof(uint16_t));
+		write(curve.values.data(), curve.values.size() * sizeof(uint16_t));
+	}
 
 	FILE* file;
-	fopen_s(&file, anim->GetFullPath().c_str(), "w");
+	fopen_s(&file, anim->GetFullPath().c_str(), "wb");
 	if (file)
 	{
 		PrintLog("Creating Animation File %s!", anim->GetFullPath().c_str());
-		fputs(output.c_str(), file);
+		fwrite(output.data(), 1, output.size(), file);
 		fclose(file);
 	}
 }
 
+bool Utils::Loader::ANIM::ParseBinary(Resources::Animation* anim, const char* data, uint32_t size)
+{
+	uint32_t pos = 0;
+	auto read = [&](void* value, size_t length)
+	{
+		if (pos + length > size)
+			return false;
+		std::memcpy(value, data + pos, length);
+		pos += (uint32_t)length;
+		return true;
+	};
+	// Counts are checked against the remaining size before anything is allocated
+	auto readCount = [&](uint32_t& count, size_t elementSize)
+	{
+		return read(&count, sizeof(count)) && (size_t)count * elementSize <= size - pos;
+	};
+
+	char magic[sizeof(s_AnimMagic)];
+	uint32_t version = 0;
+	uint32_t keyCount = 0;
+	float frameRate = 0.f;
+	if (!read(magic, sizeof(magic)) || !read(&version, sizeof(version)) || version != s_AnimVersion)
+		return false;
+	if (!read(&frameRate, sizeof(frameRate)) || !read(&keyCount, sizeof(keyCount)))
+		return false;
+
+	std::vector<Resources::CompressedPositionCurve> positions;
+	std::vector<Resources::CompressedRotationCurve> rotations;
+
+	uint32_t curveCount = 0;
+	if (!readCount(curveCount, sizeof(uint32_t)))
+		return false;
+	positions.resize(curveCount);
+	for (auto& curve : positions)
+	{
+		uint32_t keys = 0;
+		if (!readCount(keys, sizeof(uint16_t) * 4))
+			return false;
+		curve.times.resize(keys);
+		curve.values.resize(keys * 3);
+		if (!read(&curve.min, sizeof(float) * 3) || !read(&curve.extent, sizeof(float) * 3)
+			|| !read(curve.times.data(), keys * sizeof(uint16_t)) || !read(curve.values.data(), keys * 3 * sizeof(uint16_t)))
+			return false;
+	}
+
+	if (!readCount(curveCount, sizeof(uint32_t)))
+		return false;
+	rotations.resize(curveCount);
+	for (auto& curve : rotations)
+	{
+		uint32_t keys = 0;
+		if (!readCount(keys, sizeof(uint16_t) * 4))
+			return false;
+		curve.times.resize(keys);
+		curve.values.resize(keys * 3);
+		if (!read(curve.times.data(), keys * sizeof(uint16_t)) || !read(curve.values.data(), keys * 3 * sizeof(uint16_t)))
+			return false;
+	}
+
+	Core::App::Get().threadManager->Lock();
+	anim->FrameRate = frameRate;
+	anim->PositionCurves = std::move(positions);
+	anim->RotationCurves = std::move(rotations);
+	anim->UpdateKeyCount();
+	Core::App::Get().threadManager->Unlock();
+	anim->hasBeenSent = true;
+	return true;
+}
+
 void Utils::Loader::ANIM::Parse(Resources::Animation* anim, const char* data, uint32_t size)
 {
 	uint32_t pos = 0;
 	bool keyposition = true;
+	std::vector<Resources::AnimationCurve<Math::Vector3>> positions;
+	std::vector<Resources::AnimationCurve<Math::Quaternion>> rotations;
 	while (pos < size)
 	{
 		if (data[pos] == 'R')
@@ -1145,18 +1250,56 @@ void Utils::Loader::ANIM::Parse(Resources::Animation* anim, const char* data, ui
 		else if (data[pos] >= '0' && data[pos] <= '9')
 		{
 			if (keyposition)
-				GetKeyPos(data, pos, anim);
+				GetKeyPos(data, pos, positions);
 			else
-				GetKeyRot(data, pos, anim);
+				GetKeyRot(data, pos, rotations);
 		}
 		else
 		{
 			pos++;
 		}
 	}
+	Resources::AnimationCompressionSettings settings = LoadImportSettings(anim->GetFullPath());
+	Core::App::Get().threadManager->Lock();
+	anim->Compress(positions, rotations, settings);
+	Core::App::Get().threadManager->Unlock();
 	anim->hasBeenSent = true;
 }
 
+Resources::AnimationCompressionSettings Utils::Loader::ANIM::LoadImportSettings(const std::string& path)
+{
+	const Core::ProjectSettings& project = Core::App::Get().projectSettings;
+	Resources::AnimationCompressionSettings settings;
+	settings.positionTolerance = project.animationPositionTolerance;
+	settings.rotationTolerance = project.animationRotationTolerance;
+
+	std::ifstream file(path.substr(0, path.find_last_of('.')) + ".AnimImport");
+	std::string line;
+	while (file.is_open() && std::getline(file, line))
+	{
+		size_t separator = line.find(" : ");
+		if (separator == std::string::npos)
+			continue;
+		std::string key = line.substr(0, separator);
+		std::istringstream value(line.substr(separator + 3));
+		if (key == "PositionTolerance")
+			value >> settings.positionTolerance;
+		else if (key == "RotationTolerance")
+			value >> settings.rotationTolerance;
+		else if (key == "Bone")
+		{
+			size_t id = 0;
+			float multiplier = 1.f;
+			if (!(value >> id >> multiplier))
+				continue;
+			if (id >= settings.boneTolerances.size())
+				settings.boneTolerances.resize(id + 1, 1.f);
+			settings.boneTolerances[id] = multiplier;
+		}
+	}
+	return settings;
+}
+
 Math::Vector3 Utils::Loader::ANIM::GetVector3(const char* data, uint32_t& pos, int dec)
 {
 	Vector3 position;
@@ -1230,36 +1373,32 @@ float Utils::Loader::ANIM::GetFloat(const char* data, uint32_t& pos, int dec)
 	return std::stof(str);
 }
 
-inline void Utils::Loader::ANIM::GetKeyPos(const char* data, uint32_t& pos, Resources::Animation* anim)
+inline void Utils::Loader::ANIM::GetKeyPos(const char* data, uint32_t& pos, std::vector<Resources::AnimationCurve<Math::Vector3>>& curves)
 {
 	int currentIndex = GetInt2(data, pos, 0);
 	int currentKey = 0;
-	Core::App::Get().threadManager->Lock();
-	anim->KeyPositions.push_back(std::unordered_map<int, Math::Vector3>());
+	curves.emplace_back();
 	while (data[pos] >= '0' && data[pos] <= '9' && GetInt2(data, pos, 0) == currentIndex) {
 		currentIndex = GetInt(data, pos, 0);
 		currentKey = GetInt(data, pos, 1);
 
 		auto vector = GetVector3(data, pos, 2);
-		anim->KeyPositions.back()[currentKey] = vector;
+		curves.back().AddKey((float)currentKey, vector);
 	}
-	Core::App::Get().threadManager->Unlock();
 }
 
-inline void Utils::Loader::ANIM::GetKeyRot(const char* data, uint32_t& pos, Resources::Animation* anim)
+inline void Utils::Loader::ANIM::GetKeyRot(const char* data, uint32_t& pos, std::vector<Resources::AnimationCurve<Math::Quaternion>>& curves)
 {
 	int currentIndex = GetInt2(data, pos, 0);
 	int currentKey = 0;
-	Core::App::Get().threadManager->Lock();
-	anim->KeyRotations.push_back(std::unordered_map<int, Math::Quaternion>());
+	curves.emplace_back();
 	while (data[pos] >= '0' && data[pos] <= '9' && GetInt2(data, pos, 0) == currentIndex) {
 		currentIndex = GetInt(data, pos, 0);
 		currentKey = GetInt(data, pos, 1);
 
 		auto vector = MAT::GetVector4(data, pos, 2);
-		anim->KeyRotations.back()[currentKey] = vector;
+		curves.back().AddKey((float)currentKey, Math::Quaternion(vector));
 	}
-	Core::App::Get().threadManager->Unlock();
 }
 
 void Utils::Loader::ANIMC::Load(Resources::AnimationController* animC, const std::string& path)
@@ -1281,7 +1420,10 @@ void Utils::Loader::ANIMC::Save(Resources::AnimationController* animC)
 	output += "Parameters :\n";
 	for (auto& parameter : animC->parameters)
 	{
-		output += parameter.first + ": " + std::to_string(parameter.second) + '\n';
+		// name: value type
+		std::string value = parameter.type == Resources::AnimatorParameterType::Float ? std::to_string(parameter.defaultValue.f) :
+			parameter.type == Resources::AnimatorParameterType::Int ? std::to_string(parameter.defaultValue.i) : std::to_string(parameter.defaultValue.b);
+		output += parameter.name + ": " + value + ' ' + std::to_string((int)parameter.type) + '\n';
 	}
 	output += "EndParameters\n";
 	for (auto& state : animC->states)
@@ -1293,6 +1435,20 @@ void Utils::Loader::ANIMC::Save(Resources::AnimationController* animC)
 		output += "\tLoop : " + std::to_string(state.second->loop) + '\n';
 		output += "\tPos : " + state.second->pos.ToString() + '\n';
 		output += "\tColor : " + state.second->color.ToString() + '\n';
+		if (state.second->useBlendTree)
+		{
+			const Resources::BlendTree& tree = state.second->blendTree;
+			output += "\tBlend : " + std::to_string((int)tree.type) + '\n';
+			if (tree.parameterX >= 0)
+				output += "\tBlendX : " + animC->parameters[tree.parameterX].name + '\n';
+			if (tree.parameterY >= 0)
+				output += "\tBlendY : " + animC->parameters[tree.parameterY].name + '\n';
+			for (auto& motion : tree.motions)
+			{
+				if (motion.animation)
+					output += "\tMotion : " + std::to_string(motion.position.x) + ' ' + std::to_string(motion.position.y) + ' ' + motion.animation->GetPath() + '\n';
+			}
+		}
 		output += "EndState\n";
 	}
 	for (auto& link : animC->links)
@@ -1306,12 +1462,32 @@ void Utils::Loader::ANIMC::Save(Resources::AnimationController* animC)
 		output += "\tConditions :\n";
 		for (auto& condition : link->conditions)
 		{
-			output += "\t\t" + condition.first->first + '\n';
-			output += "\t\t" + std::to_string(condition.second) + '\n';
+			if (condition.parameter < 0)
+				continue;
+			// The first value is the bool expected by older versions, followed by the mode and the threshold
+			output += "\t\t" + animC->parameters[condition.parameter].name + '\n';
+			output += "\t\t" + std::to_string(condition.mode != Resources::ConditionMode::IfNot) + ' ' + std::to_string((int)condition.mode) + ' ' + std::to_string(condition.threshold) + '\n';
 		}
 		output += "\tEndConditions\n";
 		output += "EndLink\n";
 	}
+	for (auto& layer : animC->layers)
+	{
+		output += "Layer : " + layer.name + '\n';
+		if (layer.controller)
+			output += "\tController : " + layer.controller->GetPath() + '\n';
+		output += "\tWeight : " + std::to_string(layer.weight) + '\n';
+		output += "\tMode : " + std::to_string((int)layer.mode) + '\n';
+		if (!layer.mask.weights.empty())
+		{
+			// One weight per bone, in the order of Skeleton::Bones
+			output += "\tMask :";
+			for (float weight : layer.mask.weights)
+				output += ' ' + std::to_string(weight);
+			output += '\n';
+		}
+		output += "EndLayer\n";
+	}
 
 	FILE* file;
 	fopen_s(&file, animC->GetFullPath().c_str(), "w");
@@ -1331,9 +1507,13 @@ void Utils::Loader::ANIMC::Parse(Resources::AnimationController* animC, const ch
 	{
 		if (data[pos] == 'S')
 		{
-			auto state = GetState(data, pos);
+			auto state = GetState(animC, data, pos);
 			animC->states[state->name] = (state);
 		}
+		else if (data[pos] == 'L' && data[pos + 1] == 'a')
+		{
+			animC->layers.push_back(GetLayer(data, pos));
+		}
 		else if (data[pos] == 'L')
 		{
 			auto link = GetLink(animC, data, pos);
@@ -1350,7 +1530,7 @@ void Utils::Loader::ANIMC::Parse(Resources::AnimationController* animC, const ch
 	}
 }
 
-Resources::StateRect* Utils::Loader::ANIMC::GetState(const char* data, uint32_t& pos)
+Resources::StateRect* Utils::Loader::ANIMC::GetState(Resources::AnimationController* animC, const char* data, uint32_t& pos)
 {
 	StateRect* state = new StateRect();
 	while (data[pos] != 'E')
@@ -1386,6 +1566,33 @@ Resources::StateRect* Utils::Loader::ANIMC::GetState(const char* data, uint32_t&
 			bool loop = GetInt(data, pos, 7);
 			state->loop = loop;
 		}
+		else if (data[pos] == 'B')
+		{
+			state->useBlendTree = true;
+			std::string line = GetLine(data, pos);
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			if (line.rfind("BlendX : ", 0) == 0)
+				state->blendTree.parameterX = animC->GetParameterIndex(line.substr(9));
+			else if (line.rfind("BlendY : ", 0) == 0)
+				state->blendTree.parameterY = animC->GetParameterIndex(line.substr(9));
+			else
+				state->blendTree.type = (Resources::BlendTreeType)std::stoi(line.substr(8));
+		}
+		else if (data[pos] == 'M')
+		{
+			// Position of the motion then the path of its animation
+			std::istringstream line(GetLine(data, pos).substr(9));
+			Resources::BlendTreeMotion motion;
+			std::string path;
+			line >> motion.position.x >> motion.position.y;
+			line.get();
+			std::getline(line, path);
+			if (!path.empty() && path.back() == '\r')
+				path.pop_back();
+			motion.animation = Resources::ResourcesManager::Get()->GetOrLoad<Resources::Animation>(path);
+			state->blendTree.motions.push_back(motion);
+		}
 		else
 		{
 			SkipLine(data, pos);
@@ -1440,15 +1647,67 @@ inline Resources::Link* Utils::Loader::ANIMC::GetLink(Resources::AnimationContro
 	return link;
 }
 
+inline Resources::AnimationLayer Utils::Loader::ANIMC::GetLayer(const char* data, uint32_t& pos)
+{
+	Resources::AnimationLayer layer;
+	while (data[pos] != 'E')
+	{
+		if (data[pos] == 'L' || data[pos] == 'C' || data[pos] == 'W' || data[pos] == 'M')
+		{
+			// "Key : value"
+			std::string line = GetLine(data, pos);
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			size_t separator = line.find(" : ");
+			std::string key = line.substr(0, separator);
+			std::string value = separator != std::string::npos ? line.substr(separator + 3) : std::string();
+			if (key == "Layer")
+				layer.name = value;
+			else if (key == "Controller")
+				layer.controller = Resources::ResourcesManager::Get()->GetOrLoad<Resources::AnimationController>(value);
+			else if (key == "Weight")
+				layer.weight = std::stof(value);
+			else if (key == "Mode")
+				layer.mode = (Resources::BlendMode)std::stoi(value);
+			else if (key == "Mask")
+			{
+				std::istringstream weights(value);
+				float weight = 0.f;
+				while (weights >> weight)
+					layer.mask.weights.push_back(weight);
+			}
+		}
+		else
+		{
+			SkipLine(data, pos);
+		}
+	}
+	return layer;
+}
+
 void Utils::Loader::ANIMC::GetParameters(Resources::AnimationController*& animC, const char* data, uint32_t& pos)
 {
 	SkipLine(data, pos);
 	while (data[pos] != 'E')
 	{
-		auto name = GetString(data, pos, 0);
+		Resources::AnimatorParameter parameter;
+		parameter.name = GetString(data, pos, 0);
+		parameter.id = Component::Animator::StringToHash(parameter.name);
 		pos++;
-		auto value = GetInt(data, pos, 0);
-		animC->parameters[name] = value;
+
+		// Older files only have a bool value
+		std::istringstream line(GetLine(data, pos));
+		float value = 0.f;
+		int type = 0;
+		line >> value >> type;
+		parameter.type = (Resources::AnimatorParameterType)type;
+		switch (parameter.type)
+		{
+		case Resources::AnimatorParameterType::Float:	parameter.defaultValue.f = value; break;
+		case Resources::AnimatorParameterType::Int:		parameter.defaultValue.i = (int)value; break;
+		default:										parameter.defaultValue.b = value != 0.f; break;
+		}
+		animC->parameters.push_back(parameter);
 		SkipLine(data, pos);
 	}
 }
@@ -1462,9 +1721,25 @@ inline void Utils::Loader::ANIMC::GetConditions(Resources::AnimationController*&
 	{
 		auto name = GetString(data, pos, 0);
 		pos += 2;
-		bool value = GetInt(data, pos, 0);
-		if (animC->parameters.count(name))
-			link->conditions.push_back(std::make_pair(&(*animC->parameters.find(name)), value));
+
+		// Older files only have the expected bool value
+		std::istringstream line(GetLine(data, pos));
+		int value = 1;
+		int mode = 0;
+		Resources::Condition condition;
+		line >> value;
+		if (line >> mode)
+		{
+			condition.mode = (Resources::ConditionMode)mode;
+			line >> condition.threshold;
+		}
+		else
+		{
+			condition.mode = value ? Resources::ConditionMode::If : Resources::ConditionMode::IfNot;
+		}
+		condition.parameter = animC->GetParameterIndex(name);
+		if (condition.parameter >= 0)
+			link->conditions.push_back(condition);
 		SkipLine(data, pos);
 		SkipLine(data, pos);
 		if (data[pos] == '\t')
@@ -1520,6 +1795,17 @@ std::string Utils::Loader::ANIMC::GetString(const char* data, uint32_t& pos, int
 	return name;
 }
 
+std::string Utils::Loader::ANIMC::GetLine(const char* data, uint32_t& pos)
+{
+	std::string line;
+	while (data[pos] != '\0' && data[pos] != '\n')
+	{
+		line.push_back(data[pos]);
+		pos++;
+	}
+	return line;
+}
+
 int Utils::Loader::ANIMC::GetInt(const char* data, uint32_t& pos, int dec)
 {
 	pos += dec;